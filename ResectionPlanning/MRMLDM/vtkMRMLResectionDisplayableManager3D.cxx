@@ -39,11 +39,15 @@
 #include "vtkMRMLResectionSurfaceDisplayNode.h"
 #include "vtkBezierSurfaceWidget.h"
 #include "vtkHausdorffDistancePointSetFilter.h"
+#include "vtkPointSetLocatorCache.h"
+#include "vtkSparseSignedDistanceField.h"
+#include "vtkTriangleBVH.h"
 
 // MRML includes
 #include <vtkMRMLScene.h>
 #include <vtkMRMLNode.h>
 #include <vtkMRMLViewNode.h>
+#include <vtkMRMLModelNode.h>
 
 // VTK includes
 #include <vtkObjectFactory.h>
@@ -51,19 +55,23 @@
 #include <vtkRenderWindowInteractor.h>
 #include <vtkCallbackCommand.h>
 #include <vtkPointData.h>
+#include <vtkPolyData.h>
 #include <vtkContourFilter.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkActor.h>
 #include <vtkRenderer.h>
-#include <vtkPolyDataNormals.h>
 #include <vtkColorTransferFunction.h>
 #include <vtkXMLPolyDataWriter.h>
 #include <vtkClipPolyData.h>
 #include <vtkDistancePolyDataFilter.h>
 #include <vtkCollection.h>
 #include <vtkDoubleArray.h>
+#include <vtkIdList.h>
 #include <vtk3DWidget.h>
 
+// STD includes
+#include <cmath>
+
 //------------------------------------------------------------------------------
 vtkStandardNewMacro(vtkMRMLResectionDisplayableManager3D);
 
@@ -72,6 +80,10 @@ vtkStandardNewMacro(vtkMRMLResectionDisplayableManager3D);
 vtkMRMLResectionDisplayableManager3D::vtkMRMLResectionDisplayableManager3D()
 {
   vtkDebugMacro("Creating vtkMRMLResectionDisplayableManager3D");
+
+  this->LocatorCache = vtkSmartPointer<vtkPointSetLocatorCache>::New();
+  this->TumorDistanceField = vtkSmartPointer<vtkSparseSignedDistanceField>::New();
+  this->TumorDistanceFieldTime = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -225,6 +237,8 @@ AddWidget(vtkMRMLResectionSurfaceNode *resectionNode)
   updateDistanceMapCallback->SetClientData(this);
   surfaceWidget->AddObserver(vtkCommand::StartInteractionEvent,
                              updateDistanceMapCallback);
+  surfaceWidget->AddObserver(vtkCommand::InteractionEvent,
+                             updateDistanceMapCallback);
   surfaceWidget->AddObserver(vtkCommand::EndInteractionEvent,
                              updateDistanceMapCallback);
 
@@ -278,14 +292,11 @@ AddDistanceMapPipeline(vtkMRMLResectionSurfaceNode *node)
   // Create and register the distance-to-tumors filter
   vtkSmartPointer<vtkHausdorffDistancePointSetFilter> distanceFilter =
     vtkSmartPointer<vtkHausdorffDistancePointSetFilter>::New();
-  distanceFilter->SetTargetDistanceMethod(0);
+  distanceFilter->SetTargetDistanceMethod(
+    vtkHausdorffDistancePointSetFilter::POINT_TO_CELL);
+  distanceFilter->SetLocatorCache(this->LocatorCache);
   this->NodeDistanceFilterMap[node] = distanceFilter;
 
-  // Create normals filter
-  vtkSmartPointer<vtkPolyDataNormals> normals =
-    vtkSmartPointer<vtkPolyDataNormals>::New();
-  normals->SetInputConnection(distanceFilter->GetOutputPort());
-
   // Create the contour filter
   vtkSmartPointer<vtkContourFilter> contourFilter =
     vtkSmartPointer<vtkContourFilter>::New();
@@ -294,6 +305,10 @@ AddDistanceMapPipeline(vtkMRMLResectionSurfaceNode *node)
   contourFilter->SetValue(0, node->GetResectionMargin());
   this->NodeContourFilterMap[node] = contourFilter;
 
+  // Create and register the surface holding the distance map during
+  // interaction
+  this->NodeLiveDistanceSurfaceMap[node] = vtkSmartPointer<vtkPolyData>::New();
+
   // Create and register the color map
   vtkSmartPointer<vtkColorTransferFunction> colorMap =
     vtkSmartPointer<vtkColorTransferFunction>::New();
@@ -304,10 +319,11 @@ AddDistanceMapPipeline(vtkMRMLResectionSurfaceNode *node)
   colorMap->AllowDuplicateScalarsOn();
   this->NodeColorMap[node] = colorMap;
 
-  // Create the mapper for the distance map
+  // Create the mapper for the distance map (the normals of the Bézier surface
+  // are passed through by the distance filter)
   vtkSmartPointer<vtkPolyDataMapper> distanceMapper =
     vtkSmartPointer<vtkPolyDataMapper>::New();
-  distanceMapper->SetInputConnection(normals->GetOutputPort());
+  distanceMapper->SetInputConnection(distanceFilter->GetOutputPort());
   distanceMapper->SetLookupTable(colorMap);
   distanceMapper->ScalarVisibilityOn();
   distanceMapper->SetScalarRange(0,100);
@@ -467,6 +483,15 @@ void vtkMRMLResectionDisplayableManager3D::OnMRMLSceneEndClose()
     this->NodeDistanceFilterMap.erase(distanceFilterIt);
     }
 
+  // Removing the locators of the distance filters
+  this->LocatorCache->RemoveAllDataSets();
+
+  // Removing the surfaces of the distance maps during interaction
+  this->NodeLiveDistanceSurfaceMap.clear();
+
+  // Removing the results of the margin checks
+  this->NodeMarginViolatedMap.clear();
+
   this->SetUpdateFromMRMLRequested(1);
   this->RequestRender();
 }
@@ -593,6 +618,12 @@ OnMRMLSceneNodeRemoved(vtkMRMLNode *node)
     }
   this->NodeContourFilterMap.erase(contourFilterIt);
 
+  // Remove the surface of the distance map during interaction
+  this->NodeLiveDistanceSurfaceMap.erase(resectionNode);
+
+  // Remove the result of the margin check
+  this->NodeMarginViolatedMap.erase(resectionNode);
+
   // Remove distance actor
   NodeDistanceActorIt distanceActorIt =
     this->NodeDistanceActorMap.find(resectionNode);
@@ -627,6 +658,7 @@ OnMRMLSceneNodeRemoved(vtkMRMLNode *node)
     {
     return;
     }
+  this->LocatorCache->RemoveDataSet(clipperIt->second->GetOutput());
   this->NodeClipperMap.erase(clipperIt);
 
   // Remove distance filter
@@ -645,6 +677,7 @@ OnMRMLSceneNodeRemoved(vtkMRMLNode *node)
     {
     return;
     }
+  this->LocatorCache->RemoveDataSet(it->second->GetBezierSurfacePolyData());
   it->second->RemoveAllObservers();
   it->second->Off();
   this->NodeWidgetMap.erase(it);
@@ -691,6 +724,10 @@ UpdateGeometry(vtkMRMLResectionSurfaceNode *node)
     {
     contourIt->second->SetValue(0, node->GetResectionMargin());
     }
+
+  // The surface or the margin may have changed
+  double minimumDistance;
+  this->FindResectionMarginViolations(node, NULL, minimumDistance, true);
 }
 
 
@@ -830,6 +867,202 @@ UpdateVisibility(vtkMRMLResectionSurfaceNode *node)
     }
 }
 
+//------------------------------------------------------------------------------
+vtkIdType vtkMRMLResectionDisplayableManager3D::
+FindResectionMarginViolations(vtkMRMLResectionSurfaceNode *node,
+                              vtkIdList *pointIds,
+                              double &minimumDistance,
+                              bool stopAtFirst)
+{
+  minimumDistance = 0.0;
+
+  if (!node)
+    {
+    vtkErrorMacro("No node passed.");
+    return -1;
+    }
+
+  minimumDistance = node->GetResectionMargin();
+
+  NodeWidgetIt widgetIt = this->NodeWidgetMap.find(node);
+  if (widgetIt == this->NodeWidgetMap.end())
+    {
+    vtkErrorMacro("Node not handled by the displayable manager.");
+    return -1;
+    }
+
+  vtkPolyData *surface = widgetIt->second->GetBezierSurfacePolyData();
+  vtkPolyData *tumors = this->GetTumorsPolyData();
+  if (!surface || !surface->GetPoints() || !tumors)
+    {
+    this->NodeMarginViolatedMap.erase(node);
+    return -1;
+    }
+
+  // The hierarchy of the tumors is shared with the distance filters, and only
+  // its nodes closer than the margin are visited
+  vtkTriangleBVH *tumorsLocator = this->LocatorCache->GetTriangleLocator(tumors);
+  vtkIdType numberOfViolations =
+    tumorsLocator->FindPointsWithinDistance(surface->GetPoints(),
+                                            node->GetResectionMargin(),
+                                            pointIds,
+                                            minimumDistance,
+                                            stopAtFirst);
+
+  this->NodeMarginViolatedMap[node] = numberOfViolations > 0;
+
+  vtkDebugMacro("Resection margin " << node->GetResectionMargin()
+                << (numberOfViolations > 0 ? " violated" : " satisfied")
+                << " (minimum distance found " << minimumDistance << ")");
+
+  return numberOfViolations;
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLResectionDisplayableManager3D::
+IsResectionMarginViolated(vtkMRMLResectionSurfaceNode *node)
+{
+  NodeMarginViolatedIt it = this->NodeMarginViolatedMap.find(node);
+  if (it == this->NodeMarginViolatedMap.end())
+    {
+    return false;
+    }
+
+  return it->second;
+}
+
+//------------------------------------------------------------------------------
+vtkPolyData *vtkMRMLResectionDisplayableManager3D::GetTumorsPolyData()
+{
+  if (!this->GetMRMLScene())
+    {
+    return NULL;
+    }
+
+  vtkSmartPointer<vtkCollection> nodes;
+  nodes.TakeReference(this->GetMRMLScene()->
+                      GetNodesByName("LRPJointTumorsModel"));
+  vtkMRMLModelNode *jointTumorsModelNode =
+    vtkMRMLModelNode::SafeDownCast(nodes->GetItemAsObject(0));
+  if (!jointTumorsModelNode)
+    {
+    return NULL;
+    }
+
+  vtkPolyData *tumors = jointTumorsModelNode->GetPolyData();
+  if (!tumors || tumors->GetNumberOfCells() == 0)
+    {
+    return NULL;
+    }
+
+  return tumors;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLResectionDisplayableManager3D::
+UpdateTumorDistanceField(vtkPolyData *tumors)
+{
+  if (!tumors || tumors->GetNumberOfCells() == 0)
+    {
+    return;
+    }
+
+  // The tumors do not change during planning: the field is only computed
+  // again when they are modified or replaced
+  if (this->TumorDistanceFieldSurface.GetPointer() == tumors &&
+      this->TumorDistanceFieldTime == tumors->GetMTime())
+    {
+    return;
+    }
+
+  this->TumorDistanceFieldSurface = tumors;
+  this->TumorDistanceFieldTime = tumors->GetMTime();
+  this->TumorDistanceField->SetSurface(tumors);
+  this->TumorDistanceField->ComputeInBackground();
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLResectionDisplayableManager3D::
+UpdateLiveDistanceMap(vtkMRMLResectionSurfaceNode *node,
+                      vtkBezierSurfaceWidget *widget)
+{
+  if (!this->TumorDistanceField->IsReady())
+    {
+    return false;
+    }
+
+  NodeLiveDistanceSurfaceIt liveIt = this->NodeLiveDistanceSurfaceMap.find(node);
+  NodeDistanceActorIt distActorIt = this->NodeDistanceActorMap.find(node);
+  NodeContourActorIt contActorIt = this->NodeContourActorMap.find(node);
+  NodeContourFilterIt contFilIt = this->NodeContourFilterMap.find(node);
+  if (liveIt == this->NodeLiveDistanceSurfaceMap.end() ||
+      distActorIt == this->NodeDistanceActorMap.end() ||
+      contActorIt == this->NodeContourActorMap.end() ||
+      contFilIt == this->NodeContourFilterMap.end())
+    {
+    return false;
+    }
+
+  vtkPolyDataMapper *distanceMapper =
+    vtkPolyDataMapper::SafeDownCast(distActorIt->second->GetMapper());
+  if (!distanceMapper)
+    {
+    return false;
+    }
+
+  // Current surface with the distances looked up in the field
+  vtkPolyData *liveSurface = liveIt->second;
+  liveSurface->ShallowCopy(widget->GetBezierSurfacePolyData());
+
+  vtkSmartPointer<vtkDoubleArray> distances =
+    vtkSmartPointer<vtkDoubleArray>::New();
+  distances->SetName("Distance");
+  this->TumorDistanceField->EvaluateDistances(liveSurface->GetPoints(),
+                                              distances);
+
+  // The field is signed (negative inside the tumors) while the distance
+  // filter, whose output replaces this map at the end of the interaction,
+  // gives unsigned distances
+  for (vtkIdType k=0; k<distances->GetNumberOfTuples(); k++)
+    {
+    distances->SetValue(k, std::fabs(distances->GetValue(k)));
+    }
+  liveSurface->GetPointData()->SetScalars(distances);
+  liveSurface->Modified();
+
+  distanceMapper->SetInputData(liveSurface);
+  contFilIt->second->SetInputData(liveSurface);
+
+  widget->BezierSurfaceOff();
+  distActorIt->second->VisibilityOn();
+  contActorIt->second->VisibilityOn();
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLResectionDisplayableManager3D::
+RestoreDistanceMapPipeline(vtkMRMLResectionSurfaceNode *node)
+{
+  NodeDistanceFilterIt distFilIt = this->NodeDistanceFilterMap.find(node);
+  NodeDistanceActorIt distActorIt = this->NodeDistanceActorMap.find(node);
+  NodeContourFilterIt contFilIt = this->NodeContourFilterMap.find(node);
+  if (distFilIt == this->NodeDistanceFilterMap.end() ||
+      distActorIt == this->NodeDistanceActorMap.end() ||
+      contFilIt == this->NodeContourFilterMap.end())
+    {
+    return;
+    }
+
+  vtkPolyDataMapper *distanceMapper =
+    vtkPolyDataMapper::SafeDownCast(distActorIt->second->GetMapper());
+  if (distanceMapper)
+    {
+    distanceMapper->SetInputConnection(distFilIt->second->GetOutputPort());
+    }
+  contFilIt->second->SetInputConnection(distFilIt->second->GetOutputPort());
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLResectionDisplayableManager3D::
 UpdateDistanceMap(vtkObject *caller,
@@ -881,24 +1114,45 @@ UpdateDistanceMap(vtkObject *caller,
     return;
     }
 
+  // Keep the distance field of the tumors up to date
+  vtkPolyData *tumors = self->GetTumorsPolyData();
+  if (tumors)
+    {
+    self->UpdateTumorDistanceField(tumors);
+    }
+
   if (eventId == vtkCommand::StartInteractionEvent)
     {
-    widget->BezierSurfaceOn();
-    NodeDistanceActorIt distIt = self->NodeDistanceActorMap.find(node);
-    if (distIt != self->NodeDistanceActorMap.end())
+    // Without the distance field, the plain surface is shown until the end of
+    // the interaction
+    if (!self->UpdateLiveDistanceMap(node, widget))
       {
-      distIt->second->VisibilityOff();
-      }
+      widget->BezierSurfaceOn();
+      NodeDistanceActorIt distIt = self->NodeDistanceActorMap.find(node);
+      if (distIt != self->NodeDistanceActorMap.end())
+        {
+        distIt->second->VisibilityOff();
+        }
 
-    NodeContourActorIt contIt = self->NodeContourActorMap.find(node);
-    if (contIt != self->NodeContourActorMap.end())
-      {
-      contIt->second->VisibilityOff();
+      NodeContourActorIt contIt = self->NodeContourActorMap.find(node);
+      if (contIt != self->NodeContourActorMap.end())
+        {
+        contIt->second->VisibilityOff();
+        }
       }
     }
 
+  if (eventId == vtkCommand::InteractionEvent)
+    {
+    self->UpdateLiveDistanceMap(node, widget);
+
+    double minimumDistance;
+    self->FindResectionMarginViolations(node, NULL, minimumDistance, true);
+    }
+
   if (eventId == vtkCommand::EndInteractionEvent)
     {
+    self->RestoreDistanceMapPipeline(node);
     widget->BezierSurfaceOff();
 
     if (!self->GetMRMLScene())
@@ -907,12 +1161,7 @@ UpdateDistanceMap(vtkObject *caller,
       return;
       }
 
-    vtkSmartPointer<vtkCollection> nodes;
-    nodes.TakeReference(self->GetMRMLScene()->
-                        GetNodesByName("LRPJointTumorsModel"));
-    vtkMRMLModelNode *jointTumorsModelNode =
-      vtkMRMLModelNode::SafeDownCast(nodes->GetItemAsObject(0));
-    if (!jointTumorsModelNode)
+    if (!tumors)
       {
       std::cerr << "No tumors model node found." << std::endl;
       return;
@@ -929,7 +1178,7 @@ UpdateDistanceMap(vtkObject *caller,
 
     vtkHausdorffDistancePointSetFilter *distanceFilter = distFilIt->second;
     distanceFilter->SetInputData(0, widget->GetBezierSurfacePolyData());
-    distanceFilter->SetInputData(1, jointTumorsModelNode->GetPolyData());
+    distanceFilter->SetInputData(1, tumors);
     distanceFilter->Update();
     distanceFilter->GetOutput(0)->GetPointData()->
       SetScalars(distanceFilter->GetOutput(0)->
@@ -45,12 +45,17 @@
 // VTK includes
 #include <vtkNew.h>
 #include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
 
 //------------------------------------------------------------------------------
 class vtkMRMLResectionSurfaceNode;
 class vtkBezierSurfaceWidget;
 class vtk3DWidget;
 class vtkHausdorffDistancePointSetFilter;
+class vtkPointSetLocatorCache;
+class vtkSparseSignedDistanceField;
+class vtkPolyData;
+class vtkIdList;
 class vtkActor;
 class vtkColorTransferFunction;
 class vtkContourFilter;
@@ -101,6 +106,37 @@ public vtkMRMLAbstractThreeDViewDisplayableManager
    */
   void AddDistanceMapPipeline(vtkMRMLResectionSurfaceNode* node);
 
+  /**
+   * Find the points of a resection surface closer to the tumors than its
+   * resection margin. Only the parts of the tumors closer than the margin are
+   * searched, so that the check is cheap enough to run on every edit.
+   *
+   * @param node pointer to the resection node.
+   * @param pointIds if not NULL, array receiving the ids of the points of the
+   * surface violating the margin.
+   * @param minimumDistance distance of the closest point found, or the margin
+   * if the margin is not violated.
+   * @param stopAtFirst if true, the search stops at the first violations found.
+   *
+   * @return number of points violating the margin, -1 if the surface or the
+   * tumors are not available.
+   */
+  vtkIdType FindResectionMarginViolations(vtkMRMLResectionSurfaceNode *node,
+                                          vtkIdList *pointIds,
+                                          double &minimumDistance,
+                                          bool stopAtFirst = false);
+
+  /**
+   * Get whether the resection margin was violated at the last check, done
+   * every time the resection surface is edited.
+   *
+   * @param node pointer to the resection node.
+   *
+   * @return true if a point of the surface was closer to the tumors than the
+   * margin, false otherwise or if the surface was not checked.
+   */
+  bool IsResectionMarginViolated(vtkMRMLResectionSurfaceNode *node);
+
  protected:
   vtkMRMLResectionDisplayableManager3D();
   virtual ~vtkMRMLResectionDisplayableManager3D();
@@ -177,6 +213,35 @@ public vtkMRMLAbstractThreeDViewDisplayableManager
    */
   void UpdateVisibility(vtkMRMLResectionSurfaceNode *node);
 
+  /**
+   * Start the computation of the distance field of the tumors in the
+   * background, unless it was already computed for the current tumors.
+   *
+   * @param tumors pointer to the joint model of the tumors.
+   */
+  void UpdateTumorDistanceField(vtkPolyData *tumors);
+
+  /**
+   * Update the distance map of a resection surface being interacted from the
+   * distance field of the tumors, and show it instead of the plain surface.
+   *
+   * @param node pointer to the resection node.
+   * @param widget pointer to the widget being interacted.
+   *
+   * @return true if the distance field is ready and the map was updated,
+   * false otherwise.
+   */
+  bool UpdateLiveDistanceMap(vtkMRMLResectionSurfaceNode *node,
+                             vtkBezierSurfaceWidget *widget);
+
+  /**
+   * Connect the distance map and the safety contour of a resection node back
+   * to the output of its distance filter.
+   *
+   * @param node pointer to the resection node.
+   */
+  void RestoreDistanceMapPipeline(vtkMRMLResectionSurfaceNode *node);
+
   /**
    * Update MRML node values based on modifications from interactions with the
    * widget.
@@ -192,6 +257,13 @@ public vtkMRMLAbstractThreeDViewDisplayableManager
                          void *clientData,
                          void *callData);
 
+  /**
+   * Get the joint model of the tumors from the scene.
+   *
+   * @return pointer to the surface of the tumors, NULL if not present.
+   */
+  vtkPolyData *GetTumorsPolyData();
+
   /**
    * Update the distance map and the safety contour based on modifications from
    * interactions witht the widget.
@@ -219,6 +291,28 @@ public vtkMRMLAbstractThreeDViewDisplayableManager
   typedef std::map<vtkMRMLResectionSurfaceNode*,
     vtkSmartPointer<vtkBezierSurfaceWidget> >::iterator NodeWidgetIt;
 
+  // Locators shared by the distance filters of all the resection nodes
+  vtkSmartPointer<vtkPointSetLocatorCache> LocatorCache;
+
+  // Distance field of the tumors, and the tumors and modification time it was
+  // computed for
+  vtkSmartPointer<vtkSparseSignedDistanceField> TumorDistanceField;
+  vtkWeakPointer<vtkPolyData> TumorDistanceFieldSurface;
+  vtkMTimeType TumorDistanceFieldTime;
+
+  // Map and iterator holding the ResectionNode-LiveDistanceSurface
+  // relationship (distance map during interaction)
+  std::map<vtkMRMLResectionSurfaceNode*,
+    vtkSmartPointer<vtkPolyData> > NodeLiveDistanceSurfaceMap;
+  typedef std::map<vtkMRMLResectionSurfaceNode*,
+    vtkSmartPointer<vtkPolyData> >::iterator NodeLiveDistanceSurfaceIt;
+
+  // Map and iterator holding the ResectionNode-MarginViolated relationship
+  // (result of the last margin check)
+  std::map<vtkMRMLResectionSurfaceNode*, bool> NodeMarginViolatedMap;
+  typedef std::map<vtkMRMLResectionSurfaceNode*, bool>::iterator
+    NodeMarginViolatedIt;
+
   // Map and iterator holding the ResecionNode-TumorDistanceFilter relationship
   std::map<vtkMRMLResectionSurfaceNode*,
     vtkSmartPointer<vtkHausdorffDistancePointSetFilter> > NodeDistanceFilterMap;
@@ -0,0 +1,320 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkBSplineSurfaceSourceTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This modules includes
+#include "vtkBSplineSurfaceSource.h"
+#include "vtkBezierSurfaceSource.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkMath.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// B-spline basis function of a clamped uniform knot vector, evaluated from
+// its recursive definition.
+double BasisFunction(const std::vector<double> &knots, unsigned int i,
+                     unsigned int degree, double t)
+{
+  if (degree == 0)
+    {
+    // The last non-empty span includes its end so that t = 1 is covered
+    unsigned int last = knots.size() - 1;
+    while (knots[last-1] == knots[last])
+      {
+      last--;
+      }
+    if (knots[i] <= t && (t < knots[i+1] || (t == 1.0 && i+1 == last)))
+      {
+      return 1.0;
+      }
+    return 0.0;
+    }
+
+  double value = 0.0;
+  if (knots[i+degree] > knots[i])
+    {
+    value += (t - knots[i]) / (knots[i+degree] - knots[i]) *
+      BasisFunction(knots, i, degree-1, t);
+    }
+  if (knots[i+degree+1] > knots[i+1])
+    {
+    value += (knots[i+degree+1] - t) / (knots[i+degree+1] - knots[i+1]) *
+      BasisFunction(knots, i+1, degree-1, t);
+    }
+  return value;
+}
+
+//------------------------------------------------------------------------------
+std::vector<double> ClampedKnots(unsigned int numberOfControlPoints,
+                                 unsigned int degree)
+{
+  std::vector<double> knots(numberOfControlPoints + degree + 1, 0.0);
+  for (unsigned int k=degree+1; k<numberOfControlPoints; k++)
+    {
+    knots[k] = (k - degree) / static_cast<double>(numberOfControlPoints - degree);
+    }
+  for (unsigned int k=numberOfControlPoints; k<knots.size(); k++)
+    {
+    knots[k] = 1.0;
+    }
+  return knots;
+}
+
+//------------------------------------------------------------------------------
+// Creates a non-planar grid of control points.
+vtkSmartPointer<vtkPoints> CreateControlPoints(unsigned int m, unsigned int n)
+{
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  for (unsigned int i=0; i<m; i++)
+    {
+    for (unsigned int j=0; j<n; j++)
+      {
+      points->InsertNextPoint(i * 10.0, j * 7.0, std::sin(i + 2.0 * j) * 5.0);
+      }
+    }
+  return points;
+}
+
+//------------------------------------------------------------------------------
+// Compares the output of the source with the direct evaluation of the
+// (rational) tensor product surface.
+bool CheckSurface(vtkBSplineSurfaceSource *source, vtkPoints *controlPoints)
+{
+  source->Update();
+  vtkPoints *surfacePoints = source->GetOutput()->GetPoints();
+
+  unsigned int m = source->GetNumberOfControlPointsX();
+  unsigned int n = source->GetNumberOfControlPointsY();
+  unsigned int p = source->GetDegreeX();
+  unsigned int q = source->GetDegreeY();
+  unsigned int xRes = source->GetResolutionX();
+  unsigned int yRes = source->GetResolutionY();
+  std::vector<double> knotsX = ClampedKnots(m, p);
+  std::vector<double> knotsY = ClampedKnots(n, q);
+
+  if (surfacePoints == NULL ||
+      surfacePoints->GetNumberOfPoints() != static_cast<vtkIdType>(xRes*yRes))
+    {
+    std::cerr << "Wrong number of surface points" << std::endl;
+    return false;
+    }
+
+  for (unsigned int i=0; i<xRes; i++)
+    {
+    double u = i / static_cast<double>(xRes - 1);
+    for (unsigned int j=0; j<yRes; j++)
+      {
+      double v = j / static_cast<double>(yRes - 1);
+      double expected[3] = {0.0, 0.0, 0.0};
+      double sum = 0.0;
+      for (unsigned int ci=0; ci<m; ci++)
+        {
+        for (unsigned int cj=0; cj<n; cj++)
+          {
+          double weight = BasisFunction(knotsX, ci, p, u) *
+            BasisFunction(knotsY, cj, q, v) * source->GetWeight(ci*n+cj);
+          double *controlPoint = controlPoints->GetPoint(ci*n+cj);
+          expected[0] += weight * controlPoint[0];
+          expected[1] += weight * controlPoint[1];
+          expected[2] += weight * controlPoint[2];
+          sum += weight;
+          }
+        }
+      expected[0] /= sum;
+      expected[1] /= sum;
+      expected[2] /= sum;
+
+      double *point = surfacePoints->GetPoint(i*yRes+j);
+      if (std::sqrt(vtkMath::Distance2BetweenPoints(point, expected)) > 1e-9)
+        {
+        std::cerr << "Surface point (" << i << ", " << j << ") = "
+                  << point[0] << ", " << point[1] << ", " << point[2]
+                  << " expected " << expected[0] << ", " << expected[1]
+                  << ", " << expected[2] << std::endl;
+        return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkBSplineSurfaceSourceTest1(int, char *[])
+{
+  vtkNew<vtkBSplineSurfaceSource> source;
+
+  // With the degree limited by the number of control points, the surface is
+  // the Bezier surface of the control points
+  vtkNew<vtkBezierSurfaceSource> bezierSource;
+  vtkSmartPointer<vtkPoints> controlPoints = CreateControlPoints(4, 4);
+  bezierSource->SetControlPoints(controlPoints);
+  bezierSource->SetResolution(9, 11);
+  bezierSource->Update();
+  source->SetNumberOfControlPoints(4, 4);
+  source->SetControlPoints(controlPoints);
+  source->SetResolution(9, 11);
+  source->Update();
+
+  vtkPoints *bezierPoints = bezierSource->GetOutput()->GetPoints();
+  vtkPoints *surfacePoints = source->GetOutput()->GetPoints();
+  for (vtkIdType k=0; k<bezierPoints->GetNumberOfPoints(); k++)
+    {
+    if (std::sqrt(vtkMath::Distance2BetweenPoints(bezierPoints->GetPoint(k),
+                                                  surfacePoints->GetPoint(k))) > 1e-9)
+      {
+      std::cerr << "Surface differs from the Bezier surface" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Dense grid of control points of degree 3
+  source->SetNumberOfControlPoints(8, 7);
+  controlPoints = CreateControlPoints(8, 7);
+  source->SetControlPoints(controlPoints);
+  source->SetResolution(31, 25);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface with 8x7 control points is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Other degrees
+  source->SetDegree(2, 4);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface of degree 2x4 is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+  source->SetDegree(3, 3);
+
+  // Local update: the samples outside the support of the moved control
+  // point keep their values
+  source->Update();
+  vtkNew<vtkPoints> previousPoints;
+  previousPoints->DeepCopy(source->GetOutput()->GetPoints());
+
+  double displacement[3] = {1.5, -0.5, 2.0};
+  unsigned int index = 1*7+2;
+  source->MoveControlPoint(index, displacement);
+  double *controlPoint = controlPoints->GetPoint(index);
+  controlPoints->SetPoint(index, controlPoint[0] + displacement[0],
+                          controlPoint[1] + displacement[1],
+                          controlPoint[2] + displacement[2]);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface after a local update is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  surfacePoints = source->GetOutput()->GetPoints();
+  unsigned int unchanged = 0;
+  for (vtkIdType k=0; k<surfacePoints->GetNumberOfPoints(); k++)
+    {
+    if (vtkMath::Distance2BetweenPoints(surfacePoints->GetPoint(k),
+                                        previousPoints->GetPoint(k)) == 0.0)
+      {
+      unchanged++;
+      }
+    }
+  if (unchanged < surfacePoints->GetNumberOfPoints() / 2)
+    {
+    std::cerr << "Moving a control point modified " <<
+      surfacePoints->GetNumberOfPoints() - unchanged << " samples" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Local update of a group of control points
+  unsigned int group[3] = {0, 30, 55};
+  source->MoveControlPoints(3, group, displacement);
+  for (int k=0; k<3; k++)
+    {
+    controlPoint = controlPoints->GetPoint(group[k]);
+    controlPoints->SetPoint(group[k], controlPoint[0] + displacement[0],
+                            controlPoint[1] + displacement[1],
+                            controlPoint[2] + displacement[2]);
+    }
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface after a group local update is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // NURBS: a cylinder of radius 1 over a quarter circle
+  source->SetNumberOfControlPoints(3, 2);
+  source->SetDegree(2, 1);
+  source->SetResolution(17, 3);
+  vtkNew<vtkPoints> circlePoints;
+  circlePoints->InsertNextPoint(1.0, 0.0, 0.0);
+  circlePoints->InsertNextPoint(1.0, 0.0, 1.0);
+  circlePoints->InsertNextPoint(1.0, 1.0, 0.0);
+  circlePoints->InsertNextPoint(1.0, 1.0, 1.0);
+  circlePoints->InsertNextPoint(0.0, 1.0, 0.0);
+  circlePoints->InsertNextPoint(0.0, 1.0, 1.0);
+  source->SetControlPoints(circlePoints.GetPointer());
+  source->SetWeight(2, std::sqrt(0.5));
+  source->SetWeight(3, std::sqrt(0.5));
+  if (!CheckSurface(source.GetPointer(), circlePoints.GetPointer()))
+    {
+    std::cerr << "NURBS surface is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  surfacePoints = source->GetOutput()->GetPoints();
+  for (vtkIdType k=0; k<surfacePoints->GetNumberOfPoints(); k++)
+    {
+    double *point = surfacePoints->GetPoint(k);
+    if (std::fabs(point[0]*point[0] + point[1]*point[1] - 1.0) > 1e-12)
+      {
+      std::cerr << "NURBS point " << k << " is not on the unit circle" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,344 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkBezierSurfaceSourceTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This modules includes
+#include "vtkBezierSurfaceSource.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkMath.h>
+
+// STD includes
+#include <iostream>
+#include <cmath>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Bernstein polynomial evaluated from its definition.
+double Bernstein(unsigned int degree, unsigned int i, double t)
+{
+  double binomial = 1.0;
+  for (unsigned int k=0; k<i; k++)
+    {
+    binomial = binomial * (degree - k) / (k + 1);
+    }
+  return binomial * std::pow(t, static_cast<int>(i)) *
+    std::pow(1.0 - t, static_cast<int>(degree - i));
+}
+
+//------------------------------------------------------------------------------
+// Creates a non-planar grid of control points.
+vtkSmartPointer<vtkPoints> CreateControlPoints(unsigned int m, unsigned int n)
+{
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  for (unsigned int i=0; i<m; i++)
+    {
+    for (unsigned int j=0; j<n; j++)
+      {
+      points->InsertNextPoint(i * 10.0, j * 7.0, std::sin(i + 2.0 * j) * 5.0);
+      }
+    }
+  return points;
+}
+
+//------------------------------------------------------------------------------
+// Compares the output of the source with the direct evaluation of the
+// tensor product surface.
+bool CheckSurface(vtkBezierSurfaceSource *source, vtkPoints *controlPoints)
+{
+  source->Update();
+  vtkPoints *surfacePoints = source->GetOutput()->GetPoints();
+
+  unsigned int m = source->GetNumberOfControlPointsX();
+  unsigned int n = source->GetNumberOfControlPointsY();
+  unsigned int xRes = source->GetResolutionX();
+  unsigned int yRes = source->GetResolutionY();
+
+  if (surfacePoints == NULL ||
+      surfacePoints->GetNumberOfPoints() != static_cast<vtkIdType>(xRes*yRes))
+    {
+    std::cerr << "Wrong number of surface points" << std::endl;
+    return false;
+    }
+
+  for (unsigned int i=0; i<xRes; i++)
+    {
+    double u = i / static_cast<double>(xRes - 1);
+    for (unsigned int j=0; j<yRes; j++)
+      {
+      double v = j / static_cast<double>(yRes - 1);
+      double expected[3] = {0.0, 0.0, 0.0};
+      for (unsigned int ci=0; ci<m; ci++)
+        {
+        for (unsigned int cj=0; cj<n; cj++)
+          {
+          double weight = Bernstein(m-1, ci, u) * Bernstein(n-1, cj, v);
+          double *controlPoint = controlPoints->GetPoint(ci*n+cj);
+          expected[0] += weight * controlPoint[0];
+          expected[1] += weight * controlPoint[1];
+          expected[2] += weight * controlPoint[2];
+          }
+        }
+
+      double *point = surfacePoints->GetPoint(i*yRes+j);
+      if (std::fabs(point[0] - expected[0]) > 1e-9 ||
+          std::fabs(point[1] - expected[1]) > 1e-9 ||
+          std::fabs(point[2] - expected[2]) > 1e-9)
+        {
+        std::cerr << "Surface point (" << i << ", " << j << ") = "
+                  << point[0] << ", " << point[1] << ", " << point[2]
+                  << " expected " << expected[0] << ", " << expected[1]
+                  << ", " << expected[2] << std::endl;
+        return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Compares the normals and tangents of the source with the cross product of
+// the partial derivatives of the surface, evaluated from their definition.
+bool CheckNormals(vtkBezierSurfaceSource *source, vtkPoints *controlPoints)
+{
+  source->Update();
+  vtkPointData *pointData = source->GetOutput()->GetPointData();
+  vtkDataArray *normals = pointData->GetNormals();
+  vtkDataArray *tangentsU = pointData->GetArray("TangentU");
+  vtkDataArray *tangentsV = pointData->GetArray("TangentV");
+  if (normals == NULL || tangentsU == NULL || tangentsV == NULL)
+    {
+    std::cerr << "Normals or tangents not generated" << std::endl;
+    return false;
+    }
+
+  unsigned int m = source->GetNumberOfControlPointsX();
+  unsigned int n = source->GetNumberOfControlPointsY();
+  unsigned int xRes = source->GetResolutionX();
+  unsigned int yRes = source->GetResolutionY();
+
+  for (unsigned int i=0; i<xRes; i++)
+    {
+    double u = i / static_cast<double>(xRes - 1);
+    for (unsigned int j=0; j<yRes; j++)
+      {
+      double v = j / static_cast<double>(yRes - 1);
+      double expectedU[3] = {0.0, 0.0, 0.0};
+      double expectedV[3] = {0.0, 0.0, 0.0};
+      for (unsigned int ci=0; ci<m; ci++)
+        {
+        double derivativeU = (m-1) *
+          ((ci > 0 ? Bernstein(m-2, ci-1, u) : 0.0) -
+           (ci < m-1 ? Bernstein(m-2, ci, u) : 0.0));
+        for (unsigned int cj=0; cj<n; cj++)
+          {
+          double derivativeV = (n-1) *
+            ((cj > 0 ? Bernstein(n-2, cj-1, v) : 0.0) -
+             (cj < n-1 ? Bernstein(n-2, cj, v) : 0.0));
+          double *controlPoint = controlPoints->GetPoint(ci*n+cj);
+          for (int k=0; k<3; k++)
+            {
+            expectedU[k] += derivativeU * Bernstein(n-1, cj, v) * controlPoint[k];
+            expectedV[k] += Bernstein(m-1, ci, u) * derivativeV * controlPoint[k];
+            }
+          }
+        }
+
+      double expectedNormal[3];
+      vtkMath::Cross(expectedU, expectedV, expectedNormal);
+      vtkMath::Normalize(expectedNormal);
+
+      double *normal = normals->GetTuple3(i*yRes+j);
+      double *tangentU = tangentsU->GetTuple3(i*yRes+j);
+      double *tangentV = tangentsV->GetTuple3(i*yRes+j);
+      if (std::sqrt(vtkMath::Distance2BetweenPoints(normal, expectedNormal)) > 1e-9 ||
+          std::sqrt(vtkMath::Distance2BetweenPoints(tangentU, expectedU)) > 1e-8 ||
+          std::sqrt(vtkMath::Distance2BetweenPoints(tangentV, expectedV)) > 1e-8)
+        {
+        std::cerr << "Normal (" << i << ", " << j << ") = "
+                  << normal[0] << ", " << normal[1] << ", " << normal[2]
+                  << " expected " << expectedNormal[0] << ", "
+                  << expectedNormal[1] << ", " << expectedNormal[2] << std::endl;
+        return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkBezierSurfaceSourceTest1(int, char *[])
+{
+  vtkNew<vtkBezierSurfaceSource> source;
+
+  // Default bi-cubic surface
+  vtkSmartPointer<vtkPoints> controlPoints = CreateControlPoints(4, 4);
+  source->SetControlPoints(controlPoints);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Default surface is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Changing the resolution updates the basis tables
+  source->SetResolution(7, 13);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface with resolution 7x13 is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Changing the number of control points updates the basis tables
+  source->SetNumberOfControlPoints(5, 3);
+  controlPoints = CreateControlPoints(5, 3);
+  source->SetControlPoints(controlPoints);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface with 5x3 control points is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Moving the control points without changing the tables
+  controlPoints->SetPoint(7, 3.0, -4.0, 12.0);
+  source->SetControlPoints(controlPoints);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface after moving a control point is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Incremental update of a single control point
+  double displacement[3] = {1.5, -0.5, 2.0};
+  for (int k=0; k<3; k++)
+    {
+    source->MoveControlPoint(4, displacement);
+    double *point = controlPoints->GetPoint(4);
+    controlPoints->SetPoint(4, point[0] + displacement[0],
+                            point[1] + displacement[1],
+                            point[2] + displacement[2]);
+    if (!CheckSurface(source.GetPointer(), controlPoints))
+      {
+      std::cerr << "Surface after an incremental update is incorrect" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Incremental update of a group of control points
+  unsigned int group[3] = {0, 8, 14};
+  source->MoveControlPoints(3, group, displacement);
+  for (int k=0; k<3; k++)
+    {
+    double *point = controlPoints->GetPoint(group[k]);
+    controlPoints->SetPoint(group[k], point[0] + displacement[0],
+                            point[1] + displacement[1],
+                            point[2] + displacement[2]);
+    }
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface after a group incremental update is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Several updates without executing the pipeline, exceeding the maximum
+  // number of incremental updates
+  source->SetMaximumNumberOfIncrementalUpdates(2);
+  for (int k=0; k<5; k++)
+    {
+    source->MoveControlPoint(10, displacement);
+    double *point = controlPoints->GetPoint(10);
+    controlPoints->SetPoint(10, point[0] + displacement[0],
+                            point[1] + displacement[1],
+                            point[2] + displacement[2]);
+    }
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface after re-evaluation is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Analytic normals and tangents, also after an incremental update
+  source->GenerateTangentsOn();
+  if (!CheckNormals(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Normals are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  source->SetMaximumNumberOfIncrementalUpdates(100);
+  source->MoveControlPoints(3, group, displacement);
+  for (int k=0; k<3; k++)
+    {
+    double *point = controlPoints->GetPoint(group[k]);
+    controlPoints->SetPoint(group[k], point[0] + displacement[0],
+                            point[1] + displacement[1],
+                            point[2] + displacement[2]);
+    }
+  if (!CheckSurface(source.GetPointer(), controlPoints) ||
+      !CheckNormals(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Normals after an incremental update are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  source->GenerateNormalsOff();
+  source->GenerateTangentsOff();
+  source->Update();
+  if (source->GetOutput()->GetPointData()->GetNormals() != NULL)
+    {
+    std::cerr << "Normals generated while disabled" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // High resolution
+  source->SetResolution(200, 200);
+  if (!CheckSurface(source.GetPointer(), controlPoints))
+    {
+    std::cerr << "Surface with resolution 200x200 is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
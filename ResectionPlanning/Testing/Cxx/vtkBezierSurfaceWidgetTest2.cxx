@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkBezierSurfaceWidgetTest2.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This module includes
+#include "vtkBezierSurfaceWidget.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkCommand.h>
+#include <vtkCamera.h>
+#include <vtkMath.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Places the camera on the z axis, looking at the origin
+void SetCameraDistance(vtkRenderer *renderer, double distance)
+{
+  vtkCamera *camera = renderer->GetActiveCamera();
+  camera->SetFocalPoint(0.0, 0.0, 0.0);
+  camera->SetPosition(0.0, 0.0, distance);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+  renderer->ResetCameraClippingRange();
+  renderer->GetRenderWindow()->Render();
+}
+
+//------------------------------------------------------------------------------
+// Presses the left button on the first control point, and drags it by a few
+// pixels. Returns the number of points of the Bézier surface when the drag
+// starts and after the motion.
+void DragFirstControlPoint(vtkRenderer *renderer,
+                           vtkRenderWindowInteractor *interactor,
+                           vtkBezierSurfaceWidget *widget,
+                           vtkIdType numberOfPoints[2])
+{
+  double point[3];
+  widget->GetControlPoints()->GetPoint(0, point);
+  renderer->SetWorldPoint(point[0], point[1], point[2], 1.0);
+  renderer->WorldToDisplay();
+  double *display = renderer->GetDisplayPoint();
+  int x = vtkMath::Round(display[0]);
+  int y = vtkMath::Round(display[1]);
+
+  interactor->SetEventInformation(x, y);
+  interactor->InvokeEvent(vtkCommand::LeftButtonPressEvent, NULL);
+  numberOfPoints[0] = widget->GetBezierSurfacePolyData()->GetNumberOfPoints();
+
+  interactor->SetEventInformation(x+3, y+3);
+  interactor->InvokeEvent(vtkCommand::MouseMoveEvent, NULL);
+  numberOfPoints[1] = widget->GetBezierSurfacePolyData()->GetNumberOfPoints();
+}
+
+//------------------------------------------------------------------------------
+// Releases the left button. Returns the number of points of the Bézier surface.
+vtkIdType ReleaseButton(vtkRenderWindowInteractor *interactor,
+                        vtkBezierSurfaceWidget *widget)
+{
+  interactor->InvokeEvent(vtkCommand::LeftButtonReleaseEvent, NULL);
+  return widget->GetBezierSurfacePolyData()->GetNumberOfPoints();
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkBezierSurfaceWidgetTest2(int vtkNotUsed(argc), char *vtkNotUsed(argv)[])
+{
+  // Create the renderer, render window and render window interactor
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetSize(300, 300);
+  renderWindow->AddRenderer(renderer.GetPointer());
+  vtkNew<vtkRenderWindowInteractor> renderWindowInteractor;
+  renderWindowInteractor->SetRenderWindow(renderWindow.GetPointer());
+  renderWindowInteractor->Initialize();
+
+  // Create and set the Bézier Surface Widget
+  vtkNew<vtkBezierSurfaceWidget> bezierSurfaceWidget;
+  bezierSurfaceWidget->AutoSizeOn();
+  bezierSurfaceWidget->SetDefaultRenderer(renderer.GetPointer());
+  bezierSurfaceWidget->SetInteractor(renderWindowInteractor.GetPointer());
+  bezierSurfaceWidget->On();
+  bezierSurfaceWidget->SetSurfaceResolutionX(60);
+  bezierSurfaceWidget->SetSurfaceResolutionY(60);
+  bezierSurfaceWidget->SetScreenSpaceTolerance(0.5);
+  bezierSurfaceWidget->SetMinimumInteractionResolution(5);
+
+  // A bump of height 1 over [-1, 1] x [-1, 1], which needs about 5 quads per
+  // direction seen from 60 units away and about 18 from 4 units away
+  SetCameraDistance(renderer.GetPointer(), 60.0);
+  vtkNew<vtkPoints> controlPoints;
+  for(int i=0; i<4; ++i)
+    {
+    for(int j=0; j<4; ++j)
+      {
+      bool inner = (i == 1 || i == 2) && (j == 1 || j == 2);
+      controlPoints->InsertNextPoint(-1.0 + 2.0*i/3.0, -1.0 + 2.0*j/3.0,
+                                     inner ? 1.0 : 0.0);
+      }
+    }
+  bezierSurfaceWidget->SetControlPoints(controlPoints.GetPointer());
+  renderWindow->Render();
+
+  vtkIdType fullPoints =
+    bezierSurfaceWidget->GetBezierSurfacePolyData()->GetNumberOfPoints();
+
+  // A coarser surface while a control point is dragged
+  vtkIdType farPoints[2];
+  DragFirstControlPoint(renderer.GetPointer(),
+                        renderWindowInteractor.GetPointer(),
+                        bezierSurfaceWidget.GetPointer(), farPoints);
+  if (farPoints[0] >= fullPoints || farPoints[1] >= fullPoints)
+    {
+    std::cerr << "Resolution not reduced during the deformation: "
+              << farPoints[0] << " and " << farPoints[1] << " points, "
+              << fullPoints << " at full resolution" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (farPoints[1] < farPoints[0])
+    {
+    std::cerr << "Resolution decreased during the deformation" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The full resolution once the button is released
+  vtkIdType releasedPoints = ReleaseButton(renderWindowInteractor.GetPointer(),
+                                           bezierSurfaceWidget.GetPointer());
+  if (releasedPoints != fullPoints)
+    {
+    std::cerr << "Full resolution not restored on release: "
+              << releasedPoints << " points instead of " << fullPoints
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // A finer surface when the camera is closer
+  SetCameraDistance(renderer.GetPointer(), 4.0);
+  vtkIdType nearPoints[2];
+  DragFirstControlPoint(renderer.GetPointer(),
+                        renderWindowInteractor.GetPointer(),
+                        bezierSurfaceWidget.GetPointer(), nearPoints);
+  if (nearPoints[0] <= farPoints[0])
+    {
+    std::cerr << "Resolution not increased with a closer camera: "
+              << nearPoints[0] << " points, " << farPoints[0]
+              << " with the camera far away" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (nearPoints[0] >= fullPoints)
+    {
+    std::cerr << "Resolution not reduced during the deformation with a closer "
+              << "camera" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  releasedPoints = ReleaseButton(renderWindowInteractor.GetPointer(),
+                                 bezierSurfaceWidget.GetPointer());
+  if (releasedPoints != fullPoints)
+    {
+    std::cerr << "Full resolution not restored on release: "
+              << releasedPoints << " points instead of " << fullPoints
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkHausdorffDistancePointSetFilterTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This modules includes
+#include "vtkHausdorffDistancePointSetFilter.h"
+#include "vtkPointSetLocatorCache.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkPolyData.h>
+#include <vtkPointData.h>
+#include <vtkFieldData.h>
+#include <vtkDataArray.h>
+#include <vtkGenericCell.h>
+#include <vtkMath.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Distance from a point to a point set, computed exhaustively over its points
+// or its cells.
+double BruteForceDistance(double point[3], vtkPolyData *target, int method)
+{
+  double minimum = VTK_DOUBLE_MAX;
+
+  if (method == vtkHausdorffDistancePointSetFilter::POINT_TO_POINT)
+    {
+    for (vtkIdType k=0; k<target->GetNumberOfPoints(); k++)
+      {
+      double targetPoint[3];
+      target->GetPoint(k, targetPoint);
+      minimum = std::min(minimum,
+                         vtkMath::Distance2BetweenPoints(point, targetPoint));
+      }
+    }
+  else
+    {
+    vtkNew<vtkGenericCell> cell;
+    for (vtkIdType k=0; k<target->GetNumberOfCells(); k++)
+      {
+      double closestPoint[3], pcoords[3], weights[3], dist2;
+      int subId;
+      target->GetCell(k, cell.GetPointer());
+      cell->EvaluatePosition(point, closestPoint, subId, pcoords, dist2, weights);
+      minimum = std::min(minimum, dist2);
+      }
+    }
+
+  return std::sqrt(minimum);
+}
+
+//------------------------------------------------------------------------------
+// Compares the distances of an output of the filter with the exhaustive
+// computation, and returns their maximum.
+bool CheckDistances(vtkPointSet *output, vtkPolyData *source,
+                    vtkPolyData *target, int method, double &maximum)
+{
+  vtkDataArray *distances = output->GetPointData()->GetArray("Distance");
+  if (distances == NULL ||
+      distances->GetNumberOfTuples() != source->GetNumberOfPoints())
+    {
+    std::cerr << "Distance array missing or of the wrong size" << std::endl;
+    return false;
+    }
+
+  maximum = 0.0;
+  for (vtkIdType k=0; k<source->GetNumberOfPoints(); k++)
+    {
+    double point[3];
+    source->GetPoint(k, point);
+    double expected = BruteForceDistance(point, target, method);
+    if (std::fabs(distances->GetTuple1(k) - expected) > 1e-6)
+      {
+      std::cerr << "Distance of point " << k << " = " << distances->GetTuple1(k)
+                << " expected " << expected << std::endl;
+      return false;
+      }
+    maximum = std::max(maximum, expected);
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkHausdorffDistancePointSetFilterTest1(int, char *[])
+{
+  vtkNew<vtkSphereSource> sphereA;
+  sphereA->SetRadius(10.0);
+  sphereA->SetThetaResolution(40);
+  sphereA->SetPhiResolution(30);
+  sphereA->Update();
+
+  vtkNew<vtkSphereSource> sphereB;
+  sphereB->SetCenter(4.0, -2.0, 1.0);
+  sphereB->SetRadius(3.0);
+  sphereB->SetThetaResolution(12);
+  sphereB->SetPhiResolution(9);
+  sphereB->Update();
+
+  vtkPolyData *inputA = sphereA->GetOutput();
+  vtkPolyData *inputB = sphereB->GetOutput();
+
+  for (int method=vtkHausdorffDistancePointSetFilter::POINT_TO_POINT;
+       method<=vtkHausdorffDistancePointSetFilter::POINT_TO_CELL; method++)
+    {
+    vtkNew<vtkHausdorffDistancePointSetFilter> filter;
+    filter->SetInputData(0, inputA);
+    filter->SetInputData(1, inputB);
+    filter->SetTargetDistanceMethod(method);
+    filter->Update();
+
+    double maximumAToB, maximumBToA;
+    if (!CheckDistances(filter->GetOutput(0), inputA, inputB, method, maximumAToB) ||
+        !CheckDistances(filter->GetOutput(1), inputB, inputA, method, maximumBToA))
+      {
+      std::cerr << "Distances with method " << method << " are incorrect" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    double *relativeDistance = filter->GetRelativeDistance();
+    if (std::fabs(relativeDistance[0] - maximumAToB) > 1e-6 ||
+        std::fabs(relativeDistance[1] - maximumBToA) > 1e-6 ||
+        std::fabs(filter->GetHausdorffDistance() -
+                  std::max(maximumAToB, maximumBToA)) > 1e-6)
+      {
+      std::cerr << "Relative distances with method " << method << " = "
+                << relativeDistance[0] << ", " << relativeDistance[1]
+                << " expected " << maximumAToB << ", " << maximumBToA
+                << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    vtkDataArray *relativeDistanceBToA =
+      filter->GetOutput(1)->GetFieldData()->GetArray("RelativeDistanceBtoA");
+    if (relativeDistanceBToA == NULL ||
+        std::fabs(relativeDistanceBToA->GetTuple1(0) - maximumBToA) > 1e-6)
+      {
+      std::cerr << "Field data RelativeDistanceBtoA is incorrect" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Two filters sharing a locator cache and the same target: the locators of
+  // the target are built once
+  vtkNew<vtkSphereSource> sphereC;
+  sphereC->SetCenter(-3.0, 2.0, -1.0);
+  sphereC->SetRadius(8.0);
+  sphereC->Update();
+  vtkPolyData *inputC = sphereC->GetOutput();
+
+  vtkNew<vtkPointSetLocatorCache> cache;
+  vtkNew<vtkHausdorffDistancePointSetFilter> filterA;
+  filterA->SetTargetDistanceMethod(vtkHausdorffDistancePointSetFilter::POINT_TO_POINT);
+  filterA->SetLocatorCache(cache.GetPointer());
+  filterA->SetInputData(0, inputA);
+  filterA->SetInputData(1, inputB);
+  vtkNew<vtkHausdorffDistancePointSetFilter> filterC;
+  filterC->SetTargetDistanceMethod(vtkHausdorffDistancePointSetFilter::POINT_TO_POINT);
+  filterC->SetLocatorCache(cache.GetPointer());
+  filterC->SetInputData(0, inputC);
+  filterC->SetInputData(1, inputB);
+  filterA->Update();
+  filterC->Update();
+  if (cache->GetNumberOfDataSets() != 3 || cache->GetNumberOfBuilds() != 3)
+    {
+    std::cerr << "Shared cache holds " << cache->GetNumberOfDataSets()
+              << " datasets after " << cache->GetNumberOfBuilds()
+              << " builds, expected 3 and 3" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Modifying the target rebuilds its locator, and the distances follow
+  vtkPoints *pointsB = inputB->GetPoints();
+  for (vtkIdType k=0; k<pointsB->GetNumberOfPoints(); k++)
+    {
+    double *point = pointsB->GetPoint(k);
+    pointsB->SetPoint(k, point[0] - 6.0, point[1] + 1.0, point[2]);
+    }
+  pointsB->Modified();
+  filterA->Update();
+  filterC->Update();
+
+  double maximum;
+  if (!CheckDistances(filterA->GetOutput(0), inputA, inputB,
+                      vtkHausdorffDistancePointSetFilter::POINT_TO_POINT, maximum) ||
+      !CheckDistances(filterC->GetOutput(0), inputC, inputB,
+                      vtkHausdorffDistancePointSetFilter::POINT_TO_POINT, maximum))
+    {
+    std::cerr << "Distances to a modified target are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (cache->GetNumberOfBuilds() != 4)
+    {
+    std::cerr << "Modified target built " << cache->GetNumberOfBuilds() - 3
+              << " times, expected once" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  cache->RemoveDataSet(inputC);
+  if (cache->GetNumberOfDataSets() != 2)
+    {
+    std::cerr << "Dataset not removed from the cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
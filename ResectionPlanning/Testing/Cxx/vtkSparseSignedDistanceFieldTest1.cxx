@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkSparseSignedDistanceFieldTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This modules includes
+#include "vtkSparseSignedDistanceField.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSphereSource.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkMinimalStandardRandomSequence.h>
+
+// STD includes
+#include <iostream>
+#include <cmath>
+
+namespace
+{
+
+const double Center[3] = {5.0, 0.0, 0.0};
+const double Radius = 10.0;
+
+//------------------------------------------------------------------------------
+// Random points at distances from the sphere in [minimum, maximum].
+void CreatePoints(vtkPoints *points, double minimum, double maximum)
+{
+  vtkNew<vtkMinimalStandardRandomSequence> random;
+  random->SetSeed(1);
+
+  for (int k=0; k<200; k++)
+    {
+    double direction[3];
+    for (int d=0; d<3; d++)
+      {
+      direction[d] = random->GetRangeValue(-1.0, 1.0);
+      random->Next();
+      }
+    vtkMath::Normalize(direction);
+    double r = Radius + random->GetRangeValue(minimum, maximum);
+    random->Next();
+    points->InsertNextPoint(Center[0] + r*direction[0],
+                            Center[1] + r*direction[1],
+                            Center[2] + r*direction[2]);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Compares the field with the signed distance to the sphere.
+bool CheckDistances(vtkSparseSignedDistanceField *field, vtkPoints *points,
+                    double tolerance)
+{
+  vtkNew<vtkDoubleArray> distances;
+  field->EvaluateDistances(points, distances.GetPointer());
+
+  for (vtkIdType k=0; k<points->GetNumberOfPoints(); k++)
+    {
+    double x[3];
+    points->GetPoint(k, x);
+    double expected =
+      std::sqrt(vtkMath::Distance2BetweenPoints(x, Center)) - Radius;
+
+    if (std::fabs(distances->GetValue(k) - expected) > tolerance ||
+        distances->GetValue(k) != field->EvaluateDistance(x))
+      {
+      std::cerr << "Distance at " << x[0] << ", " << x[1] << ", " << x[2]
+                << " = " << distances->GetValue(k) << " expected "
+                << expected << std::endl;
+      return false;
+      }
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkSparseSignedDistanceFieldTest1(int, char *[])
+{
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetCenter(Center[0], Center[1], Center[2]);
+  sphere->SetRadius(Radius);
+  sphere->SetThetaResolution(90);
+  sphere->SetPhiResolution(90);
+  sphere->Update();
+
+  vtkNew<vtkSparseSignedDistanceField> field;
+  field->SetNarrowBandWidth(5.0);
+  field->SetNarrowBandSpacing(0.5);
+  field->SetFarFieldSpacing(4.0);
+  field->SetFarFieldPadding(50.0);
+  field->SetSurface(sphere->GetOutput());
+  if (field->IsReady())
+    {
+    std::cerr << "Field ready before being computed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  field->Compute();
+  if (!field->IsReady())
+    {
+    std::cerr << "Field not ready after being computed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Only the bricks around the sphere are sampled
+  unsigned int numberOfBricks = field->GetNumberOfNarrowBandBricks();
+  if (numberOfBricks == 0 || numberOfBricks >= 8*8*8)
+    {
+    std::cerr << numberOfBricks << " bricks in the narrow band" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Narrow band, inside and outside the sphere
+  vtkNew<vtkPoints> bandPoints;
+  CreatePoints(bandPoints.GetPointer(), -4.0, 4.0);
+  if (!CheckDistances(field.GetPointer(), bandPoints.GetPointer(), 0.05))
+    {
+    std::cerr << "Narrow band distances are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Far field
+  vtkNew<vtkPoints> farPoints;
+  CreatePoints(farPoints.GetPointer(), 10.0, 40.0);
+  if (!CheckDistances(field.GetPointer(), farPoints.GetPointer(), 0.5))
+    {
+    std::cerr << "Far field distances are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Beyond the far field, along an axis
+  double x[3] = {Center[0] + 200.0, Center[1], Center[2]};
+  if (std::fabs(field->EvaluateDistance(x) - (200.0 - Radius)) > 0.5)
+    {
+    std::cerr << "Distance beyond the far field = "
+              << field->EvaluateDistance(x) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Background computation gives the same field
+  field->SetSurface(sphere->GetOutput());
+  if (field->IsReady())
+    {
+    std::cerr << "Field ready after changing the surface" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  field->ComputeInBackground();
+  field->WaitForCompletion();
+  if (!field->IsReady() ||
+      field->GetNumberOfNarrowBandBricks() != numberOfBricks ||
+      !CheckDistances(field.GetPointer(), bandPoints.GetPointer(), 0.05))
+    {
+    std::cerr << "Field computed in the background is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Changing the surface while the field is computed stops the computation
+  field->ComputeInBackground();
+  field->SetSurface(sphere->GetOutput());
+  field->ComputeInBackground();
+  field->WaitForCompletion();
+  if (!field->IsReady() ||
+      !CheckDistances(field.GetPointer(), bandPoints.GetPointer(), 0.05))
+    {
+    std::cerr << "Field computed again in the background is incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,334 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkTriangleBVHTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// This modules includes
+#include "vtkTriangleBVH.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSphereSource.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkGenericCell.h>
+#include <vtkMath.h>
+#include <vtkMinimalStandardRandomSequence.h>
+
+// STD includes
+#include <iostream>
+#include <cmath>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Distance from a point to the closest 2D cell of a dataset, visiting all the
+// cells.
+double BruteForceDistance(const double x[3], vtkDataSet *dataSet)
+{
+  vtkNew<vtkGenericCell> cell;
+  double minimum = VTK_DOUBLE_MAX;
+  for (vtkIdType k=0; k<dataSet->GetNumberOfCells(); k++)
+    {
+    dataSet->GetCell(k, cell.GetPointer());
+    if (cell->GetCellDimension() != 2)
+      {
+      continue;
+      }
+
+    double point[3] = {x[0], x[1], x[2]};
+    double closestPoint[3], pcoords[3], weights[VTK_CELL_SIZE], dist2;
+    int subId;
+    cell->EvaluatePosition(point, closestPoint, subId, pcoords, dist2, weights);
+    minimum = std::min(minimum, dist2);
+    }
+
+  return std::sqrt(minimum);
+}
+
+//------------------------------------------------------------------------------
+// Compare single, batched and threshold queries of the hierarchy of a dataset
+// to the brute force distances, for random points in its bounds enlarged by
+// margin.
+bool CheckDistances(vtkDataSet *dataSet, double margin)
+{
+  vtkNew<vtkTriangleBVH> hierarchy;
+  hierarchy->SetDataSet(dataSet);
+  hierarchy->BuildLocator();
+
+  double bounds[6];
+  dataSet->GetBounds(bounds);
+
+  vtkNew<vtkMinimalStandardRandomSequence> random;
+  random->SetSeed(1);
+  vtkNew<vtkPoints> points;
+  for (int k=0; k<500; k++)
+    {
+    double x[3];
+    for (int d=0; d<3; d++)
+      {
+      x[d] = random->GetRangeValue(bounds[2*d] - margin, bounds[2*d+1] + margin);
+      random->Next();
+      }
+    points->InsertNextPoint(x);
+    }
+
+  vtkNew<vtkDoubleArray> distances;
+  hierarchy->FindClosestDistances(points.GetPointer(), distances.GetPointer());
+  if (distances->GetNumberOfTuples() != points->GetNumberOfPoints())
+    {
+    std::cerr << "Batched queries returned " << distances->GetNumberOfTuples()
+              << " distances for " << points->GetNumberOfPoints()
+              << " points" << std::endl;
+    return false;
+    }
+
+  for (vtkIdType k=0; k<points->GetNumberOfPoints(); k++)
+    {
+    double x[3];
+    points->GetPoint(k, x);
+    double expected = BruteForceDistance(x, dataSet);
+
+    double closestPoint[3], dist2;
+    vtkIdType cellId;
+    if (!hierarchy->FindClosestPoint(x, closestPoint, cellId, dist2))
+      {
+      std::cerr << "No closest point found for point " << k << std::endl;
+      return false;
+      }
+
+    double cellDistance = BruteForceDistance(closestPoint, dataSet);
+    if (std::fabs(std::sqrt(dist2) - expected) > 1e-6 ||
+        std::fabs(std::sqrt(vtkMath::Distance2BetweenPoints(x, closestPoint)) -
+                  expected) > 1e-6 ||
+        cellDistance > 1e-6 ||
+        cellId < 0 || cellId >= dataSet->GetNumberOfCells())
+      {
+      std::cerr << "Closest point of point " << k << " at distance "
+                << std::sqrt(dist2) << " expected " << expected << std::endl;
+      return false;
+      }
+
+    if (std::fabs(distances->GetValue(k) - expected) > 1e-6)
+      {
+      std::cerr << "Batched distance of point " << k << " = "
+                << distances->GetValue(k) << " expected " << expected
+                << std::endl;
+      return false;
+      }
+    }
+
+  // Points closer than a threshold, and the minimum distance among them
+  double threshold = margin / 2.0;
+  vtkNew<vtkIdList> expectedIds;
+  double expectedMinimum = threshold;
+  for (vtkIdType k=0; k<points->GetNumberOfPoints(); k++)
+    {
+    if (distances->GetValue(k) < threshold)
+      {
+      expectedIds->InsertNextId(k);
+      expectedMinimum = std::min(expectedMinimum, distances->GetValue(k));
+      }
+    }
+
+  vtkNew<vtkIdList> pointIds;
+  double minimumDistance;
+  vtkIdType numberOfPoints =
+    hierarchy->FindPointsWithinDistance(points.GetPointer(), threshold,
+                                        pointIds.GetPointer(), minimumDistance);
+  if (numberOfPoints != expectedIds->GetNumberOfIds() ||
+      pointIds->GetNumberOfIds() != numberOfPoints ||
+      std::fabs(minimumDistance - expectedMinimum) > 1e-6)
+    {
+    std::cerr << "Found " << numberOfPoints << " points closer than "
+              << threshold << " at " << minimumDistance << ", expected "
+              << expectedIds->GetNumberOfIds() << " at " << expectedMinimum
+              << std::endl;
+    return false;
+    }
+
+  for (vtkIdType k=0; k<numberOfPoints; k++)
+    {
+    if (pointIds->GetId(k) != expectedIds->GetId(k))
+      {
+      std::cerr << "Point " << pointIds->GetId(k) << " found closer than "
+                << threshold << ", expected " << expectedIds->GetId(k)
+                << std::endl;
+      return false;
+      }
+    }
+
+  // Stopping at the first points found: only points closer than the
+  // threshold are reported
+  numberOfPoints =
+    hierarchy->FindPointsWithinDistance(points.GetPointer(), threshold,
+                                        pointIds.GetPointer(), minimumDistance,
+                                        true);
+  if ((expectedIds->GetNumberOfIds() > 0) != (numberOfPoints > 0))
+    {
+    std::cerr << "First search found " << numberOfPoints << " points, expected "
+              << expectedIds->GetNumberOfIds() << std::endl;
+    return false;
+    }
+
+  for (vtkIdType k=0; k<numberOfPoints; k++)
+    {
+    if (distances->GetValue(pointIds->GetId(k)) >= threshold)
+      {
+      std::cerr << "First search found point " << pointIds->GetId(k)
+                << " at distance " << distances->GetValue(pointIds->GetId(k))
+                << std::endl;
+      return false;
+      }
+    }
+
+  // No point is closer than a null distance
+  if (hierarchy->FindPointsWithinDistance(points.GetPointer(), 0.0,
+                                          pointIds.GetPointer(),
+                                          minimumDistance) != 0 ||
+      pointIds->GetNumberOfIds() != 0)
+    {
+    std::cerr << "Points found closer than a null distance" << std::endl;
+    return false;
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkTriangleBVHTest1(int, char *[])
+{
+  // Triangulated sphere
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetCenter(5.0, -2.0, 1.0);
+  sphere->SetRadius(10.0);
+  sphere->SetThetaResolution(40);
+  sphere->SetPhiResolution(30);
+  sphere->Update();
+
+  if (!CheckDistances(sphere->GetOutput(), 5.0))
+    {
+    std::cerr << "Distances to the sphere are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Grid of quads, triangles and triangle strips, with a line ignored
+  // by the hierarchy
+  vtkNew<vtkPoints> points;
+  const int size = 12;
+  for (int j=0; j<=size; j++)
+    {
+    for (int i=0; i<=size; i++)
+      {
+      points->InsertNextPoint(i, j, 0.0);
+      }
+    }
+
+  vtkNew<vtkCellArray> lines;
+  vtkIdType line[2] = {0, size*(size+1)};
+  lines->InsertNextCell(2, line);
+
+  vtkNew<vtkCellArray> polys;
+  vtkNew<vtkCellArray> strips;
+  for (int j=0; j<size; j++)
+    {
+    for (int i=0; i<size; i++)
+      {
+      vtkIdType a = j*(size+1) + i;
+      vtkIdType corners[4] = {a, a+1, a+size+2, a+size+1};
+      if ((i + j) % 2 == 0)
+        {
+        polys->InsertNextCell(4, corners);
+        }
+      else if (i % 3 == 0)
+        {
+        vtkIdType strip[4] = {a, a+1, a+size+1, a+size+2};
+        strips->InsertNextCell(4, strip);
+        }
+      else
+        {
+        vtkIdType upper[3] = {a, a+1, a+size+2};
+        vtkIdType lower[3] = {a, a+size+2, a+size+1};
+        polys->InsertNextCell(3, upper);
+        polys->InsertNextCell(3, lower);
+        }
+      }
+    }
+
+  vtkNew<vtkPolyData> grid;
+  grid->SetPoints(points.GetPointer());
+  grid->SetLines(lines.GetPointer());
+  grid->SetPolys(polys.GetPointer());
+  grid->SetStrips(strips.GetPointer());
+
+  if (!CheckDistances(grid.GetPointer(), 4.0))
+    {
+    std::cerr << "Distances to the grid are incorrect" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkTriangleBVH> hierarchy;
+  hierarchy->SetDataSet(grid.GetPointer());
+  hierarchy->BuildLocator();
+  if (hierarchy->GetNumberOfTriangles() != 2*size*size)
+    {
+    std::cerr << "Grid triangulated in " << hierarchy->GetNumberOfTriangles()
+              << " triangles, expected " << 2*size*size << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Without triangles, no closest point is found
+  vtkNew<vtkPolyData> empty;
+  empty->SetPoints(points.GetPointer());
+  empty->SetLines(lines.GetPointer());
+  hierarchy->SetDataSet(empty.GetPointer());
+  hierarchy->BuildLocator();
+
+  double x[3] = {1.0, 2.0, 3.0};
+  double closestPoint[3], dist2;
+  vtkIdType cellId;
+  if (hierarchy->GetNumberOfTriangles() != 0 ||
+      hierarchy->FindClosestPoint(x, closestPoint, cellId, dist2))
+    {
+    std::cerr << "Closest point found in a dataset without triangles" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
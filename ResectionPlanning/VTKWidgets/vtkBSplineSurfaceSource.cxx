@@ -0,0 +1,553 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkBSplineSurfaceSource.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#include "vtkBSplineSurfaceSource.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkDoubleArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <algorithm>
+
+//-------------------------------------------------------------------------------
+// Clamped uniform knot vector of numberOfControlPoints+degree+1 knots in [0,1].
+static void ComputeKnots(unsigned int numberOfControlPoints,
+                         unsigned int degree,
+                         std::vector<double> &knots)
+{
+  unsigned int numberOfSpans = numberOfControlPoints - degree;
+  knots.assign(numberOfControlPoints + degree + 1, 0.0);
+
+  for (unsigned int k=1; k<numberOfSpans; k++)
+    {
+    knots[degree+k] = k / static_cast<double>(numberOfSpans);
+    }
+  for (unsigned int k=numberOfControlPoints; k<knots.size(); k++)
+    {
+    knots[k] = 1.0;
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Index of the knot span [knots[span], knots[span+1]) containing t, limited to
+// the last non-empty span so that t = 1 is included.
+static unsigned int FindSpan(unsigned int numberOfControlPoints,
+                             unsigned int degree,
+                             double t,
+                             const std::vector<double> &knots)
+{
+  if (t >= knots[numberOfControlPoints])
+    {
+    return numberOfControlPoints - 1;
+    }
+
+  unsigned int low = degree;
+  unsigned int high = numberOfControlPoints;
+  while (high - low > 1)
+    {
+    unsigned int middle = (low + high) / 2;
+    if (t < knots[middle])
+      {
+      high = middle;
+      }
+    else
+      {
+      low = middle;
+      }
+    }
+  return low;
+}
+
+//-------------------------------------------------------------------------------
+// The degree+1 non-zero basis functions at t, computed with the Cox-de Boor
+// recurrence, which only involves convex combinations and is stable for any
+// degree and number of control points.
+static void ComputeBasisFunctions(unsigned int span,
+                                  unsigned int degree,
+                                  double t,
+                                  const std::vector<double> &knots,
+                                  double *basis)
+{
+  std::vector<double> left(degree+1), right(degree+1);
+
+  basis[0] = 1.0;
+  for (unsigned int k=1; k<=degree; k++)
+    {
+    left[k] = t - knots[span+1-k];
+    right[k] = knots[span+k] - t;
+
+    double saved = 0.0;
+    for (unsigned int r=0; r<k; r++)
+      {
+      double temp = basis[r] / (right[r+1] + left[k-r]);
+      basis[r] = saved + right[r+1] * temp;
+      saved = left[k-r] * temp;
+      }
+    basis[k] = saved;
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Tabulates the knot span and the non-zero basis functions of every sample,
+// and the first and last sample influenced by every control point.
+static void ComputeBasisTable(unsigned int resolution,
+                              unsigned int numberOfControlPoints,
+                              unsigned int degree,
+                              std::vector<unsigned int> &spans,
+                              std::vector<double> &table,
+                              std::vector<unsigned int> &sampleRanges)
+{
+  std::vector<double> knots;
+  ComputeKnots(numberOfControlPoints, degree, knots);
+
+  spans.assign(resolution, 0);
+  table.assign(resolution*(degree+1), 0.0);
+  sampleRanges.resize(numberOfControlPoints*2);
+  for (unsigned int c=0; c<numberOfControlPoints; c++)
+    {
+    sampleRanges[c*2] = resolution;
+    sampleRanges[c*2+1] = 0;
+    }
+
+  for (unsigned int s=0; s<resolution; s++)
+    {
+    double t = resolution > 1 ? s / static_cast<double>(resolution - 1) : 0.0;
+    spans[s] = FindSpan(numberOfControlPoints, degree, t, knots);
+    ComputeBasisFunctions(spans[s], degree, t, knots, &table[s*(degree+1)]);
+
+    for (unsigned int a=0; a<=degree; a++)
+      {
+      unsigned int c = spans[s] - degree + a;
+      sampleRanges[c*2] = std::min(sampleRanges[c*2], s);
+      sampleRanges[c*2+1] = std::max(sampleRanges[c*2+1], s);
+      }
+    }
+}
+
+//-------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkBSplineSurfaceSource);
+
+//-------------------------------------------------------------------------------
+vtkBSplineSurfaceSource::vtkBSplineSurfaceSource()
+{
+  this->SetNumberOfInputPorts(0);
+  this->SetNumberOfOutputPorts(1);
+  this->NumberOfControlPoints[0] = 0;
+  this->NumberOfControlPoints[1] = 0;
+  this->Degree[0] = 3;
+  this->Degree[1] = 3;
+  this->Resolution[0] = 0;
+  this->Resolution[1] = 0;
+  this->SurfaceUpToDate = false;
+
+  //Note: default is a bi-cubic surface with 6x6 control points
+  this->SetNumberOfControlPoints(6,6);
+  this->SetResolution(40,40);
+}
+
+//-------------------------------------------------------------------------------
+vtkBSplineSurfaceSource::~vtkBSplineSurfaceSource()
+{
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  vtkPolyDataAlgorithm::PrintSelf(os, indent);
+
+  os << "Resolution: " << this->Resolution[0] << ", " << this->Resolution[1] << "\n";
+
+  os << "Number of Control Points : " <<
+    this->NumberOfControlPoints[0] << ", " <<
+    this->NumberOfControlPoints[1] << "\n";
+
+  os << "Degree: " << this->Degree[0] << ", " << this->Degree[1] << "\n";
+
+  unsigned int numberOfPoints =
+    this->NumberOfControlPoints[0]*this->NumberOfControlPoints[1];
+  for(unsigned int c=0; c<numberOfPoints; c++)
+    {
+    os << "Control point[" << c / this->NumberOfControlPoints[1] << ", "
+       << c % this->NumberOfControlPoints[1] << "] = "
+       << this->ControlPoints[c*3] << ", " << this->ControlPoints[c*3+1] << ", "
+       << this->ControlPoints[c*3+2] << " (weight " << this->Weights[c] << ")\n";
+    }
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::SetControlPoints(vtkPoints *points)
+{
+  unsigned int numberOfPoints =
+    this->NumberOfControlPoints[0]*this->NumberOfControlPoints[1];
+
+  if (!points || points->GetNumberOfPoints() < static_cast<vtkIdType>(numberOfPoints))
+    {
+    vtkErrorMacro("SetControlPoints: " << numberOfPoints
+                  << " control points expected.");
+    return;
+    }
+
+  for(unsigned int c=0; c<numberOfPoints; c++)
+    {
+    points->GetPoint(c, &this->ControlPoints[c*3]);
+    }
+
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+vtkSmartPointer<vtkPoints>
+vtkBSplineSurfaceSource::GetControlPoints() const
+{
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+
+  unsigned int numberOfPoints =
+    this->NumberOfControlPoints[0]*this->NumberOfControlPoints[1];
+  points->SetNumberOfPoints(numberOfPoints);
+  for(unsigned int c=0; c<numberOfPoints; c++)
+    {
+    points->SetPoint(c, &this->ControlPoints[c*3]);
+    }
+
+  return points;
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::SetNumberOfControlPoints(unsigned int m, unsigned int n)
+{
+  //Assignment of less than 2 control points in any dimension will result in 2
+  //control points
+  m = (m<2) ? 2 : m;
+  n = (n<2) ? 2 : n;
+
+  if (this->NumberOfControlPoints[0] == m && this->NumberOfControlPoints[1] == n)
+    {
+    return;
+    }
+
+  this->NumberOfControlPoints[0] = m;
+  this->NumberOfControlPoints[1] = n;
+  this->ControlPoints.assign(m*n*3, 0.0);
+  this->Weights.assign(m*n, 1.0);
+
+  this->ResetControlPoints();
+  this->ComputeBasis();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::SetDegree(unsigned int p, unsigned int q)
+{
+  p = (p<1) ? 1 : p;
+  q = (q<1) ? 1 : q;
+
+  if (this->Degree[0] == p && this->Degree[1] == q)
+    {
+    return;
+    }
+
+  this->Degree[0] = p;
+  this->Degree[1] = q;
+  this->ComputeBasis();
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::SetResolution(unsigned int x, unsigned int y)
+{
+  if (this->Resolution[0] == x && this->Resolution[1] == y)
+    {
+    return;
+    }
+
+  this->Resolution[0] = x;
+  this->Resolution[1] = y;
+
+  this->DataArray = vtkSmartPointer<vtkDoubleArray>::New();
+  this->DataArray->SetNumberOfComponents(3);
+  this->DataArray->SetNumberOfTuples(x*y);
+  this->UpdateTopology();
+  this->ComputeBasis();
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::SetWeight(unsigned int index, double weight)
+{
+  if (index >= this->Weights.size() || weight <= 0.0)
+    {
+    vtkErrorMacro("SetWeight: invalid control point " << index
+                  << " or non-positive weight " << weight << ".");
+    return;
+    }
+
+  if (this->Weights[index] == weight)
+    {
+    return;
+    }
+
+  this->Weights[index] = weight;
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+double vtkBSplineSurfaceSource::GetWeight(unsigned int index) const
+{
+  return index < this->Weights.size() ? this->Weights[index] : 0.0;
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::ResetControlPoints()
+{
+  unsigned int m = this->NumberOfControlPoints[0];
+  unsigned int n = this->NumberOfControlPoints[1];
+
+  double distx = 1.0 / static_cast<double>(m-1);
+  double disty = 1.0 / static_cast<double>(n-1);
+
+  for (unsigned int i=0; i<m; i++)
+    {
+    for (unsigned int j=0; j<n; j++)
+      {
+      double *pt = &this->ControlPoints[(i*n+j)*3];
+      pt[0] = -0.5 + i*distx;
+      pt[1] = -0.5 + j*disty;
+      pt[2] = 0.0;
+      this->Weights[i*n+j] = 1.0;
+      }
+    }
+
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::MoveControlPoint(unsigned int index,
+                                               const double displacement[3])
+{
+  this->MoveControlPoints(1, &index, displacement);
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::MoveControlPoints(unsigned int numberOfPoints,
+                                                const unsigned int *indices,
+                                                const double displacement[3])
+{
+  unsigned int yGrid = this->NumberOfControlPoints[1];
+
+  for (unsigned int k=0; k<numberOfPoints; k++)
+    {
+    if (indices[k] >= this->Weights.size())
+      {
+      vtkErrorMacro("MoveControlPoints: control point " << indices[k]
+                    << " out of range.");
+      return;
+      }
+    }
+
+  for (unsigned int k=0; k<numberOfPoints; k++)
+    {
+    double *controlPoint = &this->ControlPoints[indices[k]*3];
+    controlPoint[0] += displacement[0];
+    controlPoint[1] += displacement[1];
+    controlPoint[2] += displacement[2];
+    }
+
+  // Without a surface to update, evaluate it all in the next execution
+  if (!this->SurfaceUpToDate)
+    {
+    this->Modified();
+    return;
+    }
+
+  // Evaluate again the samples in the support of every moved control point
+  for (unsigned int k=0; k<numberOfPoints; k++)
+    {
+    unsigned int i = indices[k] / yGrid;
+    unsigned int j = indices[k] % yGrid;
+    unsigned int firstX = this->SampleRangeX[i*2];
+    unsigned int lastX = this->SampleRangeX[i*2+1];
+    unsigned int firstY = this->SampleRangeY[j*2];
+    unsigned int lastY = this->SampleRangeY[j*2+1];
+
+    // The control point may not influence any sample at low resolutions
+    if (firstX > lastX || firstY > lastY)
+      {
+      continue;
+      }
+
+    this->EvaluateSamples(firstX, lastX, firstY, lastY);
+    }
+
+  this->DataArray->Modified();
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+int vtkBSplineSurfaceSource::RequestData(vtkInformation *vtkNotUsed(request),
+                                         vtkInformationVector **vtkNotUsed(inputVector),
+                                         vtkInformationVector *outputVector)
+{
+  vtkInformation *surfaceOutputInfo = outputVector->GetInformationObject(0);
+  if (!surfaceOutputInfo)
+    {
+    return 1;
+    }
+
+  vtkPolyData *surfaceOutput =
+    vtkPolyData::SafeDownCast(surfaceOutputInfo->Get(vtkDataObject::DATA_OBJECT()));
+  if (!surfaceOutput)
+    {
+    return 1;
+    }
+
+  if (!this->SurfaceUpToDate && this->Resolution[0] > 0 && this->Resolution[1] > 0)
+    {
+    this->EvaluateSamples(0, this->Resolution[0]-1, 0, this->Resolution[1]-1);
+    this->DataArray->Modified();
+    }
+  this->SurfaceUpToDate = true;
+
+  vtkSmartPointer<vtkPoints> surfacePoints =
+    vtkSmartPointer<vtkPoints>::New();
+  surfacePoints->SetData(this->DataArray.GetPointer());
+  surfaceOutput->SetPoints(surfacePoints);
+  surfaceOutput->SetPolys(this->Topology);
+
+  return 1;
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::UpdateTopology()
+{
+  unsigned int xRes = this->Resolution[0];
+  unsigned int yRes = this->Resolution[1];
+
+  this->Topology = vtkSmartPointer<vtkCellArray>::New();
+
+  for (unsigned int i=0; i+1<xRes; i++)
+    {
+    for (unsigned int j=0; j+1<yRes; j++)
+      {
+      unsigned int base = i*yRes + j;
+      unsigned int a = base;
+      unsigned int b = base + 1;
+      unsigned int c = base + yRes + 1;
+      unsigned int d = base + yRes;
+      vtkIdType triangle[3];
+
+      triangle[0] = c;
+      triangle[1] = b;
+      triangle[2] = a;
+      this->Topology->InsertNextCell(3, triangle);
+
+      triangle[0] = d;
+      triangle[1] = c;
+      triangle[2] = a;
+      this->Topology->InsertNextCell(3, triangle);
+      }
+    }
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::ComputeBasis()
+{
+  // The degree cannot exceed the number of control points minus one
+  unsigned int p = std::min(this->Degree[0], this->NumberOfControlPoints[0]-1);
+  unsigned int q = std::min(this->Degree[1], this->NumberOfControlPoints[1]-1);
+
+  ComputeBasisTable(this->Resolution[0], this->NumberOfControlPoints[0], p,
+                    this->SpanX, this->BasisX, this->SampleRangeX);
+  ComputeBasisTable(this->Resolution[1], this->NumberOfControlPoints[1], q,
+                    this->SpanY, this->BasisY, this->SampleRangeY);
+}
+
+//-------------------------------------------------------------------------------
+void vtkBSplineSurfaceSource::EvaluateSamples(unsigned int firstX,
+                                              unsigned int lastX,
+                                              unsigned int firstY,
+                                              unsigned int lastY)
+{
+  unsigned int yGrid = this->NumberOfControlPoints[1];
+  unsigned int yRes = this->Resolution[1];
+  unsigned int p = std::min(this->Degree[0], this->NumberOfControlPoints[0]-1);
+  unsigned int q = std::min(this->Degree[1], this->NumberOfControlPoints[1]-1);
+  double *surfacePoints = this->DataArray->GetPointer(0);
+
+#pragma omp parallel for
+  for (int i=static_cast<int>(firstX); i<=static_cast<int>(lastX); i++)
+    {
+    const double *basisx = &this->BasisX[i*(p+1)];
+    unsigned int spanx = this->SpanX[i];
+
+    for (unsigned int j=firstY; j<=lastY; j++)
+      {
+      const double *basisy = &this->BasisY[j*(q+1)];
+      unsigned int spany = this->SpanY[j];
+
+      // Homogeneous coordinates of the point (the weights are 1 for
+      // non-rational surfaces)
+      double point[4] = {0.0, 0.0, 0.0, 0.0};
+
+      for (unsigned int a=0; a<=p; a++)
+        {
+        unsigned int row = (spanx - p + a) * yGrid + spany - q;
+        for (unsigned int b=0; b<=q; b++)
+          {
+          double weight = basisx[a] * basisy[b] * this->Weights[row+b];
+          const double *controlPoint = &this->ControlPoints[(row+b)*3];
+          point[0] += weight * controlPoint[0];
+          point[1] += weight * controlPoint[1];
+          point[2] += weight * controlPoint[2];
+          point[3] += weight;
+          }
+        }
+
+      double *surfacePoint = surfacePoints + (i*yRes+j)*3;
+      surfacePoint[0] = point[0] / point[3];
+      surfacePoint[1] = point[1] / point[3];
+      surfacePoint[2] = point[2] / point[3];
+      }
+    }
+  //END: parallel for
+}
@@ -0,0 +1,297 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkBSplineSurfaceSource.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#ifndef __vtkBSplineSurfaceSource_h
+#define __vtkBSplineSurfaceSource_h
+
+// VTK includes
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+//-------------------------------------------------------------------------------
+class vtkPoints;
+class vtkPolyData;
+class vtkDoubleArray;
+class vtkCellArray;
+
+//------------------------------------------------------------------------------
+/**
+ * \ingroup ResectionPlanning
+ *
+ * \brief This class generates the geometry of a tensor product B-spline
+ * surface, optionally rational (NURBS), defined by a grid of \f$m\times n\f$
+ * control points and clamped uniform knot vectors of degree \f$p\f$ and
+ * \f$q\f$ in the parametric directions \f$u\f$ and \f$v\f$.
+ *
+ * Unlike a Bézier surface, each control point only influences the
+ * \f$(p+1)\times(q+1)\f$ knot spans around it, so the grid of control points
+ * can be made as dense as required. The non-zero basis functions of every
+ * sample are computed with the Cox-de Boor recurrence (numerically stable for
+ * any number of control points) and tabulated per resolution, and moving
+ * control points only evaluates the samples of the spans they influence again.
+ *
+ * The control points are ordered as in vtkBezierSurfaceSource (see
+ * SetControlPoints()).
+ */
+class vtkBSplineSurfaceSource : public vtkPolyDataAlgorithm
+{
+ public:
+
+  /**
+   * Instantiation of object.
+   *
+   * @return pointer to vtkBSplineSurfaceSource newly created.
+   */
+  static vtkBSplineSurfaceSource *New();
+
+  vtkTypeMacro(vtkBSplineSurfaceSource, vtkPolyDataAlgorithm);
+
+  /**
+   * Print the properties of the object.
+   *
+   * @param os ouptut stream to print the properties to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent);
+
+  /**
+   * Set the control points. The control point (i, j) is the point
+   * i*n+j, where n is the number of control points in the parametric
+   * direction v.
+   *
+   * @param points pointer to vtkPoints object containing the
+   * coordinates of the control points.
+   */
+  void SetControlPoints(vtkPoints *points);
+
+  /**
+   * Get the control points.
+   *
+   * @return pointer to vtkPoints object containing the coordinates of
+   * the control points.
+   */
+  vtkSmartPointer<vtkPoints> GetControlPoints() const;
+
+  /**
+   * Set the number of control points. The control points are reset to a
+   * plane and their weights to 1.
+   *
+   * @param m number of control points in the parametric u direction.
+   * @param n number of control points in the parametric v direction.
+   */
+  void SetNumberOfControlPoints(unsigned int m, unsigned int n);
+
+  /**
+   * Get the number of control poits in the parametric direction u.
+   *
+   * @return number of control points in the parametric direction u.
+   */
+  unsigned int GetNumberOfControlPointsX() const
+  {return this->NumberOfControlPoints[0];}
+
+  /**
+   * Get the number of control poits in the parametric direction v.
+   *
+   * @return number of control points in the parametric direction v.
+   */
+  unsigned int GetNumberOfControlPointsY() const
+  {return this->NumberOfControlPoints[1];}
+
+  /**
+   * Set the degree of the surface. The degree in each parametric direction is
+   * limited to the number of control points minus one; with that degree the
+   * surface is the Bézier surface of the control points.
+   *
+   * @param p degree in the parametric direction u.
+   * @param q degree in the parametric direction v.
+   */
+  void SetDegree(unsigned int p, unsigned int q);
+
+  /**
+   * Get the degree of the surface in the parametric direction u.
+   *
+   * @return degree in the parametric direction u.
+   */
+  unsigned int GetDegreeX() const
+  {return this->Degree[0];}
+
+  /**
+   * Get the degree of the surface in the parametric direction v.
+   *
+   * @return degree in the parametric direction v.
+   */
+  unsigned int GetDegreeY() const
+  {return this->Degree[1];}
+
+  /**
+   * Set the resolution of the surface (number of samples).
+   *
+   * @param x resolution of the surface in the parametric u direction.
+   * @param y resolution of the surface in the parametric v direction.
+   */
+  void SetResolution(unsigned int x, unsigned int y);
+
+  /**
+   * Get the resolution in the parametric direction u.
+   *
+   * @return resolution in parametric direction u.
+   */
+  unsigned int GetResolutionX() const
+  {return this->Resolution[0];}
+
+  /**
+   * Get the resolution in the parametric direction v.
+   *
+   * @return resolution in the parametric direction v.
+   */
+  unsigned int GetResolutionY() const
+  {return this->Resolution[1];}
+
+  /**
+   * Set the weight of a control point, making the surface rational
+   * (NURBS). Weights must be positive; all the weights are 1 by default.
+   *
+   * @param index index of the control point (see SetControlPoints()).
+   * @param weight weight of the control point.
+   */
+  void SetWeight(unsigned int index, double weight);
+
+  /**
+   * Get the weight of a control point.
+   *
+   * @param index index of the control point (see SetControlPoints()).
+   *
+   * @return weight of the control point, 0 if the index is out of range.
+   */
+  double GetWeight(unsigned int index) const;
+
+  /**
+   * Set the control points to the default values (e.g., lying in a
+   * plane of size 1) and their weights to 1.
+   */
+  void ResetControlPoints();
+
+  /**
+   * Move a control point and update the surface locally: only the samples
+   * in the knot spans influenced by the control point are evaluated again,
+   * so the cost does not grow with the number of control points.
+   *
+   * @param index index of the control point (see SetControlPoints()).
+   * @param displacement displacement of the control point.
+   */
+  void MoveControlPoint(unsigned int index, const double displacement[3]);
+
+  /**
+   * Move a group of control points by the same displacement and update the
+   * surface locally (see MoveControlPoint()).
+   *
+   * @param numberOfPoints number of control points to move.
+   * @param indices indices of the control points to move.
+   * @param displacement displacement of the control points.
+   */
+  void MoveControlPoints(unsigned int numberOfPoints,
+                         const unsigned int *indices,
+                         const double displacement[3]);
+
+ protected:
+  vtkBSplineSurfaceSource();
+  ~vtkBSplineSurfaceSource();
+
+  /**
+   * Function computing the B-spline surface according to the pipeline
+   * architecture of VTK.
+   *
+   * @return return code.
+   */
+  int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *);
+
+ private:
+  vtkBSplineSurfaceSource(const vtkBSplineSurfaceSource&);  // Not implemented.
+  void operator=(const vtkBSplineSurfaceSource&);  // Not implemented.
+
+  /**
+   * Updates the topology of the mesh representing the surface. An effective
+   * update will happen whenever the resolution of the surface is changed.
+   */
+  void UpdateTopology();
+
+  /**
+   * Computation of the knot vectors, and of the knot span and the non-zero
+   * basis functions of every sample in both parametric directions. It is
+   * called whenever the resolution, the number of control points or the
+   * degree change.
+   */
+  void ComputeBasis();
+
+  /**
+   * Evaluation of the samples of the surface in a rectangle of the
+   * parametric grid.
+   *
+   * @param firstX first sample in the parametric direction u.
+   * @param lastX last sample in the parametric direction u.
+   * @param firstY first sample in the parametric direction v.
+   * @param lastY last sample in the parametric direction v.
+   */
+  void EvaluateSamples(unsigned int firstX, unsigned int lastX,
+                       unsigned int firstY, unsigned int lastY);
+
+  unsigned int NumberOfControlPoints[2];
+  unsigned int Degree[2];
+  unsigned int Resolution[2];
+
+  // Control points (x, y, z) and weights, in the order of SetControlPoints().
+  std::vector<double> ControlPoints;
+  std::vector<double> Weights;
+
+  // Knot span and Degree+1 non-zero basis functions of every sample, and the
+  // range of samples influenced by every control point, per parametric
+  // direction.
+  std::vector<unsigned int> SpanX;
+  std::vector<unsigned int> SpanY;
+  std::vector<double> BasisX;
+  std::vector<double> BasisY;
+  std::vector<unsigned int> SampleRangeX;
+  std::vector<unsigned int> SampleRangeY;
+
+  // Whether DataArray holds the surface of the current control points.
+  bool SurfaceUpToDate;
+
+  vtkSmartPointer<vtkDoubleArray> DataArray;
+  vtkSmartPointer<vtkCellArray> Topology;
+};
+
+#endif
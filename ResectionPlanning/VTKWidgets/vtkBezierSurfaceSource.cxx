@@ -41,33 +41,149 @@
 #include <vtkExecutive.h>
 #include <vtkInformationVector.h>
 #include <vtkDoubleArray.h>
+#include <vtkPointData.h>
+#include <vtkMath.h>
 
 // STD includes
 #include <cmath>
 
 //-------------------------------------------------------------------------------
-inline double intpow( double base, unsigned int exponent )
+// Tabulates the Bernstein polynomials of degree numberOfControlPoints-1 at
+// resolution equispaced samples of [0,1]. The polynomials are evaluated with
+// the triangular recurrence B(k,i) = (1-t)B(k-1,i) + tB(k-1,i-1), which avoids
+// both the powers and the binomial coefficients.
+static void ComputeBernsteinTable(unsigned int resolution,
+                                  unsigned int numberOfControlPoints,
+                                  std::vector<double> &table)
 {
-  double out = base;
-  for(unsigned int i=1 ; i < exponent ; i++ )
+  table.assign(resolution*numberOfControlPoints, 0.0);
+
+  for (unsigned int s=0; s<resolution; s++)
     {
-    out *= base;
+    double t = resolution > 1 ? s / static_cast<double>(resolution - 1) : 0.0;
+    double *basis = &table[s*numberOfControlPoints];
+
+    basis[0] = 1.0;
+    for (unsigned int k=1; k<numberOfControlPoints; k++)
+      {
+      basis[k] = t * basis[k-1];
+      for (unsigned int i=k-1; i>0; i--)
+        {
+        basis[i] = (1.0 - t) * basis[i] + t * basis[i-1];
+        }
+      basis[0] = (1.0 - t) * basis[0];
+      }
     }
+}
+
+//-------------------------------------------------------------------------------
+// Tabulates the derivatives of the Bernstein polynomials of degree
+// numberOfControlPoints-1, obtained from the polynomials of one degree less:
+// B'(n,i) = n (B(n-1,i-1) - B(n-1,i)).
+static void ComputeBernsteinDerivativeTable(unsigned int resolution,
+                                            unsigned int numberOfControlPoints,
+                                            std::vector<double> &table)
+{
+  unsigned int degree = numberOfControlPoints - 1;
+  std::vector<double> lower;
+  ComputeBernsteinTable(resolution, degree, lower);
+
+  table.assign(resolution*numberOfControlPoints, 0.0);
+
+  for (unsigned int s=0; s<resolution; s++)
+    {
+    const double *lowerBasis = &lower[s*degree];
+    double *derivative = &table[s*numberOfControlPoints];
+
+    for (unsigned int i=0; i<numberOfControlPoints; i++)
+      {
+      double previous = i > 0 ? lowerBasis[i-1] : 0.0;
+      double current = i < degree ? lowerBasis[i] : 0.0;
+      derivative[i] = degree * (previous - current);
+      }
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Multiplies each row of control points by a basis table in v, producing
+// numberOfControlPointsX rows of resolutionY points.
+static void MultiplyControlRows(double **controlPoints,
+                                unsigned int numberOfControlPointsX,
+                                unsigned int numberOfControlPointsY,
+                                const std::vector<double> &basisY,
+                                unsigned int resolutionY,
+                                std::vector<double> &products)
+{
+  for (unsigned int ci=0; ci<numberOfControlPointsX; ci++)
+    {
+    const double *controlRow = controlPoints[ci];
+    double *product = &products[ci*resolutionY*3];
+
+    for (unsigned int j=0; j<resolutionY; j++)
+      {
+      const double *basisy = &basisY[j*numberOfControlPointsY];
+      double point[3] = {0.0, 0.0, 0.0};
+
+      for (unsigned int cj=0; cj<numberOfControlPointsY; cj++)
+        {
+        point[0] += basisy[cj] * controlRow[cj*3];
+        point[1] += basisy[cj] * controlRow[cj*3+1];
+        point[2] += basisy[cj] * controlRow[cj*3+2];
+        }
 
-  return exponent==0?1:out;
+      product[j*3]   = point[0];
+      product[j*3+1] = point[1];
+      product[j*3+2] = point[2];
+      }
+    }
 }
 
 //-------------------------------------------------------------------------------
-inline long int Factorial(int n)
+// Combines the rows produced by MultiplyControlRows() with the basis values
+// in u of one sample, producing one row of the surface.
+static void CombineRows(const double *basisx,
+                        const std::vector<double> &products,
+                        unsigned int numberOfControlPointsX,
+                        unsigned int rowLength,
+                        double *surfaceRow)
 {
-  long int fac = 1;
+  for (unsigned int j=0; j<rowLength; j++)
+    {
+    surfaceRow[j] = 0.0;
+    }
 
-  for(int i=2; i<=n; ++i)
+  for (unsigned int ci=0; ci<numberOfControlPointsX; ci++)
     {
-    fac *= i;
+    const double weight = basisx[ci];
+    const double *product = &products[ci*rowLength];
+
+    for (unsigned int j=0; j<rowLength; j++)
+      {
+      surfaceRow[j] += weight * product[j];
+      }
     }
+}
 
-  return fac;
+//-------------------------------------------------------------------------------
+// Computes the normals of a row of samples from their tangents. Where the
+// tangents are parallel (e.g., at a collapsed edge of the control grid) the
+// normal of the previous sample in the row is used.
+static void ComputeNormalsRow(const double *tangentU,
+                              const double *tangentV,
+                              unsigned int resolutionY,
+                              double *normals)
+{
+  for (unsigned int j=0; j<resolutionY; j++)
+    {
+    double *normal = normals + j*3;
+    vtkMath::Cross(tangentU + j*3, tangentV + j*3, normal);
+    if (vtkMath::Normalize(normal) == 0.0 && j > 0)
+      {
+      normal[0] = normal[-3];
+      normal[1] = normal[-2];
+      normal[2] = normal[-1];
+      }
+    }
 }
 
 //-------------------------------------------------------------------------------
@@ -79,8 +195,15 @@ vtkBezierSurfaceSource::vtkBezierSurfaceSource()
   this->SetNumberOfInputPorts(0);
   this->SetNumberOfOutputPorts(1);
   this->ControlPoints = NULL;
-  this->BinomialCoefficientsX = 0;
-  this->BinomialCoefficientsY = 0;
+  this->NumberOfControlPoints[0] = 0;
+  this->NumberOfControlPoints[1] = 0;
+  this->Resolution[0] = 0;
+  this->Resolution[1] = 0;
+  this->SurfaceUpToDate = false;
+  this->NumberOfIncrementalUpdates = 0;
+  this->MaximumNumberOfIncrementalUpdates = 100;
+  this->GenerateNormals = true;
+  this->GenerateTangents = false;
 
   //Note: default is bi-cubic bezier surface (cp=4x4)
   this->SetNumberOfControlPoints(4,4);
@@ -101,18 +224,6 @@ vtkBezierSurfaceSource::~vtkBezierSurfaceSource()
     this->ControlPoints = NULL;
     }
 
-  if (this->BinomialCoefficientsX != NULL)
-    {
-    delete [] this->BinomialCoefficientsX;
-    this->BinomialCoefficientsX = NULL;
-    }
-
-  if (this->BinomialCoefficientsY != NULL)
-    {
-    delete [] this->BinomialCoefficientsY;
-    this->BinomialCoefficientsY = NULL;
-    }
-
   this->NumberOfControlPoints[0] = 0;
   this->NumberOfControlPoints[1] = 0;
 }
@@ -146,17 +257,14 @@ void vtkBezierSurfaceSource::PrintSelf(ostream &os, vtkIndent indent)
     os << "\n";
     }
 
-  for(unsigned int i=0; i<xGrid; i++)
-    {
-    os << "Binomial coefficient X[" << i << "] = "
-       << this->BinomialCoefficientsX[i] << "\n";
-    }
+  os << "Generate normals: " << (this->GenerateNormals ? "On" : "Off") << "\n";
+  os << "Generate tangents: " << (this->GenerateTangents ? "On" : "Off") << "\n";
 
-  for(unsigned int i=0; i<yGrid; i++)
-    {
-    os << "Binomial coefficient Y[" << i << "] = "
-       << this->BinomialCoefficientsY[i] << "\n";
-    }
+  os << "Maximum number of incremental updates: "
+     << this->MaximumNumberOfIncrementalUpdates << "\n";
+
+  os << "Basis table X: " << this->BasisX.size() << " values\n";
+  os << "Basis table Y: " << this->BasisY.size() << " values\n";
 }
 
 //-------------------------------------------------------------------------------
@@ -173,6 +281,7 @@ void vtkBezierSurfaceSource::SetControlPoints(vtkPoints *points)
       }
     }
 
+  this->SurfaceUpToDate = false;
   this->Modified();
 }
 
@@ -214,33 +323,19 @@ void vtkBezierSurfaceSource::SetNumberOfControlPoints(unsigned int m, unsigned i
     delete [] this->ControlPoints;
     }
 
-  if (this->BinomialCoefficientsX != NULL)
-    {
-    delete [] this->BinomialCoefficientsX;
-    this->BinomialCoefficientsX = NULL;
-    }
-
-  if (this->BinomialCoefficientsY != NULL)
-    {
-    delete [] this->BinomialCoefficientsY;
-    this->BinomialCoefficientsY = NULL;
-    }
-
   //Assignment of less than 2 control points in any dimension will result in 2
   //control points
   this->NumberOfControlPoints[0] = (m<2) ? 2 : m;
   this->NumberOfControlPoints[1] = (n<2) ? 2 : n;
 
   this->ControlPoints = new double*[this->NumberOfControlPoints[0]];
-  for(unsigned int i=0; i<m; i++)
+  for(unsigned int i=0; i<this->NumberOfControlPoints[0]; i++)
     {
-    this->ControlPoints[i] = new double[n*3];
+    this->ControlPoints[i] = new double[this->NumberOfControlPoints[1]*3];
     }
 
   this->ResetControlPoints();
-  this->BinomialCoefficientsX = new double[m];
-  this->BinomialCoefficientsY = new double[n];
-  this->ComputeBinomialCoefficients();
+  this->ComputeBasis();
 }
 
 //-------------------------------------------------------------------------------
@@ -263,6 +358,7 @@ void vtkBezierSurfaceSource::ResetControlPoints()
       }
     }
 
+  this->SurfaceUpToDate = false;
   this->Modified();
 }
 
@@ -280,7 +376,24 @@ void vtkBezierSurfaceSource::SetResolution(unsigned int x, unsigned int y)
   this->DataArray = vtkSmartPointer<vtkDoubleArray>::New();
   this->DataArray->SetNumberOfComponents(3);
   this->DataArray->SetNumberOfTuples(x*y);
+
+  this->NormalArray = vtkSmartPointer<vtkDoubleArray>::New();
+  this->NormalArray->SetName("Normals");
+  this->NormalArray->SetNumberOfComponents(3);
+  this->NormalArray->SetNumberOfTuples(x*y);
+
+  this->TangentUArray = vtkSmartPointer<vtkDoubleArray>::New();
+  this->TangentUArray->SetName("TangentU");
+  this->TangentUArray->SetNumberOfComponents(3);
+  this->TangentUArray->SetNumberOfTuples(x*y);
+
+  this->TangentVArray = vtkSmartPointer<vtkDoubleArray>::New();
+  this->TangentVArray->SetName("TangentV");
+  this->TangentVArray->SetNumberOfComponents(3);
+  this->TangentVArray->SetNumberOfTuples(x*y);
   this->UpdateTopology();
+  this->ComputeBasis();
+  this->SurfaceUpToDate = false;
   this->Modified();
 }
 
@@ -291,6 +404,144 @@ void vtkBezierSurfaceSource::GetResolution(unsigned int resolution[2]) const
   resolution[1] = this->Resolution[1];
 }
 
+//-------------------------------------------------------------------------------
+void vtkBezierSurfaceSource::SetGenerateNormals(bool generateNormals)
+{
+  if (this->GenerateNormals == generateNormals)
+    {
+    return;
+    }
+
+  this->GenerateNormals = generateNormals;
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBezierSurfaceSource::SetGenerateTangents(bool generateTangents)
+{
+  if (this->GenerateTangents == generateTangents)
+    {
+    return;
+    }
+
+  this->GenerateTangents = generateTangents;
+  this->SurfaceUpToDate = false;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkBezierSurfaceSource::MoveControlPoint(unsigned int index,
+                                              const double displacement[3])
+{
+  this->MoveControlPoints(1, &index, displacement);
+}
+
+//-------------------------------------------------------------------------------
+void vtkBezierSurfaceSource::MoveControlPoints(unsigned int numberOfPoints,
+                                               const unsigned int *indices,
+                                               const double displacement[3])
+{
+  unsigned int xGrid = this->NumberOfControlPoints[0];
+  unsigned int yGrid = this->NumberOfControlPoints[1];
+
+  for (unsigned int k=0; k<numberOfPoints; k++)
+    {
+    if (indices[k] >= xGrid*yGrid)
+      {
+      vtkErrorMacro("MoveControlPoints: control point " << indices[k]
+                    << " out of range.");
+      return;
+      }
+    }
+
+  for (unsigned int k=0; k<numberOfPoints; k++)
+    {
+    double *controlPoint =
+      this->ControlPoints[indices[k] / yGrid] + (indices[k] % yGrid) * 3;
+    controlPoint[0] += displacement[0];
+    controlPoint[1] += displacement[1];
+    controlPoint[2] += displacement[2];
+    }
+
+  // Evaluate from scratch if there is nothing to update, or once in a while
+  // to get rid of the accumulated rounding errors.
+  if (!this->SurfaceUpToDate ||
+      this->NumberOfIncrementalUpdates >= this->MaximumNumberOfIncrementalUpdates)
+    {
+    this->SurfaceUpToDate = false;
+    this->Modified();
+    return;
+    }
+
+  unsigned int xRes = this->Resolution[0];
+  unsigned int yRes = this->Resolution[1];
+  bool derivatives = this->GenerateNormals || this->GenerateTangents;
+  double *surfacePoints = this->DataArray->GetPointer(0);
+  double *tangentsU = this->TangentUArray->GetPointer(0);
+  double *tangentsV = this->TangentVArray->GetPointer(0);
+  double *normals = this->NormalArray->GetPointer(0);
+
+#pragma omp parallel for
+  for (unsigned int i=0; i<xRes; i++)
+    {
+    const double *basisx = &this->BasisX[i*xGrid];
+    const double *derivativex = &this->DerivativeBasisX[i*xGrid];
+    double *surfaceRow = surfacePoints + i*yRes*3;
+    double *tangentURow = tangentsU + i*yRes*3;
+    double *tangentVRow = tangentsV + i*yRes*3;
+
+    for (unsigned int j=0; j<yRes; j++)
+      {
+      const double *basisy = &this->BasisY[j*yGrid];
+      double weight = 0.0;
+
+      for (unsigned int k=0; k<numberOfPoints; k++)
+        {
+        weight += basisx[indices[k] / yGrid] * basisy[indices[k] % yGrid];
+        }
+
+      surfaceRow[j*3]   += weight * displacement[0];
+      surfaceRow[j*3+1] += weight * displacement[1];
+      surfaceRow[j*3+2] += weight * displacement[2];
+
+      // The tangents move with the derivatives of the same basis products
+      if (derivatives)
+        {
+        const double *derivativey = &this->DerivativeBasisY[j*yGrid];
+        double weightU = 0.0;
+        double weightV = 0.0;
+
+        for (unsigned int k=0; k<numberOfPoints; k++)
+          {
+          weightU += derivativex[indices[k] / yGrid] * basisy[indices[k] % yGrid];
+          weightV += basisx[indices[k] / yGrid] * derivativey[indices[k] % yGrid];
+          }
+
+        tangentURow[j*3]   += weightU * displacement[0];
+        tangentURow[j*3+1] += weightU * displacement[1];
+        tangentURow[j*3+2] += weightU * displacement[2];
+        tangentVRow[j*3]   += weightV * displacement[0];
+        tangentVRow[j*3+1] += weightV * displacement[1];
+        tangentVRow[j*3+2] += weightV * displacement[2];
+        }
+      }
+
+    if (this->GenerateNormals)
+      {
+      ComputeNormalsRow(tangentURow, tangentVRow, yRes, normals + i*yRes*3);
+      }
+    }
+  //END: parallel for
+
+  this->NumberOfIncrementalUpdates++;
+  this->DataArray->Modified();
+  this->NormalArray->Modified();
+  this->TangentUArray->Modified();
+  this->TangentVArray->Modified();
+  this->Modified();
+}
+
 //-------------------------------------------------------------------------------
 int vtkBezierSurfaceSource::RequestData(vtkInformation *vtkNotUsed(request),
                                         vtkInformationVector **vtkNotUsed(inputVector),
@@ -341,39 +592,20 @@ void vtkBezierSurfaceSource::UpdateTopology()
 }
 
 //-------------------------------------------------------------------------------
-void vtkBezierSurfaceSource::ComputeBinomialCoefficients()
+void vtkBezierSurfaceSource::ComputeBasis()
 {
-  unsigned int xGrid = this->NumberOfControlPoints[0];
-  unsigned int yGrid = this->NumberOfControlPoints[1];
-
-#pragma omp parallel for
-  for (unsigned int i=0; i<xGrid; i++)
-    {
-    this->BinomialCoefficientsX[i] =
-      Factorial(xGrid-1) /
-      static_cast<double>(Factorial(i)*Factorial(xGrid-i-1));
-    }
-  //END parallell for
-
-  if (xGrid != yGrid)
-    {
-#pragma omp parallel for
-    for (unsigned int i=0; i<yGrid; i++)
-      {
-      this->BinomialCoefficientsY[i] =
-        Factorial(yGrid-1) /
-        static_cast<double>(Factorial(i)*Factorial(yGrid-i-1));
-      }
-    }
-  else
-    {
-#pragma omp parallel for
-    for (unsigned int i=0; i<xGrid; i++)
-      {
-      this->BinomialCoefficientsY[i] = this->BinomialCoefficientsX[i];
-      }
-    //END parallell for
-    }
+  ComputeBernsteinTable(this->Resolution[0], this->NumberOfControlPoints[0],
+                        this->BasisX);
+  ComputeBernsteinTable(this->Resolution[1], this->NumberOfControlPoints[1],
+                        this->BasisY);
+  ComputeBernsteinDerivativeTable(this->Resolution[0],
+                                  this->NumberOfControlPoints[0],
+                                  this->DerivativeBasisX);
+  ComputeBernsteinDerivativeTable(this->Resolution[1],
+                                  this->NumberOfControlPoints[1],
+                                  this->DerivativeBasisY);
+  this->RowProducts.resize(this->NumberOfControlPoints[0]*this->Resolution[1]*3);
+  this->RowDerivativeProducts.resize(this->RowProducts.size());
 }
 
 //-------------------------------------------------------------------------------
@@ -387,8 +619,28 @@ void vtkBezierSurfaceSource::UpdateBezierSurfacePolyData(vtkPolyData *polyData)
   vtkSmartPointer<vtkPoints> surfacePoints =
     vtkSmartPointer<vtkPoints>::New();
 
-  this->EvaluateBezierSurface(surfacePoints);
+  // Incremental updates of the control points have already been applied
+  if (this->SurfaceUpToDate)
+    {
+    surfacePoints->SetData(this->DataArray.GetPointer());
+    }
+  else
+    {
+    this->EvaluateBezierSurface(surfacePoints);
+    }
   polyData->SetPoints(surfacePoints);
+
+  vtkPointData *pointData = polyData->GetPointData();
+  pointData->Initialize();
+  if (this->GenerateNormals)
+    {
+    pointData->SetNormals(this->NormalArray.GetPointer());
+    }
+  if (this->GenerateTangents)
+    {
+    pointData->AddArray(this->TangentUArray.GetPointer());
+    pointData->AddArray(this->TangentVArray.GetPointer());
+    }
 }
 
 //-------------------------------------------------------------------------------
@@ -399,47 +651,54 @@ void vtkBezierSurfaceSource::EvaluateBezierSurface(vtkPoints *points)
   unsigned int xRes = this->Resolution[0];
   unsigned int yRes = this->Resolution[1];
 
+  bool derivatives = this->GenerateNormals || this->GenerateTangents;
+
+  // Control points times the v basis (and its derivative): one row of yRes
+  // points per row of control points.
+  MultiplyControlRows(this->ControlPoints, xGrid, yGrid, this->BasisY, yRes,
+                      this->RowProducts);
+  if (derivatives)
+    {
+    MultiplyControlRows(this->ControlPoints, xGrid, yGrid,
+                        this->DerivativeBasisY, yRes,
+                        this->RowDerivativeProducts);
+    }
+
+  // The u basis (and its derivative) times the rows above, written straight
+  // into the point and tangent buffers. The normal is the cross product of the
+  // tangents in u and v.
+  double *surfacePoints = this->DataArray->GetPointer(0);
+  double *tangentsU = this->TangentUArray->GetPointer(0);
+  double *tangentsV = this->TangentVArray->GetPointer(0);
+  double *normals = this->NormalArray->GetPointer(0);
+
 #pragma omp parallel for
   for (unsigned int i=0; i<xRes; i++)
     {
-    double u;
-    u = i / static_cast<double>(xRes - 1);
+    CombineRows(&this->BasisX[i*xGrid], this->RowProducts, xGrid, yRes*3,
+                surfacePoints + i*yRes*3);
 
-    for (unsigned int j=0; j<yRes; j++)
+    if (derivatives)
       {
+      CombineRows(&this->DerivativeBasisX[i*xGrid], this->RowProducts,
+                  xGrid, yRes*3, tangentsU + i*yRes*3);
+      CombineRows(&this->BasisX[i*xGrid], this->RowDerivativeProducts,
+                  xGrid, yRes*3, tangentsV + i*yRes*3);
+      }
 
-      double basisx, basisy;
-      double point[3];
-      double v;
-      v = j / static_cast<double>(yRes - 1);
-
-      point[0] = 0;
-      point[1] = 0;
-      point[2] = 0;
-
-      for (unsigned int ci=0; ci<xGrid; ci++)
-        {
-        basisx = static_cast<double>(this->BinomialCoefficientsX[ci])*
-          intpow(u,ci)*intpow((1-u),(xGrid-1-ci));
-
-        for (unsigned int cj=0; cj<yGrid; cj++)
-          {
-          basisy = static_cast<double>(this->BinomialCoefficientsY[cj])*
-            intpow(v,cj)*intpow((1-v),(yGrid-1-cj));
-
-          double *controlPoint = this->ControlPoints[ci]+cj*3;
-
-          point[0] += controlPoint[0] * basisx * basisy;
-          point[1] += controlPoint[1] * basisx * basisy;
-          point[2] += controlPoint[2] * basisx * basisy;
-
-          }
-        }
-      DataArray->SetTuple(i*yRes+j,point);
+    if (this->GenerateNormals)
+      {
+      ComputeNormalsRow(tangentsU + i*yRes*3, tangentsV + i*yRes*3, yRes,
+                        normals + i*yRes*3);
       }
     }
   //END: parallel for
 
+  this->SurfaceUpToDate = true;
+  this->NumberOfIncrementalUpdates = 0;
+  this->DataArray->Modified();
+  this->NormalArray->Modified();
+  this->TangentUArray->Modified();
+  this->TangentVArray->Modified();
   points->SetData(this->DataArray.GetPointer());
-
 }
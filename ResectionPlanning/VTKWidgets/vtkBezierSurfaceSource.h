@@ -39,10 +39,15 @@
 #include <vtkPolyDataAlgorithm.h>
 #include <vtkSmartPointer.h>
 
+// STD includes
+#include <vector>
+
 //-------------------------------------------------------------------------------
 class vtkPoints;
 class vtkPolyData;
 class vtkFloatArray;
+class vtkDoubleArray;
+class vtkCellArray;
 
 //------------------------------------------------------------------------------
 /**
@@ -51,6 +56,12 @@ class vtkFloatArray;
  * \brief This class generates the geometry of a Bézier surface
  * of degree \f$m+1\times n+1\f$ where \f$m\f$ and \f$n\f$ are number of control
  * points in the respective parametric directions $u$ and \f$v\f$.
+ *
+ * The Bernstein basis of both parametric directions is tabulated once per
+ * resolution and number of control points, so evaluating the surface reduces
+ * to two small dense matrix products per coordinate. The same tables
+ * differentiated provide the exact normals (and optionally the tangents) of the
+ * surface.
  */
 class vtkBezierSurfaceSource : public vtkPolyDataAlgorithm
 {
@@ -135,6 +146,83 @@ class vtkBezierSurfaceSource : public vtkPolyDataAlgorithm
    */
   void ResetControlPoints();
 
+  /**
+   * Set whether point normals are generated with the surface. The normals are
+   * the normalized cross product of the exact partial derivatives of the
+   * surface, computed in the same pass as the points. Normals are generated
+   * by default.
+   *
+   * @param generateNormals true to generate the normals, false otherwise.
+   */
+  void SetGenerateNormals(bool generateNormals);
+
+  /**
+   * Get whether point normals are generated with the surface.
+   *
+   * @return true if the normals are generated, false otherwise.
+   */
+  vtkGetMacro(GenerateNormals, bool);
+  vtkBooleanMacro(GenerateNormals, bool);
+
+  /**
+   * Set whether the partial derivatives of the surface in u and v are
+   * generated as the point data arrays "TangentU" and "TangentV". Tangents
+   * are not generated by default.
+   *
+   * @param generateTangents true to generate the tangents, false otherwise.
+   */
+  void SetGenerateTangents(bool generateTangents);
+
+  /**
+   * Get whether the partial derivatives of the surface are generated.
+   *
+   * @return true if the tangents are generated, false otherwise.
+   */
+  vtkGetMacro(GenerateTangents, bool);
+  vtkBooleanMacro(GenerateTangents, bool);
+
+  /**
+   * Move a control point and update the surface incrementally. Since the
+   * surface is linear in the control points, displacing the control point
+   * (i, j) by d displaces every sample of the surface by
+   * \f$d B_i(u) B_j(v)\f$, which is added to the surface points evaluated
+   * previously instead of evaluating the whole surface again.
+   *
+   * @param index index of the control point (i * number of control points in
+   * v + j), as in SetControlPoints().
+   * @param displacement displacement of the control point.
+   */
+  void MoveControlPoint(unsigned int index, const double displacement[3]);
+
+  /**
+   * Move a group of control points by the same displacement and update the
+   * surface incrementally (see MoveControlPoint()).
+   *
+   * @param numberOfPoints number of control points to move.
+   * @param indices indices of the control points to move.
+   * @param displacement displacement of the control points.
+   */
+  void MoveControlPoints(unsigned int numberOfPoints,
+                         const unsigned int *indices,
+                         const double displacement[3]);
+
+  /**
+   * Set the maximum number of incremental updates (see MoveControlPoint())
+   * applied before the surface is evaluated from scratch again, which bounds
+   * the accumulation of rounding errors.
+   *
+   * @param maximum maximum number of consecutive incremental updates.
+   */
+  vtkSetMacro(MaximumNumberOfIncrementalUpdates, unsigned int);
+
+  /**
+   * Get the maximum number of incremental updates applied before the surface
+   * is evaluated from scratch again.
+   *
+   * @return maximum number of consecutive incremental updates.
+   */
+  vtkGetMacro(MaximumNumberOfIncrementalUpdates, unsigned int);
+
   /**
    * Get the number of control poits in the parametric direction u.
    *
@@ -175,10 +263,12 @@ class vtkBezierSurfaceSource : public vtkPolyDataAlgorithm
   void UpdateTopology();
 
   /**
-   * Computation of the binomial coefficients required for the
-   * computation of the Bézier surface. This function is used internally.
+   * Computation of the tables of the Bernstein basis evaluated at the samples
+   * of the surface in both parametric directions. The tables only depend on
+   * the resolution and the number of control points, so this function is
+   * called whenever any of these changes.
    */
-  void ComputeBinomialCoefficients();
+  void ComputeBasis();
 
   /**
    * Computation of the tensor product surface of Bernstein basis (Bézier).
@@ -197,8 +287,33 @@ class vtkBezierSurfaceSource : public vtkPolyDataAlgorithm
   unsigned int NumberOfControlPoints[2];
   unsigned int Resolution[2];
   double **ControlPoints;
-  double *BinomialCoefficientsX;
-  double *BinomialCoefficientsY;
+
+  // Bernstein basis in u (Resolution[0] x NumberOfControlPoints[0]) and v
+  // (Resolution[1] x NumberOfControlPoints[1]), row-major per sample.
+  std::vector<double> BasisX;
+  std::vector<double> BasisY;
+
+  // Derivatives of the Bernstein basis, with the same layout.
+  std::vector<double> DerivativeBasisX;
+  std::vector<double> DerivativeBasisY;
+
+  // Whether DataArray holds the surface of the current control points, and
+  // the number of incremental updates applied to it since it was evaluated.
+  bool SurfaceUpToDate;
+  unsigned int NumberOfIncrementalUpdates;
+  unsigned int MaximumNumberOfIncrementalUpdates;
+
+  // Control points multiplied by the v basis and its derivative
+  // (NumberOfControlPoints[0] x Resolution[1] x 3), kept to avoid an
+  // allocation per evaluation.
+  std::vector<double> RowProducts;
+  std::vector<double> RowDerivativeProducts;
+
+  bool GenerateNormals;
+  bool GenerateTangents;
+  vtkSmartPointer<vtkDoubleArray> NormalArray;
+  vtkSmartPointer<vtkDoubleArray> TangentUArray;
+  vtkSmartPointer<vtkDoubleArray> TangentVArray;
   vtkSmartPointer<vtkDoubleArray> DataArray;
   vtkSmartPointer<vtkCellArray> Topology;
 };
@@ -56,7 +56,12 @@
 #include <vtkRenderer.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkCommand.h>
-#include <vtkPolyDataNormals.h>
+#include <vtkCamera.h>
+#include <vtkMath.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
 
 //------------------------------------------------------------------------------
 vtkStandardNewMacro(vtkBezierSurfaceWidget);
@@ -68,6 +73,9 @@ vtkBezierSurfaceWidget::vtkBezierSurfaceWidget()
    MultiPointInteraction(1),
    TranslationInteraction(1),
    ContinuousBezierUpdate(1),
+   AdaptiveResolution(1),
+   ScreenSpaceTolerance(0.5),
+   MinimumInteractionResolution(5),
    SurfaceResolutionX(40),
    SurfaceResolutionY(40),
    NumberOfControlPointsX(4),
@@ -183,6 +191,7 @@ vtkBezierSurfaceWidget::vtkBezierSurfaceWidget()
                                                       this->NumberOfControlPointsY);
   this->BezierSurfaceSource->SetResolution(this->SurfaceResolutionX,
                                            this->SurfaceResolutionY);
+  this->BezierSurfaceSource->SetGenerateNormals(this->ComputeNormalsFlag);
 
   this->BezierSurfaceSource->SetControlPoints(this->ControlPolygonPolyData->GetPoints());
 
@@ -414,6 +423,11 @@ void vtkBezierSurfaceWidget::PrintSelf(ostream &os, vtkIndent indent)
      << (this->TranslationInteraction ? "On\n" : "Off\n");
   os << indent << "Continuous Bézier update: "
      << (this->ContinuousBezierUpdate ? "On\n" : "Off\n");
+  os << indent << "Adaptive resolution: "
+     << (this->AdaptiveResolution ? "On\n" : "Off\n");
+  os << indent << "Screen space tolerance: " << this->ScreenSpaceTolerance << "\n";
+  os << indent << "Minimum interaction resolution: "
+     << this->MinimumInteractionResolution << "\n";
 
   // Bézie surface
   os << indent << "Bézier surface: "
@@ -673,6 +687,8 @@ void vtkBezierSurfaceWidget::OnLeftButtonDown()
       }
     }
 
+  this->UpdateSurfaceResolution(true);
+
   this->EventCallbackCommand->SetAbortFlag(1);
   this->StartInteraction();
   this->InvokeEvent(vtkCommand::StartInteractionEvent, NULL);
@@ -696,6 +712,7 @@ void vtkBezierSurfaceWidget::OnLeftButtonUp()
   this->HighlightControlPolygon(0);
   this->CurrentHandle = NULL;
 
+  this->UpdateSurfaceResolution(false);
   this->BezierSurfaceSource->SetControlPoints(this->ControlPolygonPolyData->GetPoints());
 
   this->ControlPoints->DeepCopy(this->ControlPolygonPolyData->GetPoints());
@@ -753,6 +770,8 @@ void vtkBezierSurfaceWidget::OnRightButtonDown()
       }
     }
 
+  this->UpdateSurfaceResolution(true);
+
   this->EventCallbackCommand->SetAbortFlag(1);
   this->StartInteraction();
   this->InvokeEvent(vtkCommand::StartInteractionEvent, NULL);
@@ -775,6 +794,7 @@ void vtkBezierSurfaceWidget::OnRightButtonUp()
   this->HighlightControlPolygon(0);
   this->CurrentHandle = NULL;
 
+  this->UpdateSurfaceResolution(false);
   this->BezierSurfaceSource
     ->SetControlPoints(this->ControlPolygonPolyData->GetPoints());
 
@@ -837,6 +857,12 @@ void vtkBezierSurfaceWidget::OnMouseMove()
     this->MoveControlPolygon(prevPickPoint, pickPoint);
     }
 
+  // The deformation may need a finer tessellation
+  if (this->State == vtkBezierSurfaceWidget::Deforming ||
+      this->State == vtkBezierSurfaceWidget::MultiDeforming)
+    {
+    this->UpdateSurfaceResolution(false);
+    }
 
   this->EventCallbackCommand->SetAbortFlag(1);
   this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
@@ -926,10 +952,11 @@ void vtkBezierSurfaceWidget::MoveControlPoint(int cp, double *p1, double *p2)
   this->ControlPolygonPolyData->GetPoints()->SetPoint(cp, destinationPoint);
   this->ControlPolygonPolyData->Modified();
 
+  // The surface is updated incrementally while dragging, and evaluated from
+  // scratch at the end of the interaction.
   if (this->ContinuousBezierUpdate)
     {
-    this->BezierSurfaceSource->
-      SetControlPoints(this->ControlPolygonPolyData->GetPoints());
+    this->BezierSurfaceSource->MoveControlPoint(cp, motionVector);
     }
 }
 
@@ -951,6 +978,8 @@ void vtkBezierSurfaceWidget::MultiMoveControlPoint(int cp, double *p1, double *p
 
   bool externalMarking = row == 0 || row == 3 || column == 0 || column == 3;
 
+  unsigned int movedPoints[16];
+  unsigned int numberOfMovedPoints = 0;
 
   for(int i=0; i<4; ++i)
     {
@@ -980,6 +1009,7 @@ void vtkBezierSurfaceWidget::MultiMoveControlPoint(int cp, double *p1, double *p
 
           this->ControlPolygonPolyData->GetPoints()->SetPoint(i*4+j,
                                                               destinationPoint);
+          movedPoints[numberOfMovedPoints++] = i*4+j;
           }
 
         }
@@ -991,11 +1021,143 @@ void vtkBezierSurfaceWidget::MultiMoveControlPoint(int cp, double *p1, double *p
 
   if (this->ContinuousBezierUpdate)
     {
-    this->BezierSurfaceSource->
-      SetControlPoints(this->ControlPolygonPolyData->GetPoints());
+    this->BezierSurfaceSource->MoveControlPoints(numberOfMovedPoints,
+                                                 movedPoints,
+                                                 motionVector);
     }
 }
 
+//------------------------------------------------------------------------------
+void vtkBezierSurfaceWidget::ComputeInteractionResolution(unsigned int resolution[2])
+{
+  resolution[0] = this->SurfaceResolutionX;
+  resolution[1] = this->SurfaceResolutionY;
+
+  vtkPoints *points = this->ControlPolygonPolyData->GetPoints();
+  if (!this->CurrentRenderer || !points ||
+      points->GetNumberOfPoints() !=
+      static_cast<vtkIdType>(this->NumberOfControlPointsX*this->NumberOfControlPointsY))
+    {
+    return;
+    }
+
+  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+  int *size = this->CurrentRenderer->GetSize();
+  if (!camera || size[1] <= 0 || this->ScreenSpaceTolerance <= 0.0)
+    {
+    return;
+    }
+
+  unsigned int m = this->NumberOfControlPointsX;
+  unsigned int n = this->NumberOfControlPointsY;
+
+  // Largest second differences of the control points in u and v, which times
+  // degree*(degree-1) bound the second derivatives of the surface.
+  double secondDifference[2] = {0.0, 0.0};
+  for(unsigned int i=0; i<m; ++i)
+    {
+    for(unsigned int j=0; j<n; ++j)
+      {
+      double p0[3], p1[3], p2[3], difference[3];
+      if (i+2 < m)
+        {
+        points->GetPoint(i*n+j, p0);
+        points->GetPoint((i+1)*n+j, p1);
+        points->GetPoint((i+2)*n+j, p2);
+        for(int k=0; k<3; ++k)
+          {
+          difference[k] = p2[k] - 2.0*p1[k] + p0[k];
+          }
+        secondDifference[0] = std::max(secondDifference[0],
+                                       vtkMath::Norm(difference));
+        }
+      if (j+2 < n)
+        {
+        points->GetPoint(i*n+j, p0);
+        points->GetPoint(i*n+j+1, p1);
+        points->GetPoint(i*n+j+2, p2);
+        for(int k=0; k<3; ++k)
+          {
+          difference[k] = p2[k] - 2.0*p1[k] + p0[k];
+          }
+        secondDifference[1] = std::max(secondDifference[1],
+                                       vtkMath::Norm(difference));
+        }
+      }
+    }
+
+  // Pixels per world unit at the nearest point of the bounding box of the
+  // control points (which contains the surface).
+  double pixelsPerUnit;
+  if (camera->GetParallelProjection())
+    {
+    pixelsPerUnit = size[1] / (2.0 * camera->GetParallelScale());
+    }
+  else
+    {
+    double bounds[6];
+    points->GetBounds(bounds);
+    double *position = camera->GetPosition();
+    double distance2 = 0.0;
+    for(int k=0; k<3; ++k)
+      {
+      double nearest = std::min(std::max(position[k], bounds[2*k]),
+                                bounds[2*k+1]);
+      distance2 += (position[k] - nearest) * (position[k] - nearest);
+      }
+
+    double halfHeight = std::sqrt(distance2) *
+      std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0);
+    if (halfHeight <= 0.0)
+      {
+      return;
+      }
+    pixelsPerUnit = size[1] / (2.0 * halfHeight);
+    }
+
+  // A grid of N segments deviates from the surface by at most M/(8 N^2),
+  // where M bounds the second derivative.
+  unsigned int degree[2] = {m-1, n-1};
+  unsigned int fullResolution[2] = {this->SurfaceResolutionX,
+                                    this->SurfaceResolutionY};
+  for(int d=0; d<2; ++d)
+    {
+    double bound = degree[d] * (degree[d] - 1.0) * secondDifference[d];
+    double segments = std::ceil(std::sqrt(bound * pixelsPerUnit /
+                                          (8.0 * this->ScreenSpaceTolerance)));
+    double required = std::max(segments + 1.0,
+                               static_cast<double>(this->MinimumInteractionResolution));
+    resolution[d] = required < fullResolution[d] ?
+      static_cast<unsigned int>(required) : fullResolution[d];
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkBezierSurfaceWidget::UpdateSurfaceResolution(bool startInteraction)
+{
+  bool interacting = this->State == vtkBezierSurfaceWidget::Deforming ||
+    this->State == vtkBezierSurfaceWidget::MultiDeforming ||
+    this->State == vtkBezierSurfaceWidget::Moving;
+
+  unsigned int resolution[2] = {this->SurfaceResolutionX,
+                                this->SurfaceResolutionY};
+
+  if (interacting && this->AdaptiveResolution && this->ContinuousBezierUpdate)
+    {
+    this->ComputeInteractionResolution(resolution);
+
+    if (!startInteraction)
+      {
+      resolution[0] = std::max(resolution[0],
+                               this->BezierSurfaceSource->GetResolutionX());
+      resolution[1] = std::max(resolution[1],
+                               this->BezierSurfaceSource->GetResolutionY());
+      }
+    }
+
+  this->BezierSurfaceSource->SetResolution(resolution[0], resolution[1]);
+}
+
 //------------------------------------------------------------------------------
 void vtkBezierSurfaceWidget::CreateDefaultProperties()
 {
@@ -1142,16 +1304,14 @@ vtkBezierSurfaceWidget::GetBezierSurfacePolyData() const
 void vtkBezierSurfaceWidget::ComputeNormalsOn()
 {
   this->ComputeNormalsFlag = true;
-  this->Normals->SetInputConnection(this->BezierSurfaceSource->GetOutputPort());
-  this->BezierSurfaceMapper->SetInputConnection(this->Normals->GetOutputPort());
+  this->BezierSurfaceSource->GenerateNormalsOn();
 }
 
 //------------------------------------------------------------------------------
 void vtkBezierSurfaceWidget::ComputeNormalsOff()
 {
   this->ComputeNormalsFlag = false;
-  this->BezierSurfaceMapper->
-    SetInputConnection(this->BezierSurfaceSource->GetOutputPort());
+  this->BezierSurfaceSource->GenerateNormalsOff();
 }
 
 //------------------------------------------------------------------------------
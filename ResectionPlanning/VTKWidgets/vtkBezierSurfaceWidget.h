@@ -52,7 +52,6 @@ class vtkPolyDataMapper;
 class vtkCellPicker;
 class vtkTubeFilter;
 class vtkPoints;
-class vtkPolyDataNormals;
 
 //------------------------------------------------------------------------------
 /**
@@ -197,6 +196,53 @@ class vtkBezierSurfaceWidget: public vtk3DWidget
   vtkSetMacro(ContinuousBezierUpdate, int);
   vtkBooleanMacro(ContinuousBezierUpdate, int);
 
+  /**
+  * Get the AdaptiveResolution flag. If the flag is != 0 (enabled) then the
+  * Bézier surface is evaluated on a coarser grid while the user interacts with
+  * the widget, just dense enough to keep the error on screen under
+  * ScreenSpaceTolerance, and at full resolution when the interaction
+  * ends. Adaptive resolution is enabled by default.
+  *
+  * @return 0 if disabled, 1 otherwise.
+  */
+  vtkGetMacro(AdaptiveResolution, int);
+
+  /**
+  * Set the AdaptiveResolution flag (see GetAdaptiveResolution()).
+  */
+  vtkSetMacro(AdaptiveResolution, int);
+  vtkBooleanMacro(AdaptiveResolution, int);
+
+  /**
+   * Get the maximum distance on screen (in pixels) between the Bézier surface
+   * and its coarse tessellation during the interaction.
+   *
+   * @return tolerance in pixels.
+   */
+  vtkGetMacro(ScreenSpaceTolerance, double);
+
+  /**
+   * Set the maximum distance on screen (in pixels) between the Bézier surface
+   * and its coarse tessellation during the interaction.
+   *
+   * @param tolerance tolerance in pixels.
+   */
+  vtkSetMacro(ScreenSpaceTolerance, double);
+
+  /**
+   * Get the minimum resolution of the Bézier surface during the interaction.
+   *
+   * @return minimum resolution (in both parametric directions).
+   */
+  vtkGetMacro(MinimumInteractionResolution, unsigned int);
+
+  /**
+   * Set the minimum resolution of the Bézier surface during the interaction.
+   *
+   * @param resolution minimum resolution (in both parametric directions).
+   */
+  vtkSetMacro(MinimumInteractionResolution, unsigned int);
+
   /**
    * Get the visual properties of the handle.
    *
@@ -408,7 +454,8 @@ class vtkBezierSurfaceWidget: public vtk3DWidget
   void SetControlPoints(vtkPoints *points);
 
     /**
-   * Enable surface normals computation
+   * Enable surface normals computation. The normals are computed analytically
+   * by the Bézier surface source.
    *
    */
   void ComputeNormalsOn();
@@ -587,6 +634,30 @@ class vtkBezierSurfaceWidget: public vtk3DWidget
    */
   void MultiMoveControlPoint(int cp, double *p1, double *p2);
 
+  /**
+   * Computes the coarsest resolution of the Bézier surface keeping the
+   * distance between the surface and its tessellation under
+   * ScreenSpaceTolerance pixels. The distance is bounded by the second
+   * differences of the control points (which bound the second derivatives of
+   * the surface), scaled by the number of pixels per world unit at the
+   * distance of the control points from the camera.
+   *
+   * @param resolution computed resolution in the parametric directions u and v,
+   * between MinimumInteractionResolution and the surface resolution.
+   */
+  void ComputeInteractionResolution(unsigned int resolution[2]);
+
+  /**
+   * Sets the resolution of the Bézier surface according to the state of the
+   * widget: the interaction resolution (see ComputeInteractionResolution())
+   * while interacting, if AdaptiveResolution is enabled, and the surface
+   * resolution otherwise. While interacting, the resolution only increases so
+   * the tessellation does not flicker.
+   *
+   * @param startInteraction true if the interaction is starting.
+   */
+  void UpdateSurfaceResolution(bool startInteraction);
+
   // Handles visual properties.
   vtkNew<vtkProperty> HandleProperty;
   vtkNew<vtkProperty> SelectedHandleProperty;
@@ -605,6 +676,11 @@ class vtkBezierSurfaceWidget: public vtk3DWidget
   int MultiPointInteraction;
   int TranslationInteraction;
   int ContinuousBezierUpdate;
+  int AdaptiveResolution;
+
+  // Level of detail during the interaction.
+  double ScreenSpaceTolerance;
+  unsigned int MinimumInteractionResolution;
 
   // Parameters of Bézier surfaces. The reader should note that the number of
   // control points is fixed to 4 to facilitate the interaction (internal,
@@ -624,7 +700,6 @@ class vtkBezierSurfaceWidget: public vtk3DWidget
   vtkNew<vtkActor> BezierSurfaceActor;
 
   // Polydata normals
-  vtkNew<vtkPolyDataNormals> Normals;
   bool ComputeNormalsFlag;
 
   // Control points
@@ -25,6 +25,8 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "vtkHausdorffDistancePointSetFilter.h"
+#include "vtkPointSetLocatorCache.h"
+#include "vtkTriangleBVH.h"
 
 
 #include <vtkInformation.h>
@@ -35,12 +37,129 @@
 
 #include <vtkSmartPointer.h>
 #include <vtkPointSet.h>
-#include <vtkKdTreePointLocator.h>
-#include <vtkCellLocator.h>
-#include <vtkGenericCell.h>
+#include <vtkStaticPointLocator.h>
+#include <vtkMath.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
 
 #include <cmath>
 
+namespace
+{
+
+//! Functor computing, for every point of a source point set, the distance
+//! to the closest point of a target point set, and the maximum of these
+//! distances. Each thread keeps its own maximum, reduced once all the points
+//! have been processed.
+class DistanceToPointSetFunctor
+{
+public:
+  DistanceToPointSetFunctor(vtkPointSet *source,
+                            vtkPointSet *target,
+                            vtkStaticPointLocator *pointLocator,
+                            vtkDoubleArray *distances)
+    : Source(source), Target(target), PointLocator(pointLocator),
+      Distances(distances), Maximum(0.0)
+  {
+  }
+
+  void Initialize()
+  {
+    this->LocalMaximum.Local() = 0.0;
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    double &localMaximum = this->LocalMaximum.Local();
+    double *distances = this->Distances->GetPointer(0);
+
+    for (vtkIdType i=begin; i<end; i++)
+      {
+      double currentPoint[3];
+      double closestPoint[3];
+
+      // Queries of the static point locator are thread safe
+      this->Source->GetPoint(i, currentPoint);
+      vtkIdType closestPointId = this->PointLocator->FindClosestPoint(currentPoint);
+      this->Target->GetPoint(closestPointId, closestPoint);
+
+      double dist =
+        std::sqrt(vtkMath::Distance2BetweenPoints(currentPoint, closestPoint));
+      distances[i] = dist;
+
+      if (dist > localMaximum)
+        {
+        localMaximum = dist;
+        }
+      }
+  }
+
+  void Reduce()
+  {
+    this->Maximum = 0.0;
+    vtkSMPThreadLocal<double>::iterator it;
+    for (it = this->LocalMaximum.begin(); it != this->LocalMaximum.end(); ++it)
+      {
+      if (*it > this->Maximum)
+        {
+        this->Maximum = *it;
+        }
+      }
+  }
+
+  double GetMaximum() const
+  {
+    return this->Maximum;
+  }
+
+private:
+  vtkPointSet *Source;
+  vtkPointSet *Target;
+  vtkStaticPointLocator *PointLocator;
+  vtkDoubleArray *Distances;
+
+  double Maximum;
+  vtkSMPThreadLocal<double> LocalMaximum;
+};
+
+//! Compute the distance from every point of a source point set to a target
+//! point set, and return the maximum. Point-to-cell distances are exact
+//! distances to the triangles of the target; targets without triangles fall
+//! back to point-to-point distances.
+double ComputeDistances(vtkPointSet *source,
+                        vtkPointSet *target,
+                        int method,
+                        vtkPointSetLocatorCache *cache,
+                        vtkDoubleArray *distances)
+{
+  if (method == vtkHausdorffDistancePointSetFilter::POINT_TO_CELL)
+    {
+    vtkTriangleBVH *triangleLocator = cache->GetTriangleLocator(target);
+    if (triangleLocator->GetNumberOfTriangles() > 0)
+      {
+      triangleLocator->FindClosestDistances(source->GetPoints(), distances);
+
+      double maximum = 0.0;
+      for (vtkIdType i=0; i<source->GetNumberOfPoints(); i++)
+        {
+        if (distances->GetValue(i) > maximum)
+          {
+          maximum = distances->GetValue(i);
+          }
+        }
+      return maximum;
+      }
+    }
+
+  DistanceToPointSetFunctor functor(source, target,
+                                    cache->GetPointLocator(target),
+                                    distances);
+  vtkSMPTools::For(0, source->GetNumberOfPoints(), functor);
+  return functor.GetMaximum();
+}
+
+}
+
 
 vtkStandardNewMacro(vtkHausdorffDistancePointSetFilter);
 
@@ -54,19 +173,29 @@ vtkHausdorffDistancePointSetFilter::vtkHausdorffDistancePointSetFilter()
   this->SetNumberOfInputPorts(2);
   this->SetNumberOfOutputPorts(2);
 
-  this->TargetDistanceMethod = POINT_TO_POINT;
+  this->TargetDistanceMethod = POINT_TO_CELL;
 
-  this->PointLocatorB = vtkSmartPointer<vtkKdTreePointLocator>::New();
-  this->CellLocatorB = vtkSmartPointer<vtkCellLocator>::New();
-
-  this->PointLocatorBBuilt = false;
-  this->CellLocatorBBuilt = false;
+  this->LocatorCache = vtkSmartPointer<vtkPointSetLocatorCache>::New();
 }
 
 vtkHausdorffDistancePointSetFilter::~vtkHausdorffDistancePointSetFilter()
 {
 }
 
+void vtkHausdorffDistancePointSetFilter::SetLocatorCache(vtkPointSetLocatorCache *cache)
+{
+  if( !cache || cache == this->LocatorCache.GetPointer() )
+    return;
+
+  this->LocatorCache = cache;
+  this->Modified();
+}
+
+vtkPointSetLocatorCache *vtkHausdorffDistancePointSetFilter::GetLocatorCache()
+{
+  return this->LocatorCache;
+}
+
 int vtkHausdorffDistancePointSetFilter::RequestData(vtkInformation *vtkNotUsed(request),
 		vtkInformationVector **inputVector,
 		vtkInformationVector *outputVector)
@@ -101,33 +230,6 @@ int vtkHausdorffDistancePointSetFilter::RequestData(vtkInformation *vtkNotUsed(r
   this->RelativeDistance[1]=0.0;
   this->HausdorffDistance = 0.0;
 
-  vtkSmartPointer<vtkKdTreePointLocator> pointLocatorA = vtkSmartPointer<vtkKdTreePointLocator>::New();
-  vtkSmartPointer<vtkCellLocator> cellLocatorA = vtkSmartPointer<vtkCellLocator>::New();
-
-
-  if(this->TargetDistanceMethod == POINT_TO_POINT)
-  {
-    pointLocatorA->SetDataSet(inputA);
-    pointLocatorA->BuildLocator();
-    if(!this->PointLocatorBBuilt)
-      {
-        PointLocatorB->SetDataSet(inputB);
-        PointLocatorB->BuildLocator();
-        this->PointLocatorBBuilt = true;
-      }
-  }
-  else
-    {
-    cellLocatorA->SetDataSet(inputA);
-    cellLocatorA->BuildLocator();
-    if(!this->CellLocatorBBuilt)
-      {
-        this->CellLocatorB->SetDataSet(inputB);
-        this->CellLocatorB->BuildLocator();
-        this->CellLocatorBBuilt = true;
-      }
-  }
-
   vtkSmartPointer<vtkDoubleArray> distanceAToB = vtkSmartPointer<vtkDoubleArray>::New();
   distanceAToB->SetNumberOfComponents(1);
   distanceAToB->SetNumberOfTuples(inputA->GetNumberOfPoints());
@@ -138,60 +240,16 @@ int vtkHausdorffDistancePointSetFilter::RequestData(vtkInformation *vtkNotUsed(r
   distanceBToA->SetNumberOfTuples(inputB->GetNumberOfPoints());
   distanceBToA->SetName( "Distance" );
 
-  //find the nearest neighbors to each point and add adges between them, if they do not already exist and they are not self loops
-  //#pragma omp parallel for
-  for(int i = 0; i < inputA->GetNumberOfPoints(); i++)
-  {
-    double dist;
-    double currentPoint[3];
-    double closestPoint[3];
-    vtkIdType cellId;
-    vtkSmartPointer<vtkGenericCell> cell = vtkSmartPointer<vtkGenericCell>::New( );
-    int subId;
-
-    inputA->GetPoint(i, currentPoint);
-    if( this->TargetDistanceMethod == POINT_TO_POINT )
-    {
-      vtkIdType closestPointId = this->PointLocatorB->FindClosestPoint(currentPoint);
-      inputB->GetPoint(closestPointId,closestPoint);
-    }
-    else
-    {
-      this->CellLocatorB->FindClosestPoint(currentPoint,closestPoint,cell,cellId,subId,dist);
-    }
-
-    dist = sqrt(pow(currentPoint[0]-closestPoint[0],2)+pow(currentPoint[1]-closestPoint[1],2)+pow(currentPoint[2]-closestPoint[2],2));
-
-    distanceAToB->SetValue(i,dist);
-
-    if( dist > this->RelativeDistance[0])
-    {
-	this->RelativeDistance[0] = dist;
-    }
-  }
-
-  // for(int i = 0; i < inputB->GetNumberOfPoints(); i++)
-  // {
-  //   inputB->GetPoint(i, currentPoint);
-  //   if( this->TargetDistanceMethod == POINT_TO_POINT )
-  //   {
-  //     vtkIdType closestPointId = pointLocatorA->FindClosestPoint(currentPoint);
-  //     inputA->GetPoint(closestPointId,closestPoint);
-  //   }
-  //   else
-  //   {
-  //     cellLocatorA->FindClosestPoint(currentPoint,closestPoint,cell,cellId,subId,dist);
-  //   }
-
-  //   dist = sqrt(pow(currentPoint[0]-closestPoint[0],2)+pow(currentPoint[1]-closestPoint[1],2)+pow(currentPoint[2]-closestPoint[2],2));
-
-  //   distanceBToA->SetValue(i,dist);
-
-  //   if( dist > this->RelativeDistance[1])
-  //   {
-  //       this->RelativeDistance[1] = dist;
-  //   }
-  // }
+  // Distances in both directions. The locators are built again only if the
+  // inputs have been modified
+  this->RelativeDistance[0] = ComputeDistances(inputA, inputB,
+                                               this->TargetDistanceMethod,
+                                               this->LocatorCache,
+                                               distanceAToB);
+  this->RelativeDistance[1] = ComputeDistances(inputB, inputA,
+                                               this->TargetDistanceMethod,
+                                               this->LocatorCache,
+                                               distanceBToA);
 
   if(this->RelativeDistance[0] >= RelativeDistance[1])
     this->HausdorffDistance = this->RelativeDistance[0];
@@ -32,7 +32,9 @@
 //! vtkPointSet or vtkPolyData without vtkPolys), the distances are
 //! computed between point location. If polys exist (ie triangulation),
 //! the TargetDistanceMethod allows for an interpolation of the cells to
-//! ensure a better minimal distance exploration.
+//! ensure a better minimal distance exploration. Point-to-cell distances
+//! (the default) are exact distances to the triangles of the target, found
+//! with a bounding volume hierarchy (vtkTriangleBVH).
 //!
 //! The ouputs (port 0 and 1) have the same geometry and topology as its
 //! respective input port. Two FieldData arrays are added : HausdorffDistance
@@ -53,8 +55,7 @@
 
 #include <vtkSmartPointer.h>
 
-class vtkKdTreePointLocator;
-class vtkCellLocator;
+class vtkPointSetLocatorCache;
 
 class VTK_EXPORT vtkHausdorffDistancePointSetFilter : public
 vtkPointSetAlgorithm
@@ -74,6 +75,13 @@ public:
     vtkSetMacro( TargetDistanceMethod, int );
     vtkGetMacro( TargetDistanceMethod, int );
 
+    //! Set the cache providing the locators of the inputs. Filters sharing a
+    //! cache share the locators of their common inputs, which are built again
+    //! only when the inputs are modified. By default, each filter has its own
+    //! cache.
+    void SetLocatorCache( vtkPointSetLocatorCache *cache );
+    vtkPointSetLocatorCache *GetLocatorCache( );
+
 
     enum DistanceMethod {POINT_TO_POINT, POINT_TO_CELL};
 
@@ -86,11 +94,8 @@ protected:
 private:
 
     int TargetDistanceMethod; //!< point-to-point if 0, point-to-cell if 1
-    bool PointLocatorBBuilt;
-    bool CellLocatorBBuilt;
 
-    vtkSmartPointer<vtkKdTreePointLocator> PointLocatorB;
-    vtkSmartPointer<vtkCellLocator> CellLocatorB;
+    vtkSmartPointer<vtkPointSetLocatorCache> LocatorCache; //!< locators of the inputs
 
     double RelativeDistance[2]; //!< relative distance between inputs
     double HausdorffDistance; //!< hausdorff distance (max(relative distance))
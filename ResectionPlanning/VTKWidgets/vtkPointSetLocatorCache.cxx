@@ -0,0 +1,131 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkPointSetLocatorCache.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#include "vtkPointSetLocatorCache.h"
+#include "vtkTriangleBVH.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkDataSet.h>
+#include <vtkStaticPointLocator.h>
+
+//-------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkPointSetLocatorCache);
+
+//-------------------------------------------------------------------------------
+vtkPointSetLocatorCache::vtkPointSetLocatorCache()
+{
+  this->NumberOfBuilds = 0;
+}
+
+//-------------------------------------------------------------------------------
+vtkPointSetLocatorCache::~vtkPointSetLocatorCache()
+{
+}
+
+//-------------------------------------------------------------------------------
+void vtkPointSetLocatorCache::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number of datasets: " << this->Entries.size() << "\n";
+  os << indent << "Number of builds: " << this->NumberOfBuilds << "\n";
+
+  for (EntryIt it=this->Entries.begin(); it!=this->Entries.end(); ++it)
+    {
+    os << indent << "Dataset " << it->first
+       << (it->second.PointLocator ? " (point locator)" : "")
+       << (it->second.TriangleLocator ? " (triangle locator)" : "") << "\n";
+    }
+}
+
+//-------------------------------------------------------------------------------
+vtkStaticPointLocator *vtkPointSetLocatorCache::GetPointLocator(vtkDataSet *dataSet)
+{
+  if (!dataSet)
+    {
+    vtkErrorMacro("GetPointLocator: no dataset passed.");
+    return NULL;
+    }
+
+  LocatorEntry &entry = this->Entries[dataSet];
+  if (!entry.PointLocator || entry.PointLocatorTime != dataSet->GetMTime())
+    {
+    entry.PointLocator = vtkSmartPointer<vtkStaticPointLocator>::New();
+    entry.PointLocator->SetDataSet(dataSet);
+    entry.PointLocator->BuildLocator();
+    entry.PointLocatorTime = dataSet->GetMTime();
+    this->NumberOfBuilds++;
+    }
+
+  return entry.PointLocator;
+}
+
+//-------------------------------------------------------------------------------
+vtkTriangleBVH *vtkPointSetLocatorCache::GetTriangleLocator(vtkDataSet *dataSet)
+{
+  if (!dataSet)
+    {
+    vtkErrorMacro("GetTriangleLocator: no dataset passed.");
+    return NULL;
+    }
+
+  LocatorEntry &entry = this->Entries[dataSet];
+  if (!entry.TriangleLocator || entry.TriangleLocatorTime != dataSet->GetMTime())
+    {
+    entry.TriangleLocator = vtkSmartPointer<vtkTriangleBVH>::New();
+    entry.TriangleLocator->SetDataSet(dataSet);
+    entry.TriangleLocator->BuildLocator();
+    entry.TriangleLocatorTime = dataSet->GetMTime();
+    this->NumberOfBuilds++;
+    }
+
+  return entry.TriangleLocator;
+}
+
+//-------------------------------------------------------------------------------
+void vtkPointSetLocatorCache::RemoveDataSet(vtkDataSet *dataSet)
+{
+  EntryIt it = this->Entries.find(dataSet);
+  if (it != this->Entries.end())
+    {
+    this->Entries.erase(it);
+    }
+}
+
+//-------------------------------------------------------------------------------
+void vtkPointSetLocatorCache::RemoveAllDataSets()
+{
+  this->Entries.clear();
+}
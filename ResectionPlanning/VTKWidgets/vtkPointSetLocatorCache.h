@@ -0,0 +1,157 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkPointSetLocatorCache.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#ifndef __vtkPointSetLocatorCache_h
+#define __vtkPointSetLocatorCache_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+
+//-------------------------------------------------------------------------------
+class vtkDataSet;
+class vtkStaticPointLocator;
+class vtkTriangleBVH;
+
+//------------------------------------------------------------------------------
+/**
+ * \ingroup ResectionPlanning
+ *
+ * \brief This class keeps the point and triangle locators of a set of datasets, so
+ * that several distance filters querying the same dataset (e.g., the tumors)
+ * share a single locator.
+ *
+ * A locator is built the first time it is requested and built again only when
+ * the modification time of its dataset changes. The locators hold a reference
+ * to their dataset: datasets no longer queried should be removed with
+ * RemoveDataSet().
+ */
+class vtkPointSetLocatorCache : public vtkObject
+{
+ public:
+
+  /**
+   * Instantiation of object.
+   *
+   * @return pointer to vtkPointSetLocatorCache newly created.
+   */
+  static vtkPointSetLocatorCache *New();
+
+  vtkTypeMacro(vtkPointSetLocatorCache, vtkObject);
+
+  /**
+   * Print the properties of the object.
+   *
+   * @param os ouptut stream to print the properties to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent);
+
+  /**
+   * Get the point locator of a dataset, built if the dataset is new to the
+   * cache or has been modified since the locator was built.
+   *
+   * @param dataSet dataset to locate points in.
+   *
+   * @return pointer to the point locator, NULL if no dataset is passed.
+   */
+  vtkStaticPointLocator *GetPointLocator(vtkDataSet *dataSet);
+
+  /**
+   * Get the triangle locator of a dataset, built if the dataset is new to
+   * the cache or has been modified since the locator was built.
+   *
+   * @param dataSet dataset to locate triangles in.
+   *
+   * @return pointer to the triangle locator, NULL if no dataset is passed.
+   */
+  vtkTriangleBVH *GetTriangleLocator(vtkDataSet *dataSet);
+
+  /**
+   * Remove the locators of a dataset from the cache.
+   *
+   * @param dataSet dataset whose locators are removed.
+   */
+  void RemoveDataSet(vtkDataSet *dataSet);
+
+  /**
+   * Remove the locators of all the datasets from the cache.
+   */
+  void RemoveAllDataSets();
+
+  /**
+   * Get the number of datasets with locators in the cache.
+   *
+   * @return number of datasets in the cache.
+   */
+  unsigned int GetNumberOfDataSets() const
+  {return static_cast<unsigned int>(this->Entries.size());}
+
+  /**
+   * Get the number of locators built by the cache since its creation.
+   *
+   * @return number of locators built.
+   */
+  vtkGetMacro(NumberOfBuilds, unsigned long);
+
+ protected:
+  vtkPointSetLocatorCache();
+  ~vtkPointSetLocatorCache();
+
+ private:
+  vtkPointSetLocatorCache(const vtkPointSetLocatorCache&);  // Not implemented.
+  void operator=(const vtkPointSetLocatorCache&);  // Not implemented.
+
+  // Locators of a dataset and the modification time of the dataset when each
+  // of them was built.
+  struct LocatorEntry
+  {
+    LocatorEntry() : PointLocatorTime(0), TriangleLocatorTime(0) {}
+
+    vtkSmartPointer<vtkStaticPointLocator> PointLocator;
+    vtkMTimeType PointLocatorTime;
+    vtkSmartPointer<vtkTriangleBVH> TriangleLocator;
+    vtkMTimeType TriangleLocatorTime;
+  };
+
+  std::map<vtkDataSet*, LocatorEntry> Entries;
+  typedef std::map<vtkDataSet*, LocatorEntry>::iterator EntryIt;
+
+  unsigned long NumberOfBuilds;
+};
+
+#endif
@@ -0,0 +1,488 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkSparseSignedDistanceField.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#include "vtkSparseSignedDistanceField.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkDoubleArray.h>
+#include <vtkImplicitPolyDataDistance.h>
+#include <vtkSMPTools.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Number of cells along each edge of a brick of the narrow band.
+const int BrickSize = 8;
+
+// Number of samples along each edge of a brick of the narrow band.
+const int BrickSamples = BrickSize + 1;
+
+//-------------------------------------------------------------------------------
+// Trilinear interpolation of the samples of a grid (x fastest) at the grid
+// coordinates g, which must lie within the grid.
+double Interpolate(const float *samples, const int dimensions[3], const double g[3])
+{
+  int index[3];
+  double t[3];
+  for (int d=0; d<3; d++)
+    {
+    index[d] = std::min(static_cast<int>(g[d]), dimensions[d]-2);
+    index[d] = std::max(index[d], 0);
+    t[d] = g[d] - index[d];
+    }
+
+  const float *corner =
+    samples + index[0] + dimensions[0]*(index[1] + dimensions[1]*index[2]);
+  int dy = dimensions[0];
+  int dz = dimensions[0]*dimensions[1];
+
+  double c00 = corner[0]*(1.0-t[0]) + corner[1]*t[0];
+  double c10 = corner[dy]*(1.0-t[0]) + corner[dy+1]*t[0];
+  double c01 = corner[dz]*(1.0-t[0]) + corner[dz+1]*t[0];
+  double c11 = corner[dz+dy]*(1.0-t[0]) + corner[dz+dy+1]*t[0];
+
+  double c0 = c00*(1.0-t[1]) + c10*t[1];
+  double c1 = c01*(1.0-t[1]) + c11*t[1];
+
+  return c0*(1.0-t[2]) + c1*t[2];
+}
+
+//-------------------------------------------------------------------------------
+// Functor evaluating the distance field at a range of points.
+class EvaluateDistancesFunctor
+{
+public:
+  EvaluateDistancesFunctor(const vtkSparseSignedDistanceField *field,
+                           vtkPoints *points,
+                           double *distances)
+    : Field(field), Points(points), Distances(distances)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end) const
+  {
+    double x[3];
+    for (vtkIdType i=begin; i<end; i++)
+      {
+      this->Points->GetPoint(i, x);
+      this->Distances[i] = this->Field->EvaluateDistance(x);
+      }
+  }
+
+private:
+  const vtkSparseSignedDistanceField *Field;
+  vtkPoints *Points;
+  double *Distances;
+};
+
+}
+
+//-------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSparseSignedDistanceField);
+
+//-------------------------------------------------------------------------------
+vtkSparseSignedDistanceField::vtkSparseSignedDistanceField()
+{
+  this->NarrowBandWidth = 20.0;
+  this->NarrowBandSpacing = 1.0;
+  this->FarFieldSpacing = 5.0;
+  this->FarFieldPadding = 100.0;
+
+  for (int d=0; d<3; d++)
+    {
+    this->FarFieldOrigin[d] = 0.0;
+    this->FarFieldDimensions[d] = 0;
+    this->NarrowBandOrigin[d] = 0.0;
+    this->BrickGridDimensions[d] = 0;
+    }
+  this->NumberOfBricks = 0;
+
+  this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+  this->ThreadId = -1;
+  this->Ready = false;
+  this->StopRequested = false;
+}
+
+//-------------------------------------------------------------------------------
+vtkSparseSignedDistanceField::~vtkSparseSignedDistanceField()
+{
+  this->StopComputation();
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Narrow band width: " << this->NarrowBandWidth << "\n";
+  os << indent << "Narrow band spacing: " << this->NarrowBandSpacing << "\n";
+  os << indent << "Far field spacing: " << this->FarFieldSpacing << "\n";
+  os << indent << "Far field padding: " << this->FarFieldPadding << "\n";
+  os << indent << "Far field dimensions: " << this->FarFieldDimensions[0] << ", "
+     << this->FarFieldDimensions[1] << ", " << this->FarFieldDimensions[2] << "\n";
+  os << indent << "Number of narrow band bricks: " << this->NumberOfBricks << "\n";
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::SetSurface(vtkPolyData *surface)
+{
+  this->StopComputation();
+
+  this->StateLock.Lock();
+  this->Ready = false;
+  this->StateLock.Unlock();
+
+  this->Surface = NULL;
+  if (surface)
+    {
+    this->Surface = vtkSmartPointer<vtkPolyData>::New();
+    this->Surface->DeepCopy(surface);
+    }
+
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::Compute()
+{
+  this->StopComputation();
+
+  this->StateLock.Lock();
+  this->Ready = false;
+  this->StateLock.Unlock();
+
+  bool computed = this->ComputeField();
+
+  this->StateLock.Lock();
+  this->Ready = computed;
+  this->StateLock.Unlock();
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::ComputeInBackground()
+{
+  this->StopComputation();
+
+  this->StateLock.Lock();
+  this->Ready = false;
+  this->StateLock.Unlock();
+
+  this->ThreadId = this->Threader->SpawnThread(
+    vtkSparseSignedDistanceField::ComputeThread, this);
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::WaitForCompletion()
+{
+  if (this->ThreadId >= 0)
+    {
+    this->Threader->TerminateThread(this->ThreadId);
+    this->ThreadId = -1;
+    }
+}
+
+//-------------------------------------------------------------------------------
+bool vtkSparseSignedDistanceField::IsReady()
+{
+  this->StateLock.Lock();
+  bool ready = this->Ready;
+  this->StateLock.Unlock();
+
+  return ready;
+}
+
+//-------------------------------------------------------------------------------
+double vtkSparseSignedDistanceField::EvaluateDistance(const double x[3]) const
+{
+  // Narrow band, if the point lies in an allocated brick
+  if (this->NumberOfBricks > 0)
+    {
+    double g[3];
+    int brick[3];
+    bool inside = true;
+    for (int d=0; d<3 && inside; d++)
+      {
+      g[d] = (x[d] - this->NarrowBandOrigin[d]) / this->NarrowBandSpacing;
+      inside = g[d] >= 0.0 && g[d] <= this->BrickGridDimensions[d]*BrickSize;
+      brick[d] = std::min(static_cast<int>(g[d]) / BrickSize,
+                          this->BrickGridDimensions[d]-1);
+      }
+
+    if (inside)
+      {
+      int brickIndex = this->BrickIndices[brick[0] + this->BrickGridDimensions[0]*
+                                          (brick[1] + this->BrickGridDimensions[1]*
+                                           brick[2])];
+      if (brickIndex >= 0)
+        {
+        static const int brickDimensions[3] =
+          {BrickSamples, BrickSamples, BrickSamples};
+        double local[3];
+        for (int d=0; d<3; d++)
+          {
+          local[d] = g[d] - brick[d]*BrickSize;
+          }
+        return Interpolate(&this->Bricks[brickIndex*BrickSamples*BrickSamples*BrickSamples],
+                           brickDimensions, local);
+        }
+      }
+    }
+
+  return this->EvaluateFarField(x);
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::EvaluateDistances(vtkPoints *points,
+                                                     vtkDoubleArray *distances) const
+{
+  if (!points || !distances)
+    {
+    vtkErrorMacro("EvaluateDistances: no points or distances passed.");
+    return;
+    }
+
+  distances->SetNumberOfComponents(1);
+  distances->SetNumberOfTuples(points->GetNumberOfPoints());
+
+  EvaluateDistancesFunctor functor(this, points, distances->GetPointer(0));
+  vtkSMPTools::For(0, points->GetNumberOfPoints(), functor);
+}
+
+//-------------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSparseSignedDistanceField::ComputeThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkSparseSignedDistanceField *self =
+    static_cast<vtkSparseSignedDistanceField*>(info->UserData);
+
+  bool computed = self->ComputeField();
+
+  self->StateLock.Lock();
+  self->Ready = computed;
+  self->StateLock.Unlock();
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-------------------------------------------------------------------------------
+bool vtkSparseSignedDistanceField::ComputeField()
+{
+  if (!this->Surface || this->Surface->GetNumberOfCells() == 0)
+    {
+    return false;
+    }
+
+  if (this->NarrowBandSpacing <= 0.0 || this->FarFieldSpacing <= 0.0)
+    {
+    return false;
+    }
+
+  vtkSmartPointer<vtkImplicitPolyDataDistance> distance =
+    vtkSmartPointer<vtkImplicitPolyDataDistance>::New();
+  distance->SetInput(this->Surface);
+
+  double bounds[6];
+  this->Surface->GetBounds(bounds);
+
+  // Far field over the bounds of the surface enlarged by the padding
+  for (int d=0; d<3; d++)
+    {
+    double extent = bounds[2*d+1] - bounds[2*d] + 2.0*this->FarFieldPadding;
+    this->FarFieldOrigin[d] = bounds[2*d] - this->FarFieldPadding;
+    this->FarFieldDimensions[d] =
+      std::max(2, static_cast<int>(std::ceil(extent / this->FarFieldSpacing)) + 1);
+    }
+
+  int *farDimensions = this->FarFieldDimensions;
+  this->FarField.resize(farDimensions[0]*farDimensions[1]*farDimensions[2]);
+  for (int k=0; k<farDimensions[2]; k++)
+    {
+    if (this->IsStopRequested())
+      {
+      return false;
+      }
+
+    for (int j=0; j<farDimensions[1]; j++)
+      {
+      for (int i=0; i<farDimensions[0]; i++)
+        {
+        double x[3] = {this->FarFieldOrigin[0] + i*this->FarFieldSpacing,
+                       this->FarFieldOrigin[1] + j*this->FarFieldSpacing,
+                       this->FarFieldOrigin[2] + k*this->FarFieldSpacing};
+        this->FarField[i + farDimensions[0]*(j + farDimensions[1]*k)] =
+          static_cast<float>(distance->EvaluateFunction(x));
+        }
+      }
+    }
+
+  // Narrow band over the bounds of the surface enlarged by the band width,
+  // split into bricks. A brick is sampled only if the far field does not
+  // exclude it from the band; since the distance is 1-Lipschitz, the
+  // trilinear interpolation error of the far field is bounded by half the
+  // diagonal of its cells.
+  double brickLength = BrickSize*this->NarrowBandSpacing;
+  for (int d=0; d<3; d++)
+    {
+    double extent = bounds[2*d+1] - bounds[2*d] +
+      2.0*(this->NarrowBandWidth + this->NarrowBandSpacing);
+    this->NarrowBandOrigin[d] =
+      bounds[2*d] - this->NarrowBandWidth - this->NarrowBandSpacing;
+    this->BrickGridDimensions[d] =
+      std::max(1, static_cast<int>(std::ceil(extent / brickLength)));
+    }
+
+  int *brickDimensions = this->BrickGridDimensions;
+  double halfDiagonal = std::sqrt(3.0)*brickLength/2.0;
+  double farFieldError = std::sqrt(3.0)*this->FarFieldSpacing/2.0;
+  int samplesPerBrick = BrickSamples*BrickSamples*BrickSamples;
+
+  this->BrickIndices.assign(brickDimensions[0]*brickDimensions[1]*brickDimensions[2], -1);
+  this->Bricks.clear();
+  this->NumberOfBricks = 0;
+
+  for (int bk=0; bk<brickDimensions[2]; bk++)
+    {
+    for (int bj=0; bj<brickDimensions[1]; bj++)
+      {
+      if (this->IsStopRequested())
+        {
+        this->NumberOfBricks = 0;
+        return false;
+        }
+
+      for (int bi=0; bi<brickDimensions[0]; bi++)
+        {
+        double corner[3] = {this->NarrowBandOrigin[0] + bi*brickLength,
+                            this->NarrowBandOrigin[1] + bj*brickLength,
+                            this->NarrowBandOrigin[2] + bk*brickLength};
+        double center[3] = {corner[0] + brickLength/2.0,
+                            corner[1] + brickLength/2.0,
+                            corner[2] + brickLength/2.0};
+
+        if (std::fabs(this->EvaluateFarField(center)) - halfDiagonal -
+            farFieldError > this->NarrowBandWidth)
+          {
+          continue;
+          }
+
+        this->BrickIndices[bi + brickDimensions[0]*(bj + brickDimensions[1]*bk)] =
+          this->NumberOfBricks;
+        this->Bricks.resize((this->NumberOfBricks+1)*samplesPerBrick);
+        float *samples = &this->Bricks[this->NumberOfBricks*samplesPerBrick];
+
+        for (int k=0; k<BrickSamples; k++)
+          {
+          for (int j=0; j<BrickSamples; j++)
+            {
+            for (int i=0; i<BrickSamples; i++)
+              {
+              double x[3] = {corner[0] + i*this->NarrowBandSpacing,
+                             corner[1] + j*this->NarrowBandSpacing,
+                             corner[2] + k*this->NarrowBandSpacing};
+              samples[i + BrickSamples*(j + BrickSamples*k)] =
+                static_cast<float>(distance->EvaluateFunction(x));
+              }
+            }
+          }
+
+        this->NumberOfBricks++;
+        }
+      }
+    }
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+void vtkSparseSignedDistanceField::StopComputation()
+{
+  if (this->ThreadId < 0)
+    {
+    return;
+    }
+
+  this->StateLock.Lock();
+  this->StopRequested = true;
+  this->StateLock.Unlock();
+
+  this->Threader->TerminateThread(this->ThreadId);
+  this->ThreadId = -1;
+
+  this->StateLock.Lock();
+  this->StopRequested = false;
+  this->StateLock.Unlock();
+}
+
+//-------------------------------------------------------------------------------
+bool vtkSparseSignedDistanceField::IsStopRequested()
+{
+  this->StateLock.Lock();
+  bool stopRequested = this->StopRequested;
+  this->StateLock.Unlock();
+
+  return stopRequested;
+}
+
+//-------------------------------------------------------------------------------
+double vtkSparseSignedDistanceField::EvaluateFarField(const double x[3]) const
+{
+  if (this->FarField.empty())
+    {
+    return VTK_DOUBLE_MAX;
+    }
+
+  // Points beyond the far field are moved to its boundary, adding the
+  // distance to the boundary (an upper bound of the distance)
+  double g[3];
+  double outside2 = 0.0;
+  for (int d=0; d<3; d++)
+    {
+    double last = this->FarFieldDimensions[d] - 1;
+    g[d] = (x[d] - this->FarFieldOrigin[d]) / this->FarFieldSpacing;
+    double clamped = std::min(std::max(g[d], 0.0), last);
+    outside2 += (g[d] - clamped)*(g[d] - clamped);
+    g[d] = clamped;
+    }
+
+  return Interpolate(&this->FarField[0], this->FarFieldDimensions, g) +
+    std::sqrt(outside2)*this->FarFieldSpacing;
+}
@@ -0,0 +1,249 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkSparseSignedDistanceField.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#ifndef __vtkSparseSignedDistanceField_h
+#define __vtkSparseSignedDistanceField_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+#include <vtkSimpleCriticalSection.h>
+#include <vtkMultiThreader.h>
+
+// STD includes
+#include <vector>
+
+//-------------------------------------------------------------------------------
+class vtkPolyData;
+class vtkPoints;
+class vtkDoubleArray;
+
+//------------------------------------------------------------------------------
+/**
+ * \ingroup ResectionPlanning
+ *
+ * \brief This class samples the signed distance to a closed surface (e.g., the
+ * tumors) once, so that the distance at any point is then obtained by
+ * trilinear interpolation in constant time.
+ *
+ * The distance is sampled at two levels: a narrow band around the surface,
+ * stored as a sparse set of bricks of 8x8x8 cells with spacing
+ * NarrowBandSpacing, and a coarse far field with spacing FarFieldSpacing
+ * covering the bounds of the surface enlarged by FarFieldPadding. Points in
+ * the narrow band are interpolated in their brick, the rest in the far field,
+ * and points beyond the far field add their distance to it. The distance is
+ * negative inside the surface.
+ *
+ * The field can be computed in a background thread (ComputeInBackground()),
+ * and must not be evaluated before IsReady() returns true.
+ */
+class vtkSparseSignedDistanceField : public vtkObject
+{
+ public:
+
+  /**
+   * Instantiation of object.
+   *
+   * @return pointer to vtkSparseSignedDistanceField newly created.
+   */
+  static vtkSparseSignedDistanceField *New();
+
+  vtkTypeMacro(vtkSparseSignedDistanceField, vtkObject);
+
+  /**
+   * Print the properties of the object.
+   *
+   * @param os ouptut stream to print the properties to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent);
+
+  /**
+   * Set the surface to compute the distance to. The surface is copied, so it
+   * can be modified while the field is computed. Any computation in progress
+   * is stopped, and the field is not ready until computed again.
+   *
+   * @param surface pointer to the surface.
+   */
+  void SetSurface(vtkPolyData *surface);
+
+  /**
+   * Set/Get the half width of the narrow band around the surface (mm).
+   * The parameters take effect at the next computation of the field.
+   */
+  vtkSetMacro(NarrowBandWidth, double);
+  vtkGetMacro(NarrowBandWidth, double);
+
+  /**
+   * Set/Get the spacing of the narrow band samples (mm).
+   */
+  vtkSetMacro(NarrowBandSpacing, double);
+  vtkGetMacro(NarrowBandSpacing, double);
+
+  /**
+   * Set/Get the spacing of the far field samples (mm).
+   */
+  vtkSetMacro(FarFieldSpacing, double);
+  vtkGetMacro(FarFieldSpacing, double);
+
+  /**
+   * Set/Get the padding of the far field around the bounds of the surface
+   * (mm).
+   */
+  vtkSetMacro(FarFieldPadding, double);
+  vtkGetMacro(FarFieldPadding, double);
+
+  /**
+   * Compute the field in the calling thread.
+   */
+  void Compute();
+
+  /**
+   * Start the computation of the field in a background thread and return
+   * immediately. Any computation in progress is stopped first.
+   */
+  void ComputeInBackground();
+
+  /**
+   * Wait until the computation in the background thread has finished.
+   */
+  void WaitForCompletion();
+
+  /**
+   * Whether the field has been computed and can be evaluated.
+   *
+   * @return true if the field is ready, false otherwise.
+   */
+  bool IsReady();
+
+  /**
+   * Evaluate the signed distance at a point. The field must be ready.
+   *
+   * @param x coordinates of the point.
+   *
+   * @return signed distance at the point.
+   */
+  double EvaluateDistance(const double x[3]) const;
+
+  /**
+   * Evaluate the signed distance at a set of points, in parallel. The field
+   * must be ready.
+   *
+   * @param points points to evaluate the distance at.
+   * @param distances array receiving the distance of every point.
+   */
+  void EvaluateDistances(vtkPoints *points, vtkDoubleArray *distances) const;
+
+  /**
+   * Get the number of bricks allocated in the narrow band.
+   *
+   * @return number of bricks in the narrow band.
+   */
+  unsigned int GetNumberOfNarrowBandBricks() const
+  {return this->NumberOfBricks;}
+
+ protected:
+  vtkSparseSignedDistanceField();
+  ~vtkSparseSignedDistanceField();
+
+ private:
+  vtkSparseSignedDistanceField(const vtkSparseSignedDistanceField&);  // Not implemented.
+  void operator=(const vtkSparseSignedDistanceField&);  // Not implemented.
+
+  /**
+   * Entry point of the background thread.
+   *
+   * @param arg thread information, with the field as user data.
+   */
+  static VTK_THREAD_RETURN_TYPE ComputeThread(void *arg);
+
+  /**
+   * Sampling of the far field and of the narrow band.
+   *
+   * @return true if the field was computed, false if the computation was
+   * stopped or the surface is not valid.
+   */
+  bool ComputeField();
+
+  /**
+   * Stop the computation in the background thread, if any, and wait for
+   * the thread to finish.
+   */
+  void StopComputation();
+
+  /**
+   * Whether the computation in progress has been asked to stop.
+   *
+   * @return true if the computation has to stop, false otherwise.
+   */
+  bool IsStopRequested();
+
+  /**
+   * Evaluation of the signed distance in the far field.
+   *
+   * @param x coordinates of the point.
+   *
+   * @return signed distance at the point.
+   */
+  double EvaluateFarField(const double x[3]) const;
+
+  vtkSmartPointer<vtkPolyData> Surface;
+
+  double NarrowBandWidth;
+  double NarrowBandSpacing;
+  double FarFieldSpacing;
+  double FarFieldPadding;
+
+  // Far field samples, x fastest.
+  double FarFieldOrigin[3];
+  int FarFieldDimensions[3];
+  std::vector<float> FarField;
+
+  // Narrow band: index of the brick (or -1) of every brick position, x
+  // fastest, and the (8+1)^3 samples of every brick.
+  double NarrowBandOrigin[3];
+  int BrickGridDimensions[3];
+  std::vector<int> BrickIndices;
+  std::vector<float> Bricks;
+  unsigned int NumberOfBricks;
+
+  // Background computation.
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  int ThreadId;
+  vtkSimpleCriticalSection StateLock;
+  bool Ready;
+  bool StopRequested;
+};
+
+#endif
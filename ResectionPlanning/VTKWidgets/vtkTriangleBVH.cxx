@@ -0,0 +1,870 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkTriangleBVH.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#include "vtkTriangleBVH.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkDataSet.h>
+#include <vtkPoints.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkCellType.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+
+// Maximum number of triangles in a leaf, and number of bins of the surface
+// area heuristic.
+const int MaximumLeafSize = 4;
+const int NumberOfBins = 16;
+
+// Maximum depth of the hierarchy (bounds the traversal stack).
+const int MaximumDepth = 60;
+
+// Number of points checked before testing whether a search stopping at the
+// first point found can stop.
+const vtkIdType BatchSize = 4096;
+
+typedef std::vector<std::pair<unsigned int, vtkIdType> > MortonOrder;
+
+//-------------------------------------------------------------------------------
+double Dot(const double a[3], const double b[3])
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+//-------------------------------------------------------------------------------
+// Squared distance from a point to a segment a + t*e, t in [0,1], and the
+// parameter of the closest point, without data-dependent branches.
+double SegmentDistance2(const double p[3], const double a[3], const double e[3],
+                        double &t)
+{
+  double v[3] = {p[0]-a[0], p[1]-a[1], p[2]-a[2]};
+  double ee = Dot(e, e);
+  t = ee > 0.0 ? Dot(v, e) / ee : 0.0;
+  t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+  double d[3] = {v[0]-t*e[0], v[1]-t*e[1], v[2]-t*e[2]};
+  return Dot(d, d);
+}
+
+//-------------------------------------------------------------------------------
+// Closest point on a triangle (a, b, c): the projection on its plane if it
+// lies inside the triangle, otherwise the closest point on its edges. All the
+// candidates are computed and selected without data-dependent branches.
+double ClosestPointOnTriangle(const double p[3],
+                              const double a[3],
+                              const double b[3],
+                              const double c[3],
+                              double *closestPoint)
+{
+  double ab[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+  double bc[3] = {c[0]-b[0], c[1]-b[1], c[2]-b[2]};
+  double ca[3] = {a[0]-c[0], a[1]-c[1], a[2]-c[2]};
+  double n[3] = {ab[1]*(-ca[2]) - ab[2]*(-ca[1]),
+                 ab[2]*(-ca[0]) - ab[0]*(-ca[2]),
+                 ab[0]*(-ca[1]) - ab[1]*(-ca[0])};
+  double nn = Dot(n, n);
+
+  // Side of the point with respect to every edge, in the plane
+  double pa[3] = {p[0]-a[0], p[1]-a[1], p[2]-a[2]};
+  double pb[3] = {p[0]-b[0], p[1]-b[1], p[2]-b[2]};
+  double pc[3] = {p[0]-c[0], p[1]-c[1], p[2]-c[2]};
+  double sideAB = n[0]*(ab[1]*pa[2] - ab[2]*pa[1]) +
+    n[1]*(ab[2]*pa[0] - ab[0]*pa[2]) + n[2]*(ab[0]*pa[1] - ab[1]*pa[0]);
+  double sideBC = n[0]*(bc[1]*pb[2] - bc[2]*pb[1]) +
+    n[1]*(bc[2]*pb[0] - bc[0]*pb[2]) + n[2]*(bc[0]*pb[1] - bc[1]*pb[0]);
+  double sideCA = n[0]*(ca[1]*pc[2] - ca[2]*pc[1]) +
+    n[1]*(ca[2]*pc[0] - ca[0]*pc[2]) + n[2]*(ca[0]*pc[1] - ca[1]*pc[0]);
+  bool inside = nn > 0.0 && sideAB >= 0.0 && sideBC >= 0.0 && sideCA >= 0.0;
+
+  double height = nn > 0.0 ? Dot(pa, n) / nn : 0.0;
+  double planeDistance2 = height*height*nn;
+
+  double tAB, tBC, tCA;
+  double distanceAB2 = SegmentDistance2(p, a, ab, tAB);
+  double distanceBC2 = SegmentDistance2(p, b, bc, tBC);
+  double distanceCA2 = SegmentDistance2(p, c, ca, tCA);
+  double edgeDistance2 = std::min(distanceAB2, std::min(distanceBC2, distanceCA2));
+
+  double dist2 = inside ? planeDistance2 : edgeDistance2;
+
+  if (closestPoint)
+    {
+    for (int d=0; d<3; d++)
+      {
+      if (inside)
+        {
+        closestPoint[d] = p[d] - height*n[d];
+        }
+      else if (edgeDistance2 == distanceAB2)
+        {
+        closestPoint[d] = a[d] + tAB*ab[d];
+        }
+      else if (edgeDistance2 == distanceBC2)
+        {
+        closestPoint[d] = b[d] + tBC*bc[d];
+        }
+      else
+        {
+        closestPoint[d] = c[d] + tCA*ca[d];
+        }
+      }
+    }
+
+  return dist2;
+}
+
+//-------------------------------------------------------------------------------
+// Squared distance from a point to a box (0 inside).
+double BoxDistance2(const double bounds[6], const double x[3])
+{
+  double dist2 = 0.0;
+  for (int d=0; d<3; d++)
+    {
+    double below = bounds[2*d] - x[d];
+    double above = x[d] - bounds[2*d+1];
+    double outside = std::max(0.0, std::max(below, above));
+    dist2 += outside*outside;
+    }
+  return dist2;
+}
+
+//-------------------------------------------------------------------------------
+// Half the surface area of a box.
+double HalfArea(const double bounds[6])
+{
+  double dx = std::max(0.0, bounds[1] - bounds[0]);
+  double dy = std::max(0.0, bounds[3] - bounds[2]);
+  double dz = std::max(0.0, bounds[5] - bounds[4]);
+  return dx*dy + dy*dz + dz*dx;
+}
+
+//-------------------------------------------------------------------------------
+void InitializeBounds(double bounds[6])
+{
+  for (int d=0; d<3; d++)
+    {
+    bounds[2*d] = VTK_DOUBLE_MAX;
+    bounds[2*d+1] = -VTK_DOUBLE_MAX;
+    }
+}
+
+//-------------------------------------------------------------------------------
+void AddBounds(double bounds[6], const double other[6])
+{
+  for (int d=0; d<3; d++)
+    {
+    bounds[2*d] = std::min(bounds[2*d], other[2*d]);
+    bounds[2*d+1] = std::max(bounds[2*d+1], other[2*d+1]);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Predicate selecting the triangles whose centroid falls before a bin.
+class BinPredicate
+{
+public:
+  BinPredicate(const std::vector<double> &centroids, int axis, double minimum,
+               double scale, int bin)
+    : Centroids(centroids), Axis(axis), Minimum(minimum), Scale(scale), Bin(bin)
+  {
+  }
+
+  bool operator()(int triangle) const
+  {
+    int bin = static_cast<int>((this->Centroids[3*triangle+this->Axis] -
+                                this->Minimum) * this->Scale);
+    return std::min(bin, NumberOfBins-1) < this->Bin;
+  }
+
+private:
+  const std::vector<double> &Centroids;
+  int Axis;
+  double Minimum;
+  double Scale;
+  int Bin;
+};
+
+//-------------------------------------------------------------------------------
+// Predicate ordering triangles along an axis by their centroid.
+class CentroidLess
+{
+public:
+  CentroidLess(const std::vector<double> &centroids, int axis)
+    : Centroids(centroids), Axis(axis)
+  {
+  }
+
+  bool operator()(int a, int b) const
+  {
+    return this->Centroids[3*a+this->Axis] < this->Centroids[3*b+this->Axis];
+  }
+
+private:
+  const std::vector<double> &Centroids;
+  int Axis;
+};
+
+//-------------------------------------------------------------------------------
+// Morton code of a point quantized to 10 bits per coordinate.
+unsigned int MortonCode(const double x[3], const double bounds[6])
+{
+  unsigned int code = 0;
+  unsigned int quantized[3];
+  for (int d=0; d<3; d++)
+    {
+    double extent = bounds[2*d+1] - bounds[2*d];
+    double t = extent > 0.0 ? (x[d] - bounds[2*d]) / extent : 0.0;
+    quantized[d] = static_cast<unsigned int>(std::min(std::max(t, 0.0), 1.0) * 1023.0);
+    }
+  for (int bit=9; bit>=0; bit--)
+    {
+    for (int d=0; d<3; d++)
+      {
+      code = (code << 1) | ((quantized[d] >> bit) & 1u);
+      }
+    }
+  return code;
+}
+
+//-------------------------------------------------------------------------------
+// Ids of the points sorted by Morton code.
+void SortPoints(vtkPoints *points, MortonOrder &order)
+{
+  double bounds[6];
+  points->GetBounds(bounds);
+
+  order.resize(points->GetNumberOfPoints());
+  for (vtkIdType k=0; k<points->GetNumberOfPoints(); k++)
+    {
+    double x[3];
+    points->GetPoint(k, x);
+    order[k] = std::make_pair(MortonCode(x, bounds), k);
+    }
+  std::sort(order.begin(), order.end());
+}
+
+//-------------------------------------------------------------------------------
+// Functor computing the distance of a range of points in Morton order. Each
+// query starts from the triangle found by the previous one.
+class ClosestDistancesFunctor
+{
+public:
+  ClosestDistancesFunctor(const vtkTriangleBVH *hierarchy,
+                          vtkPoints *points,
+                          const MortonOrder &order,
+                          double *distances)
+    : Hierarchy(hierarchy), Points(points), Order(order), Distances(distances)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end) const
+  {
+    int triangle = -1;
+    for (vtkIdType k=begin; k<end; k++)
+      {
+      vtkIdType pointId = this->Order[k].second;
+      double x[3];
+      this->Points->GetPoint(pointId, x);
+
+      double dist2 = triangle >= 0 ?
+        this->Hierarchy->TriangleDistance2(x, triangle) : VTK_DOUBLE_MAX;
+      this->Hierarchy->FindClosestTriangle(x, dist2, triangle);
+      this->Distances[pointId] = std::sqrt(dist2);
+      }
+  }
+
+private:
+  const vtkTriangleBVH *Hierarchy;
+  vtkPoints *Points;
+  const MortonOrder &Order;
+  double *Distances;
+};
+
+//-------------------------------------------------------------------------------
+// Functor finding the points of a range in Morton order closer than a
+// distance. Each thread keeps the points it found and their minimum distance.
+class PointsWithinDistanceFunctor
+{
+public:
+  PointsWithinDistanceFunctor(const vtkTriangleBVH *hierarchy,
+                              vtkPoints *points,
+                              const MortonOrder &order,
+                              double distance2,
+                              bool stopAtFirst)
+    : Hierarchy(hierarchy), Points(points), Order(order),
+      Distance2(distance2), StopAtFirst(stopAtFirst), Minimum2(distance2)
+  {
+  }
+
+  void Initialize()
+  {
+    this->LocalPointIds.Local().clear();
+    this->LocalMinimum2.Local() = this->Distance2;
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    std::vector<vtkIdType> &pointIds = this->LocalPointIds.Local();
+    double &minimum2 = this->LocalMinimum2.Local();
+
+    int triangle = -1;
+    for (vtkIdType k=begin; k<end; k++)
+      {
+      if (this->StopAtFirst && !pointIds.empty())
+        {
+        return;
+        }
+
+      vtkIdType pointId = this->Order[k].second;
+      double x[3];
+      this->Points->GetPoint(pointId, x);
+
+      // The triangle closest to the previous point found tightens the bound
+      double dist2 = this->Distance2;
+      int closest = -1;
+      if (triangle >= 0)
+        {
+        double triangleDistance2 = this->Hierarchy->TriangleDistance2(x, triangle);
+        if (triangleDistance2 < dist2)
+          {
+          dist2 = triangleDistance2;
+          closest = triangle;
+          }
+        }
+
+      this->Hierarchy->FindClosestTriangle(x, dist2, closest);
+      if (closest < 0)
+        {
+        continue;
+        }
+
+      triangle = closest;
+      pointIds.push_back(pointId);
+      minimum2 = std::min(minimum2, dist2);
+      }
+  }
+
+  void Reduce()
+  {
+    vtkSMPThreadLocal<std::vector<vtkIdType> >::iterator idsIt;
+    for (idsIt = this->LocalPointIds.begin();
+         idsIt != this->LocalPointIds.end(); ++idsIt)
+      {
+      this->PointIds.insert(this->PointIds.end(), idsIt->begin(), idsIt->end());
+      }
+
+    vtkSMPThreadLocal<double>::iterator minimumIt;
+    for (minimumIt = this->LocalMinimum2.begin();
+         minimumIt != this->LocalMinimum2.end(); ++minimumIt)
+      {
+      this->Minimum2 = std::min(this->Minimum2, *minimumIt);
+      }
+  }
+
+  const std::vector<vtkIdType> &GetPointIds() const
+  {
+    return this->PointIds;
+  }
+
+  double GetMinimum2() const
+  {
+    return this->Minimum2;
+  }
+
+private:
+  const vtkTriangleBVH *Hierarchy;
+  vtkPoints *Points;
+  const MortonOrder &Order;
+  double Distance2;
+  bool StopAtFirst;
+
+  std::vector<vtkIdType> PointIds;
+  double Minimum2;
+  vtkSMPThreadLocal<std::vector<vtkIdType> > LocalPointIds;
+  vtkSMPThreadLocal<double> LocalMinimum2;
+};
+
+}
+
+//-------------------------------------------------------------------------------
+vtkStandardNewMacro(vtkTriangleBVH);
+
+//-------------------------------------------------------------------------------
+vtkTriangleBVH::vtkTriangleBVH()
+{
+}
+
+//-------------------------------------------------------------------------------
+vtkTriangleBVH::~vtkTriangleBVH()
+{
+}
+
+//-------------------------------------------------------------------------------
+void vtkTriangleBVH::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Dataset: " << this->DataSet.GetPointer() << "\n";
+  os << indent << "Number of triangles: " << this->CellIds.size() << "\n";
+  os << indent << "Number of nodes: " << this->Nodes.size() << "\n";
+}
+
+//-------------------------------------------------------------------------------
+void vtkTriangleBVH::SetDataSet(vtkDataSet *dataSet)
+{
+  if (this->DataSet.GetPointer() == dataSet)
+    {
+    return;
+    }
+
+  this->DataSet = dataSet;
+  this->Modified();
+}
+
+//-------------------------------------------------------------------------------
+void vtkTriangleBVH::BuildLocator()
+{
+  this->Nodes.clear();
+  this->CellIds.clear();
+  for (int c=0; c<9; c++)
+    {
+    this->Coordinates[c].clear();
+    }
+
+  if (!this->DataSet)
+    {
+    vtkErrorMacro("BuildLocator: no dataset set.");
+    return;
+    }
+
+  // Triangulation of the 2D cells
+  std::vector<vtkIdType> triangles;
+  std::vector<vtkIdType> cellIds;
+  vtkSmartPointer<vtkIdList> cellPoints = vtkSmartPointer<vtkIdList>::New();
+  for (vtkIdType cellId=0; cellId<this->DataSet->GetNumberOfCells(); cellId++)
+    {
+    int cellType = this->DataSet->GetCellType(cellId);
+    if (cellType != VTK_TRIANGLE && cellType != VTK_QUAD &&
+        cellType != VTK_POLYGON && cellType != VTK_TRIANGLE_STRIP)
+      {
+      continue;
+      }
+
+    this->DataSet->GetCellPoints(cellId, cellPoints);
+    vtkIdType numberOfPoints = cellPoints->GetNumberOfIds();
+    for (vtkIdType k=2; k<numberOfPoints; k++)
+      {
+      if (cellType == VTK_TRIANGLE_STRIP)
+        {
+        triangles.push_back(cellPoints->GetId(k-2));
+        triangles.push_back(cellPoints->GetId(k-1));
+        }
+      else
+        {
+        triangles.push_back(cellPoints->GetId(0));
+        triangles.push_back(cellPoints->GetId(k-1));
+        }
+      triangles.push_back(cellPoints->GetId(k));
+      cellIds.push_back(cellId);
+      }
+    }
+
+  int numberOfTriangles = static_cast<int>(cellIds.size());
+  if (numberOfTriangles == 0)
+    {
+    return;
+    }
+
+  std::vector<double> bounds(6*numberOfTriangles);
+  std::vector<double> centroids(3*numberOfTriangles);
+  std::vector<int> order(numberOfTriangles);
+  for (int t=0; t<numberOfTriangles; t++)
+    {
+    double *triangleBounds = &bounds[6*t];
+    InitializeBounds(triangleBounds);
+    for (int v=0; v<3; v++)
+      {
+      double x[3];
+      this->DataSet->GetPoint(triangles[3*t+v], x);
+      double pointBounds[6] = {x[0], x[0], x[1], x[1], x[2], x[2]};
+      AddBounds(triangleBounds, pointBounds);
+      }
+    for (int d=0; d<3; d++)
+      {
+      centroids[3*t+d] = (triangleBounds[2*d] + triangleBounds[2*d+1]) / 2.0;
+      }
+    order[t] = t;
+    }
+
+  this->Nodes.reserve(2*numberOfTriangles);
+  this->BuildNode(0, numberOfTriangles, 0, bounds, centroids, order);
+
+  // Triangles in leaf order
+  for (int c=0; c<9; c++)
+    {
+    this->Coordinates[c].resize(numberOfTriangles);
+    }
+  this->CellIds.resize(numberOfTriangles);
+  for (int t=0; t<numberOfTriangles; t++)
+    {
+    for (int v=0; v<3; v++)
+      {
+      double x[3];
+      this->DataSet->GetPoint(triangles[3*order[t]+v], x);
+      for (int d=0; d<3; d++)
+        {
+        this->Coordinates[3*v+d][t] = x[d];
+        }
+      }
+    this->CellIds[t] = cellIds[order[t]];
+    }
+}
+
+//-------------------------------------------------------------------------------
+bool vtkTriangleBVH::FindClosestPoint(const double x[3], double closestPoint[3],
+                                      vtkIdType &cellId, double &dist2) const
+{
+  int triangle = -1;
+  dist2 = VTK_DOUBLE_MAX;
+  this->FindClosestTriangle(x, dist2, triangle);
+  if (triangle < 0)
+    {
+    cellId = -1;
+    return false;
+    }
+
+  dist2 = this->TriangleDistance2(x, triangle, closestPoint);
+  cellId = this->CellIds[triangle];
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+void vtkTriangleBVH::FindClosestDistances(vtkPoints *points,
+                                          vtkDoubleArray *distances) const
+{
+  if (!points || !distances)
+    {
+    vtkErrorMacro("FindClosestDistances: no points or distances passed.");
+    return;
+    }
+
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  distances->SetNumberOfComponents(1);
+  distances->SetNumberOfTuples(numberOfPoints);
+  if (numberOfPoints == 0)
+    {
+    return;
+    }
+
+  MortonOrder order;
+  SortPoints(points, order);
+
+  ClosestDistancesFunctor functor(this, points, order, distances->GetPointer(0));
+  vtkSMPTools::For(0, numberOfPoints, functor);
+}
+
+//-------------------------------------------------------------------------------
+vtkIdType vtkTriangleBVH::FindPointsWithinDistance(vtkPoints *points,
+                                                   double distance,
+                                                   vtkIdList *pointIds,
+                                                   double &minimumDistance,
+                                                   bool stopAtFirst) const
+{
+  minimumDistance = distance;
+  if (pointIds)
+    {
+    pointIds->Reset();
+    }
+
+  if (!points)
+    {
+    vtkErrorMacro("FindPointsWithinDistance: no points passed.");
+    return 0;
+    }
+
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  if (numberOfPoints == 0 || distance <= 0.0)
+    {
+    return 0;
+    }
+
+  MortonOrder order;
+  SortPoints(points, order);
+
+  // Without early exit, all the points form a single batch; otherwise the
+  // batches stop once a point is found
+  vtkIdType batchSize = stopAtFirst ? BatchSize : numberOfPoints;
+  std::vector<vtkIdType> found;
+  double minimum2 = distance*distance;
+  for (vtkIdType begin=0; begin<numberOfPoints && found.empty(); begin+=batchSize)
+    {
+    vtkIdType end = std::min(begin+batchSize, numberOfPoints);
+    PointsWithinDistanceFunctor functor(this, points, order, distance*distance,
+                                        stopAtFirst);
+    vtkSMPTools::For(begin, end, functor);
+
+    found.insert(found.end(), functor.GetPointIds().begin(),
+                 functor.GetPointIds().end());
+    minimum2 = std::min(minimum2, functor.GetMinimum2());
+    }
+
+  if (found.empty())
+    {
+    return 0;
+    }
+
+  minimumDistance = std::sqrt(minimum2);
+  if (pointIds)
+    {
+    std::sort(found.begin(), found.end());
+    pointIds->SetNumberOfIds(static_cast<vtkIdType>(found.size()));
+    for (size_t k=0; k<found.size(); k++)
+      {
+      pointIds->SetId(static_cast<vtkIdType>(k), found[k]);
+      }
+    }
+
+  return static_cast<vtkIdType>(found.size());
+}
+
+//-------------------------------------------------------------------------------
+void vtkTriangleBVH::FindClosestTriangle(const double x[3], double &dist2,
+                                         int &triangle) const
+{
+  if (this->Nodes.empty())
+    {
+    return;
+    }
+
+  int stack[MaximumDepth+2];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+    {
+    const Node &node = this->Nodes[stack[--top]];
+    if (BoxDistance2(node.Bounds, x) >= dist2)
+      {
+      continue;
+      }
+
+    if (node.Count > 0)
+      {
+      // Distances to the triangles of the leaf, computed before selecting
+      // the closest so that the loop has no data-dependent branches
+      double leafDistances[MaximumLeafSize];
+      for (int first=node.Start; first<node.Start+node.Count; first+=MaximumLeafSize)
+        {
+        int count = std::min(MaximumLeafSize, node.Start+node.Count-first);
+        for (int k=0; k<count; k++)
+          {
+          leafDistances[k] = this->TriangleDistance2(x, first+k);
+          }
+        for (int k=0; k<count; k++)
+          {
+          if (leafDistances[k] < dist2)
+            {
+            dist2 = leafDistances[k];
+            triangle = first+k;
+            }
+          }
+        }
+      continue;
+      }
+
+    // Push the farthest child first so that the closest one is visited first
+    int nearChild = static_cast<int>(&node - &this->Nodes[0]) + 1;
+    int farChild = node.Right;
+    double nearDistance2 = BoxDistance2(this->Nodes[nearChild].Bounds, x);
+    double farDistance2 = BoxDistance2(this->Nodes[farChild].Bounds, x);
+    if (farDistance2 < nearDistance2)
+      {
+      std::swap(nearChild, farChild);
+      std::swap(nearDistance2, farDistance2);
+      }
+    if (farDistance2 < dist2)
+      {
+      stack[top++] = farChild;
+      }
+    if (nearDistance2 < dist2)
+      {
+      stack[top++] = nearChild;
+      }
+    }
+}
+
+//-------------------------------------------------------------------------------
+double vtkTriangleBVH::TriangleDistance2(const double x[3], int triangle,
+                                         double *closestPoint) const
+{
+  double a[3] = {this->Coordinates[0][triangle], this->Coordinates[1][triangle],
+                 this->Coordinates[2][triangle]};
+  double b[3] = {this->Coordinates[3][triangle], this->Coordinates[4][triangle],
+                 this->Coordinates[5][triangle]};
+  double c[3] = {this->Coordinates[6][triangle], this->Coordinates[7][triangle],
+                 this->Coordinates[8][triangle]};
+  return ClosestPointOnTriangle(x, a, b, c, closestPoint);
+}
+
+//-------------------------------------------------------------------------------
+int vtkTriangleBVH::BuildNode(int start, int end, int depth,
+                              const std::vector<double> &bounds,
+                              const std::vector<double> &centroids,
+                              std::vector<int> &order)
+{
+  int nodeIndex = static_cast<int>(this->Nodes.size());
+  this->Nodes.push_back(Node());
+
+  double nodeBounds[6];
+  double centroidBounds[6];
+  InitializeBounds(nodeBounds);
+  InitializeBounds(centroidBounds);
+  for (int k=start; k<end; k++)
+    {
+    AddBounds(nodeBounds, &bounds[6*order[k]]);
+    const double *centroid = &centroids[3*order[k]];
+    double centroidBox[6] = {centroid[0], centroid[0], centroid[1],
+                             centroid[1], centroid[2], centroid[2]};
+    AddBounds(centroidBounds, centroidBox);
+    }
+  std::copy(nodeBounds, nodeBounds+6, this->Nodes[nodeIndex].Bounds);
+
+  int count = end - start;
+  if (count <= MaximumLeafSize || depth >= MaximumDepth)
+    {
+    this->Nodes[nodeIndex].Start = start;
+    this->Nodes[nodeIndex].Count = count;
+    this->Nodes[nodeIndex].Right = -1;
+    return nodeIndex;
+    }
+
+  // Binned surface area heuristic over the three axes
+  int bestAxis = -1;
+  int bestBin = 0;
+  double bestCost = VTK_DOUBLE_MAX;
+  for (int axis=0; axis<3; axis++)
+    {
+    double minimum = centroidBounds[2*axis];
+    double extent = centroidBounds[2*axis+1] - minimum;
+    if (extent <= 0.0)
+      {
+      continue;
+      }
+    double scale = NumberOfBins / extent;
+
+    int binCounts[NumberOfBins];
+    double binBounds[NumberOfBins][6];
+    for (int b=0; b<NumberOfBins; b++)
+      {
+      binCounts[b] = 0;
+      InitializeBounds(binBounds[b]);
+      }
+    for (int k=start; k<end; k++)
+      {
+      int bin = static_cast<int>((centroids[3*order[k]+axis] - minimum) * scale);
+      bin = std::min(bin, NumberOfBins-1);
+      binCounts[bin]++;
+      AddBounds(binBounds[bin], &bounds[6*order[k]]);
+      }
+
+    // Areas and counts on the left of every split, swept from the left, then
+    // cost of every split swept from the right
+    double leftAreas[NumberOfBins];
+    int leftCounts[NumberOfBins];
+    double sweptBounds[6];
+    int sweptCount = 0;
+    InitializeBounds(sweptBounds);
+    for (int b=0; b<NumberOfBins-1; b++)
+      {
+      AddBounds(sweptBounds, binBounds[b]);
+      sweptCount += binCounts[b];
+      leftAreas[b+1] = HalfArea(sweptBounds);
+      leftCounts[b+1] = sweptCount;
+      }
+
+    InitializeBounds(sweptBounds);
+    sweptCount = 0;
+    for (int b=NumberOfBins-1; b>0; b--)
+      {
+      AddBounds(sweptBounds, binBounds[b]);
+      sweptCount += binCounts[b];
+      if (sweptCount == 0 || leftCounts[b] == 0)
+        {
+        continue;
+        }
+      double cost = leftAreas[b]*leftCounts[b] + HalfArea(sweptBounds)*sweptCount;
+      if (cost < bestCost)
+        {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin = b;
+        }
+      }
+    }
+
+  int middle;
+  if (bestAxis >= 0)
+    {
+    double minimum = centroidBounds[2*bestAxis];
+    double scale = NumberOfBins / (centroidBounds[2*bestAxis+1] - minimum);
+    middle = static_cast<int>(
+      std::partition(order.begin()+start, order.begin()+end,
+                     BinPredicate(centroids, bestAxis, minimum, scale, bestBin)) -
+      order.begin());
+    }
+  else
+    {
+    // All the centroids coincide: split by count
+    middle = (start + end) / 2;
+    std::nth_element(order.begin()+start, order.begin()+middle,
+                     order.begin()+end, CentroidLess(centroids, 0));
+    }
+
+  this->Nodes[nodeIndex].Start = start;
+  this->Nodes[nodeIndex].Count = 0;
+  this->BuildNode(start, middle, depth+1, bounds, centroids, order);
+  this->Nodes[nodeIndex].Right =
+    this->BuildNode(middle, end, depth+1, bounds, centroids, order);
+
+  return nodeIndex;
+}
@@ -0,0 +1,243 @@
+/*=========================================================================
+
+  Program: NorMIT-Plan
+  Module: vtkTriangleBVH.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+#ifndef __vtkTriangleBVH_h
+#define __vtkTriangleBVH_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+//-------------------------------------------------------------------------------
+class vtkDataSet;
+class vtkPoints;
+class vtkDoubleArray;
+class vtkIdList;
+
+//------------------------------------------------------------------------------
+/**
+ * \ingroup ResectionPlanning
+ *
+ * \brief This class finds the exact closest point on the triangles of a
+ * dataset, using a bounding volume hierarchy of the triangles.
+ *
+ * The hierarchy is built with the surface area heuristic (binned) and stored
+ * as a flat array of nodes in depth-first order, so that the left child of a
+ * node follows it. The triangles are stored in leaf order as a structure of
+ * arrays, and the distances to the triangles of a leaf are computed without
+ * data-dependent branches, so that the compiler can vectorize them.
+ *
+ * Polygons, quads and triangle strips are triangulated; cells of other
+ * dimensions are ignored. The queries do not modify the hierarchy and can be
+ * run concurrently.
+ */
+class vtkTriangleBVH : public vtkObject
+{
+ public:
+
+  /**
+   * Instantiation of object.
+   *
+   * @return pointer to vtkTriangleBVH newly created.
+   */
+  static vtkTriangleBVH *New();
+
+  vtkTypeMacro(vtkTriangleBVH, vtkObject);
+
+  /**
+   * Print the properties of the object.
+   *
+   * @param os ouptut stream to print the properties to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent);
+
+  /**
+   * Set the dataset whose triangles are located.
+   *
+   * @param dataSet pointer to the dataset.
+   */
+  void SetDataSet(vtkDataSet *dataSet);
+
+  /**
+   * Get the dataset whose triangles are located.
+   *
+   * @return pointer to the dataset.
+   */
+  vtkDataSet *GetDataSet() const
+  {return this->DataSet;}
+
+  /**
+   * Build the hierarchy of the triangles of the dataset.
+   */
+  void BuildLocator();
+
+  /**
+   * Get the number of triangles in the hierarchy.
+   *
+   * @return number of triangles.
+   */
+  vtkIdType GetNumberOfTriangles() const
+  {return static_cast<vtkIdType>(this->CellIds.size());}
+
+  /**
+   * Get the number of nodes of the hierarchy.
+   *
+   * @return number of nodes.
+   */
+  vtkIdType GetNumberOfNodes() const
+  {return static_cast<vtkIdType>(this->Nodes.size());}
+
+  /**
+   * Find the closest point on the triangles to a given point.
+   *
+   * @param x coordinates of the point.
+   * @param closestPoint coordinates of the closest point on the triangles.
+   * @param cellId id of the cell containing the closest point.
+   * @param dist2 squared distance to the closest point.
+   *
+   * @return true if the closest point was found, false if there are no
+   * triangles.
+   */
+  bool FindClosestPoint(const double x[3], double closestPoint[3],
+                        vtkIdType &cellId, double &dist2) const;
+
+  /**
+   * Compute the distance from a set of points to the triangles, in parallel.
+   * The points are processed in the order of their Morton code, so that
+   * consecutive queries are close in space and start from the triangle found
+   * by the previous one.
+   *
+   * @param points points to compute the distance from.
+   * @param distances array receiving the distance of every point.
+   */
+  void FindClosestDistances(vtkPoints *points, vtkDoubleArray *distances) const;
+
+  /**
+   * Find the points closer to the triangles than a given distance, e.g., the
+   * points of a resection surface violating the resection margin. The nodes
+   * farther than the distance are not visited, so that the points satisfying
+   * the margin are rejected early. The points are processed in Morton order
+   * and in parallel, by batches when stopping at the first point found.
+   *
+   * @param points points to check.
+   * @param distance distance below which a point is reported.
+   * @param pointIds if not NULL, array receiving the ids of the points found,
+   * in increasing order.
+   * @param minimumDistance distance of the closest point found, or the given
+   * distance if no point is closer.
+   * @param stopAtFirst if true, the search stops after the batch of points in
+   * which the first point closer than the distance is found.
+   *
+   * @return number of points found.
+   */
+  vtkIdType FindPointsWithinDistance(vtkPoints *points, double distance,
+                                     vtkIdList *pointIds,
+                                     double &minimumDistance,
+                                     bool stopAtFirst = false) const;
+
+  /**
+   * Search of the closest triangle, pruning the nodes not closer than the
+   * given squared distance.
+   *
+   * @param x coordinates of the point.
+   * @param dist2 squared distance bounding the search; on return, squared
+   * distance to the closest triangle if closer than the bound.
+   * @param triangle index of the closest triangle (unchanged if no triangle
+   * is closer than the bound).
+   */
+  void FindClosestTriangle(const double x[3], double &dist2, int &triangle) const;
+
+  /**
+   * Squared distance from a point to a triangle of the hierarchy.
+   *
+   * @param x coordinates of the point.
+   * @param triangle index of the triangle.
+   * @param closestPoint if not NULL, coordinates of the closest point.
+   *
+   * @return squared distance to the triangle.
+   */
+  double TriangleDistance2(const double x[3], int triangle,
+                           double *closestPoint = NULL) const;
+
+ protected:
+  vtkTriangleBVH();
+  ~vtkTriangleBVH();
+
+ private:
+  vtkTriangleBVH(const vtkTriangleBVH&);  // Not implemented.
+  void operator=(const vtkTriangleBVH&);  // Not implemented.
+
+  // Node of the hierarchy: a leaf holds Count triangles from Start, an inner
+  // node has its left child next to it and its right child at Right.
+  struct Node
+  {
+    double Bounds[6];
+    int Start;
+    int Count;
+    int Right;
+  };
+
+  /**
+   * Recursive construction of the hierarchy of the triangles in a range of
+   * Order.
+   *
+   * @param start first position in Order.
+   * @param end position after the last in Order.
+   * @param depth depth of the node.
+   * @param bounds bounds of every triangle (6 values per triangle).
+   * @param centroids centroid of every triangle (3 values per triangle).
+   * @param order triangles, reordered so that every node holds a range.
+   *
+   * @return index of the node.
+   */
+  int BuildNode(int start, int end, int depth,
+                const std::vector<double> &bounds,
+                const std::vector<double> &centroids,
+                std::vector<int> &order);
+
+  vtkSmartPointer<vtkDataSet> DataSet;
+
+  std::vector<Node> Nodes;
+
+  // Coordinates of the vertices of the triangles in leaf order (ax, ay, az,
+  // bx, ..., cz), and the id of the cell of every triangle.
+  std::vector<double> Coordinates[9];
+  std::vector<vtkIdType> CellIds;
+};
+
+#endif
@@ -176,6 +176,11 @@ namespace itk
         itkGetConstMacro(AlgorithmDebug, bool);
         itkBooleanMacro(AlgorithmDebug);
         
+        /** Get the bounding region of the output voxels labelled by the last
+         * update. Voxels copied from the PreviousOutput are not included and
+         * the region is empty when nothing was labelled. */
+        itkGetConstReferenceMacro(ModifiedRegion, OutputImageRegionType);
+        
         /** This is overloaded to create the Threshold output image */
         typedef ProcessObject::DataObjectPointerArraySizeType DataObjectPointerArraySizeType;
         
@@ -220,6 +225,12 @@ namespace itk
         bool m_GenerateCentrelineOutput;
         bool m_AlgorithmDebug;
         
+        /** Number of cross-sections analysed, used for progress reporting. */
+        unsigned int m_NumberOfCrossSections;
+        
+        /** Bounding region of the voxels labelled by the last update. */
+        OutputImageRegionType m_ModifiedRegion;
+        
         typename CentrelineImageType::Pointer m_CentrelineImage;
         
         InputImagePointer m_TempOutputImage;
@@ -281,6 +292,9 @@ namespace itk
         
         /** Function to make sperical label maps around all centres. */
         void SmoothOutput();
+        
+        /** Function to grow the modified region to include index. */
+        void AddToModifiedRegion(const Index3D & index);
     };
 } //end namespace ITK
 
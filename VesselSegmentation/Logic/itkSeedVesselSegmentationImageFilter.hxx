@@ -87,6 +87,8 @@ namespace itk
         m_GenerateCentrelineOutput = false;
         m_AlgorithmDebug           = false;
         
+        m_NumberOfCrossSections = 0;
+        
         m_TempOutputImage = InputImageType::New();
         
         m_CentrelineImage = CentrelineImageType::New();
@@ -790,13 +792,14 @@ namespace itk
         
         typename TOutputImage::Pointer outputImage = this->GetOutput();
         outputImage->SetRequestedRegion(distanceMapWithinVessel->GetLargestPossibleRegion());
-        Image3DIteratorType itOutput(outputImage, outputImage->GetRequestedRegion());
+        itk::ImageRegionIterator<OutputImageType> itOutput(outputImage, outputImage->GetRequestedRegion());
         
         for (itThreshold.GoToBegin(), itOutput.GoToBegin(), itTempOutput.GoToBegin(); !itThreshold.IsAtEnd(); ++itThreshold, ++itOutput, ++itTempOutput)
         {
             if (itThreshold.Get())
             {
                 itOutput.Set(static_cast< OutputImagePixelType >(m_OutputLabel));
+                AddToModifiedRegion(itOutput.GetIndex());
                 itTempOutput.Set(static_cast< InputImagePixelType >(m_OutputLabel));
             }
         }
@@ -935,6 +938,17 @@ namespace itk
     {
         typedef typename itk::Index<2> Index2D;
         
+        //stop tracking when aborted, GenerateData reports the abort
+        if (this->GetAbortGenerateData())
+        {
+            return;
+        }
+        
+        //the length of the vessel tree is not known in advance, so progress
+        //approaches 1 as the number of analysed cross-sections grows
+        ++m_NumberOfCrossSections;
+        this->UpdateProgress( static_cast<float>(m_NumberOfCrossSections) / (m_NumberOfCrossSections + 200.0f) );
+        
         //get previous values from lists
         double prevRadius = calculatedRadius.front();
         Index3D prevCentre = calculatedCentre.front();
@@ -1165,7 +1179,7 @@ namespace itk
         }
         
         
-        Image3DIteratorType it_output(this->GetOutput(), this->GetOutput()->GetLargestPossibleRegion());
+        itk::ImageRegionIterator<OutputImageType> it_output(this->GetOutput(), this->GetOutput()->GetLargestPossibleRegion());
         Image3DIteratorType it_c(m_CentrelineImage, m_CentrelineImage->GetRequestedRegion());
         
         if (m_GenerateCentrelineOutput)
@@ -1353,7 +1367,7 @@ namespace itk
         
         if (!this->GetInputImage()->GetRequestedRegion().IsInside(it.GetBoundingBoxAsImageRegion()))
         {
-            std::cout<<"Outside Image Bound on First Seed Radius Calculation"<<std::endl;
+            itkWarningMacro(<< "Outside Image Bound on First Seed Radius Calculation");
             return false;
         }
 
@@ -1421,6 +1435,7 @@ namespace itk
     {
         C_R centresAndRadius;
         typedef itk::ShapedNeighborhoodIterator< OutputImageType > ShapedNeighborhoodIteratorType;
+        typedef itk::ConstShapedNeighborhoodIterator< InputImageType > InputShapedNeighborhoodIteratorType;
         typedef itk::BinaryBallStructuringElement< OutputImagePixelType, 3 >  StructuringElementType;
         typename StructuringElementType::RadiusType elementRadius;
         
@@ -1444,7 +1459,7 @@ namespace itk
             
             ShapedNeighborhoodIteratorType it(structuringElement.GetRadius(), this->GetOutput(),
                                               this->GetOutput()->GetLargestPossibleRegion());
-            ShapedNeighborhoodIteratorType itin(structuringElement.GetRadius(), this->GetInputImage(),
+            InputShapedNeighborhoodIteratorType itin(structuringElement.GetRadius(), this->GetInputImage(),
                                               this->GetInputImage()->GetLargestPossibleRegion());
             
             it.CreateActiveListFromNeighborhood(structuringElement);
@@ -1457,7 +1472,7 @@ namespace itk
             itin.SetLocation(centre);
             
             typename ShapedNeighborhoodIteratorType::Iterator i;
-            typename ShapedNeighborhoodIteratorType::Iterator in;
+            typename InputShapedNeighborhoodIteratorType::ConstIterator in;
             
             Index3D tempIndex;
             
@@ -1471,6 +1486,7 @@ namespace itk
                 if ( (!i.Get()) && (in.Get() >= 100) )
                 {
                     i.Set(static_cast< OutputImagePixelType >(m_OutputLabel));
+                    AddToModifiedRegion(tempIndex);
                 }
             }
             
@@ -1478,6 +1494,37 @@ namespace itk
         }
     }
     
+    template< typename TInputImage, typename TOutputImage >
+    void
+    SeedVesselSegmentationImageFilter< TInputImage, TOutputImage >
+    ::AddToModifiedRegion(const Index3D & index)
+    {
+        if (m_ModifiedRegion.GetNumberOfPixels() == 0)
+        {
+            typename OutputImageRegionType::SizeType size;
+            size.Fill(1);
+            m_ModifiedRegion.SetIndex(index);
+            m_ModifiedRegion.SetSize(size);
+            return;
+        }
+        
+        for (unsigned int d = 0; d < 3; d++)
+        {
+            IndexValueType lower = m_ModifiedRegion.GetIndex(d);
+            IndexValueType upper = lower + static_cast<IndexValueType>(m_ModifiedRegion.GetSize(d)) - 1;
+            if (index[d] < lower)
+            {
+                lower = index[d];
+            }
+            if (index[d] > upper)
+            {
+                upper = index[d];
+            }
+            m_ModifiedRegion.SetIndex(d, lower);
+            m_ModifiedRegion.SetSize(d, static_cast<SizeValueType>(upper - lower + 1));
+        }
+    }
+    
     template< typename TInputImage, typename TOutputImage >
     void
     SeedVesselSegmentationImageFilter< TInputImage, TOutputImage >
@@ -1504,8 +1551,16 @@ namespace itk
             //Initialize pointer for Previous Output
             OutputImageConstPointer previousOutput = this->GetPreviousOutput();
             
-            itk::ImageRegionIterator<InputImageType> outputIterator(output, output->GetLargestPossibleRegion());
-            itk::ImageRegionConstIterator<OutputImageType> prevOutputIterator(previousOutput, previousOutput->GetLargestPossibleRegion());
+            //Only the voxels both images hold are copied, the previous output
+            //may cover another region of the volume
+            typename OutputImageType::RegionType sharedRegion = output->GetBufferedRegion();
+            if ( !sharedRegion.Crop( previousOutput->GetBufferedRegion() ) )
+            {
+                sharedRegion.SetSize( typename OutputImageType::SizeType() );
+            }
+            
+            itk::ImageRegionIterator<OutputImageType> outputIterator(output, sharedRegion);
+            itk::ImageRegionConstIterator<OutputImageType> prevOutputIterator(previousOutput, sharedRegion);
             
             //Copy Previous Outuput to Current Output
             for (outputIterator.GoToBegin(), prevOutputIterator.GoToBegin(); !outputIterator.IsAtEnd(); ++outputIterator, ++prevOutputIterator)
@@ -1555,7 +1610,7 @@ namespace itk
         bool flag = CalculateFirstSeedRadius( radius );
         if (!flag)
         {
-            std::cout<< "No Output Created from First Slice Radius Calculation";
+            itkWarningMacro(<< "No Output Created from First Slice Radius Calculation");
             return;
         }
         
@@ -1616,10 +1671,22 @@ namespace itk
         calculatedCentre.push_front( startSeed );
         
         //Call function to track the next cross-sections of vessel
+        m_NumberOfCrossSections = 0;
+        m_ModifiedRegion = OutputImageRegionType();
         RunNextCrossSection(calculatedRadius, calculatedCentre, calculatedEigenVecs);
         
+        if (this->GetAbortGenerateData())
+        {
+            m_AllCentresRadius.clear();
+            ProcessAborted e(__FILE__, __LINE__);
+            e.SetDescription("Process aborted.");
+            e.SetLocation(ITK_LOCATION);
+            throw e;
+        }
+        
         //Call function to make spherical label at all centres with known radius at the centre
         SmoothOutput();
+        this->UpdateProgress(1.0f);
     }
     
     /** Get the Centreline Image Output */
@@ -1641,6 +1708,7 @@ namespace itk
         
         os << indent << "Seed:  " << m_Seed << std::endl;
         os << indent << "DirectionSeed:  " << m_DirectionSeed << std::endl;
+        os << indent << "ModifiedRegion:  " << m_ModifiedRegion << std::endl;
     }
 }// end namespace
 
@@ -38,6 +38,8 @@
 #include "VesselSegmentationITKuseGPU.h"
 #include "itkImageToImageFilter.h"
 
+#include "itkExtractImageFilter.h"
+#include "itkShrinkImageFilter.h"
 #include "itkSigmoidImageFilter.h"
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkResampleImageFilter.h"
@@ -60,6 +62,10 @@ namespace itk
      * The filter will preprocess the input image data to obtain better
      * vessel segmentation results.
      *
+     * The input can have any scalar pixel type, for example the short pixels
+     * of a CT volume. The sigmoid pass reads the input directly and writes the
+     * pixel type of the output, so no converted copy of the input is made.
+     *
      *
      * \author Rahul P Kumar PhD, The Intervention Centre,
      *                            Oslo University Hospital, Norway.
@@ -87,8 +93,12 @@ namespace itk
         typedef typename Superclass::OutputImageType OutputImageType;
         typedef typename InputImageType::PixelType   InputPixelType;
         typedef typename OutputImageType::PixelType  OutputPixelType;
+        typedef typename InputImageType::RegionType  InputImageRegionType;
         typedef typename OutputImageType::RegionType OutputImageRegionType;
         
+        /** All passes after the sigmoid work on the output pixel type. */
+        typedef Image< OutputPixelType, TInputImage::ImageDimension > InternalImageType;
+        
         /** Image dimension = 3. */
         itkStaticConstMacro(ImageDimension, unsigned int,
                             InputImageType ::ImageDimension);
@@ -101,7 +111,7 @@ namespace itk
                      ImageToImageFilter);
 #ifdef ITK_USE_GPU
         /** Type for GPU image. */
-        typedef GPUImage< InputPixelType, itkGetStaticConstMacro(InputImageDimension) > GPUImageType;
+        typedef GPUImage< OutputPixelType, itkGetStaticConstMacro(InputImageDimension) > GPUImageType;
 #endif
         
         /** Set/Get macros for LowerThreshold */
@@ -128,6 +138,38 @@ namespace itk
         itkSetMacro(NumberOfIterations, unsigned int);
         itkGetConstMacro(NumberOfIterations, unsigned int);
         
+        /** Set/Get macros for ShrinkFactor
+         * When greater than 1 the input is downsampled by this factor before
+         * the sigmoid, and the output spacing is coarsened accordingly. Used
+         * to produce a quick preview of the preprocessing parameters.
+         */
+        itkSetClampMacro(ShrinkFactor, unsigned int, 1, NumericTraits<unsigned int>::max());
+        itkGetConstMacro(ShrinkFactor, unsigned int);
+        
+        /** Set/Get macros for RegionOfInterest
+         * When not empty only this region of the input is read. The output
+         * then only covers the region, on the grid the whole input would be
+         * resampled to and with the indices of that grid, so it can be pasted
+         * into an image of the UncroppedOutputRegion.
+         */
+        itkSetMacro(RegionOfInterest, InputImageRegionType);
+        itkGetConstReferenceMacro(RegionOfInterest, InputImageRegionType);
+        
+        /** Get macro for UncroppedOutputRegion
+         * The region of the output without a region of interest, available
+         * after the update.
+         */
+        itkGetConstReferenceMacro(UncroppedOutputRegion, OutputImageRegionType);
+        
+        /** Get macros for the stage being run
+         * The stages are sigmoid, diffusion and resample. An IterationEvent
+         * is invoked when each of them starts, and once more with an empty
+         * name when they are all done, so observers can time them. The
+         * number of pixels is the size of the image the stage processes.
+         */
+        itkGetStringMacro(StageName);
+        itkGetConstMacro(StageNumberOfPixels, SizeValueType);
+        
 #ifdef ITK_USE_CONCEPT_CHECKING
         // Begin concept checking
         itkConceptMacro( DoubleConvertibleToOutputCheck,
@@ -144,27 +186,32 @@ namespace itk
         /** Generate Data */
         void GenerateData(void) ITK_OVERRIDE;
         
+        /** Sets the stage being run and notifies the observers */
+        void StartStage(const char *stageName, SizeValueType numberOfPixels);
+        
     private:
         VesselSegmentationPreProcessingFilter(const Self &); //purposely not
         // implemented
         void operator=(const Self &);                        //purposely not
         // implemented
         
-        typedef itk::SigmoidImageFilter< InputImageType, InputImageType >                       SigmoidFilterType;
-        typedef itk::RescaleIntensityImageFilter< InputImageType, InputImageType >              RescaleFilterType;
+        typedef itk::ExtractImageFilter< InputImageType, InputImageType >                       ExtractFilterType;
+        typedef itk::ShrinkImageFilter< InputImageType, InputImageType >                        ShrinkFilterType;
+        typedef itk::SigmoidImageFilter< InputImageType, InternalImageType >                    SigmoidFilterType;
+        typedef itk::RescaleIntensityImageFilter< InternalImageType, InternalImageType >        RescaleFilterType;
 
 #ifdef  ITK_USE_GPU
         // Redefine the smoothing filter to use GPU & gpuimagetype
-        typedef itk::GPUGradientAnisotropicDiffusionImageFilter< InputImageType, GPUImageType > SmoothingFilterType;
+        typedef itk::GPUGradientAnisotropicDiffusionImageFilter< InternalImageType, GPUImageType > SmoothingFilterType;
 #else
-        typedef itk::GradientAnisotropicDiffusionImageFilter< InputImageType, InputImageType > SmoothingFilterType;
+        typedef itk::GradientAnisotropicDiffusionImageFilter< InternalImageType, InternalImageType > SmoothingFilterType;
 #endif
 
-        typedef itk::ResampleImageFilter< InputImageType, OutputImageType >                     ResampleFilterType;
+        typedef itk::ResampleImageFilter< InternalImageType, OutputImageType >                  ResampleFilterType;
         
         typedef itk::AffineTransform< double, 3 >  TransformType;
         
-        typedef itk::LinearInterpolateImageFunction< InputImageType, double >  InterpolatorType;
+        typedef itk::LinearInterpolateImageFunction< InternalImageType, double >  InterpolatorType;
         
         int m_LowerThreshold;
         int m_UpperThreshold;
@@ -173,6 +220,13 @@ namespace itk
         unsigned int m_Alpha;
         unsigned int m_Conductance;
         unsigned int m_NumberOfIterations;
+        unsigned int m_ShrinkFactor;
+        
+        InputImageRegionType  m_RegionOfInterest;
+        OutputImageRegionType m_UncroppedOutputRegion;
+        
+        std::string   m_StageName;
+        SizeValueType m_StageNumberOfPixels;
         
     };
 }  //end namespace itk
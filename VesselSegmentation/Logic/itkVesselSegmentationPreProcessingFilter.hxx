@@ -36,6 +36,9 @@
 #define itkVesselSegmentationPreProcessingFilter_hxx
 
 #include "itkVesselSegmentationPreProcessingFilter.h"
+#include "itkProgressAccumulator.h"
+
+#include <cmath>
 
 namespace itk
 {
@@ -54,34 +57,92 @@ namespace itk
         m_Conductance    = 20;
         
         m_NumberOfIterations = 30;
+        m_ShrinkFactor       = 1;
         
+        m_StageNumberOfPixels = 0;
     }
     
     template< typename TInputImage, typename TOutputImage >
     void VesselSegmentationPreProcessingFilter< TInputImage, TOutputImage >
-    ::GenerateData()
+    ::StartStage(const char *stageName, SizeValueType numberOfPixels)
     {
+        itkDebugMacro(<< "Stage " << stageName << " (" << numberOfPixels << " pixels)");
         
-        std::cout << "1/3: nonLinearIntensityRemap - Sigmoid" << std::endl;
+        m_StageName = stageName;
+        m_StageNumberOfPixels = numberOfPixels;
+        this->InvokeEvent( IterationEvent() );
+    }
+    
+    template< typename TInputImage, typename TOutputImage >
+    void VesselSegmentationPreProcessingFilter< TInputImage, TOutputImage >
+    ::GenerateData()
+    {
+        // the progress accumulator also forwards AbortGenerateData to the
+        // internal filters, so a running preprocessing can be cancelled
+        ProgressAccumulator::Pointer progress = ProgressAccumulator::New();
+        progress->SetMiniPipelineFilter(this);
         
         typename SigmoidFilterType::Pointer sigmoidFilter = SigmoidFilterType::New();
-        sigmoidFilter->SetInput( this->GetInput() );
+        
+        // only the region of interest is read, the extracted image keeps the
+        // indices and the origin of the input
+        const InputImageType *input = this->GetInput();
+        InputImageRegionType region = input->GetLargestPossibleRegion();
+        const bool cropped = m_RegionOfInterest.GetNumberOfPixels() > 0;
+        typename ExtractFilterType::Pointer extractFilter = ExtractFilterType::New();
+        if (cropped)
+        {
+            if (!region.Crop(m_RegionOfInterest))
+            {
+                itkExceptionMacro(<< "Region of interest " << m_RegionOfInterest
+                                  << " is outside of the input.");
+            }
+            extractFilter->SetInput( input );
+            extractFilter->SetExtractionRegion( region );
+            extractFilter->SetDirectionCollapseToSubmatrix();
+            input = extractFilter->GetOutput();
+        }
+        
+        // the shrink runs in the sigmoid stage
+        StartStage( "sigmoid", region.GetNumberOfPixels() );
+        
+        if (m_ShrinkFactor > 1)
+        {
+            itkDebugMacro(<< "0/3: ShrinkImage (factor " << m_ShrinkFactor << ")");
+            
+            typename ShrinkFilterType::Pointer shrinkFilter = ShrinkFilterType::New();
+            shrinkFilter->SetInput( input );
+            shrinkFilter->SetShrinkFactors( m_ShrinkFactor );
+            progress->RegisterInternalFilter( shrinkFilter, 0.05f );
+            sigmoidFilter->SetInput( shrinkFilter->GetOutput() );
+        }
+        else
+        {
+            sigmoidFilter->SetInput( input );
+        }
+        
+        // the sigmoid also converts the native input pixels to the output type
+        itkDebugMacro(<< "1/3: nonLinearIntensityRemap - Sigmoid");
+        
         sigmoidFilter->SetOutputMinimum( m_LowerThreshold );
         sigmoidFilter->SetOutputMaximum( m_UpperThreshold );
         sigmoidFilter->SetAlpha( m_Alpha );
         sigmoidFilter->SetBeta( m_Beta );
+        progress->RegisterInternalFilter( sigmoidFilter, 0.05f );
         
         typename RescaleFilterType::Pointer rescaleIntensity = RescaleFilterType::New();
         rescaleIntensity->SetInput( sigmoidFilter->GetOutput() );
         rescaleIntensity->SetOutputMinimum(0.0);
         rescaleIntensity->SetOutputMaximum(255.0);
+        progress->RegisterInternalFilter( rescaleIntensity, 0.05f );
         rescaleIntensity->Update();
-        typename InputImageType::Pointer remappedImage = rescaleIntensity->GetOutput();
+        typename InternalImageType::Pointer remappedImage = rescaleIntensity->GetOutput();
         
         
-        std::cout << "2/3: SmoothImage" << std::endl;
+        itkDebugMacro(<< "2/3: SmoothImage");
+        StartStage( "diffusion", remappedImage->GetLargestPossibleRegion().GetNumberOfPixels() );
         
-        const typename InputImageType::SpacingType& sp = remappedImage->GetSpacing();
+        const typename InternalImageType::SpacingType& sp = remappedImage->GetSpacing();
         double min_Spacing = sp[0];
         if (min_Spacing > sp[1])
         {
@@ -99,16 +160,18 @@ namespace itk
         smoothing->SetTimeStep( timeStep );
         smoothing->SetNumberOfIterations(  m_NumberOfIterations );
         smoothing->SetConductanceParameter( m_Conductance );
+        progress->RegisterInternalFilter( smoothing, m_ShrinkFactor > 1 ? 0.70f : 0.75f );
         
         typename RescaleFilterType::Pointer rescaleIntensity2 = RescaleFilterType::New();
         rescaleIntensity2->SetInput( smoothing->GetOutput() );
         rescaleIntensity2->SetOutputMinimum(0.0);
         rescaleIntensity2->SetOutputMaximum(255.0);
+        progress->RegisterInternalFilter( rescaleIntensity2, 0.05f );
         rescaleIntensity2->Update();
-        typename InputImageType::Pointer smoothedImage =  rescaleIntensity2->GetOutput();
+        typename InternalImageType::Pointer smoothedImage =  rescaleIntensity2->GetOutput();
         
         
-        std::cout << "3/3: ResampleImage" << std::endl;
+        itkDebugMacro(<< "3/3: ResampleImage");
         
         typename ResampleFilterType::Pointer resampleFilter = ResampleFilterType::New();
         typename TransformType::Pointer transform = TransformType::New();
@@ -119,30 +182,71 @@ namespace itk
         resampleFilter->SetInterpolator( interpolator );
         resampleFilter->SetDefaultPixelValue( NumericTraits<OutputPixelType>::ZeroValue() );
         
-        if (sp[2] > 1.5)
+        // the spacing cap scales with the shrink factor so a preview stays
+        // proportionally coarser than the full resolution result
+        if (sp[2] > 1.5 * m_ShrinkFactor)
         {
-            min_Spacing = 1.5;
+            min_Spacing = 1.5 * m_ShrinkFactor;
         }
         
-        typename InputImageType::SpacingType newSp;
+        typename InternalImageType::SpacingType newSp;
         newSp[0] = min_Spacing;
         newSp[1] = min_Spacing;
         newSp[2] = min_Spacing;
-        std::cout<<"original spacing :"<< sp << std::endl;
-        std::cout<<"new spacing      :"<< newSp << std::endl;
+        itkDebugMacro(<< "original spacing :" << sp);
+        itkDebugMacro(<< "new spacing      :" << newSp);
         resampleFilter->SetOutputSpacing( newSp );
         resampleFilter->SetOutputOrigin( smoothedImage->GetOrigin() );
         resampleFilter->SetOutputDirection( smoothedImage->GetDirection() );
         
-        typename InputImageType::SizeType   newSize;
+        typename InternalImageType::SizeType   newSize;
         newSize[0] = int( ( double(smoothedImage->GetLargestPossibleRegion().GetSize()[0]) * double(smoothedImage->GetSpacing()[0]) ) / double(newSp[0]) );  // number of pixels along X
         newSize[1] = int( ( double(smoothedImage->GetLargestPossibleRegion().GetSize()[1]) * double(smoothedImage->GetSpacing()[1]) ) / double(newSp[1]) );  // number of pixels along Y
         newSize[2] = int( ( double(smoothedImage->GetLargestPossibleRegion().GetSize()[2]) * double(smoothedImage->GetSpacing()[2]) ) / double(newSp[2]) );  // number of pixels along Z
         
-        std::cout<<"New Size : "<< newSize << std::endl;
+        itkDebugMacro(<< "New Size : " << newSize);
+        m_UncroppedOutputRegion.SetIndex( typename OutputImageRegionType::IndexType() );
+        m_UncroppedOutputRegion.SetSize( newSize );
+        
+        if (cropped)
+        {
+            // the grid of the whole input starts at its origin, the output
+            // takes the voxels of that grid whose centres are in the region
+            const typename InputImageType::SpacingType& inputSp = this->GetInput()->GetSpacing();
+            const typename InputImageType::PointType& inputOrigin = this->GetInput()->GetOrigin();
+            const InputImageRegionType& inputRegion = this->GetInput()->GetLargestPossibleRegion();
+            
+            typename OutputImageRegionType::IndexType newIndex;
+            for (unsigned int d = 0; d < ImageDimension; d++)
+            {
+                double scale = inputSp[d] / newSp[d];
+                newSize[d] = int( double(inputRegion.GetSize()[d]) * scale );
+                m_UncroppedOutputRegion.SetIndex( d, static_cast<IndexValueType>(
+                    std::ceil( inputRegion.GetIndex()[d] * scale ) ) );
+                m_UncroppedOutputRegion.SetSize( d, newSize[d] );
+                
+                IndexValueType lower = static_cast<IndexValueType>(
+                    std::ceil( region.GetIndex()[d] * scale ) );
+                IndexValueType upper = static_cast<IndexValueType>(
+                    std::floor( ( region.GetIndex()[d] + IndexValueType(region.GetSize()[d]) - 1 ) * scale ) );
+                newIndex[d] = lower;
+                newSize[d] = upper >= lower ? static_cast<SizeValueType>(upper - lower + 1) : 1;
+            }
+            
+            OutputImageRegionType newRegion( newIndex, newSize );
+            newRegion.Crop( m_UncroppedOutputRegion );
+            newSize = newRegion.GetSize();
+            itkDebugMacro(<< "Cropped Region : " << newRegion);
+            
+            resampleFilter->SetOutputOrigin( inputOrigin );
+            resampleFilter->SetOutputStartIndex( newRegion.GetIndex() );
+        }
+        
         resampleFilter->SetSize( newSize );
+        StartStage( "resample", static_cast<SizeValueType>(newSize[0]) * newSize[1] * newSize[2] );
         
         resampleFilter->SetInput( smoothedImage );
+        progress->RegisterInternalFilter( resampleFilter, 0.10f );
         resampleFilter->Update();
         
         // Allocate the output
@@ -157,7 +261,8 @@ namespace itk
         this->GraftOutput( resampleFilter->GetOutput() );
         //this->GraftOutput(rescaleIntensity2->GetOutput());
         
-        std::cout<<std::endl<<"Done PreProcessing."<<std::endl;
+        StartStage( "", 0 );
+        itkDebugMacro(<< "Done PreProcessing.");
     }
     
     template< typename TInputImage, typename TOutputImage >
@@ -172,6 +277,8 @@ namespace itk
         os << indent << "Beta:  " << m_Beta  << std::endl;
         os << indent << "Conductance:  " << m_Conductance  << std::endl;
         os << indent << "NumberOfIterations:  " << m_NumberOfIterations  << std::endl;
+        os << indent << "ShrinkFactor:  " << m_ShrinkFactor  << std::endl;
+        os << indent << "RegionOfInterest:  " << m_RegionOfInterest  << std::endl;
     }
 }  // end namespace itk
 #endif
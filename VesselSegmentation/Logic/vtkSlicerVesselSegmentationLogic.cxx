@@ -37,6 +37,10 @@
 #include "vtkSlicerVesselSegmentationLogic.h"
 #include "vtkMRMLVesselSegmentationSeedNode.h"
 #include "itkVesselSegmentationPreProcessingFilter.h"
+#include "vtkVesselSegmentationBrickMesher.h"
+#include "vtkVesselSegmentationLabelHistory.h"
+#include "vtkVesselSegmentationMetrics.h"
+#include "vtkVesselSegmentationMemoryManager.h"
 
 // MRML includes
 #include <vtkMRMLScene.h>
@@ -52,6 +56,10 @@
 #include <vtkMRMLModelNode.h>
 #include <vtkMRMLModelDisplayNode.h>
 #include <vtkMRMLDisplayNode.h>
+#include <vtkMRMLDisplayableNode.h>
+
+// Slicer includes
+#include <vtkSlicerApplicationLogic.h>
 
 // VTK includes
 #include <vtkIntArray.h>
@@ -62,47 +70,2139 @@
 #include <vtkImageData.h>
 #include <vtkImageThreshold.h>
 
-#include <vtkImageToStructuredPoints.h>
-#include <vtkMarchingCubes.h>
-#include <vtkDiscreteMarchingCubes.h>
-#include <vtkWindowedSincPolyDataFilter.h>
-#include <vtkTransformPolyDataFilter.h>
-#include <vtkTransform.h>
-#include <vtkImageBlend.h>
-#include <vtkXMLImageDataWriter.h>
-#include <vtkImageCast.h>
+#include <vtkMarchingCubes.h>
+#include <vtkImageBlend.h>
+#include <vtkXMLImageDataWriter.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkAlgorithm.h>
+#include <vtkPolyData.h>
+#include <vtkTypeTraits.h>
+
+#include <vtkRenderWindow.h>
+#include <vtkRendererCollection.h>
+
+#include <vtkMRMLViewNode.h>
+
+#include <qSlicerApplication.h>
+#include <qSlicerLayoutManager.h>
+#include <qMRMLThreeDWidget.h>
+#include <qMRMLThreeDView.h>
+
+// ITK includes
+#include <itkImageFileWriter.h>
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkExtractImageFilter.h>
+#include <itkOrImageFilter.h>
+#include <itkCastImageFilter.h>
+#include <itkSigmoidImageFilter.h>
+#include <itkAddImageFilter.h>
+#include <itkBinaryBallStructuringElement.h>
+#include <itkConnectedComponentImageFilter.h>
+#include <itkLabelImageToShapeLabelMapFilter.h>
+#include <itkPoint.h>
+#include <itkTimeProbe.h>
+#include <itkCommand.h>
+#include <itkProcessObject.h>
+
+// STD includes
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkSlicerVesselSegmentationLogic);
+
+typedef itk::SeedVesselSegmentationImageFilter<vtkVesselSegmentationHelper::SeedImageType,
+    vtkVesselSegmentationHelper::LabelImageType>  SeedFilterType;
+
+//----------------------------------------------------------------------------
+/**
+ * Records the sigmoid, diffusion and resample stages of a preprocessing
+ * filter in the metrics, from the IterationEvent the filter invokes when it
+ * starts each of them.
+ */
+template<class TFilter>
+class PreprocessingStageCommand : public itk::Command
+{
+public:
+  typedef PreprocessingStageCommand Self;
+  typedef itk::SmartPointer<Self> Pointer;
+  itkNewMacro(Self);
+
+  void SetMetrics(vtkVesselSegmentationMetrics *metrics)
+  {
+    this->Metrics = metrics;
+  }
+
+  virtual void Execute(itk::Object *caller, const itk::EventObject &event)
+  {
+    this->Execute(const_cast<const itk::Object*>(caller), event);
+  }
+
+  virtual void Execute(const itk::Object *caller, const itk::EventObject &event)
+  {
+    const TFilter *filter = dynamic_cast<const TFilter*>(caller);
+    if (filter == NULL || !itk::IterationEvent().CheckEvent(&event))
+      {
+      return;
+      }
+
+    // a stage ends when the next one starts
+    this->Probe.Stop(this->NumberOfPixels);
+    this->NumberOfPixels = filter->GetStageNumberOfPixels();
+    const char *stage = filter->GetStageName();
+    if (stage && *stage)
+      {
+      this->Probe.Start(this->Metrics, stage);
+      }
+  }
+
+protected:
+  PreprocessingStageCommand() : NumberOfPixels(0) {}
+
+private:
+  vtkSmartPointer<vtkVesselSegmentationMetrics> Metrics;
+  vtkVesselSegmentationMetrics::Probe Probe;
+  itk::SizeValueType NumberOfPixels;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Sets up the preprocessing filter for the pixel type of the input, so the
+ * input is read in its own type and only the output is float. Called through
+ * vtkVesselSegmentationTemplateMacro with a null pointer of the pixel type.
+ */
+struct PreprocessingFilterSetup
+{
+  PreprocessingFilterSetup(vtkVesselSegmentationHelper::NativeImageType *input,
+                           int lowerThreshold, int upperThreshold, unsigned int alpha,
+                           int beta, unsigned int conductance, unsigned int iterations,
+                           unsigned int shrinkFactor)
+    : Input(input)
+    , LowerThreshold(lowerThreshold)
+    , UpperThreshold(upperThreshold)
+    , Alpha(alpha)
+    , Beta(beta)
+    , Conductance(conductance)
+    , Iterations(iterations)
+    , ShrinkFactor(shrinkFactor)
+    , Metrics(NULL)
+    , UncroppedRegion(NULL)
+  {
+  }
+
+  template<class TPixel> void operator()(TPixel*)
+  {
+    typedef itk::Image<TPixel, 3> InputImageType;
+    typedef itk::VesselSegmentationPreProcessingFilter<InputImageType,
+        vtkVesselSegmentationHelper::SeedImageType> FilterType;
+
+    typename FilterType::Pointer filter = FilterType::New();
+    filter->SetInput(dynamic_cast<InputImageType*>(this->Input));
+    filter->SetLowerThreshold(this->LowerThreshold);
+    filter->SetUpperThreshold(this->UpperThreshold);
+    filter->SetAlpha(this->Alpha);
+    filter->SetBeta(this->Beta);
+    filter->SetConductance(this->Conductance);
+    filter->SetNumberOfIterations(this->Iterations);
+    filter->SetShrinkFactor(this->ShrinkFactor);
+
+    // a region covering the whole input is not cropped
+    if (this->Region.GetNumberOfPixels() > 0 &&
+        this->Region != this->Input->GetLargestPossibleRegion())
+      {
+      filter->SetRegionOfInterest(this->Region);
+      }
+
+    if (this->Metrics && this->Metrics->GetEnabled())
+      {
+      typedef PreprocessingStageCommand<FilterType> StageCommandType;
+      typename StageCommandType::Pointer stageCommand = StageCommandType::New();
+      stageCommand->SetMetrics(this->Metrics);
+      filter->AddObserver(itk::IterationEvent(), stageCommand);
+      }
+
+    this->Filter = filter.GetPointer();
+    this->Output = filter->GetOutput();
+    this->UncroppedRegion = &filter->GetUncroppedOutputRegion();
+  }
+
+  vtkVesselSegmentationHelper::NativeImageType *Input;
+  int LowerThreshold;
+  int UpperThreshold;
+  unsigned int Alpha;
+  int Beta;
+  unsigned int Conductance;
+  unsigned int Iterations;
+  unsigned int ShrinkFactor;
+
+  // the stages of the filter are recorded here if set
+  vtkVesselSegmentationMetrics *Metrics;
+
+  // only this region of the input is preprocessed if set
+  vtkVesselSegmentationHelper::NativeImageType::RegionType Region;
+
+  itk::ProcessObject::Pointer Filter;
+  vtkVesselSegmentationHelper::SeedImageType::Pointer Output;
+
+  // region of the output without cropping, held by the filter and set once it has run
+  const vtkVesselSegmentationHelper::SeedImageType::RegionType *UncroppedRegion;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Extracts a region of the input as a float image, which keeps the indices of
+ * the input. Called like PreprocessingFilterSetup, for a volume that is
+ * segmented without preprocessing.
+ */
+struct ExtractRegionSetup
+{
+  ExtractRegionSetup(vtkVesselSegmentationHelper::NativeImageType *input,
+                     const vtkVesselSegmentationHelper::SeedImageType::RegionType &region)
+    : Input(input)
+    , Region(region)
+  {
+  }
+
+  template<class TPixel> void operator()(TPixel*)
+  {
+    typedef itk::Image<TPixel, 3> InputImageType;
+    typedef itk::ExtractImageFilter<InputImageType,
+        vtkVesselSegmentationHelper::SeedImageType> FilterType;
+
+    typename FilterType::Pointer filter = FilterType::New();
+    filter->SetInput(dynamic_cast<InputImageType*>(this->Input));
+    filter->SetExtractionRegion(this->Region);
+    filter->SetDirectionCollapseToSubmatrix();
+    filter->Update();
+
+    this->Output = filter->GetOutput();
+    this->Output->DisconnectPipeline();
+  }
+
+  vtkVesselSegmentationHelper::NativeImageType *Input;
+  vtkVesselSegmentationHelper::SeedImageType::RegionType Region;
+  vtkVesselSegmentationHelper::SeedImageType::Pointer Output;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Grows region to the bounding region of region and other. Empty regions
+ * are ignored.
+ */
+static void UnionLabelRegion(vtkVesselSegmentationHelper::LabelImageType::RegionType &region,
+                             const vtkVesselSegmentationHelper::LabelImageType::RegionType &other)
+{
+  if (other.GetNumberOfPixels() == 0)
+    {
+    return;
+    }
+  if (region.GetNumberOfPixels() == 0)
+    {
+    region = other;
+    return;
+    }
+
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    itk::IndexValueType lower = std::min(region.GetIndex(d), other.GetIndex(d));
+    itk::IndexValueType upper = std::max(
+        region.GetIndex(d) + static_cast<itk::IndexValueType>(region.GetSize(d)),
+        other.GetIndex(d) + static_cast<itk::IndexValueType>(other.GetSize(d)));
+    region.SetIndex(d, lower);
+    region.SetSize(d, static_cast<itk::SizeValueType>(upper - lower));
+    }
+}
+
+//----------------------------------------------------------------------------
+// labels of the vessel mesher, which are also the indices of its outputs
+enum
+{
+  HepaticMesherLabel = 0,
+  PortalMesherLabel = 1
+};
+
+//----------------------------------------------------------------------------
+// indices of the label maps in the undo history
+enum
+{
+  HepaticHistoryLabelMap = 0,
+  PortalHistoryLabelMap = 1,
+  NumberOfHistoryLabelMaps = 2
+};
+
+//----------------------------------------------------------------------------
+// images the memory manager maps, as bits of the images used by a job
+enum
+{
+  PreprocessedMappedImage = 0,
+  HepaticMappedImage = 1,
+  PortalMappedImage = 2,
+  MergedMappedImage = 3,
+  NumberOfMappedImages = 4
+};
+
+static const char *MappedImageNames[NumberOfMappedImages] =
+  { "preprocessed", "hepatic", "portal", "merged" };
+
+//----------------------------------------------------------------------------
+/**
+ * Copies region of a label map into an image holding only that region, to
+ * keep the values that an edit in place overwrites.
+ */
+static vtkVesselSegmentationHelper::LabelImageType::Pointer CopyLabelRegion(
+    const vtkVesselSegmentationHelper::LabelImageType *image,
+    const vtkVesselSegmentationHelper::LabelImageType::RegionType &region)
+{
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+  LabelImageType::Pointer copy = LabelImageType::New();
+  copy->CopyInformation(image);
+  copy->SetRegions(region);
+  copy->Allocate();
+
+  itk::ImageRegionConstIterator<LabelImageType> itImage(image, region);
+  itk::ImageRegionIterator<LabelImageType> itCopy(copy, region);
+  for(itImage.GoToBegin(), itCopy.GoToBegin(); !itCopy.IsAtEnd(); ++itImage, ++itCopy)
+    {
+    itCopy.Set(itImage.Get());
+    }
+  return copy;
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Label map of region holding the voxels of image that fall inside it, zero
+ * elsewhere. A label map computed before the region of interest changed is
+ * moved onto the region of the new preprocessed image this way.
+ */
+static vtkVesselSegmentationHelper::LabelImageType::Pointer ResizeLabelRegion(
+    const vtkVesselSegmentationHelper::LabelImageType *image,
+    const vtkVesselSegmentationHelper::LabelImageType::RegionType &region)
+{
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+  LabelImageType::Pointer resized = LabelImageType::New();
+  resized->CopyInformation(image);
+  resized->SetRegions(region);
+  resized->Allocate();
+  resized->FillBuffer(0);
+
+  LabelImageType::RegionType shared = region;
+  if (!shared.Crop(image->GetBufferedRegion()))
+    {
+    return resized;
+    }
+
+  itk::ImageRegionConstIterator<LabelImageType> itImage(image, shared);
+  itk::ImageRegionIterator<LabelImageType> itResized(resized, shared);
+  for(itImage.GoToBegin(), itResized.GoToBegin(); !itResized.IsAtEnd(); ++itImage, ++itResized)
+    {
+    itResized.Set(itImage.Get());
+    }
+  return resized;
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Marks region of a label map as changed for a label of mesher. The VTK
+ * images of the label maps index their voxels like the ITK images.
+ */
+static void AddModifiedLabelRegion(vtkVesselSegmentationBrickMesher *mesher, int label,
+                                   const vtkVesselSegmentationHelper::LabelImageType::RegionType &region)
+{
+  if (region.GetNumberOfPixels() == 0)
+    {
+    return;
+    }
+
+  int extent[6];
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    extent[2*d] = static_cast<int>(region.GetIndex(d));
+    extent[2*d+1] = static_cast<int>(region.GetIndex(d) + region.GetSize(d)) - 1;
+    }
+  mesher->AddModifiedExtent(label, extent);
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Region of the voxels of a volume node. The images cropped to the region of
+ * interest keep these indices.
+ */
+static vtkVesselSegmentationHelper::LabelImageType::RegionType GetVolumeRegion(vtkMRMLVolumeNode *volume)
+{
+  vtkVesselSegmentationHelper::LabelImageType::RegionType region;
+  if (volume == NULL || volume->GetImageData() == NULL)
+    {
+    return region;
+    }
+
+  int *extent = volume->GetImageData()->GetExtent();
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    region.SetIndex(d, extent[2*d]);
+    region.SetSize(d, extent[2*d+1] >= extent[2*d] ?
+                   static_cast<itk::SizeValueType>(extent[2*d+1] - extent[2*d] + 1) : 0);
+    }
+  return region;
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Copies region of an image into image data of the same scalar type, whose
+ * extent holds the indices of the image. The parts of the region outside of
+ * the extent are skipped.
+ */
+template<class TImage>
+static void PasteImageRegion(vtkImageData *imageData, const TImage *image,
+                             const typename TImage::RegionType &region)
+{
+  typedef typename TImage::PixelType PixelType;
+  if (imageData->GetScalarType() != vtkTypeTraits<PixelType>::VTKTypeID() ||
+      imageData->GetNumberOfScalarComponents() != 1)
+    {
+    return;
+    }
+
+  typename TImage::RegionType extentRegion;
+  int *extent = imageData->GetExtent();
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    extentRegion.SetIndex(d, extent[2*d]);
+    extentRegion.SetSize(d, extent[2*d+1] >= extent[2*d] ?
+                         static_cast<itk::SizeValueType>(extent[2*d+1] - extent[2*d] + 1) : 0);
+    }
+
+  typename TImage::RegionType pasted = region;
+  if (!pasted.Crop(extentRegion) || !pasted.Crop(image->GetBufferedRegion()))
+    {
+    return;
+    }
+
+  // one row at a time, the rows are contiguous on both sides
+  const size_t rowSize = pasted.GetSize(0) * sizeof(PixelType);
+  typename TImage::IndexType index = pasted.GetIndex();
+  for (itk::SizeValueType k = 0; k < pasted.GetSize(2); k++)
+    {
+    index[2] = pasted.GetIndex(2) + static_cast<itk::IndexValueType>(k);
+    for (itk::SizeValueType j = 0; j < pasted.GetSize(1); j++)
+      {
+      index[1] = pasted.GetIndex(1) + static_cast<itk::IndexValueType>(j);
+      std::memcpy(imageData->GetScalarPointer(static_cast<int>(index[0]), static_cast<int>(index[1]),
+                                              static_cast<int>(index[2])),
+                  image->GetBufferPointer() + image->ComputeOffset(index), rowSize);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Converts an image made by a job to the image data of a node of the scene.
+ * An image cropped to the region of interest is pasted into image data of the
+ * whole region, which is zero elsewhere. Any other image shares its buffer.
+ */
+template<class TImage>
+static vtkSmartPointer<vtkImageData> ConvertToNodeImageData(TImage *image,
+                                                            const typename TImage::RegionType &wholeRegion)
+{
+  if (wholeRegion.GetNumberOfPixels() == 0 || image->GetBufferedRegion() == wholeRegion)
+    {
+    return vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(typename TImage::Pointer(image));
+    }
+
+  int extent[6];
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    extent[2*d] = static_cast<int>(wholeRegion.GetIndex(d));
+    extent[2*d+1] = static_cast<int>(wholeRegion.GetIndex(d) + wholeRegion.GetSize(d)) - 1;
+    }
+
+  vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+  imageData->SetExtent(extent);
+  imageData->AllocateScalars(vtkTypeTraits<typename TImage::PixelType>::VTKTypeID(), 1);
+  std::memset(imageData->GetScalarPointer(), 0,
+              static_cast<size_t>(imageData->GetNumberOfPoints()) * sizeof(typename TImage::PixelType));
+  PasteImageRegion(imageData.GetPointer(), image, image->GetBufferedRegion());
+  return imageData;
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Shows the changes to region of a label image in its node. The node shares
+ * the buffer of an uncropped image, a cropped one is pasted into it.
+ */
+static void UpdateLabelMapRegion(vtkMRMLLabelMapVolumeNode *labelMap,
+                                 const vtkVesselSegmentationHelper::LabelImageType *image,
+                                 const vtkVesselSegmentationHelper::LabelImageType::RegionType &region)
+{
+  if (labelMap == NULL || labelMap->GetImageData() == NULL)
+    {
+    return;
+    }
+
+  vtkImageData *imageData = labelMap->GetImageData();
+  if (image != NULL &&
+      imageData->GetScalarPointer() != static_cast<const void*>(image->GetBufferPointer()))
+    {
+    PasteImageRegion(imageData, image, region);
+    }
+  imageData->Modified();
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Image data of a label map for the mesher. A label image cropped to the
+ * region of interest is meshed in its own extent, so the bricks outside of the
+ * region are not visited. Otherwise the image data of the node is shallow
+ * copied, so the worker never touches the pipeline information of the data
+ * shown in the scene.
+ */
+static vtkSmartPointer<vtkImageData> GetMesherInput(vtkMRMLLabelMapVolumeNode *labelMap,
+                                                    vtkVesselSegmentationHelper::LabelImageType *image)
+{
+  vtkSmartPointer<vtkImageData> imageData;
+  if (labelMap == NULL || labelMap->GetImageData() == NULL)
+    {
+    return vtkSmartPointer<vtkImageData>::New();
+    }
+
+  if (image != NULL && image->GetLargestPossibleRegion() != GetVolumeRegion(labelMap))
+    {
+    imageData = vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(
+        vtkVesselSegmentationHelper::LabelImageType::Pointer(image));
+    }
+  if (imageData == NULL)
+    {
+    imageData = vtkSmartPointer<vtkImageData>::New();
+    imageData->ShallowCopy(labelMap->GetImageData());
+    }
+  return imageData;
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Base of the units of work run by the logic. Prepare and Apply are called on
+ * the main thread and are the only places where the MRML scene is accessed.
+ * Execute is called on the worker thread (or straight after Prepare when the
+ * logic is synchronous) and only works on ITK and VTK data.
+ */
+class vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  Job(const char *name, bool preprocessing = false)
+    : Name(name)
+    , Preprocessing(preprocessing)
+    , State(JobQueued)
+    , UsedImages(0)
+    , Finished(false)
+    , Succeeded(false)
+    , Aborted(false)
+    , Progress(0.0)
+    , NotifiedProgress(0.0)
+    , StageStart(0.0)
+    , StageWeight(0.0)
+    , FilterObserverTag(0)
+    , AlgorithmObserverTag(0)
+  {
+    this->Lock = vtkSmartPointer<vtkMutexLock>::New();
+
+    this->ITKProgressCommand = ITKProgressCommandType::New();
+    this->ITKProgressCommand->SetCallbackFunction(this, &Job::OnITKProgress);
+
+    this->VTKProgressCommand = vtkSmartPointer<vtkCallbackCommand>::New();
+    this->VTKProgressCommand->SetCallback(Job::OnVTKProgress);
+    this->VTKProgressCommand->SetClientData(this);
+  }
+
+  virtual ~Job() {}
+
+  /**
+   * Main thread: gathers the input of the job from the logic and the scene.
+   *
+   * @return false (after reporting the error) if the job cannot run.
+   */
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic) = 0;
+
+  /**
+   * Worker thread: does the computation, only ITK and VTK data may be used.
+   *
+   * @return false if the job did not produce a result.
+   */
+  virtual bool Execute() = 0;
+
+  /**
+   * Main thread: writes the result of the job to the logic and the scene.
+   */
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic) = 0;
+
+  /**
+   * Main thread: called instead of Apply when the job was cancelled or failed.
+   */
+  virtual void Discard(vtkSlicerVesselSegmentationLogic *vtkNotUsed(logic)) {}
+
+  /**
+   * Asks the running filter to stop, can be called from any thread.
+   */
+  void Abort()
+  {
+    this->Lock->Lock();
+    this->Aborted = true;
+    if (this->ActiveFilter.IsNotNull())
+      {
+      this->ActiveFilter->AbortGenerateDataOn();
+      }
+    if (this->ActiveAlgorithm)
+      {
+      this->ActiveAlgorithm->AbortExecuteOn();
+      }
+    this->Lock->Unlock();
+  }
+
+  bool IsAborted()
+  {
+    this->Lock->Lock();
+    bool aborted = this->Aborted;
+    this->Lock->Unlock();
+    return aborted;
+  }
+
+  bool IsFinished()
+  {
+    this->Lock->Lock();
+    bool finished = this->Finished;
+    this->Lock->Unlock();
+    return finished;
+  }
+
+  bool HasSucceeded()
+  {
+    this->Lock->Lock();
+    bool succeeded = this->Succeeded;
+    this->Lock->Unlock();
+    return succeeded;
+  }
+
+  double GetProgress()
+  {
+    this->Lock->Lock();
+    double progress = this->Progress;
+    this->Lock->Unlock();
+    return progress;
+  }
+
+  std::string GetErrorMessage()
+  {
+    this->Lock->Lock();
+    std::string message = this->ErrorMessage;
+    this->Lock->Unlock();
+    return message;
+  }
+
+  void SetFinished(bool succeeded, const std::string &errorMessage)
+  {
+    this->Lock->Lock();
+    this->Finished = true;
+    this->Succeeded = succeeded;
+    this->ErrorMessage = errorMessage;
+    this->Lock->Unlock();
+  }
+
+  std::string Name;
+  bool Preprocessing;
+
+  // only used on the main thread
+  int State;
+
+  // set when the job runs in the worker thread, to get back to the main thread
+  vtkSmartPointer<vtkSlicerApplicationLogic> AppLogic;
+  vtkSmartPointer<vtkObject> Notifier;
+
+  // where the stages of the job are recorded, set when the job is submitted
+  vtkSmartPointer<vtkVesselSegmentationMetrics> Metrics;
+
+  // maps the images made by the job, set when the job is submitted
+  vtkSmartPointer<vtkVesselSegmentationMemoryManager> MemoryManager;
+
+  /**
+   * Main thread: marks the images read by the job as used, so they are the
+   * last ones spilled and their pages are read back ahead of the job.
+   */
+  void TouchUsedImages()
+  {
+    for (int i = 0; i < NumberOfMappedImages; ++i)
+      {
+      if (this->UsedImages & (1 << i))
+        {
+        this->MemoryManager->Touch(MappedImageNames[i]);
+        }
+      }
+  }
+
+protected:
+  // bits of the mapped images read by the job
+  int UsedImages;
+
+  /**
+   * Starts a stage of the computation, the progress of the filter accounts
+   * for the given fraction of the progress of the job.
+   */
+  void BeginStage(itk::ProcessObject *filter, double weight)
+  {
+    this->Lock->Lock();
+    this->ActiveFilter = filter;
+    this->StageWeight = weight;
+    if (this->Aborted)
+      {
+      filter->AbortGenerateDataOn();
+      }
+    this->Lock->Unlock();
+    this->FilterObserverTag = filter->AddObserver(itk::ProgressEvent(), this->ITKProgressCommand);
+  }
+
+  void BeginStage(vtkAlgorithm *algorithm, double weight)
+  {
+    this->Lock->Lock();
+    this->ActiveAlgorithm = algorithm;
+    this->StageWeight = weight;
+    if (this->Aborted)
+      {
+      algorithm->AbortExecuteOn();
+      }
+    this->Lock->Unlock();
+    this->AlgorithmObserverTag = algorithm->AddObserver(vtkCommand::ProgressEvent, this->VTKProgressCommand);
+  }
+
+  /**
+   * Starts a stage of the computation that reports its own progress through
+   * UpdateStageProgress.
+   */
+  void BeginStage(double weight)
+  {
+    this->Lock->Lock();
+    this->StageWeight = weight;
+    this->Lock->Unlock();
+  }
+
+  void EndStage()
+  {
+    this->UpdateStageProgress(1.0);
+
+    this->Lock->Lock();
+    if (this->ActiveFilter.IsNotNull())
+      {
+      this->ActiveFilter->RemoveObserver(this->FilterObserverTag);
+      this->ActiveFilter = NULL;
+      }
+    if (this->ActiveAlgorithm)
+      {
+      this->ActiveAlgorithm->RemoveObserver(this->AlgorithmObserverTag);
+      this->ActiveAlgorithm = NULL;
+      }
+    this->StageStart += this->StageWeight;
+    this->StageWeight = 0.0;
+    this->Lock->Unlock();
+  }
+
+  void UpdateStageProgress(double stageProgress)
+  {
+    bool notify = false;
+
+    this->Lock->Lock();
+    this->Progress = this->StageStart + this->StageWeight * stageProgress;
+    // do not flood the main thread, one notification per percent is plenty
+    if (this->Progress - this->NotifiedProgress >= 0.01)
+      {
+      this->NotifiedProgress = this->Progress;
+      notify = true;
+      }
+    this->Lock->Unlock();
+
+    if (notify && this->AppLogic)
+      {
+      this->AppLogic->RequestModified(this->Notifier);
+      }
+  }
+
+  void OnITKProgress(itk::Object *caller, const itk::EventObject &vtkNotUsed(event))
+  {
+    itk::ProcessObject *filter = dynamic_cast<itk::ProcessObject*>(caller);
+    if (filter)
+      {
+      this->UpdateStageProgress(filter->GetProgress());
+      }
+  }
+
+  static void OnVTKProgress(vtkObject *vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                            void *clientData, void *callData)
+  {
+    Job *self = static_cast<Job*>(clientData);
+    double *progress = static_cast<double*>(callData);
+    if (self && progress)
+      {
+      self->UpdateStageProgress(*progress);
+      }
+  }
+
+private:
+  typedef itk::MemberCommand<Job> ITKProgressCommandType;
+
+  vtkSmartPointer<vtkMutexLock> Lock;
+
+  // guarded by the lock
+  bool Finished;
+  bool Succeeded;
+  bool Aborted;
+  std::string ErrorMessage;
+  double Progress;
+  double NotifiedProgress;
+  double StageStart;
+  double StageWeight;
+  itk::ProcessObject::Pointer ActiveFilter;
+  vtkSmartPointer<vtkAlgorithm> ActiveAlgorithm;
+
+  ITKProgressCommandType::Pointer ITKProgressCommand;
+  vtkSmartPointer<vtkCallbackCommand> VTKProgressCommand;
+  unsigned long FilterObserverTag;
+  unsigned long AlgorithmObserverTag;
+
+  Job(const Job&); // Not implemented
+  void operator=(const Job&); // Not implemented
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Runs the preprocessing filter on the active volume, or on the voxels of it
+ * in the region of interest. The preview path fills in the input and the
+ * region itself, and updates the preview node instead of adding one.
+ */
+class vtkSlicerVesselSegmentationLogic::PreprocessingJob : public vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  PreprocessingJob(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta,
+                   unsigned int conductance, unsigned int iterations, bool preview)
+    : Job("Preprocessing", true)
+    , LowerThreshold(lowerThreshold)
+    , UpperThreshold(upperThreshold)
+    , Alpha(alpha)
+    , Beta(beta)
+    , Conductance(conductance)
+    , Iterations(iterations)
+    , Preview(preview)
+    , Time(0.0)
+    , InputScalarType(VTK_VOID)
+  {
+  }
+
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    // the preview has already converted its input
+    if (this->Input.IsNotNull())
+      {
+      return true;
+      }
+
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = logic->GetActiveVolume();
+
+    // check have valid activevol
+    if (!activeVol)
+      {
+      vtkErrorWithObjectMacro(logic, "PreprocessImage: could not get active volume.")
+      return false;
+      }
+
+    // check again for the mrml scene, since used explicitly in Apply
+    if (!logic->GetMRMLScene())
+      {
+      vtkErrorWithObjectMacro(logic, "No MRML scene.");
+      return false;
+      }
+
+    // shares the buffer of the node in its own scalar type, which it keeps
+    // alive; the filter casts to float in its first pass
+    vtkVesselSegmentationMetrics::Probe importProbe;
+    importProbe.Start(this->Metrics, "import");
+    this->InputScalarType = activeVol->GetImageData() ?
+        activeVol->GetImageData()->GetScalarType() : VTK_VOID;
+    this->Input = vtkVesselSegmentationHelper::ConvertVolumeNodeToNativeItkImage(activeVol);
+    if (this->Input.IsNull() == true )
+      {
+      vtkErrorWithObjectMacro(logic, "PreprocessImage: conversion to ITK not successful.")
+      return false;
+      }
+    importProbe.Stop(this->Input->GetLargestPossibleRegion().GetNumberOfPixels());
+
+    if (!logic->ComputeRegionOfInterest(activeVol, this->Region))
+      {
+      return false;
+      }
+
+    return true;
+  }
+
+  virtual bool Execute()
+  {
+    // Create a vesselness Filter for the pixel type of the input
+    PreprocessingFilterSetup setup(this->Input, this->LowerThreshold, this->UpperThreshold,
+                                   this->Alpha, this->Beta, this->Conductance,
+                                   this->Iterations, 1);
+    setup.Metrics = this->Metrics;
+    setup.Region = this->Region;
+    switch (this->InputScalarType)
+      {
+      vtkVesselSegmentationTemplateMacro(setup(static_cast<VTK_TT*>(NULL)));
+      default:
+        std::cerr << "PreprocessImage: scalar type of the volume is not supported."
+                  << std::endl;
+        return false;
+      }
+
+    // pass everything into function
+    this->BeginStage(setup.Filter, 1.0);
+    itk::TimeProbe clock1;
+    clock1.Start();
+    setup.Filter->Update();
+    clock1.Stop();
+    this->EndStage();
+    this->Time = clock1.GetMean();
+
+    this->Output = setup.Output;
+    this->Output->ReleaseDataFlagOff();
+    this->Output->DisconnectPipeline();
+    this->UncroppedRegion = *setup.UncroppedRegion;
+
+    if (this->Preview)
+      {
+      return true;
+      }
+
+    this->Output = this->MemoryManager->MapImage(this->Output.GetPointer(),
+                                                 MappedImageNames[PreprocessedMappedImage]);
+
+    // the VTK image shares the output buffer and keeps it alive, so it stays
+    // valid when more than one preprocessed image is made; a cropped output
+    // is pasted into an image of the whole volume instead
+    this->OutputData = ConvertToNodeImageData(this->Output.GetPointer(), this->UncroppedRegion);
+
+    return true;
+  }
+
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkDebugWithObjectMacro(logic, "Time taken for PreProcessing : " << this->Time << "sec\n" );
+
+    logic->preprocessedImg = this->Output;
+
+    if (this->Preview)
+      {
+      // replaces the low resolution preview
+      logic->UpdatePreprocessedNode(this->Output, this->UncroppedRegion);
+      return;
+      }
+
+    if (this->OutputData == NULL)
+      {
+      vtkErrorWithObjectMacro(logic, "PreprocessImage: conversion to VTK not successful.")
+      return;
+      }
+
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> preprocessedNode =
+        vtkVesselSegmentationHelper::ConvertVtkImageDataToVolumeNode(this->OutputData, this->Output, true);
+
+    preprocessedNode->SetName("preprocessedImage");
+    logic->GetMRMLScene()->AddNode(preprocessedNode);
+  }
+
+  vtkVesselSegmentationHelper::NativeImageType::Pointer Input;
+  int InputScalarType;
+
+  // voxels of the input that are preprocessed
+  vtkVesselSegmentationHelper::NativeImageType::RegionType Region;
+
+private:
+  int LowerThreshold;
+  int UpperThreshold;
+  unsigned int Alpha;
+  int Beta;
+  unsigned int Conductance;
+  unsigned int Iterations;
+  bool Preview;
+
+  double Time;
+  vtkVesselSegmentationHelper::SeedImageType::Pointer Output;
+  vtkVesselSegmentationHelper::SeedImageType::RegionType UncroppedRegion;
+  vtkSmartPointer<vtkImageData> OutputData;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Traces a hepatic or portal vessel from a pair of seeds. The seeds are copied
+ * when the job is created, since the seed node is removed straight after.
+ */
+class vtkSlicerVesselSegmentationLogic::SegmentationJob : public vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  SegmentationJob(vtkMRMLVesselSegmentationSeedNode *seedNode, bool isHepatic)
+    : Job(isHepatic ? "Hepatic segmentation" : "Portal segmentation")
+    , IsHepatic(isHepatic)
+    , Time(0.0)
+    , HasLabelMapData(false)
+    , RegionChanged(false)
+  {
+    this->UsedImages = (1 << PreprocessedMappedImage) |
+        (1 << (isHepatic ? HepaticMappedImage : PortalMappedImage));
+    double *seed1 = seedNode->GetSeed1();
+    double *seed2 = seedNode->GetSeed2();
+    for (int i = 0; i < 3; ++i)
+      {
+      this->Seed1[i] = seed1[i];
+      this->Seed2[i] = seed2[i];
+      }
+  }
+
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = logic->GetActiveVolume();
+
+    // check have valid activevol
+    if (!activeVol)
+      {
+      vtkErrorWithObjectMacro(logic, "SegmentVessels: could not get active volume.")
+      return false;
+      }
+    /*
+     * check if we already have an image converted to ITK
+     * if not then create it
+     */
+    this->WholeRegion = GetVolumeRegion(activeVol);
+    if( logic->preprocessedImg.IsNull() )
+      {
+      vtkVesselSegmentationHelper::LabelImageType::RegionType region;
+      if (!logic->ComputeRegionOfInterest(activeVol, region))
+        {
+        return false;
+        }
+
+      vtkVesselSegmentationMetrics::Probe importProbe;
+      importProbe.Start(this->Metrics, "import");
+      if (region == this->WholeRegion)
+        {
+        logic->preprocessedImg = vtkVesselSegmentationHelper::
+            ConvertVolumeNodeToItkImage(activeVol);
+        }
+      else
+        {
+        // only the voxels in the region of interest are converted
+        vtkVesselSegmentationHelper::NativeImageType::Pointer input =
+            vtkVesselSegmentationHelper::ConvertVolumeNodeToNativeItkImage(activeVol);
+        ExtractRegionSetup setup(input, region);
+        if (input.IsNotNull())
+          {
+          switch (activeVol->GetImageData()->GetScalarType())
+            {
+            vtkVesselSegmentationTemplateMacro(setup(static_cast<VTK_TT*>(NULL)));
+            default:
+              break;
+            }
+          }
+        logic->preprocessedImg = setup.Output;
+        }
+
+      if( logic->preprocessedImg.IsNull() )
+        {
+        vtkErrorWithObjectMacro(logic, "SegmentVessels: conversion to ITK not successful, "
+            "do not have preprocessed image.")
+        return false;
+        }
+      importProbe.Stop(logic->preprocessedImg->GetLargestPossibleRegion().GetNumberOfPixels());
+      }
+
+    vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
+    activeVol->GetIJKToRASMatrix(mat);
+    vtkNew<vtkMatrix4x4> RAStoIJKmatrix;
+    RAStoIJKmatrix->DeepCopy(mat);
+    RAStoIJKmatrix->Invert();
+
+    // get the pair of seeds in the right format for the itk filter
+    const double seed1_0[4] = {this->Seed1[0], this->Seed1[1], this->Seed1[2], 1}; // RAS
+    const double seed2_0[4] = {this->Seed1[0], this->Seed2[1], this->Seed2[2], 1}; // RAS
+
+    double seedIJK1[4]; // the actual first seed
+    double seedIJK2[4]; // the direction seed
+
+    // use the ijk matrix to convert the points
+    RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed1_0, seedIJK1);
+    RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed2_0, seedIJK2);
+
+    // the actual first seed
+    this->Coord1[0] = seedIJK1[0];
+    this->Coord1[1] = seedIJK1[1];
+    this->Coord1[2] = seedIJK1[2];
+    // the direction seed
+    this->Coord2[0] = seedIJK2[0];
+    this->Coord2[1] = seedIJK2[1];
+    this->Coord2[2] = seedIJK2[2];
+
+    vtkDebugWithObjectMacro(logic, "Seed IJK: " << this->Coord1 << " Direction seed: " << this->Coord2 );
+
+    // the image may only hold the voxels in the region of interest
+    if( !logic->preprocessedImg->GetLargestPossibleRegion().IsInside(this->Coord1) )
+      {
+      vtkErrorWithObjectMacro(logic, "SegmentVessels: the seed is outside of the preprocessed "
+          "image, or of its region of interest.")
+      return false;
+      }
+
+    this->ReferenceVolume = activeVol;
+    this->Input = logic->preprocessedImg;
+    this->PreviousOutput = this->IsHepatic ? logic->hepaticITKdata : logic->portalITKdata;
+
+    // the region of interest changed since the label map was traced: the
+    // filter pairs the previous output voxel by voxel with its input
+    this->RegionChanged = false;
+    if( this->PreviousOutput.IsNotNull() &&
+        this->PreviousOutput->GetLargestPossibleRegion() != this->Input->GetLargestPossibleRegion() )
+      {
+      this->PreviousOutput = ResizeLabelRegion(this->PreviousOutput,
+                                               this->Input->GetLargestPossibleRegion());
+      this->RegionChanged = true;
+      }
+    vtkMRMLLabelMapVolumeNode *labelMap = this->IsHepatic ? logic->hepaticLabelMap : logic->portalLabelMap;
+    this->HasLabelMapData = labelMap != NULL && labelMap->GetImageData() != NULL;
+
+    return true;
+  }
+
+  virtual bool Execute()
+  {
+    /*
+     * Have what is needed to call segmentation algorithm
+     * a pair of seeds and an ITK image
+     */
+    SeedFilterType::Pointer filter = SeedFilterType::New();
+    filter->SetInput(this->Input);
+    filter->SetSeed(this->Coord1);
+    filter->SetDirectionSeed(this->Coord2);
+    filter->SetOutputLabel(this->IsHepatic ? 4 : 5);
+    if( this->PreviousOutput.IsNotNull() )
+      {
+      filter->SetPreviousOutput(this->PreviousOutput);
+      }
+
+    // each pair of seeds traces one branch, recorded with the voxels it changed
+    vtkVesselSegmentationMetrics::Probe trackingProbe;
+    trackingProbe.Start(this->Metrics, this->IsHepatic ? "hepatic tracking" : "portal tracking");
+
+    this->BeginStage(filter, 1.0);
+    itk::TimeProbe clock1;
+    clock1.Start();
+    filter->Update();
+    clock1.Stop();
+    this->EndStage();
+    this->Time = clock1.GetMean();
+
+    this->Output = filter->GetOutput();
+
+    // a new label map, or one moved to another region of interest, is
+    // changed everywhere
+    if( this->PreviousOutput.IsNotNull() && !this->RegionChanged )
+      {
+      this->ModifiedRegion = filter->GetModifiedRegion();
+      }
+    else
+      {
+      this->ModifiedRegion = this->Output->GetLargestPossibleRegion();
+      }
+
+    // the voxels changed by this trace, for undo
+    this->Change.Encode(this->IsHepatic ? HepaticHistoryLabelMap : PortalHistoryLabelMap,
+                        this->PreviousOutput, this->Output, this->ModifiedRegion);
+    trackingProbe.Stop(this->Change.GetNumberOfChangedVoxels());
+
+    this->Output = this->MemoryManager->MapImage(this->Output.GetPointer(),
+        MappedImageNames[this->IsHepatic ? HepaticMappedImage : PortalMappedImage]);
+
+    // convert output of filter back to VTK; once the label map of a cropped
+    // output is in the scene, Apply only pastes the modified region into it,
+    // unless the labels outside the new region of interest must be cleared
+    if (!this->HasLabelMapData || this->RegionChanged ||
+        this->Output->GetLargestPossibleRegion() == this->WholeRegion)
+      {
+      this->OutputData = ConvertToNodeImageData(this->Output.GetPointer(), this->WholeRegion);
+      }
+
+    return true;
+  }
+
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkDebugWithObjectMacro(logic, "Time taken for itk::SeedVesselSegmentationImageFilter : "
+        << this->Time <<"sec\n" );
+
+    vtkVesselSegmentationHelper::LabelImageType::Pointer &itkData =
+        this->IsHepatic ? logic->hepaticITKdata : logic->portalITKdata;
+    vtkSmartPointer<vtkMRMLLabelMapVolumeNode> &labelMap =
+        this->IsHepatic ? logic->hepaticLabelMap : logic->portalLabelMap;
+    bool &updated = this->IsHepatic ? logic->hepaticUpdated : logic->portalUpdated;
+
+    itkData = this->Output;
+    UnionLabelRegion(this->IsHepatic ? logic->hepaticDirtyRegion : logic->portalDirtyRegion,
+                     this->ModifiedRegion);
+
+    if (this->RegionChanged)
+      {
+      // the steps were recorded on the previous region of interest
+      logic->labelHistory->Clear();
+      }
+    logic->labelHistory->AddDelta(this->Change);
+    logic->labelHistory->EndStep();
+
+    // only the bricks of the model around the new vessels are extracted again
+    int mesherLabel = this->IsHepatic ? HepaticMesherLabel : PortalMesherLabel;
+    if (labelMap == NULL || this->PreviousOutput.IsNull() || this->RegionChanged)
+      {
+      logic->vesselMesher->Reset(mesherLabel);
+      }
+    else
+      {
+      AddModifiedLabelRegion(logic->vesselMesher, mesherLabel, this->ModifiedRegion);
+      }
+
+    if (this->OutputData.GetPointer() == NULL && labelMap != NULL && labelMap->GetImageData() != NULL)
+      {
+      // the label map of the whole volume only changes where the vessel was traced
+      UpdateLabelMapRegion(labelMap, this->Output, this->ModifiedRegion);
+      }
+    else
+      {
+      if (this->OutputData.GetPointer() == NULL)
+        {
+        this->OutputData = ConvertToNodeImageData(this->Output.GetPointer(), this->WholeRegion);
+        }
+      if (this->OutputData.GetPointer() == NULL )
+        {
+        vtkErrorWithObjectMacro(logic, "SegmentVessels: conversion to VTK not successful.")
+        return;
+        }
+
+      if(labelMap == NULL)
+        {
+        // first time to create the label map
+        labelMap = vtkSmartPointer<vtkMRMLLabelMapVolumeNode>::New();
+        labelMap->CopyOrientation(this->ReferenceVolume);
+        labelMap->SetAndObserveImageData(this->OutputData.GetPointer());
+        labelMap->SetName(this->IsHepatic ? "hepaticLabel" : "portalLabel");
+        logic->GetMRMLScene()->AddNode(labelMap);
+
+        // make this label map the selected one
+        logic->SetAndPropagateActiveLabel(labelMap);
+        }
+      else // already had a label map
+        {
+        labelMap->SetAndObserveImageData(this->OutputData.GetPointer());
+        }
+      }
+
+    // have updated this label map, but now merged is not up to date
+    updated = true;
+    logic->mergedUpdated = false;
+
+    // will updated models if data has been modified: portalUpdated or hepaticUpdated
+    logic->UpdateModels();
+  }
+
+private:
+  bool IsHepatic;
+  double Seed1[3];
+  double Seed2[3];
+  vtkVesselSegmentationHelper::Index3D Coord1;
+  vtkVesselSegmentationHelper::Index3D Coord2;
+
+  double Time;
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> ReferenceVolume;
+  vtkVesselSegmentationHelper::LabelImageType::RegionType WholeRegion;
+  bool HasLabelMapData;
+  vtkVesselSegmentationHelper::SeedImageType::Pointer Input;
+  vtkVesselSegmentationHelper::LabelImageType::Pointer PreviousOutput;
+  bool RegionChanged;
+  vtkVesselSegmentationHelper::LabelImageType::Pointer Output;
+  vtkVesselSegmentationHelper::LabelImageType::RegionType ModifiedRegion;
+  vtkVesselSegmentationLabelHistory::Delta Change;
+  vtkSmartPointer<vtkImageData> OutputData;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Adds the hepatic and portal label maps, overlapping voxels end up as 9.
+ * Once the merged image exists only the regions changed by the segmentations
+ * since the last merge are added again.
+ */
+class vtkSlicerVesselSegmentationLogic::MergeJob : public vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  MergeJob()
+    : Job("Merging label maps")
+  {
+    this->UsedImages = (1 << HepaticMappedImage) | (1 << PortalMappedImage) | (1 << MergedMappedImage);
+  }
+
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = logic->GetActiveVolume();
+
+    // check have valid activevol
+    if (!activeVol)
+      {
+      vtkErrorWithObjectMacro(logic, "MergeLabelMaps: could not get active volume.")
+      return false;
+      }
+    // check if we have the ITK versions of data, and try to convert it if not
+    bool converted = false;
+    if( logic->hepaticITKdata.IsNull() )
+      {
+      logic->hepaticITKdata =
+          vtkVesselSegmentationHelper::ConvertVolumeNodeToItkLabelImage(logic->hepaticLabelMap);
+      converted = true;
+      }
+    if( logic->portalITKdata.IsNull() )
+      {
+      logic->portalITKdata =
+          vtkVesselSegmentationHelper::ConvertVolumeNodeToItkLabelImage(logic->portalLabelMap);
+      converted = true;
+      }
+
+    // check we have the data needed (if the conversions worked)
+    if( logic->hepaticITKdata.IsNull() && logic->portalITKdata.IsNull() )
+      {
+      vtkErrorWithObjectMacro(logic, "CallMergeLabelMaps: Do not have 2 label maps.")
+      return false;
+      }
+    else if( logic->hepaticITKdata.IsNull() )
+      {
+      vtkErrorWithObjectMacro(logic, "CallMergeLabelMaps: Do not have hepatic label map.")
+      return false;
+      }
+    else if( logic->portalITKdata.IsNull() )
+      {
+      vtkErrorWithObjectMacro(logic, "CallMergeLabelMaps: Do not have portal label map.")
+      return false;
+      }
+
+    // a label map converted from its node covers the whole volume, while the
+    // other one may be cropped to the region of interest
+    if( logic->hepaticITKdata->GetLargestPossibleRegion() != logic->portalITKdata->GetLargestPossibleRegion() )
+      {
+      LabelImageType::RegionType region = logic->hepaticITKdata->GetLargestPossibleRegion();
+      if( !region.Crop(logic->portalITKdata->GetLargestPossibleRegion()) )
+        {
+        vtkErrorWithObjectMacro(logic, "CallMergeLabelMaps: the label maps do not overlap.")
+        return false;
+        }
+      if( region != logic->hepaticITKdata->GetLargestPossibleRegion() )
+        {
+        logic->hepaticITKdata = CopyLabelRegion(logic->hepaticITKdata, region);
+        }
+      if( region != logic->portalITKdata->GetLargestPossibleRegion() )
+        {
+        logic->portalITKdata = CopyLabelRegion(logic->portalITKdata, region);
+        }
+      converted = true;
+      }
+
+    this->ReferenceVolume = activeVol;
+    this->WholeRegion = GetVolumeRegion(activeVol);
+    this->Hepatic = logic->hepaticITKdata;
+    this->Portal = logic->portalITKdata;
+
+    // the whole volume is added unless the merged image is still valid outside
+    // of the dirty regions
+    if( !converted && logic->mergedITKdata.IsNotNull() && logic->mergedLabelMap != NULL &&
+        logic->mergedITKdata->GetLargestPossibleRegion() == this->Hepatic->GetLargestPossibleRegion() &&
+        logic->mergedITKdata->GetLargestPossibleRegion() == this->Portal->GetLargestPossibleRegion() )
+      {
+      this->Merged = logic->mergedITKdata;
+      this->Region = logic->hepaticDirtyRegion;
+      UnionLabelRegion(this->Region, logic->portalDirtyRegion);
+      if( !this->Region.Crop(this->Merged->GetLargestPossibleRegion()) )
+        {
+        this->Region = LabelImageType::RegionType();
+        }
+      }
+
+    return true;
+  }
+
+  virtual bool Execute()
+  {
+    vtkVesselSegmentationMetrics::Probe mergeProbe;
+    mergeProbe.Start(this->Metrics, "merge");
+
+    if (this->Merged.IsNull())
+      {
+      typedef itk::AddImageFilter<LabelImageType, LabelImageType> AddFilterType;
+      AddFilterType::Pointer addFilter = AddFilterType::New();
+      addFilter->SetInput1(this->Hepatic);
+      addFilter->SetInput2(this->Portal);
+      this->BeginStage(addFilter, 1.0);
+      addFilter->Update();
+      this->EndStage();
+      this->Output = this->MemoryManager->MapImage(addFilter->GetOutput(),
+                                                   MappedImageNames[MergedMappedImage]);
+
+      // convert output of add filter back to VTK
+      this->OutputData = ConvertToNodeImageData(this->Output.GetPointer(), this->WholeRegion);
+      }
+    else if (this->Region.GetNumberOfPixels() > 0)
+      {
+      // add the dirty region only, Apply copies it into the merged image
+      this->Patch = LabelImageType::New();
+      this->Patch->CopyInformation(this->Merged);
+      this->Patch->SetRegions(this->Region);
+      this->Patch->Allocate();
+
+      itk::ImageRegionConstIterator<LabelImageType> itHepatic(this->Hepatic, this->Region);
+      itk::ImageRegionConstIterator<LabelImageType> itPortal(this->Portal, this->Region);
+      itk::ImageRegionIterator<LabelImageType> itPatch(this->Patch, this->Region);
+      for(itPatch.GoToBegin(), itHepatic.GoToBegin(), itPortal.GoToBegin(); !itPatch.IsAtEnd();
+          ++itPatch, ++itHepatic, ++itPortal)
+        {
+        itPatch.Set(static_cast<LabelImageType::PixelType>(itHepatic.Get() + itPortal.Get()));
+        }
+      }
+
+    mergeProbe.Stop(this->Merged.IsNull() ? this->Output->GetLargestPossibleRegion().GetNumberOfPixels() :
+                                            this->Region.GetNumberOfPixels());
+    return true;
+  }
+
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    // the hepatic and portal changes are now all in the merged image
+    logic->hepaticDirtyRegion = LabelImageType::RegionType();
+    logic->portalDirtyRegion = LabelImageType::RegionType();
+
+    if (this->Merged.IsNull())
+      {
+      logic->mergedITKdata = this->Output;
+
+      if (this->OutputData.GetPointer() == NULL )
+        {
+        vtkErrorWithObjectMacro(logic, "CallMergeLabelMaps: Conversion to VTK not successful.")
+        return;
+        }
+
+      if(logic->mergedLabelMap == NULL)
+        {
+        // first time to create a merged label map
+        logic->mergedLabelMap = vtkSmartPointer<vtkMRMLLabelMapVolumeNode>::New();
+        logic->mergedLabelMap->CopyOrientation(this->ReferenceVolume);
+        logic->mergedLabelMap->SetAndObserveImageData(this->OutputData.GetPointer());
+        logic->mergedLabelMap->SetName("mergedLabel");
+        logic->GetMRMLScene()->AddNode(logic->mergedLabelMap);
+        }
+      else
+        {
+        logic->mergedLabelMap->SetAndObserveImageData(this->OutputData.GetPointer());
+        }
+
+      logic->overlapDirtyRegion = this->Output->GetLargestPossibleRegion();
+      }
+    else if (this->Patch.IsNotNull())
+      {
+      // the label map shares its buffer with the merged image, unless cropped
+      itk::ImageRegionConstIterator<LabelImageType> itPatch(this->Patch, this->Region);
+      itk::ImageRegionIterator<LabelImageType> itMerged(logic->mergedITKdata, this->Region);
+      for(itPatch.GoToBegin(), itMerged.GoToBegin(); !itPatch.IsAtEnd(); ++itPatch, ++itMerged)
+        {
+        itMerged.Set(itPatch.Get());
+        }
+      UpdateLabelMapRegion(logic->mergedLabelMap, logic->mergedITKdata, this->Region);
+
+      UnionLabelRegion(logic->overlapDirtyRegion, this->Region);
+      }
+
+    // merged label map has been updated
+    logic->mergedUpdated = true;
+
+    logic->SetAndPropagateActiveLabel(logic->mergedLabelMap);
+  }
+
+private:
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> ReferenceVolume;
+  LabelImageType::RegionType WholeRegion;
+  LabelImageType::Pointer Hepatic;
+  LabelImageType::Pointer Portal;
+  LabelImageType::Pointer Merged;
+  LabelImageType::RegionType Region;
+  LabelImageType::Pointer Patch;
+  LabelImageType::Pointer Output;
+  vtkSmartPointer<vtkImageData> OutputData;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Finds the overlapping area closest to the seed. The search runs in the
+ * worker, the reassignment of the voxels is done in Apply since the label
+ * maps shown in the scene share their buffers with the ITK images.
+ *
+ * The overlap objects are cached between calls. Only the objects reaching
+ * into the merged voxels changed since the last call are labelled again, and
+ * the dilation and labelling only run in the bounding box of each cluster of
+ * overlap voxels.
+ */
+class vtkSlicerVesselSegmentationLogic::SplitJob : public vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  SplitJob(vtkMRMLVesselSegmentationSeedNode *seedNode, bool isHepatic)
+    : Job("Vessel splitting")
+    , IsHepatic(isHepatic)
+    , Recompute(false)
+    , Time(0.0)
+  {
+    this->UsedImages = (1 << HepaticMappedImage) | (1 << PortalMappedImage) | (1 << MergedMappedImage);
+    double *seed1 = seedNode->GetSeed1();
+    for (int i = 0; i < 3; ++i)
+      {
+      this->Seed1[i] = seed1[i];
+      }
+  }
+
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = logic->GetActiveVolume();
+
+    // check have valid activevol
+    if (!activeVol)
+      {
+      vtkErrorWithObjectMacro(logic, "SplitVessels: could not get active volume.")
+      return false;
+      }
+    // check have a merged label map
+    if( logic->mergedITKdata.IsNull() )
+      {
+      vtkErrorWithObjectMacro(logic, "SplitVessels: Do not have merged label map.")
+      return false;
+      }
+
+    vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
+    activeVol->GetIJKToRASMatrix(mat);
+    vtkNew<vtkMatrix4x4> RAStoIJKmatrix;
+    RAStoIJKmatrix->DeepCopy(mat);
+    RAStoIJKmatrix->Invert();
+
+    const double seed1_0[4] = {this->Seed1[0], this->Seed1[1], this->Seed1[2], 1}; // IJK
+    // have a seed
+    double seedIJK[4];
+    // use the ijk matrix to convert the points
+    RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed1_0, seedIJK); //was commented out in old code?
+
+    this->SeedLPS[0] = - seedIJK[0];
+    this->SeedLPS[1] = - seedIJK[1];
+    this->SeedLPS[2] = seedIJK[2];
+
+    this->Merged = logic->mergedITKdata;
+    this->PreviousLabelMap = logic->onlyOverlapLabelMap;
+
+    // if first time, or if the merged label map has been updated
+    if (this->PreviousLabelMap.IsNull())
+      {
+      this->DirtyRegion = this->Merged->GetLargestPossibleRegion();
+      }
+    else
+      {
+      this->DirtyRegion = logic->overlapDirtyRegion;
+      }
+    this->Recompute = this->DirtyRegion.GetNumberOfPixels() > 0;
+    if (!this->Recompute)
+      {
+      this->OverlapLabelMap = this->PreviousLabelMap;
+      }
+
+    return true;
+  }
+
+  virtual bool Execute()
+  {
+    if (this->Recompute)
+      {
+      vtkVesselSegmentationMetrics::Probe splitProbe;
+      splitProbe.Start(this->Metrics, "split");
+      itk::TimeProbe clock1;
+      clock1.Start();
+
+      LabelImageType::RegionType largest = this->Merged->GetLargestPossibleRegion();
+
+      // a changed overlap voxel changes the dilation within its radius
+      LabelImageType::RegionType region = this->DirtyRegion;
+      region.PadByRadius(DilationRadius);
+      region.Crop(largest);
+
+      // cached objects touching the region are labelled again as a whole, which
+      // can grow the region into other objects
+      std::vector<bool> keepObject;
+      if (this->PreviousLabelMap.IsNotNull())
+        {
+        keepObject.assign(this->PreviousLabelMap->GetNumberOfLabelObjects(), true);
+        bool grown = true;
+        while (grown)
+          {
+          grown = false;
+          LabelImageType::RegionType touching = region;
+          touching.PadByRadius(1);
+          for(unsigned int n = 0; n < keepObject.size(); n++)
+            {
+            if (!keepObject[n])
+              {
+              continue;
+              }
+            LabelImageType::RegionType box =
+                this->PreviousLabelMap->GetNthLabelObject(n)->GetBoundingBox();
+            if (box.Crop(touching))
+              {
+              keepObject[n] = false;
+              UnionLabelRegion(region, this->PreviousLabelMap->GetNthLabelObject(n)->GetBoundingBox());
+              grown = true;
+              }
+            }
+          }
+        }
+
+      // collect the overlap voxels of the region, the objects reaching into it
+      // are complete after the growing above
+      std::vector<LabelImageType::IndexType> overlapVoxels;
+      itk::ImageRegionConstIterator<LabelImageType> itOrg(this->Merged, region);
+      for(itOrg.GoToBegin(); !itOrg.IsAtEnd(); ++itOrg)
+        {
+        if(itOrg.Get() == 9)
+          {
+          overlapVoxels.push_back(itOrg.GetIndex());
+          }
+        }
+
+      // dilated voxels can only touch when their centres are less than a
+      // block apart, so clusters of neighbouring blocks are labelled separately
+      const itk::IndexValueType blockSize = 2 * DilationRadius + 2;
+      itk::OffsetValueType numberOfBlocks[3];
+      for (unsigned int d = 0; d < 3; d++)
+        {
+        numberOfBlocks[d] = static_cast<itk::OffsetValueType>(region.GetSize(d)) / blockSize + 1;
+        }
+
+      std::map<itk::OffsetValueType, unsigned int> blockIds;
+      std::vector<LabelImageType::IndexType> blocks;
+      std::vector<unsigned int> voxelBlocks(overlapVoxels.size());
+      for(size_t v = 0; v < overlapVoxels.size(); v++)
+        {
+        LabelImageType::IndexType block;
+        for (unsigned int d = 0; d < 3; d++)
+          {
+          block[d] = (overlapVoxels[v][d] - region.GetIndex(d)) / blockSize;
+          }
+        itk::OffsetValueType key = block[0] + numberOfBlocks[0] * (block[1] + numberOfBlocks[1] * block[2]);
+        std::map<itk::OffsetValueType, unsigned int>::iterator found = blockIds.find(key);
+        if (found == blockIds.end())
+          {
+          found = blockIds.insert(std::make_pair(key, static_cast<unsigned int>(blocks.size()))).first;
+          blocks.push_back(block);
+          }
+        voxelBlocks[v] = found->second;
+        }
+
+      std::vector<unsigned int> parents(blocks.size());
+      for(unsigned int b = 0; b < blocks.size(); b++)
+        {
+        parents[b] = b;
+        }
+      for(unsigned int b = 0; b < blocks.size(); b++)
+        {
+        for (int z = -1; z <= 1; z++)
+          {
+          for (int y = -1; y <= 1; y++)
+            {
+            for (int x = -1; x <= 1; x++)
+              {
+              itk::OffsetValueType nx = blocks[b][0] + x;
+              itk::OffsetValueType ny = blocks[b][1] + y;
+              itk::OffsetValueType nz = blocks[b][2] + z;
+              if (nx < 0 || ny < 0 || nz < 0 ||
+                  nx >= numberOfBlocks[0] || ny >= numberOfBlocks[1] || nz >= numberOfBlocks[2])
+                {
+                continue;
+                }
+              std::map<itk::OffsetValueType, unsigned int>::iterator found =
+                  blockIds.find(nx + numberOfBlocks[0] * (ny + numberOfBlocks[1] * nz));
+              if (found != blockIds.end())
+                {
+                parents[FindRoot(parents, found->second)] = FindRoot(parents, b);
+                }
+              }
+            }
+          }
+        }
+
+      std::map<unsigned int, unsigned int> clusterIds;
+      std::vector< std::vector<LabelImageType::IndexType> > clusters;
+      for(size_t v = 0; v < overlapVoxels.size(); v++)
+        {
+        unsigned int root = FindRoot(parents, voxelBlocks[v]);
+        std::map<unsigned int, unsigned int>::iterator found = clusterIds.find(root);
+        if (found == clusterIds.end())
+          {
+          found = clusterIds.insert(std::make_pair(root, static_cast<unsigned int>(clusters.size()))).first;
+          clusters.push_back(std::vector<LabelImageType::IndexType>());
+          }
+        clusters[found->second].push_back(overlapVoxels[v]);
+        }
+
+      //Structuring Element for the dilation, used as a list of offsets
+      typedef itk::BinaryBallStructuringElement< vtkVesselSegmentationHelper::labelPixelType, 3 > StructuringElementType;
+      StructuringElementType structuringElement;
+      structuringElement.SetRadius(DilationRadius);
+      structuringElement.CreateStructuringElement();
+
+      std::vector<LabelImageType::OffsetType> ballOffsets;
+      for(unsigned int k = 0; k < structuringElement.Size(); k++)
+        {
+        if (structuringElement[k])
+          {
+          ballOffsets.push_back(structuringElement.GetOffset(k));
+          }
+        }
+      std::vector<itk::OffsetValueType> ballLinearOffsets(ballOffsets.size());
+
+      this->OverlapLabelMap = LabelMapType::New();
+      this->OverlapLabelMap->CopyInformation(this->Merged);
+      this->OverlapLabelMap->SetRegions(largest);
+      this->OverlapLabelMap->SetBackgroundValue( itk::NumericTraits< LabelType >::Zero );
+
+      this->BeginStage(1.0);
+      for(size_t c = 0; c < clusters.size(); c++)
+        {
+        if (this->IsAborted())
+          {
+          return false;
+          }
+
+        const std::vector<LabelImageType::IndexType> &voxels = clusters[c];
+
+        // bounding box of the cluster and its dilation
+        LabelImageType::IndexType lower = voxels[0];
+        LabelImageType::IndexType upper = voxels[0];
+        for(size_t v = 1; v < voxels.size(); v++)
+          {
+          for (unsigned int d = 0; d < 3; d++)
+            {
+            lower[d] = std::min(lower[d], voxels[v][d]);
+            upper[d] = std::max(upper[d], voxels[v][d]);
+            }
+          }
+        LabelImageType::RegionType box;
+        box.SetIndex(lower);
+        for (unsigned int d = 0; d < 3; d++)
+          {
+          box.SetSize(d, static_cast<itk::SizeValueType>(upper[d] - lower[d] + 1));
+          }
+        box.PadByRadius(DilationRadius);
+        box.Crop(largest);
+
+        LabelImageType::Pointer dilated = LabelImageType::New();
+        dilated->CopyInformation(this->Merged);
+        dilated->SetRegions(box);
+        dilated->Allocate();
+        dilated->FillBuffer(0);
+
+        LabelImageType::PixelType *buffer = dilated->GetBufferPointer();
+        const itk::OffsetValueType *offsetTable = dilated->GetOffsetTable();
+        for(size_t k = 0; k < ballOffsets.size(); k++)
+          {
+          ballLinearOffsets[k] = ballOffsets[k][0] * offsetTable[0] +
+                                 ballOffsets[k][1] * offsetTable[1] +
+                                 ballOffsets[k][2] * offsetTable[2];
+          }
+
+        // stamp the ball around each overlap voxel, checking the bounds only
+        // near the border of the volume
+        for(size_t v = 0; v < voxels.size(); v++)
+          {
+          bool ballInside = true;
+          for (unsigned int d = 0; d < 3; d++)
+            {
+            if (voxels[v][d] - DilationRadius < box.GetIndex(d) ||
+                voxels[v][d] + DilationRadius >= box.GetIndex(d) + static_cast<itk::IndexValueType>(box.GetSize(d)))
+              {
+              ballInside = false;
+              }
+            }
+
+          if (ballInside)
+            {
+            LabelImageType::PixelType *centre = buffer + dilated->ComputeOffset(voxels[v]);
+            for(size_t k = 0; k < ballLinearOffsets.size(); k++)
+              {
+              centre[ballLinearOffsets[k]] = 1;
+              }
+            }
+          else
+            {
+            for(size_t k = 0; k < ballOffsets.size(); k++)
+              {
+              LabelImageType::IndexType index = voxels[v] + ballOffsets[k];
+              if (box.IsInside(index))
+                {
+                buffer[dilated->ComputeOffset(index)] = 1;
+                }
+              }
+            }
+          }
+
+        //Label connected objects separately
+        typedef itk::ConnectedComponentImageFilter <LabelImageType, ComponentImageType >   ConnectedComponentImageFilterType;
+        ConnectedComponentImageFilterType::Pointer connectedComponent =   ConnectedComponentImageFilterType::New ();
+        connectedComponent->SetInput(dilated);
+        connectedComponent->SetBackgroundValue(0);
+
+        //Convert LabelImage to LabelMap containing connected labelObjects
+        typedef itk::LabelImageToShapeLabelMapFilter< ComponentImageType, LabelMapType> LabelImageToLabelMapFilterType;
+        LabelImageToLabelMapFilterType::Pointer labelImageToLabelMapFilter = LabelImageToLabelMapFilterType::New();
+        labelImageToLabelMapFilter->SetInput(connectedComponent->GetOutput());
+        labelImageToLabelMapFilter->SetBackgroundValue( itk::NumericTraits< LabelType >::Zero );
+        labelImageToLabelMapFilter->Update();
+
+        LabelMapType *clusterLabelMap = labelImageToLabelMapFilter->GetOutput();
+        for(unsigned int n = 0; n < clusterLabelMap->GetNumberOfLabelObjects(); n++)
+          {
+          ShapeLabelObjectType::Pointer labelObject = ShapeLabelObjectType::New();
+          labelObject->CopyAllFrom(clusterLabelMap->GetNthLabelObject(n));
+          this->OverlapLabelMap->PushLabelObject(labelObject);
+          }
+
+        this->UpdateStageProgress(static_cast<double>(c + 1) / clusters.size());
+        }
+      this->EndStage();
+
+      // add the cached objects that were not labelled again
+      for(unsigned int n = 0; n < keepObject.size(); n++)
+        {
+        if (keepObject[n])
+          {
+          ShapeLabelObjectType::Pointer labelObject = ShapeLabelObjectType::New();
+          labelObject->CopyAllFrom(this->PreviousLabelMap->GetNthLabelObject(n));
+          this->OverlapLabelMap->PushLabelObject(labelObject);
+          }
+        }
+
+      clock1.Stop();
+      this->Time = clock1.GetMean();
+      splitProbe.Stop(region.GetNumberOfPixels());
+      }
+
+    //Find LabelObject containing Seed
+    unsigned int labelObjectNumber = 0;
+    double distance = 0.0;
+    double minDistance = 100000.0;
+    itk::Point<double, 3> objectCentroid;
+
+    // Loop over each connected object to find minimum distance
+    for(unsigned int n = 0; n < this->OverlapLabelMap->GetNumberOfLabelObjects(); n++)
+      {
+      ShapeLabelObjectType * labelObject = this->OverlapLabelMap->GetNthLabelObject(n);
+
+      objectCentroid = labelObject->GetCentroid();
+      distance = this->SeedLPS.EuclideanDistanceTo(objectCentroid);
+
+      if((minDistance > distance) && (labelObject->GetNumberOfPixels() > 100))
+        {
+        minDistance = distance;
+        labelObjectNumber = n;
+        }
+      }
+
+    if (this->OverlapLabelMap->GetNumberOfLabelObjects() > 0)
+      {
+      this->SelectedObject = this->OverlapLabelMap->GetNthLabelObject(labelObjectNumber);
+      }
+
+    return true;
+  }
+
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    if (this->Recompute)
+      {
+      vtkDebugWithObjectMacro(logic, "Dilation and Connected Components - time taken : " << this->Time <<"sec\n" );
+      logic->overlapDirtyRegion = LabelImageType::RegionType();
+      }
+    logic->onlyOverlapLabelMap = this->OverlapLabelMap;
+
+    if (this->SelectedObject.IsNull())
+      {
+      vtkErrorWithObjectMacro(logic, "SplitVessels: no overlapping area to assign.")
+      return;
+      }
+
+    // assign object, the label images share their geometry so the offsets of
+    // the merged image are valid for all three
+    LabelImageType::PixelType *merged = logic->mergedITKdata->GetBufferPointer();
+    LabelImageType::PixelType *assigned = this->IsHepatic ?
+        logic->hepaticITKdata->GetBufferPointer() : logic->portalITKdata->GetBufferPointer();
+    LabelImageType::PixelType *erased = this->IsHepatic ?
+        logic->portalITKdata->GetBufferPointer() : logic->hepaticITKdata->GetBufferPointer();
+    const LabelImageType::PixelType label = this->IsHepatic ? 4 : 5;
+
+    // keep what the assignment overwrites, for undo
+    ShapeLabelObjectType * selectedLabelObject = this->SelectedObject;
+    LabelImageType::RegionType objectRegion = selectedLabelObject->GetBoundingBox();
+    LabelImageType::Pointer hepaticBefore = CopyLabelRegion(logic->hepaticITKdata, objectRegion);
+    LabelImageType::Pointer portalBefore = CopyLabelRegion(logic->portalITKdata, objectRegion);
+
+    // Change Selected LabelObject as Hepatic or Portal, one line at a time
+    for(itk::SizeValueType lineId = 0; lineId < selectedLabelObject->GetNumberOfLines(); lineId++)
+      {
+      const ShapeLabelObjectType::LineType &line = selectedLabelObject->GetLine(lineId);
+      itk::OffsetValueType offset = logic->mergedITKdata->ComputeOffset(line.GetIndex());
+      for(itk::SizeValueType i = 0; i < line.GetLength(); i++, offset++)
+        {
+        if(merged[offset]) // merged region exists
+          {
+          // change the merged label map to the selected vessel
+          merged[offset] = label;
+          // erase the other vessel in this area
+          erased[offset] = 0;
+          // ensure the label map of the selected vessel is also correct
+          if(!assigned[offset])
+            {
+            assigned[offset] = label;
+            }
+          }
+        }
+      }
+
+    vtkVesselSegmentationLabelHistory::Delta hepaticChange;
+    hepaticChange.Encode(HepaticHistoryLabelMap, hepaticBefore, logic->hepaticITKdata, objectRegion);
+    vtkVesselSegmentationLabelHistory::Delta portalChange;
+    portalChange.Encode(PortalHistoryLabelMap, portalBefore, logic->portalITKdata, objectRegion);
+    logic->labelHistory->AddDelta(hepaticChange);
+    logic->labelHistory->AddDelta(portalChange);
+    logic->labelHistory->EndStep();
+
+    // the label map nodes of cropped images hold copies of the voxels
+    UpdateLabelMapRegion(logic->hepaticLabelMap, logic->hepaticITKdata, objectRegion);
+    UpdateLabelMapRegion(logic->portalLabelMap, logic->portalITKdata, objectRegion);
+    UpdateLabelMapRegion(logic->mergedLabelMap, logic->mergedITKdata, objectRegion);
+
+    // both models change where the object was assigned
+    AddModifiedLabelRegion(logic->vesselMesher, HepaticMesherLabel, objectRegion);
+    AddModifiedLabelRegion(logic->vesselMesher, PortalMesherLabel, objectRegion);
+
+    logic->hepaticUpdated = true;
+    logic->portalUpdated = true;
+    logic->UpdateModels();
+
+    logic->mergedUpdated = false;
+    logic->SetAndPropagateActiveLabel(logic->mergedLabelMap);
+  }
+
+private:
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+  typedef itk::Image<LabelType, 3>  ComponentImageType;
+
+  enum { DilationRadius = 4 };
+
+  static unsigned int FindRoot(std::vector<unsigned int> &parents, unsigned int id)
+  {
+    while (parents[id] != id)
+      {
+      parents[id] = parents[parents[id]];
+      id = parents[id];
+      }
+    return id;
+  }
+
+  bool IsHepatic;
+  bool Recompute;
+  double Seed1[3];
+  itk::Point<double, 3> SeedLPS;
+
+  double Time;
+  LabelImageType::Pointer Merged;
+  LabelImageType::RegionType DirtyRegion;
+  LabelMapType::Pointer PreviousLabelMap;
+  LabelMapType::Pointer OverlapLabelMap;
+  ShapeLabelObjectType::Pointer SelectedObject;
+};
+
+//----------------------------------------------------------------------------
+/**
+ * Extracts the surfaces of the label maps that have been updated. The label
+ * map data is shallow copied on the main thread so the worker never touches
+ * the pipeline information of the data shown in the scene. Label maps cropped
+ * to the region of interest are meshed from their ITK images instead.
+ */
+class vtkSlicerVesselSegmentationLogic::ModelsJob : public vtkSlicerVesselSegmentationLogic::Job
+{
+public:
+  ModelsJob()
+    : Job("Updating models"), UpdateHepatic(false), UpdatePortal(false)
+  {
+    this->UsedImages = (1 << HepaticMappedImage) | (1 << PortalMappedImage);
+  }
+
+  virtual bool Prepare(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = logic->GetActiveVolume();
+
+    // check have valid activevol
+    if (!activeVol)
+      {
+      vtkErrorWithObjectMacro(logic, "UpdateModels: could not get active volume.")
+      return false;
+      }
+
+    this->IJKtoRASmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    activeVol->GetIJKToRASMatrix(this->IJKtoRASmatrix);
+    this->Mesher = logic->vesselMesher;
+
+    this->UpdateHepatic = logic->hepaticLabelMap != NULL && logic->hepaticUpdated;
+    this->UpdatePortal = logic->portalLabelMap != NULL && logic->portalUpdated;
+
+    // an unchanged label map is still an input of the mesher, which then takes
+    // all of its bricks from the cache
+    this->HepaticImage = GetMesherInput(logic->hepaticLabelMap, logic->hepaticITKdata);
+    this->PortalImage = GetMesherInput(logic->portalLabelMap, logic->portalITKdata);
+
+    if (this->UpdateHepatic)
+      {
+      logic->hepaticUpdated = false;
+      }
+    if (this->UpdatePortal)
+      {
+      logic->portalUpdated = false;
+      }
+
+    return true;
+  }
+
+  virtual bool Execute()
+  {
+    if (!this->UpdateHepatic && !this->UpdatePortal)
+      {
+      return true;
+      }
 
-#include <vtkRenderWindow.h>
-#include <vtkRendererCollection.h>
+    // one mesher extracts, smooths and transforms the changed bricks of both
+    // label maps concurrently
+    this->Mesher->SetTransformMatrix(this->IJKtoRASmatrix);
+    this->Mesher->SetInputData(this->HepaticImage);
+    this->Mesher->AddInputData(this->PortalImage);
+    vtkVesselSegmentationMetrics::Probe meshingProbe;
+    meshingProbe.Start(this->Metrics, "meshing");
+    this->BeginStage(this->Mesher, 1.0);
+    this->Mesher->Update();
+    this->EndStage();
+    meshingProbe.Stop((this->UpdateHepatic ? this->HepaticImage->GetNumberOfPoints() : 0) +
+                      (this->UpdatePortal ? this->PortalImage->GetNumberOfPoints() : 0));
+
+    if (this->IsAborted())
+      {
+      return false;
+      }
 
-#include <vtkMRMLViewNode.h>
+    // the outputs of the mesher are reused by the next update
+    if (this->UpdateHepatic)
+      {
+      this->HepaticModel = vtkSmartPointer<vtkPolyData>::New();
+      this->HepaticModel->ShallowCopy(this->Mesher->GetOutput(HepaticMesherLabel));
+      }
+    if (this->UpdatePortal)
+      {
+      this->PortalModel = vtkSmartPointer<vtkPolyData>::New();
+      this->PortalModel->ShallowCopy(this->Mesher->GetOutput(PortalMesherLabel));
+      }
 
-#include <qSlicerApplication.h>
-#include <qSlicerLayoutManager.h>
-#include <qMRMLThreeDWidget.h>
-#include <qMRMLThreeDView.h>
+    return true;
+  }
 
-// ITK includes
-#include <itkImageFileWriter.h>
-#include <itkImage.h>
-#include <itkImageRegionIteratorWithIndex.h>
-#include <itkOrImageFilter.h>
-#include <itkCastImageFilter.h>
-#include <itkSigmoidImageFilter.h>
-#include <itkAddImageFilter.h>
-#include <itkBinaryDilateImageFilter.h>
-#include <itkBinaryBallStructuringElement.h>
-#include <itkConnectedComponentImageFilter.h>
-#include <itkLabelImageToShapeLabelMapFilter.h>
-#include <itkPoint.h>
-#include <itkTimeProbe.h>
+  virtual void Discard(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    // the models are still out of date
+    if (this->UpdateHepatic)
+      {
+      logic->hepaticUpdated = true;
+      }
+    if (this->UpdatePortal)
+      {
+      logic->portalUpdated = true;
+      }
+  }
 
-// STD includes
-#include <iostream>
-#include <cmath>
+  virtual void Apply(vtkSlicerVesselSegmentationLogic *logic)
+  {
+    if (this->HepaticModel)
+      {
+      if( logic->hepaticModelNode == NULL )
+        {
+        // first time to create hepatic model node
+        logic->hepaticModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
+        logic->hepaticModelNode->SetName("hepaticVesselModel");
+        logic->hepaticModelNode->SetAndObservePolyData(this->HepaticModel);
+        logic->GetMRMLScene()->AddNode(logic->hepaticModelNode);
+
+        // also need a display node
+        logic->hepaticModelDisplayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+        logic->hepaticModelDisplayNode->SetColor(0,0,1); // blue
+        logic->GetMRMLScene()->AddNode(logic->hepaticModelDisplayNode);
+        logic->hepaticModelNode->SetAndObserveDisplayNodeID(logic->hepaticModelDisplayNode->GetID());
+        }
+      else // add to 3D model, as already have nodes
+        {
+        logic->hepaticModelNode->SetAndObservePolyData(this->HepaticModel);
+        }
+      }
+    if (this->PortalModel)
+      {
+      if( logic->portalModelNode == NULL )
+        {
+        // first time to create portal model node
+        logic->portalModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
+        logic->portalModelNode->SetName("portalVesselModel");
+        logic->portalModelNode->SetAndObservePolyData(this->PortalModel);
+        logic->GetMRMLScene()->AddNode(logic->portalModelNode);
+
+        // also need a display node
+        logic->portalModelDisplayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+        logic->portalModelDisplayNode->SetColor(1,0,0); // red
+        logic->GetMRMLScene()->AddNode(logic->portalModelDisplayNode);
+        logic->portalModelNode->SetAndObserveDisplayNodeID(logic->portalModelDisplayNode->GetID());
+        }
+      else // add to 3D model, as already have nodes
+        {
+        logic->portalModelNode->SetAndObservePolyData(this->PortalModel);
+        }
+      }
 
-//----------------------------------------------------------------------------
-vtkStandardNewMacro(vtkSlicerVesselSegmentationLogic);
+    logic->Reset3DView();
+  }
+
+private:
+  vtkSmartPointer<vtkMatrix4x4> IJKtoRASmatrix;
+  vtkSmartPointer<vtkImageData> HepaticImage;
+  vtkSmartPointer<vtkImageData> PortalImage;
+  vtkSmartPointer<vtkVesselSegmentationBrickMesher> Mesher;
+  bool UpdateHepatic;
+  bool UpdatePortal;
+  vtkSmartPointer<vtkPolyData> HepaticModel;
+  vtkSmartPointer<vtkPolyData> PortalModel;
+};
 
 //----------------------------------------------------------------------------
 /**
@@ -113,12 +2213,59 @@ vtkSlicerVesselSegmentationLogic::vtkSlicerVesselSegmentationLogic()
   hepaticUpdated = false;
   portalUpdated = false;
   mergedUpdated = false;
+
+  vesselMesher = vtkSmartPointer<vtkVesselSegmentationBrickMesher>::New();
+  vesselMesher->SetNumberOfLabels(2);
+  vesselMesher->SetLabel(HepaticMesherLabel, 4);
+  vesselMesher->SetLabel(PortalMesherLabel, 5);
+
+  hasRegionOfInterest = false;
+  for (int i = 0; i < 6; ++i)
+    {
+    regionOfInterest[i] = 0.0;
+    }
+  this->RegionOfInterestMargin = 10.0;
+
+  labelHistory = vtkSmartPointer<vtkVesselSegmentationLabelHistory>::New();
+  metrics = vtkSmartPointer<vtkVesselSegmentationMetrics>::New();
+  memoryManager = vtkSmartPointer<vtkVesselSegmentationMemoryManager>::New();
+
+  this->Asynchronous = false;
+  this->currentJob = NULL;
+  this->jobThreadID = -1;
+  this->lastJobState = JobIdle;
+  this->jobThreader = vtkSmartPointer<vtkMultiThreader>::New();
+
+  // the worker requests a Modified() on this object to report progress and
+  // completion, which the application logic then invokes on the main thread
+  this->jobNotifier = vtkSmartPointer<vtkObject>::New();
+  this->jobCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+  this->jobCallback->SetCallback(vtkSlicerVesselSegmentationLogic::OnJobNotification);
+  this->jobCallback->SetClientData(this);
+  this->jobNotifier->AddObserver(vtkCommand::ModifiedEvent, this->jobCallback);
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerVesselSegmentationLogic::~vtkSlicerVesselSegmentationLogic()
 {
-
+  // nothing may be written to the scene anymore, drop all the jobs
+  while (!this->pendingJobs.empty())
+    {
+    delete this->pendingJobs.front();
+    this->pendingJobs.pop_front();
+    }
+  if (this->currentJob)
+    {
+    this->currentJob->Abort();
+    if (this->jobThreadID >= 0)
+      {
+      this->jobThreader->TerminateThread(this->jobThreadID);
+      this->jobThreadID = -1;
+      }
+    delete this->currentJob;
+    this->currentJob = NULL;
+    }
+  this->jobNotifier->RemoveObserver(this->jobCallback);
 }
 
 //----------------------------------------------------------------------------
@@ -130,6 +2277,11 @@ void vtkSlicerVesselSegmentationLogic::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "vtkScalarType: " << this->vtkScalarType << "\n";
 
+  os << indent << "Asynchronous: " << (this->Asynchronous ? "true" : "false") << "\n";
+  os << indent << "JobState: " << GetJobStateAsString(this->GetJobState()) << "\n";
+  os << indent << "JobName: " << this->GetJobName() << "\n";
+  os << indent << "NumberOfPendingJobs: " << this->GetNumberOfPendingJobs() << "\n";
+
   os << indent << "hepaticUpdated: ";
   if(this->hepaticUpdated)
     os << indent << "true" << "\n";
@@ -164,6 +2316,27 @@ void vtkSlicerVesselSegmentationLogic::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "mergedLabelMap: " << this->mergedLabelMap << "\n";
 
   os << indent << "onlyOverlapLabelMap: " << this->onlyOverlapLabelMap << "\n";
+  os << indent << "hepaticDirtyRegion: " << this->hepaticDirtyRegion << "\n";
+  os << indent << "portalDirtyRegion: " << this->portalDirtyRegion << "\n";
+  os << indent << "overlapDirtyRegion: " << this->overlapDirtyRegion << "\n";
+  os << indent << "RegionOfInterest: ";
+  if(this->hasRegionOfInterest)
+    {
+    os << this->regionOfInterest[0] << " " << this->regionOfInterest[1] << " "
+       << this->regionOfInterest[2] << " " << this->regionOfInterest[3] << " "
+       << this->regionOfInterest[4] << " " << this->regionOfInterest[5] << "\n";
+    }
+  else
+    {
+    os << "(none)" << "\n";
+    }
+  os << indent << "RegionOfInterestMargin: " << this->RegionOfInterestMargin << "\n";
+  os << indent << "NumberOfUndoSteps: " << this->labelHistory->GetNumberOfUndoSteps() << "\n";
+  os << indent << "NumberOfRedoSteps: " << this->labelHistory->GetNumberOfRedoSteps() << "\n";
+  os << indent << "MetricsEnabled: " << (this->metrics->GetEnabled() ? "true" : "false") << "\n";
+  os << indent << "MemoryBudget: " << this->memoryManager->GetMemoryBudget() << "\n";
+  os << indent << "MappedImagesSize: " << this->memoryManager->GetMappedSize() << "\n";
+  os << indent << "MappedImagesResidentSize: " << this->memoryManager->GetResidentSize() << "\n";
 }
 
 //---------------------------------------------------------------------------
@@ -223,6 +2396,277 @@ void vtkSlicerVesselSegmentationLogic::OnMRMLNodeModified(vtkMRMLNode* vtkNotUse
 
 }
 
+//---------------------------------------------------------------------------
+/**
+ * Section to do with running the jobs
+ */
+void vtkSlicerVesselSegmentationLogic::RunJob(Job *job, bool urgent)
+{
+  job->Metrics = this->metrics;
+  job->MemoryManager = this->memoryManager;
+
+  if (!this->Asynchronous || this->GetApplicationLogic() == NULL)
+    {
+    // nobody to bring the result back to the main thread, run it here
+    job->State = JobRunning;
+    this->InvokeEvent(JobStartedEvent);
+    job->TouchUsedImages();
+    if (job->Prepare(this))
+      {
+      vtkSlicerVesselSegmentationLogic::ExecuteJob(job);
+      }
+    this->FinishJob(job);
+    delete job;
+    return;
+    }
+
+  job->State = JobQueued;
+  if (urgent)
+    {
+    this->pendingJobs.push_front(job);
+    }
+  else
+    {
+    this->pendingJobs.push_back(job);
+    }
+  this->StartNextJob();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::StartNextJob()
+{
+  while (this->currentJob == NULL && !this->pendingJobs.empty())
+    {
+    Job *job = this->pendingJobs.front();
+    this->pendingJobs.pop_front();
+
+    this->currentJob = job;
+    job->State = JobRunning;
+    this->InvokeEvent(JobStartedEvent);
+
+    job->TouchUsedImages();
+    if (!job->Prepare(this))
+      {
+      this->FinishCurrentJob();
+      continue;
+      }
+
+    job->AppLogic = this->GetApplicationLogic();
+    job->Notifier = this->jobNotifier;
+    if (job->AppLogic == NULL)
+      {
+      vtkSlicerVesselSegmentationLogic::ExecuteJob(job);
+      this->FinishCurrentJob();
+      continue;
+      }
+
+    this->jobThreadID = this->jobThreader->SpawnThread(
+        vtkSlicerVesselSegmentationLogic::JobThreadFunction, job);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::FinishCurrentJob()
+{
+  Job *job = this->currentJob;
+  if (job == NULL)
+    {
+    return;
+    }
+
+  if (this->jobThreadID >= 0)
+    {
+    this->jobThreader->TerminateThread(this->jobThreadID);
+    this->jobThreadID = -1;
+    }
+
+  // the job is still current while applied, so the jobs it
+  // submits (e.g. the model update) are queued behind it
+  this->FinishJob(job);
+  this->currentJob = NULL;
+  delete job;
+
+  this->StartNextJob();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::FinishJob(Job *job)
+{
+  if (job->IsAborted())
+    {
+    job->State = JobCancelled;
+    job->Discard(this);
+    }
+  else if (job->HasSucceeded())
+    {
+    job->State = JobCompleted;
+    job->Apply(this);
+    }
+  else
+    {
+    job->State = JobFailed;
+    // errors of Prepare have already been reported
+    std::string errorMessage = job->GetErrorMessage();
+    if (!errorMessage.empty())
+      {
+      vtkErrorMacro(<< job->Name << " failed: " << errorMessage);
+      }
+    job->Discard(this);
+    }
+
+  // the images the job did not use are spilled first
+  this->memoryManager->EnforceBudget();
+
+  this->lastJobState = job->State;
+  this->lastJobName = job->Name;
+  this->InvokeEvent(JobFinishedEvent);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::ExecuteJob(Job *job)
+{
+  bool succeeded = false;
+  std::string errorMessage;
+  try
+    {
+    succeeded = job->Execute() && !job->IsAborted();
+    }
+  catch (itk::ProcessAborted &)
+    {
+    // reported as cancelled
+    }
+  catch (itk::ExceptionObject &e)
+    {
+    errorMessage = e.GetDescription();
+    }
+
+  job->SetFinished(succeeded, errorMessage);
+}
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkSlicerVesselSegmentationLogic::JobThreadFunction(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  Job *job = static_cast<Job*>(info->UserData);
+
+  vtkSlicerVesselSegmentationLogic::ExecuteJob(job);
+
+  // always report back, also when cancelled or failed
+  job->AppLogic->RequestModified(job->Notifier);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::OnJobNotification(vtkObject* vtkNotUsed(caller),
+                                                         unsigned long vtkNotUsed(eid),
+                                                         void *clientData,
+                                                         void* vtkNotUsed(callData))
+{
+  vtkSlicerVesselSegmentationLogic *self =
+      static_cast<vtkSlicerVesselSegmentationLogic*>(clientData);
+
+  // the notification may belong to a job that was cancelled meanwhile
+  if (!self || self->currentJob == NULL)
+    {
+    return;
+    }
+
+  if (!self->currentJob->IsFinished())
+    {
+    double progress = self->currentJob->GetProgress();
+    self->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+    return;
+    }
+
+  self->FinishCurrentJob();
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerVesselSegmentationLogic::GetJobState()
+{
+  if (this->currentJob)
+    {
+    return JobRunning;
+    }
+  if (!this->pendingJobs.empty())
+    {
+    return JobQueued;
+    }
+  return this->lastJobState;
+}
+
+//---------------------------------------------------------------------------
+const char* vtkSlicerVesselSegmentationLogic::GetJobName()
+{
+  if (this->currentJob)
+    {
+    return this->currentJob->Name.c_str();
+    }
+  return this->lastJobName.c_str();
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerVesselSegmentationLogic::GetJobProgress()
+{
+  if (this->currentJob)
+    {
+    return this->currentJob->GetProgress();
+    }
+  return 0.0;
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerVesselSegmentationLogic::GetNumberOfPendingJobs()
+{
+  return static_cast<int>(this->pendingJobs.size());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::CancelJob()
+{
+  while (!this->pendingJobs.empty())
+    {
+    Job *job = this->pendingJobs.front();
+    this->pendingJobs.pop_front();
+    job->Abort();
+    this->FinishJob(job);
+    delete job;
+    }
+
+  if (this->currentJob)
+    {
+    // propagated to the internal filters, waits for the worker to stop
+    this->currentJob->Abort();
+    this->FinishCurrentJob();
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::WaitForJobs()
+{
+  // each finished job starts the next queued one
+  while (this->currentJob)
+    {
+    this->FinishCurrentJob();
+    }
+}
+
+//---------------------------------------------------------------------------
+const char* vtkSlicerVesselSegmentationLogic::GetJobStateAsString(int state)
+{
+  switch (state)
+    {
+    case JobIdle: return "Idle";
+    case JobQueued: return "Queued";
+    case JobRunning: return "Running";
+    case JobCompleted: return "Completed";
+    case JobCancelled: return "Cancelled";
+    case JobFailed: return "Failed";
+    default: return "Unknown";
+    }
+}
+
 //---------------------------------------------------------------------------
 /**
 * Preprocess image for better vesselness (pipeline of ITK filters)
@@ -233,91 +2677,180 @@ void vtkSlicerVesselSegmentationLogic::PreprocessImage( int lowerThreshold,
                                                         int beta,
                                                         unsigned int conductance,
                                                         unsigned int iterations )
+{
+  // a background preprocessing would otherwise overwrite this result
+  this->CancelPreprocessing();
+
+  this->RunJob(new PreprocessingJob(lowerThreshold, upperThreshold, alpha, beta,
+                                    conductance, iterations, false));
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::PreprocessImagePreview( int lowerThreshold,
+                                                               int upperThreshold,
+                                                               unsigned int alpha,
+                                                               int beta,
+                                                               unsigned int conductance,
+                                                               unsigned int iterations,
+                                                               unsigned int shrinkFactor )
 {
   vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = this->GetActiveVolume();
 
   // check have valid activevol
   if (!activeVol)
     {
-    vtkErrorMacro("SegmentVessels: could not get active volume.")
+    vtkErrorMacro("PreprocessImagePreview: could not get active volume.")
+    return;
+    }
+
+  if (!this->GetMRMLScene())
+    {
+    vtkErrorMacro("No MRML scene.");
+    return;
+    }
+
+  // newer parameters make the running job obsolete
+  this->CancelPreprocessing();
+
+  // the preview becomes the active volume, keep preprocessing the original
+  if (activeVol == this->preprocessedNode)
+    {
+    if (this->preprocessingSourceVolume == NULL ||
+        !this->GetMRMLScene()->IsNodePresent(this->preprocessingSourceVolume))
+      {
+      vtkErrorMacro("PreprocessImagePreview: lost the volume being preprocessed.")
+      return;
+      }
+    activeVol = this->preprocessingSourceVolume;
+    }
+  this->preprocessingSourceVolume = activeVol;
+
+  PreprocessingJob *job = new PreprocessingJob(lowerThreshold, upperThreshold, alpha, beta,
+                                               conductance, iterations, true);
+  job->InputScalarType = activeVol->GetImageData() ?
+      activeVol->GetImageData()->GetScalarType() : VTK_VOID;
+  job->Input = vtkVesselSegmentationHelper::ConvertVolumeNodeToNativeItkImage(activeVol);
+  if (job->Input.IsNull())
+    {
+    vtkErrorMacro("PreprocessImagePreview: conversion to ITK not successful.")
+    delete job;
+    return;
+    }
+  if (!this->ComputeRegionOfInterest(activeVol, job->Region))
+    {
+    delete job;
     return;
     }
 
-  // check again for the mrml scene, since used explicitly in this function
-  if (!this->GetMRMLScene())
+  // quick low resolution pass
+  PreprocessingFilterSetup previewSetup(job->Input, lowerThreshold, upperThreshold, alpha,
+                                        beta, conductance, iterations, shrinkFactor);
+  previewSetup.Region = job->Region;
+  switch (job->InputScalarType)
+    {
+    vtkVesselSegmentationTemplateMacro(previewSetup(static_cast<VTK_TT*>(NULL)));
+    default:
+      vtkErrorMacro("PreprocessImagePreview: scalar type of the volume is not supported.")
+      delete job;
+      return;
+    }
+
+  vtkVesselSegmentationMetrics::Probe previewProbe;
+  previewProbe.Start(this->metrics, "preview");
+  itk::TimeProbe clock1;
+  clock1.Start();
+  previewSetup.Filter->Update();
+  clock1.Stop();
+  previewProbe.Stop(previewSetup.Output->GetLargestPossibleRegion().GetNumberOfPixels());
+  vtkDebugMacro("Time taken for PreProcessing preview : " << clock1.GetMean() << "sec\n" );
+
+  this->UpdatePreprocessedNode(previewSetup.Output, *previewSetup.UncroppedRegion);
+
+  // full resolution pass
+  this->RunJob(job);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::CancelPreprocessing()
+{
+  std::deque<Job*> remainingJobs;
+  while (!this->pendingJobs.empty())
+    {
+    Job *job = this->pendingJobs.front();
+    this->pendingJobs.pop_front();
+    if (job->Preprocessing)
+      {
+      job->Abort();
+      this->FinishJob(job);
+      delete job;
+      }
+    else
+      {
+      remainingJobs.push_back(job);
+      }
+    }
+  this->pendingJobs.swap(remainingJobs);
+
+  if (this->currentJob && this->currentJob->Preprocessing)
     {
-    vtkErrorMacro("No MRML scene.");
-    return;
+    // propagated to the internal filters through the progress accumulator
+    this->currentJob->Abort();
+    this->FinishCurrentJob();
     }
+}
 
-  // Need to cast data the first time to get it into float
-  vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
-  cast->SetOutputScalarTypeToFloat();
-  cast->SetInputData( activeVol->GetImageData() );
-  cast->Update();
-  // casting is not in place (makes a copy), so switch what data the node is pointing to
-  activeVol->SetAndObserveImageData(cast->GetOutput());
-
-  vtkVesselSegmentationHelper::SeedImageType::Pointer itkConvertedImage =
-      vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(activeVol);
-  if (itkConvertedImage.IsNull() == true )
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::IsPreprocessingRunning()
+{
+  if (this->currentJob && this->currentJob->Preprocessing)
     {
-    vtkErrorMacro("PreprocessImage: conversion to ITK not successful.")
-    return;
+    return true;
     }
 
-  // Declare the type of objectness measure image filter
-  typedef itk::VesselSegmentationPreProcessingFilter<vtkVesselSegmentationHelper::SeedImageType,
-      vtkVesselSegmentationHelper::SeedImageType > VesselPreProcessingFilterType;
-
-  // Create a vesselness Filter
-  VesselPreProcessingFilterType::Pointer VesselPreProcessingFilter =
-      VesselPreProcessingFilterType::New();
-
-  //Connect to input image
-  VesselPreProcessingFilter->SetInput( itkConvertedImage );
-
-  VesselPreProcessingFilter->SetLowerThreshold(lowerThreshold);
-  VesselPreProcessingFilter->SetUpperThreshold(upperThreshold);
-  VesselPreProcessingFilter->SetAlpha(alpha);
-  VesselPreProcessingFilter->SetBeta(beta);
-  VesselPreProcessingFilter->SetConductance(conductance);
-  VesselPreProcessingFilter->SetNumberOfIterations(iterations);
-
-  // pass everything into function
-  itk::TimeProbe clock1;
-  clock1.Start();
-  VesselPreProcessingFilter->Update();
-  clock1.Stop();
-  vtkDebugMacro("Time taken for PreProcessing : " << clock1.GetMean() << "sec\n" );
-
-  preprocessedImg = VesselPreProcessingFilter->GetOutput();
+  for (std::deque<Job*>::iterator it = this->pendingJobs.begin();
+       it != this->pendingJobs.end(); ++it)
+    {
+    if ((*it)->Preprocessing)
+      {
+      return true;
+      }
+    }
 
-  preprocessedImg->ReleaseDataFlagOff();
-  preprocessedImg->DisconnectPipeline();
+  return false;
+}
 
-  // at this point it should be a copy of the data? since it is the output of a non in place filter...
-  vtkSmartPointer<vtkImageData> tempVtkImageData =
-      vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(preprocessedImg);
-  if (tempVtkImageData == NULL)
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::UpdatePreprocessedNode(
+    vtkVesselSegmentationHelper::SeedImageType::Pointer image,
+    const vtkVesselSegmentationHelper::SeedImageType::RegionType &wholeRegion)
+{
+  // shares the buffer of the ITK image, which it keeps alive, unless the
+  // image is cropped to the region of interest
+  vtkSmartPointer<vtkImageData> imageData = ConvertToNodeImageData(image.GetPointer(), wholeRegion);
+  if (imageData == NULL)
     {
-    vtkErrorMacro("PreprocessImage: conversion to ITK not successful.")
+    vtkErrorMacro("UpdatePreprocessedNode: conversion to VTK not successful.")
     return;
     }
 
-  // Need to cast data to get it to be copied so it doesn't go out of scope
-  // if we make more than one preprocessed image
-  vtkSmartPointer<vtkImageCast> cast2 = vtkSmartPointer<vtkImageCast>::New();
-  cast2->SetOutputScalarTypeToFloat();
-  cast2->SetInputData( tempVtkImageData );
-  cast2->Update();
-  // casting is not in place (makes a copy), so switch what data the node is pointing to
-
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> preprocessedNode =
-      vtkVesselSegmentationHelper::ConvertVtkImageDataToVolumeNode(cast2->GetOutput(), preprocessedImg, true);
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> convertedNode =
+      vtkVesselSegmentationHelper::ConvertVtkImageDataToVolumeNode(imageData, image, true);
 
-  preprocessedNode->SetName("preprocessedImage");
-  this->GetMRMLScene()->AddNode(preprocessedNode);
+  if (this->preprocessedNode == NULL ||
+      !this->GetMRMLScene()->IsNodePresent(this->preprocessedNode))
+    {
+    // first time, show it in the slice views
+    this->preprocessedNode = convertedNode;
+    this->preprocessedNode->SetName("preprocessedImage");
+    this->GetMRMLScene()->AddNode(this->preprocessedNode);
+    this->SetAndPropagateActiveVolume(this->preprocessedNode);
+    }
+  else
+    {
+    // preview and full resolution differ in geometry, so copy both
+    this->preprocessedNode->CopyOrientation(convertedNode);
+    this->preprocessedNode->SetAndObserveImageData(imageData);
+    }
 }
 
 //---------------------------------------------------------------------------
@@ -340,6 +2873,7 @@ void vtkSlicerVesselSegmentationLogic::SegmentVesselsFromWidget(bool isHepatic)
   // check if this seed node satisfies the requirements for segmentation
   if(seedNode != NULL && seedNode->GetIsSeed1Set() && seedNode->GetIsSeed2Set())
     {
+    // the seeds are copied, so new ones can be placed while this one runs
     this->SegmentVessels(seedNode, isHepatic);
     // then remove from scene
     scene->RemoveNode(seedNode);
@@ -355,198 +2889,7 @@ void vtkSlicerVesselSegmentationLogic::SegmentVesselsFromWidget(bool isHepatic)
 void vtkSlicerVesselSegmentationLogic::SegmentVessels(
     vtkMRMLVesselSegmentationSeedNode *seedNode, bool isHepatic)
 {
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = this->GetActiveVolume();
-
-  // check have valid activevol
-  if (!activeVol)
-    {
-    vtkErrorMacro("SegmentVessels: could not get active volume.")
-    return;
-    }
-  /*
-   * check if we already have an image converted to ITK
-   * if not then create it
-   */
-  if( this->preprocessedImg.IsNull() )
-    {
-    this->preprocessedImg = vtkVesselSegmentationHelper::
-        ConvertVolumeNodeToItkImage(activeVol);
-
-    if( this->preprocessedImg.IsNull() )
-    {
-      vtkErrorMacro("SegmentVessels: conversion to ITK not successful, "
-          "do not have preprocessed image.")
-      return;
-    }
-  }
-
-  vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
-  activeVol->GetIJKToRASMatrix(mat);
-  vtkNew<vtkMatrix4x4> IJKtoRASmatrix;
-  vtkNew<vtkMatrix4x4> RAStoIJKmatrix;
-  IJKtoRASmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->Invert();
-
-  // get the pair of seeds in the right format for the itk filter
-  double *seed1 = seedNode->GetSeed1();
-  double *seed2 = seedNode->GetSeed2();
-
-  const double seed1_0[4] = {seed1[0], seed1[1], seed1[2], 1}; // RAS
-  const double seed2_0[4] = {seed1[0], seed2[1], seed2[2], 1}; // RAS
-
-  double *seedIJK1 = new double[4]; // the actual first seed
-  double *seedIJK2 = new double[4]; // the direction seed
-
-  // use the ijk matrix to convert the points
-  RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed1_0, seedIJK1);
-  RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed2_0, seedIJK2);
-
-  vtkVesselSegmentationHelper::Index3D coord1;
-  vtkVesselSegmentationHelper::Index3D coord2;
-
-  // the actual first seed
-  coord1[0] = seedIJK1[0];
-  coord1[1] = seedIJK1[1];
-  coord1[2] = seedIJK1[2];
-  // the direction seed
-  coord2[0] = seedIJK2[0];
-  coord2[1] = seedIJK2[1];
-  coord2[2] = seedIJK2[2];
-
-  //std::cout << "Seed IJK1 (155, 118, 41): " << coord1[0] << " " << coord1[1] << " " << coord1[2] << std::endl;
-  //std::cout << "Seed IJK2 (145, 116, 55): " << coord2[0] << " " << coord2[1] << " " << coord2[2] << std::endl;
-
-  // create filter
-  typedef itk::SeedVesselSegmentationImageFilter<vtkVesselSegmentationHelper::SeedImageType,
-      vtkVesselSegmentationHelper::SeedImageType>  SeedFilterType;
-  SeedFilterType::Pointer filter = SeedFilterType::New();
-
-  /*
-   * Have what is needed to call segmentation algorithm
-   * a pair of seeds and an ITK image
-   */
-  if(isHepatic == true) // HEPATIC radio button is selected
-    {
-    // instantiate filter
-    itk::TimeProbe clock1;
-    clock1.Start();
-
-    vtkDebugMacro( "Seed IJK: " << coord1 << " Direction seed: " << coord2 );
-
-    filter->SetInput(preprocessedImg);
-    filter->SetSeed(coord1);
-    filter->SetDirectionSeed(coord2);
-    filter->SetOutputLabel(4);
-    if( this->hepaticITKdata.IsNotNull() )
-      {
-      filter->SetPreviousOutput(this->hepaticITKdata);
-      }
-    filter->Update();
-
-    this->hepaticITKdata  = filter->GetOutput();
-    clock1.Stop();
-    vtkDebugMacro( "Time taken for itk::SeedVesselSegmentationImageFilter : "
-        << clock1.GetMean() <<"sec\n" );
-
-    // convert output of filter back to VTK
-    vtkSmartPointer<vtkImageData> outVTKImage = vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(this->hepaticITKdata);
-    if (outVTKImage.GetPointer()  == NULL )
-      {
-      vtkErrorMacro("SegmentVessels: conversion to VTK not successful.")
-      return;
-      }
-
-    if(this->hepaticLabelMap == NULL)
-      {
-      // first time to create a hepatic label map
-      this->hepaticLabelMap = vtkSmartPointer<vtkMRMLLabelMapVolumeNode>::New();
-      this->hepaticLabelMap->CopyOrientation(activeVol);
-      this->hepaticLabelMap->SetAndObserveImageData(outVTKImage.GetPointer());
-      this->hepaticLabelMap->SetName("hepaticLabel");
-      this->GetMRMLScene()->AddNode(this->hepaticLabelMap);
-
-      // make this label map the selected one
-      this->SetAndPropagateActiveLabel(this->hepaticLabelMap);
-
-      // have updated hepatic, but now merged is not up to date
-      this->hepaticUpdated = true;
-      this->mergedUpdated = false;
-      }
-    else // already had an hepaticLabelMap
-      {
-      this->hepaticLabelMap->SetAndObserveImageData(outVTKImage.GetPointer());
-
-      // have updated hepatic, but now merged is not up to date
-      this->hepaticUpdated = true;
-      this->mergedUpdated = false;
-      }
-    }
-    else // PORTAL radio button is selected
-      {
-      // instantiate filter
-      itk::TimeProbe clock1;
-      clock1.Start();
-      typedef itk::SeedVesselSegmentationImageFilter<vtkVesselSegmentationHelper::SeedImageType,
-          vtkVesselSegmentationHelper::SeedImageType>  SeedFilterType;
-
-      vtkDebugMacro( "Seed IJK: " << coord1 << " Direction seed: " << coord2 );
-
-      // Create a seed filter
-      SeedFilterType::Pointer filter = SeedFilterType::New();
-      filter->SetInput(preprocessedImg);
-      filter->SetSeed(coord1);
-      filter->SetDirectionSeed(coord2);
-      filter->SetOutputLabel(5);
-      if( this->portalITKdata.IsNotNull() )
-        {
-        filter->SetPreviousOutput(this->portalITKdata);
-        }
-      filter->Update();
-
-      this->portalITKdata  = filter->GetOutput();
-      clock1.Stop();
-      vtkDebugMacro( "Time taken for itk::SeedVesselSegmentationImageFilter : "
-          << clock1.GetMean() <<"sec\n" );
-
-      //----------------------------------------------------------------------------
-      // convert output of filter back to VTK
-      vtkSmartPointer<vtkImageData> outVTKImage = vtkVesselSegmentationHelper::
-          ConvertItkImageToVtkImageData(this->portalITKdata);
-
-      if (outVTKImage.GetPointer()  == NULL )
-        {
-        vtkErrorMacro("SegmentVessels: conversion to VTK not successful.")
-        return;
-        }
-
-      if(this->portalLabelMap == NULL)
-        {
-        // first time to create a portal label map
-        this->portalLabelMap = vtkSmartPointer<vtkMRMLLabelMapVolumeNode>::New();
-        this->portalLabelMap->CopyOrientation(activeVol);
-        this->portalLabelMap->SetAndObserveImageData(outVTKImage.GetPointer());
-        this->portalLabelMap->SetName("portalLabel");
-        this->GetMRMLScene()->AddNode(this->portalLabelMap);
-
-        // make this label map the selected one
-        this->SetAndPropagateActiveLabel(this->portalLabelMap);
-
-        // have updated portal, but now merged is not up to date
-        this->portalUpdated = true;
-        this->mergedUpdated = false;
-        }
-      else // already had an portalLabelMap
-        {
-        this->portalLabelMap->SetAndObserveImageData(outVTKImage.GetPointer());
-
-        // have updated portal, but now merged is not up to date
-        this->portalUpdated = true;
-        this->mergedUpdated = false;
-      }
-    }
-    // will updated models if data has been modified: portalUpdated or hepaticUpdated
-    this->UpdateModels();
+  this->RunJob(new SegmentationJob(seedNode, isHepatic));
 }
 
 //---------------------------------------------------------------------------
@@ -555,82 +2898,7 @@ void vtkSlicerVesselSegmentationLogic::SegmentVessels(
 */
 void vtkSlicerVesselSegmentationLogic::MergeLabelMaps()
 {
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = this->GetActiveVolume();
-
-  // check have valid activevol
-  if (!activeVol)
-    {
-    vtkErrorMacro("MergeLabelMaps: could not get active volume.")
-    return;
-    }
-  // check if we have the ITK versions of data, and try to convert it if not
-  if( this->hepaticITKdata.IsNull() )
-    {
-    this->hepaticITKdata =
-        vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(this->hepaticLabelMap);
-    }
-  if( this->portalITKdata.IsNull() )
-    {
-    this->portalITKdata =
-        vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(this->portalLabelMap);
-    }
-
-  // check we have the data needed (if the conversions worked)
-  if( this->hepaticITKdata.IsNull() && this->portalITKdata.IsNull() )
-    {
-    vtkErrorMacro("CallMergeLabelMaps: Do not have 2 label maps.")
-    return;
-    }
-  else if( this->hepaticITKdata.IsNull() )
-    {
-    vtkErrorMacro("CallMergeLabelMaps: Do not have hepatic label map.")
-    return;
-    }
-  else if( this->portalITKdata.IsNull() )
-    {
-    vtkErrorMacro("CallMergeLabelMaps: Do not have portal label map.")
-    return;
-    }
-
-  typedef itk::AddImageFilter<vtkVesselSegmentationHelper::SeedImageType,
-      vtkVesselSegmentationHelper::SeedImageType> AddFilterType;
-  AddFilterType::Pointer addFilter = AddFilterType::New();
-  addFilter->SetInput1(this->hepaticITKdata);
-  addFilter->SetInput2(this->portalITKdata);
-  addFilter->Update();
-  this->mergedITKdata = addFilter->GetOutput();
-
-  // convert output of add filter back to VTK
-  vtkSmartPointer<vtkImageData> mergedVTKImage =
-      vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(this->mergedITKdata);
-
-  if (mergedVTKImage.GetPointer()  == NULL )
-    {
-    vtkErrorMacro("CallMergeLabelMaps: Conversion to VTK not successful.")
-    return;
-    }
-
-  if(this->mergedLabelMap == NULL)
-    {
-    // first time to create a hepatic label map
-    mergedLabelMap = vtkSmartPointer<vtkMRMLLabelMapVolumeNode>::New();
-    mergedLabelMap->CopyOrientation(activeVol);
-    mergedLabelMap->SetAndObserveImageData(mergedVTKImage.GetPointer());
-    mergedLabelMap->SetName("mergedLabel");
-    this->GetMRMLScene()->AddNode(mergedLabelMap);
-
-    // merged label map has been updated
-    this->mergedUpdated = true;
-    }
-  else
-    {
-    mergedLabelMap->SetAndObserveImageData(mergedVTKImage.GetPointer());
-
-    // merged label map has been updated
-    this->mergedUpdated = true;
-    }
-
-  this->SetAndPropagateActiveLabel(this->mergedLabelMap);
+  this->RunJob(new MergeJob);
 }
 
 //---------------------------------------------------------------------------
@@ -665,336 +2933,280 @@ void vtkSlicerVesselSegmentationLogic::SplitVesselsFromWidget(bool isHepatic)
 void vtkSlicerVesselSegmentationLogic::SplitVessels(
     vtkMRMLVesselSegmentationSeedNode *seedNode, bool isHepatic)
 {
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = this->GetActiveVolume();
+  this->RunJob(new SplitJob(seedNode, isHepatic));
+}
 
-  // check have valid activevol
-  if (!activeVol)
-    {
-    vtkErrorMacro("SplitVessels: could not get active volume.")
-    return;
-    }
-  // check have a merged label map
-  if( this->mergedITKdata.IsNull() )
-    {
-    vtkErrorMacro("SplitVessels: Do not have merged label map.")
-    return;
-    }
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::Undo()
+{
+  return this->ApplyHistoryStep(true);
+}
 
-  vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
-  activeVol->GetIJKToRASMatrix(mat);
-  vtkNew<vtkMatrix4x4> IJKtoRASmatrix;
-  vtkNew<vtkMatrix4x4> RAStoIJKmatrix;
-  IJKtoRASmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->Invert();
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::Redo()
+{
+  return this->ApplyHistoryStep(false);
+}
 
-  double *seed1 = seedNode->GetSeed1();
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::CanUndo()
+{
+  return this->labelHistory->GetNumberOfUndoSteps() > 0;
+}
 
-  const double seed1_0[4] = {seed1[0], seed1[1], seed1[2], 1}; // IJK
-  // have a seed
-  double *seedIJK = new double[4];
-  // use the ijk matrix to convert the points
-  RAStoIJKmatrix.GetPointer()->MultiplyPoint(seed1_0, seedIJK); //was commented out in old code?
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::CanRedo()
+{
+  return this->labelHistory->GetNumberOfRedoSteps() > 0;
+}
 
-  itk::Point<double, 3> seedLPS;
-  seedLPS[0] = - seedIJK[0];
-  seedLPS[1] = - seedIJK[1];
-  seedLPS[2] = seedIJK[2];
+//---------------------------------------------------------------------------
+vtkVesselSegmentationLabelHistory* vtkSlicerVesselSegmentationLogic::GetLabelHistory()
+{
+  return this->labelHistory;
+}
 
-  //Cast image for LabelMap
-  typedef itk::Image<LabelType, 3>  LabelImageType;
-  typedef itk::CastImageFilter< vtkVesselSegmentationHelper::SeedImageType, LabelImageType > CastFilterType;
-  CastFilterType::Pointer castFilter = CastFilterType::New();
-  castFilter->SetInput(mergedITKdata);
-  castFilter->Update();
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMetrics* vtkSlicerVesselSegmentationLogic::GetMetrics()
+{
+  return this->metrics;
+}
 
-  // create image with just overlapping areas (overlapping areas added lower down)
-  LabelImageType::Pointer OnlyOverlap = LabelImageType::New();
-  OnlyOverlap->CopyInformation(castFilter->GetOutput());
-  OnlyOverlap->SetRegions(castFilter->GetOutput()->GetRequestedRegion());
-  OnlyOverlap->Allocate();
-  OnlyOverlap->FillBuffer(0);
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager* vtkSlicerVesselSegmentationLogic::GetMemoryManager()
+{
+  return this->memoryManager;
+}
 
-  itk::ImageRegionIteratorWithIndex<LabelImageType> itOrg(castFilter->GetOutput(),
-      castFilter->GetOutput()->GetRequestedRegion());
-  itk::ImageRegionIteratorWithIndex<LabelImageType> itOnlyOverlap(OnlyOverlap,
-      OnlyOverlap->GetRequestedRegion());
+//---------------------------------------------------------------------------
+/**
+* Section to do with the region of interest
+*/
+void vtkSlicerVesselSegmentationLogic::SetRegionOfInterest(const double bounds[6])
+{
+  if (bounds[1] < bounds[0] || bounds[3] < bounds[2] || bounds[5] < bounds[4])
+    {
+    vtkErrorMacro("SetRegionOfInterest: the bounds are empty.");
+    return;
+    }
 
-  // Copy only overlapping regions to the image created above
-  for(itOrg.GoToBegin(), itOnlyOverlap.GoToBegin(); !itOrg.IsAtEnd(); ++itOrg, ++itOnlyOverlap)
+  for (int i = 0; i < 6; ++i)
     {
-    if(itOrg.Get() == 9)
-      {
-      itOnlyOverlap.Set( 1 );
-      }
+    this->regionOfInterest[i] = bounds[i];
     }
+  this->hasRegionOfInterest = true;
+  this->Modified();
+}
 
-  // if first time, or if segmentations have been updated
-  if( this->onlyOverlapLabelMap.IsNull() || this->mergedUpdated == true )
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::SetRegionOfInterestFromNode(vtkMRMLDisplayableNode *node)
+{
+  if (node == NULL)
     {
-    itk::TimeProbe clock1;
-    clock1.Start();
+    vtkErrorMacro("SetRegionOfInterestFromNode: no node.");
+    return false;
+    }
 
-    //Structuring Element for Dilation filter
-    typedef itk::BinaryBallStructuringElement< LabelType, 3 > StructuringElementType;
-    StructuringElementType structuringElement;
-    structuringElement.SetRadius(4);
-    structuringElement.CreateStructuringElement();
-
-    //Dilation filter for increasing the border size of the object
-    typedef itk::BinaryDilateImageFilter <LabelImageType, LabelImageType,
-        StructuringElementType>  BinaryDilateImageFilterType;
-    BinaryDilateImageFilterType::Pointer dilateFilter = BinaryDilateImageFilterType::New();
-    dilateFilter->SetInput(OnlyOverlap);
-    dilateFilter->SetKernel(structuringElement);
-    dilateFilter->SetBackgroundValue(0);
-    dilateFilter->SetForegroundValue(1);
-
-    //Label connected objects separately
-    typedef itk::ConnectedComponentImageFilter <LabelImageType, LabelImageType >   ConnectedComponentImageFilterType;
-    ConnectedComponentImageFilterType::Pointer connectedComponent =   ConnectedComponentImageFilterType::New ();
-    connectedComponent->SetInput(dilateFilter->GetOutput());
-    connectedComponent->SetBackgroundValue(0);
-
-    //Convert LabelImage to LabelMap containing connected labelObjects
-    typedef itk::LabelImageToShapeLabelMapFilter< LabelImageType, LabelMapType> LabelImageToLabelMapFilterType;
-    LabelImageToLabelMapFilterType::Pointer labelImageToLabelMapFilter = LabelImageToLabelMapFilterType::New();
-    labelImageToLabelMapFilter->SetInput(connectedComponent->GetOutput());
-    labelImageToLabelMapFilter->SetBackgroundValue( itk::NumericTraits< LabelType >::Zero );
-    labelImageToLabelMapFilter->Update();
+  double bounds[6] = {1.0, -1.0, 1.0, -1.0, 1.0, -1.0};
+  vtkMRMLLabelMapVolumeNode *labelMap = vtkMRMLLabelMapVolumeNode::SafeDownCast(node);
+  if (labelMap)
+    {
+    // the box of the labelled voxels, not of the whole volume
+    vtkVesselSegmentationHelper::LabelImageType::Pointer image =
+        vtkVesselSegmentationHelper::ConvertVolumeNodeToItkLabelImage(labelMap, false, false);
+    if (image.IsNull())
+      {
+      vtkErrorMacro("SetRegionOfInterestFromNode: conversion to ITK not successful.");
+      return false;
+      }
 
-    clock1.Stop();
-    vtkDebugMacro( "Dilation and Connected Components - time taken : " << clock1.GetMean() <<"sec\n" );
+    vtkVesselSegmentationHelper::LabelImageType::IndexType lower;
+    vtkVesselSegmentationHelper::LabelImageType::IndexType upper;
+    lower.Fill(0);
+    upper.Fill(0);
+    bool found = false;
+    itk::ImageRegionConstIteratorWithIndex<vtkVesselSegmentationHelper::LabelImageType>
+        it(image, image->GetLargestPossibleRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+      {
+      if (it.Get() == 0)
+        {
+        continue;
+        }
+      const vtkVesselSegmentationHelper::LabelImageType::IndexType &index = it.GetIndex();
+      for (unsigned int d = 0; d < 3; d++)
+        {
+        lower[d] = found ? std::min(lower[d], index[d]) : index[d];
+        upper[d] = found ? std::max(upper[d], index[d]) : index[d];
+        }
+      found = true;
+      }
+    if (!found)
+      {
+      vtkErrorMacro("SetRegionOfInterestFromNode: label map " << labelMap->GetName() << " is empty.");
+      return false;
+      }
 
-    this->onlyOverlapLabelMap = labelImageToLabelMapFilter->GetOutput();
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    labelMap->GetIJKToRASMatrix(ijkToRAS.GetPointer());
+    for (int c = 0; c < 8; ++c)
+      {
+      const double ijk[4] = { static_cast<double>((c & 1) ? upper[0] : lower[0]),
+                              static_cast<double>((c & 2) ? upper[1] : lower[1]),
+                              static_cast<double>((c & 4) ? upper[2] : lower[2]), 1.0 };
+      double ras[4];
+      ijkToRAS->MultiplyPoint(ijk, ras);
+      for (int d = 0; d < 3; d++)
+        {
+        bounds[2*d] = c == 0 ? ras[d] : std::min(bounds[2*d], ras[d]);
+        bounds[2*d+1] = c == 0 ? ras[d] : std::max(bounds[2*d+1], ras[d]);
+        }
+      }
     }
-
-  //Find LabelObject containing Seed
-  unsigned int labelObjectNumber = 0;
-  double distance = 0.0;
-  double minDistance = 100000.0;
-  itk::Point<double, 3> objectCentroid;
-
-  // Loop over each connected object to find minimum distance
-  for(unsigned int n = 0; n < this->onlyOverlapLabelMap->GetNumberOfLabelObjects(); n++)
+  else
     {
-    ShapeLabelObjectType * labelObject = this->onlyOverlapLabelMap->GetNthLabelObject(n);
+    // e.g. a model or a segmentation of the liver parenchyma
+    node->GetRASBounds(bounds);
+    }
 
-    // check if this connected object is of value 9 in label map
-    itOrg.SetIndex(labelObject->GetIndex(0));
-    int labelValue = itOrg.Get();
+  if (bounds[1] < bounds[0] || bounds[3] < bounds[2] || bounds[5] < bounds[4])
+    {
+    vtkErrorMacro("SetRegionOfInterestFromNode: node " << node->GetName() << " does not have bounds.");
+    return false;
+    }
 
-    vtkDebugMacro( "Found a label of: " << labelObject->GetLabel() << " underlying label: "
-            << labelValue << " number of pixels: " << labelObject->GetNumberOfPixels() );
+  this->SetRegionOfInterest(bounds);
+  return true;
+}
 
-    objectCentroid = labelObject->GetCentroid();
-    vtkDebugMacro("  coordinates of Centroid :" << objectCentroid );
-    distance = seedLPS.EuclideanDistanceTo(objectCentroid);
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::RemoveRegionOfInterest()
+{
+  if (!this->hasRegionOfInterest)
+    {
+    return;
+    }
+  this->hasRegionOfInterest = false;
+  this->Modified();
+}
 
-    if((minDistance > distance) && (labelObject->GetNumberOfPixels() > 100))
-      {
-      minDistance = distance;
-      labelObjectNumber = n;
-      vtkDebugMacro( "Distance and label object number set: " << distance << " " << n );
-      }
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::GetRegionOfInterest(double bounds[6])
+{
+  if (!this->hasRegionOfInterest)
+    {
+    return false;
+    }
+  for (int i = 0; i < 6; ++i)
+    {
+    bounds[i] = this->regionOfInterest[i];
     }
+  return true;
+}
 
-  // assign object
-  itk::ImageRegionIteratorWithIndex<vtkVesselSegmentationHelper::SeedImageType>
-      itMerged(mergedITKdata, mergedITKdata->GetRequestedRegion());
-  itk::ImageRegionIteratorWithIndex<vtkVesselSegmentationHelper::SeedImageType>
-      itHepatic(hepaticITKdata, hepaticITKdata->GetRequestedRegion());
-  itk::ImageRegionIteratorWithIndex<vtkVesselSegmentationHelper::SeedImageType>
-      itPortal(portalITKdata, portalITKdata->GetRequestedRegion());
+//---------------------------------------------------------------------------
+bool vtkSlicerVesselSegmentationLogic::ComputeRegionOfInterest(vtkMRMLVolumeNode *volume,
+    vtkVesselSegmentationHelper::LabelImageType::RegionType &region)
+{
+  region = GetVolumeRegion(volume);
+  if (!this->hasRegionOfInterest)
+    {
+    return true;
+    }
 
-  // Change Selected LabelObject as Hepatic or Portal
-  ShapeLabelObjectType * selectedLabelObject = this->onlyOverlapLabelMap->GetNthLabelObject(labelObjectNumber);
-  if(isHepatic) // hepatic
+  // voxels of the corners of the box and its margin
+  vtkNew<vtkMatrix4x4> rasToIJK;
+  volume->GetRASToIJKMatrix(rasToIJK.GetPointer());
+  double lower[3] = {0.0, 0.0, 0.0};
+  double upper[3] = {0.0, 0.0, 0.0};
+  for (int c = 0; c < 8; ++c)
     {
-    for(unsigned int pixelId = 0; pixelId < selectedLabelObject->Size(); pixelId++)
+    double ras[4] = {0.0, 0.0, 0.0, 1.0};
+    for (int d = 0; d < 3; d++)
       {
-      itMerged.SetIndex(selectedLabelObject->GetIndex(pixelId));
-      if(itMerged.Get()) // merged region exists
-        {
-          // change the merged label map to hepatic
-          itMerged.Set(4);
-          // erase the portal in this area
-          itPortal.SetIndex(selectedLabelObject->GetIndex(pixelId));
-          itPortal.Set(0);
-          // ensure the hepatic label map is also correct
-          itHepatic.SetIndex(selectedLabelObject->GetIndex(pixelId));
-          if(!itHepatic.Get())
-          {
-            itHepatic.Set(4);
-          }
-        }
+      ras[d] = (c & (1 << d)) ? this->regionOfInterest[2*d+1] + this->RegionOfInterestMargin :
+                                this->regionOfInterest[2*d] - this->RegionOfInterestMargin;
       }
-    }
-  else // portal
-    {
-    for(unsigned int pixelId = 0; pixelId < selectedLabelObject->Size(); pixelId++)
+    double ijk[4];
+    rasToIJK->MultiplyPoint(ras, ijk);
+    for (int d = 0; d < 3; d++)
       {
-      itMerged.SetIndex(selectedLabelObject->GetIndex(pixelId));
-      if(itMerged.Get()) // merged region exists
-        {
-        // change the merged label map to portal
-        itMerged.Set(5);
-        // erase the hepatic in this area
-        itHepatic.SetIndex(selectedLabelObject->GetIndex(pixelId));
-        itHepatic.Set(0);
-        // ensure the portal label map is also correct
-        itPortal.SetIndex(selectedLabelObject->GetIndex(pixelId));
-        if(!itPortal.Get())
-          {
-          itPortal.Set(5);
-          }
-        }
+      lower[d] = c == 0 ? ijk[d] : std::min(lower[d], ijk[d]);
+      upper[d] = c == 0 ? ijk[d] : std::max(upper[d], ijk[d]);
       }
     }
 
-  this->hepaticUpdated = true;
-  this->portalUpdated = true;
-  this->UpdateModels();
+  vtkVesselSegmentationHelper::LabelImageType::RegionType box;
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    itk::IndexValueType first = static_cast<itk::IndexValueType>(std::floor(lower[d]));
+    itk::IndexValueType last = static_cast<itk::IndexValueType>(std::ceil(upper[d]));
+    box.SetIndex(d, first);
+    box.SetSize(d, static_cast<itk::SizeValueType>(last - first + 1));
+    }
 
-  this->mergedUpdated = false;
-  this->SetAndPropagateActiveLabel(this->mergedLabelMap);
+  if (!box.Crop(region))
+    {
+    vtkErrorMacro("ComputeRegionOfInterest: the region of interest is outside of volume "
+                  << (volume->GetName() ? volume->GetName() : "") << ".");
+    return false;
+    }
+  region = box;
+  return true;
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerVesselSegmentationLogic::UpdateModels()
+bool vtkSlicerVesselSegmentationLogic::ApplyHistoryStep(bool undo)
 {
-  vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol = this->GetActiveVolume();
-
-  // check have valid activevol
-  if (!activeVol)
+  // the jobs read the label maps written here, and may add steps
+  this->WaitForJobs();
+  this->memoryManager->Touch(MappedImageNames[HepaticMappedImage]);
+  this->memoryManager->Touch(MappedImageNames[PortalMappedImage]);
+
+  vtkVesselSegmentationHelper::LabelImageType *labelMaps[NumberOfHistoryLabelMaps] =
+    { this->hepaticITKdata.GetPointer(), this->portalITKdata.GetPointer() };
+  vtkVesselSegmentationHelper::LabelImageType::RegionType modifiedRegions[NumberOfHistoryLabelMaps];
+
+  bool applied = undo ?
+      this->labelHistory->Undo(labelMaps, NumberOfHistoryLabelMaps, modifiedRegions) :
+      this->labelHistory->Redo(labelMaps, NumberOfHistoryLabelMaps, modifiedRegions);
+  if (!applied)
     {
-    vtkErrorMacro("UpdateModels: could not get active volume.")
-    return;
+    vtkErrorMacro(<< (undo ? "Undo" : "Redo") << ": no step to apply to the label maps.");
+    return false;
     }
 
-  vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
-  activeVol->GetIJKToRASMatrix(mat);
-  vtkNew<vtkMatrix4x4> IJKtoRASmatrix;
-  vtkNew<vtkMatrix4x4> RAStoIJKmatrix;
-  IJKtoRASmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->DeepCopy(mat);
-  RAStoIJKmatrix->Invert();
-
-  if(this->hepaticLabelMap != NULL && this->hepaticUpdated)
-  {
-    vtkSmartPointer<vtkImageToStructuredPoints> structuredPointsHepatic =
-        vtkSmartPointer<vtkImageToStructuredPoints>::New();
-    vtkSmartPointer<vtkDiscreteMarchingCubes> mCubesHepatic =
-        vtkSmartPointer<vtkDiscreteMarchingCubes>::New();
-
-    structuredPointsHepatic->SetInputData(this->hepaticLabelMap->GetImageData());
-    structuredPointsHepatic->Update();
-    mCubesHepatic->SetInputConnection(structuredPointsHepatic->GetOutputPort());
-    mCubesHepatic->SetValue(0,4);
-    mCubesHepatic->Update();
-
-    vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother =
-        vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
-    vtkSmartPointer<vtkTransform> translation =
-        vtkSmartPointer<vtkTransform>::New();
-    vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter =
-        vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-
-    smoother->SetInputConnection(mCubesHepatic->GetOutputPort());
-    smoother->SetNumberOfIterations(10);
-    smoother->BoundarySmoothingOff();
-    smoother->FeatureEdgeSmoothingOff();
-    smoother->SetFeatureAngle(120.0);
-    smoother->SetPassBand(.001);
-    smoother->NonManifoldSmoothingOn();
-    smoother->NormalizeCoordinatesOn();
-    smoother->Update();
-
-    translation->SetMatrix(IJKtoRASmatrix.GetPointer());
-
-    transformFilter->SetInputConnection(smoother->GetOutputPort());
-    transformFilter->SetTransform(translation);
-    transformFilter->Update();
-
-    if( this->hepaticModelNode == NULL )
-    {
-      // first time to create hepatic model node
-      this->hepaticModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
-      this->hepaticModelNode->SetName("hepaticVesselModel");
-      this->hepaticModelNode->SetAndObservePolyData(transformFilter->GetOutput());
-      this->GetMRMLScene()->AddNode(this->hepaticModelNode);
-
-      // also need a display node
-      this->hepaticModelDisplayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
-      this->hepaticModelDisplayNode->SetColor(0,0,1); // blue
-      this->GetMRMLScene()->AddNode(this->hepaticModelDisplayNode);
-      this->hepaticModelNode->SetAndObserveDisplayNodeID(this->hepaticModelDisplayNode->GetID());
-    }
-    else // add to 3D model, as already have nodes
-    {
-      this->hepaticModelNode->SetAndObservePolyData(transformFilter->GetOutput());
-    }
-    this->hepaticUpdated = false;
+  // the label map nodes share their buffers with the ITK images, or hold
+  // copies of them when they are cropped
+  if (modifiedRegions[HepaticHistoryLabelMap].GetNumberOfPixels() > 0)
+    {
+    UnionLabelRegion(this->hepaticDirtyRegion, modifiedRegions[HepaticHistoryLabelMap]);
+    AddModifiedLabelRegion(this->vesselMesher, HepaticMesherLabel,
+                           modifiedRegions[HepaticHistoryLabelMap]);
+    UpdateLabelMapRegion(this->hepaticLabelMap, this->hepaticITKdata,
+                         modifiedRegions[HepaticHistoryLabelMap]);
+    this->hepaticUpdated = true;
+    }
+  if (modifiedRegions[PortalHistoryLabelMap].GetNumberOfPixels() > 0)
+    {
+    UnionLabelRegion(this->portalDirtyRegion, modifiedRegions[PortalHistoryLabelMap]);
+    AddModifiedLabelRegion(this->vesselMesher, PortalMesherLabel,
+                           modifiedRegions[PortalHistoryLabelMap]);
+    UpdateLabelMapRegion(this->portalLabelMap, this->portalITKdata,
+                         modifiedRegions[PortalHistoryLabelMap]);
+    this->portalUpdated = true;
+    }
 
-  }
-  if(this->portalLabelMap != NULL && this->portalUpdated)
-  {
-    vtkSmartPointer<vtkImageToStructuredPoints> structuredPointsPortal =
-        vtkSmartPointer<vtkImageToStructuredPoints>::New();
-    vtkSmartPointer<vtkDiscreteMarchingCubes> mCubesPortal =
-        vtkSmartPointer<vtkDiscreteMarchingCubes>::New();
-
-    structuredPointsPortal->SetInputData(this->portalLabelMap->GetImageData());
-    structuredPointsPortal->Update();
-    mCubesPortal->SetInputConnection(structuredPointsPortal->GetOutputPort());
-    mCubesPortal->SetValue(0,5);
-    mCubesPortal->Update();
-
-    vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother =
-        vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
-    vtkSmartPointer<vtkTransform> translation =
-        vtkSmartPointer<vtkTransform>::New();
-    vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter =
-        vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-
-    smoother->SetInputConnection(mCubesPortal->GetOutputPort());
-    smoother->SetNumberOfIterations(10);
-    smoother->BoundarySmoothingOff();
-    smoother->FeatureEdgeSmoothingOff();
-    smoother->SetFeatureAngle(120.0);
-    smoother->SetPassBand(.001);
-    smoother->NonManifoldSmoothingOn();
-    smoother->NormalizeCoordinatesOn();
-    smoother->Update();
-
-    translation->SetMatrix(IJKtoRASmatrix.GetPointer());
-
-    transformFilter->SetInputConnection(smoother->GetOutputPort());
-    transformFilter->SetTransform(translation);
-    transformFilter->Update();
-
-    if( this->portalModelNode == NULL )
-    {
-      // first time to create portal model node
-      this->portalModelNode = vtkSmartPointer<vtkMRMLModelNode>::New();
-      this->portalModelNode->SetName("portalVesselModel");
-      this->portalModelNode->SetAndObservePolyData(transformFilter->GetOutput());
-      this->GetMRMLScene()->AddNode(this->portalModelNode);
-
-      // also need a display node
-      this->portalModelDisplayNode = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
-      this->portalModelDisplayNode->SetColor(1,0,0); // red
-      this->GetMRMLScene()->AddNode(this->portalModelDisplayNode);
-      this->portalModelNode->SetAndObserveDisplayNodeID(this->portalModelDisplayNode->GetID());
-    }
-    else // add to 3D model, as already have nodes
-    {
-      this->portalModelNode->SetAndObservePolyData(transformFilter->GetOutput());
-    }
-    this->portalUpdated = false;
-  }
+  this->mergedUpdated = false;
+  this->UpdateModels();
+  return true;
+}
 
-  this->Reset3DView();
+//---------------------------------------------------------------------------
+void vtkSlicerVesselSegmentationLogic::UpdateModels()
+{
+  // the models should follow the label maps as soon as possible
+  this->RunJob(new ModelsJob, true);
 }
 
 //---------------------------------------------------------------------------
@@ -1193,21 +3405,21 @@ vtkSlicerVesselSegmentationLogic::GetPreprocessedITKData()
 }
 
 //---------------------------------------------------------------------------
-vtkVesselSegmentationHelper::SeedImageType::Pointer
+vtkVesselSegmentationHelper::LabelImageType::Pointer
 vtkSlicerVesselSegmentationLogic::GetHepaticITKData()
 {
   return this->hepaticITKdata;
 }
 
 //---------------------------------------------------------------------------
-vtkVesselSegmentationHelper::SeedImageType::Pointer
+vtkVesselSegmentationHelper::LabelImageType::Pointer
 vtkSlicerVesselSegmentationLogic::GetPortalITKData()
 {
   return this->portalITKdata;
 }
 
 //---------------------------------------------------------------------------
-vtkVesselSegmentationHelper::SeedImageType::Pointer
+vtkVesselSegmentationHelper::LabelImageType::Pointer
 vtkSlicerVesselSegmentationLogic::GetMergedITKData()
 {
   return this->mergedITKdata;
@@ -1218,6 +3430,9 @@ void vtkSlicerVesselSegmentationLogic::SetHepaticLabelMap(
     vtkMRMLLabelMapVolumeNode* labelMap)
 {
   this->hepaticLabelMap = labelMap;
+  this->vesselMesher->Reset(HepaticMesherLabel);
+  // the steps were recorded on the previous label map
+  this->labelHistory->Clear();
 }
 
 //---------------------------------------------------------------------------
@@ -1225,5 +3440,8 @@ void vtkSlicerVesselSegmentationLogic::SetPortalLabelMap(
     vtkMRMLLabelMapVolumeNode* labelMap)
 {
   this->portalLabelMap = labelMap;
+  this->vesselMesher->Reset(PortalMesherLabel);
+  // the steps were recorded on the previous label map
+  this->labelHistory->Clear();
 }
 
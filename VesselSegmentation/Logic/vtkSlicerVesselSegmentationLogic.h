@@ -42,7 +42,11 @@
 
 // STD includes
 #include <vector>
+#include <deque>
+#include <string>
 #include <vtkNew.h>
+#include <vtkCommand.h>
+#include <vtkMultiThreader.h>
 
 #include <itkImage.h>
 #include <itkShapeLabelObject.h>
@@ -55,11 +59,17 @@
 
 class vtkMRMLNode;
 class vtkMRMLScene;
+class vtkMRMLDisplayableNode;
 class vtkMRMLVesselSegmentationSeedNode;
 class vtkMRMLScalarVolumeNode;
 class vtkMRMLLabelMapVolumeNode;
 class vtkMRMLModelNode;
 class vtkMRMLModelDisplayNode;
+class vtkCallbackCommand;
+class vtkVesselSegmentationBrickMesher;
+class vtkVesselSegmentationLabelHistory;
+class vtkVesselSegmentationMetrics;
+class vtkVesselSegmentationMemoryManager;
 
 /**
  * \ingroup VesselSegmentation
@@ -93,6 +103,90 @@ public:
    */
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  /**
+   * State of the jobs run by the logic, as returned by GetJobState().
+   */
+  enum JobState
+  {
+    JobIdle = 0,
+    JobQueued,
+    JobRunning,
+    JobCompleted,
+    JobCancelled,
+    JobFailed
+  };
+
+  /**
+   * Events invoked on the logic (on the main thread) when a job starts and
+   * when it has finished and its result is in the scene. Progress of the
+   * running job is reported with vtkCommand::ProgressEvent, the call data
+   * being a pointer to a double between 0 and 1.
+   */
+  enum
+  {
+    JobStartedEvent = vtkCommand::UserEvent + 270,
+    JobFinishedEvent
+  };
+
+  /**
+   * If on, the preprocessing, segmentation, merging, splitting and model
+   * updates are computed in a worker thread and the MRML scene is updated
+   * on the main thread when they finish. Requires the Slicer application
+   * logic, otherwise the jobs still run synchronously. Off by default.
+   */
+  vtkSetMacro(Asynchronous, bool);
+  vtkGetMacro(Asynchronous, bool);
+  vtkBooleanMacro(Asynchronous, bool);
+
+  /**
+   * Method to query the job being run by the logic.
+   *
+   * @return JobRunning or JobQueued while there is work to do, otherwise
+   * the state in which the last job finished (or JobIdle).
+   */
+  int GetJobState();
+
+  /**
+   * Method to get the name of the running job, or of the last job if none runs.
+   *
+   * @return name of the job, empty if no job has been run.
+   */
+  const char* GetJobName();
+
+  /**
+   * Method to get the progress of the running job.
+   *
+   * @return progress between 0 and 1, 0 if no job is running.
+   */
+  double GetJobProgress();
+
+  /**
+   * Method to get the number of jobs waiting for the running one.
+   *
+   * @return number of queued jobs.
+   */
+  int GetNumberOfPendingJobs();
+
+  /**
+   * Cancels the running job and discards the queued ones.
+   * Nothing of a cancelled job is written to the scene.
+   */
+  void CancelJob();
+
+  /**
+   * Blocks until all the submitted jobs have finished and
+   * their results have been written to the scene.
+   */
+  void WaitForJobs();
+
+  /**
+   * Helper to get a readable version of a job state.
+   *
+   * @param state job state.
+   * @return name of the state.
+   */
+  static const char* GetJobStateAsString(int state);
+
   /**
    * Calls preprocessing to enhance the vesselness of the image
    * (prerequisite: an input image).
@@ -106,6 +200,35 @@ public:
    */
   void PreprocessImage( int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations );
 
+  /**
+   * Runs the preprocessing on a downsampled version of the input image to give a
+   * quick preview of the parameters, then starts the full resolution preprocessing
+   * in a background thread. The full resolution result replaces the preview when it
+   * finishes. A running background preprocessing is cancelled first.
+   *
+   * @param lower threshold.
+   * @pararm upper threshold.
+   * @param alpha.
+   * @param beta.
+   * @param conductance.
+   * @param number of interations.
+   * @param downsampling factor of the preview (e.g. 2 or 4).
+   */
+  void PreprocessImagePreview( int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations, unsigned int shrinkFactor );
+
+  /**
+   * Cancels the running and queued preprocessing jobs, if any.
+   * Returns once the worker thread has stopped.
+   */
+  void CancelPreprocessing();
+
+  /**
+   * Method to query the background preprocessing.
+   *
+   * @return true if a preprocessing job is running or queued.
+   */
+  bool IsPreprocessingRunning();
+
   /**
    * Calls the segmentation algorithm when the button is pressed.
    *
@@ -143,6 +266,103 @@ public:
    */
   void SplitVessels(vtkMRMLVesselSegmentationSeedNode *seedNode, bool isHepatic);
 
+  /**
+   * Undoes the last segmentation or split step on the hepatic and portal
+   * label maps, from the changes recorded when it was made. Waits for the
+   * running jobs first.
+   *
+   * @return false if there is no step to undo.
+   */
+  bool Undo();
+
+  /**
+   * Redoes the last undone segmentation or split step.
+   *
+   * @return false if there is no step to redo.
+   */
+  bool Redo();
+
+  /**
+   * Method to query the undo history.
+   *
+   * @return true if there is a step to undo.
+   */
+  bool CanUndo();
+
+  /**
+   * Method to query the redo history.
+   *
+   * @return true if there is a step to redo.
+   */
+  bool CanRedo();
+
+  /**
+   * Method to get the undo history, e.g. to limit its number of steps.
+   *
+   * @return pointer to the history of the label maps.
+   */
+  vtkVesselSegmentationLabelHistory* GetLabelHistory();
+
+  /**
+   * Method to get the time and memory taken by the stages of the pipeline,
+   * which are recorded once the metrics are enabled, e.g. from Python:
+   * logic.GetMetrics().EnabledOn() and later logic.GetMetrics().ExportJSON().
+   *
+   * @return pointer to the metrics of the logic.
+   */
+  vtkVesselSegmentationMetrics* GetMetrics();
+
+  /**
+   * Method to get the memory manager of the preprocessed and label images.
+   * Once its budget is set, e.g. logic.GetMemoryManager().SetMemoryBudget(4 << 30),
+   * the images made by the jobs are mapped from temporary files and the ones
+   * the current step does not use are spilled to them to stay in the budget.
+   *
+   * @return pointer to the memory manager of the logic.
+   */
+  vtkVesselSegmentationMemoryManager* GetMemoryManager();
+
+  /**
+   * Restricts the pipeline to a box, e.g. around the liver. The preprocessing,
+   * the vessel tracking and the meshing only run on the voxels in the box and
+   * its margin. The label maps written to the scene still cover the whole
+   * volume, the results being pasted into them. Takes effect from the next
+   * preprocessing, or the next segmentation of a volume not preprocessed.
+   *
+   * @param bounds of the box in RAS: xmin, xmax, ymin, ymax, zmin, zmax.
+   */
+  void SetRegionOfInterest(const double bounds[6]);
+
+  /**
+   * Restricts the pipeline to the bounds of a node, e.g. a model or a
+   * segmentation of the liver parenchyma, or to the box of the labelled
+   * voxels of a label map.
+   *
+   * @param node giving the region of interest.
+   * @return false (after reporting the error) if the node does not have bounds.
+   */
+  bool SetRegionOfInterestFromNode(vtkMRMLDisplayableNode *node);
+
+  /**
+   * Runs the pipeline on the whole volume again, from the next preprocessing.
+   */
+  void RemoveRegionOfInterest();
+
+  /**
+   * Method to get the box the pipeline is restricted to.
+   *
+   * @param bounds of the box in RAS, only set if there is one.
+   * @return false if the pipeline runs on the whole volume.
+   */
+  bool GetRegionOfInterest(double bounds[6]);
+
+  /**
+   * Margin in mm added around the region of interest, so the vessels at its
+   * border are not cut off by the smoothing. 10 mm by default.
+   */
+  vtkSetMacro(RegionOfInterestMargin, double);
+  vtkGetMacro(RegionOfInterestMargin, double);
+
   /**
    * Helper function to update the 3D models
    */
@@ -187,21 +407,21 @@ public:
    *
    * @return pointer to hepatic ITK data.
    */
-  vtkVesselSegmentationHelper::SeedImageType::Pointer GetHepaticITKData();
+  vtkVesselSegmentationHelper::LabelImageType::Pointer GetHepaticITKData();
 
   /**
    * Method to get the portal ITK data.
    *
    * @return pointer to portal ITK data.
    */
-  vtkVesselSegmentationHelper::SeedImageType::Pointer GetPortalITKData();
+  vtkVesselSegmentationHelper::LabelImageType::Pointer GetPortalITKData();
 
   /**
    * Method to get the merged ITK data.
    *
    * @return pointer to merged ITK data.
    */
-  vtkVesselSegmentationHelper::SeedImageType::Pointer GetMergedITKData();
+  vtkVesselSegmentationHelper::LabelImageType::Pointer GetMergedITKData();
 
   /**
    * Method to set the hepatic label map.
@@ -264,35 +484,148 @@ protected:
    * @param node pointer to the vtkMRMLNode to be modified.
    */
   virtual void OnMRMLNodeModified(vtkMRMLNode* node);
-    
+
+  /**
+   * Creates (or updates) the preprocessed image node from the given ITK image.
+   *
+   * @param preprocessed ITK image.
+   * @param region of the whole preprocessed volume, into which a cropped image is pasted.
+   */
+  void UpdatePreprocessedNode(vtkVesselSegmentationHelper::SeedImageType::Pointer image,
+                              const vtkVesselSegmentationHelper::SeedImageType::RegionType &wholeRegion);
+
+  /**
+   * Computes the voxels of a volume in the region of interest and its margin.
+   *
+   * @param volume node.
+   * @param region set to the voxels, all of them if there is no region of interest.
+   * @return false (after reporting the error) if the region of interest is
+   * outside of the volume.
+   */
+  bool ComputeRegionOfInterest(vtkMRMLVolumeNode *volume,
+                               vtkVesselSegmentationHelper::LabelImageType::RegionType &region);
+
+  /**
+   * Undoes or redoes a step of the label history and marks the changed
+   * regions of the label maps for the merge and the models.
+   *
+   * @param true to undo, false to redo.
+   * @return false if there was no step to apply.
+   */
+  bool ApplyHistoryStep(bool undo);
+
+  class Job;
+  class PreprocessingJob;
+  class SegmentationJob;
+  class MergeJob;
+  class SplitJob;
+  class ModelsJob;
+
+  /**
+   * Submits a job. It runs straight away when the logic is synchronous,
+   * otherwise it is queued for the worker thread.
+   *
+   * @param job to run, the logic takes ownership.
+   * @param urgent if the job should run before the ones already queued.
+   */
+  void RunJob(Job *job, bool urgent = false);
+
+  /**
+   * Starts the first queued job, if the worker thread is free.
+   */
+  void StartNextJob();
+
+  /**
+   * Joins the worker thread and writes the result of the current job to the scene.
+   */
+  void FinishCurrentJob();
+
+  /**
+   * Writes the result of a job to the scene, or discards it, and reports that it finished.
+   */
+  void FinishJob(Job *job);
+
+  /**
+   * Runs the computation of a job and catches the ITK exceptions.
+   */
+  static void ExecuteJob(Job *job);
+
+  /**
+   * Entry point of the worker thread.
+   */
+  static VTK_THREAD_RETURN_TYPE JobThreadFunction(void *arg);
+
+  /**
+   * Called on the main thread when the worker reports progress or has finished.
+   */
+  static void OnJobNotification(vtkObject *caller, unsigned long eid,
+                                void *clientData, void *callData);
+
+  bool Asynchronous;
+  double RegionOfInterestMargin;
+
 private:
+  Job *currentJob;
+  std::deque<Job*> pendingJobs;
+  int jobThreadID;
+  int lastJobState;
+  std::string lastJobName;
+  vtkSmartPointer<vtkMultiThreader> jobThreader;
+  vtkSmartPointer<vtkObject> jobNotifier;
+  vtkSmartPointer<vtkCallbackCommand> jobCallback;
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> preprocessingSourceVolume;
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> preprocessedNode;
+
   vtkVesselSegmentationHelper::SeedImageType::Pointer preprocessedImg;
 
+  // box in RAS the pipeline is restricted to, if set
+  bool hasRegionOfInterest;
+  double regionOfInterest[6];
+
   int vtkScalarType;
 
   bool hepaticUpdated;
-  vtkVesselSegmentationHelper::SeedImageType::Pointer hepaticITKdata;
+  vtkVesselSegmentationHelper::LabelImageType::Pointer hepaticITKdata;
   vtkSmartPointer<vtkMRMLModelNode> hepaticModelNode;
   vtkSmartPointer<vtkMRMLModelDisplayNode> hepaticModelDisplayNode;
   vtkSmartPointer<vtkMRMLLabelMapVolumeNode> hepaticLabelMap;
 
   bool portalUpdated;
-  vtkVesselSegmentationHelper::SeedImageType::Pointer portalITKdata;
+  vtkVesselSegmentationHelper::LabelImageType::Pointer portalITKdata;
   vtkSmartPointer<vtkMRMLModelNode> portalModelNode;
   vtkSmartPointer<vtkMRMLModelDisplayNode> portalModelDisplayNode;
   vtkSmartPointer<vtkMRMLLabelMapVolumeNode> portalLabelMap;
 
   bool mergedUpdated;
-  vtkVesselSegmentationHelper::SeedImageType::Pointer mergedITKdata;
+  vtkVesselSegmentationHelper::LabelImageType::Pointer mergedITKdata;
   vtkSmartPointer<vtkMRMLModelDisplayNode> mergedModelDisplayNode;
   vtkSmartPointer<vtkMRMLLabelMapVolumeNode> mergedLabelMap;
 
+  // extracts the hepatic and portal models from their label maps
+  vtkSmartPointer<vtkVesselSegmentationBrickMesher> vesselMesher;
+
+  // run length encoded changes of the segmentation and split steps
+  vtkSmartPointer<vtkVesselSegmentationLabelHistory> labelHistory;
+
+  // time and memory of the stages of the jobs, disabled by default
+  vtkSmartPointer<vtkVesselSegmentationMetrics> metrics;
+
+  // maps the images made by the jobs and keeps them within the memory budget
+  vtkSmartPointer<vtkVesselSegmentationMemoryManager> memoryManager;
+
+  // connected components of the overlap can exceed the range of the label type
   typedef unsigned short LabelType;
   typedef itk::ShapeLabelObject< LabelType, 3 >  ShapeLabelObjectType;
   typedef itk::LabelMap< ShapeLabelObjectType >  LabelMapType;
 
   LabelMapType::Pointer onlyOverlapLabelMap;
 
+  // bounding regions of the voxels changed since the last merge, and of the
+  // merged voxels changed since the overlap label map was last computed
+  vtkVesselSegmentationHelper::LabelImageType::RegionType hepaticDirtyRegion;
+  vtkVesselSegmentationHelper::LabelImageType::RegionType portalDirtyRegion;
+  vtkVesselSegmentationHelper::LabelImageType::RegionType overlapDirtyRegion;
+
   vtkSlicerVesselSegmentationLogic(const vtkSlicerVesselSegmentationLogic&); // Not implemented
   void operator=(const vtkSlicerVesselSegmentationLogic&); // Not implemented
 };
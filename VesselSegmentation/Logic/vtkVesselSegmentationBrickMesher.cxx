@@ -0,0 +1,806 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationBrickMesher.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#include "vtkVesselSegmentationBrickMesher.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkTransform.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkDiscreteMarchingCubes.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkAppendPolyData.h>
+#include <vtkCleanPolyData.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+vtkStandardNewMacro(vtkVesselSegmentationBrickMesher);
+
+//---------------------------------------------------------------------------
+class vtkVesselSegmentationBrickMesher::vtkInternal
+{
+public:
+  // cached surface of one label
+  struct LabelState
+  {
+    LabelState()
+      : Label(1), AllModified(true), SurfaceModified(true)
+    {
+      for (int i = 0; i < 6; ++i)
+        {
+        this->Extent[i] = 0;
+        }
+    }
+
+    int Label;
+
+    // everything has to be extracted, the cached bricks are not valid
+    bool AllModified;
+
+    // extent of the image the cached bricks were extracted from
+    int Extent[6];
+
+    // changed extents since the last update, 6 values each
+    std::vector<int> ModifiedExtents;
+
+    // smoothed surface of each brick that contains some of the label
+    std::map<int, vtkSmartPointer<vtkPolyData> > Bricks;
+
+    // bricks joined together, rebuilt when a brick changed
+    vtkSmartPointer<vtkPolyData> Surface;
+    bool SurfaceModified;
+  };
+
+  // samples of an input image, read by all threads
+  struct InputSamples
+  {
+    const char *Scalars;
+    vtkIdType Increments[3];
+    int Extent[6];
+    int ScalarType;
+    int NumberOfComponents;
+    int VoxelSize;
+    double Origin[3];
+    double Spacing[3];
+  };
+
+  // a brick of an input image and the labels to extract from it
+  struct BrickTask
+  {
+    int Input;
+    int Brick;
+    std::vector<int> Labels;
+  };
+
+  // surface of a label in a brick, NULL when the brick has none of the label
+  struct BrickResult
+  {
+    int Label;
+    int Brick;
+    vtkSmartPointer<vtkPolyData> Surface;
+  };
+
+  vtkInternal()
+  {
+    this->Labels.resize(1);
+    this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+    this->Lock = vtkSmartPointer<vtkMutexLock>::New();
+    this->Self = NULL;
+    this->NextTask = 0;
+    this->FinishedTasks = 0;
+  }
+
+  static bool IsEmpty(const int extent[6])
+  {
+    return extent[1] < extent[0] || extent[3] < extent[2] || extent[5] < extent[4];
+  }
+
+  static int ComputeNumberOfBricks(const int extent[6], int brickSize, int numberOfBricks[3])
+  {
+    for (int d = 0; d < 3; ++d)
+      {
+      int cells = extent[2*d+1] - extent[2*d];
+      numberOfBricks[d] = cells > 0 ? (cells + brickSize - 1) / brickSize : 0;
+      }
+    return numberOfBricks[0] * numberOfBricks[1] * numberOfBricks[2];
+  }
+
+  /**
+   * Add the bricks of a label that have to be extracted to brickIds. A changed
+   * voxel changes the cells on both of its sides which can belong to two
+   * bricks along each axis.
+   */
+  static void FindModifiedBricks(const LabelState &state, int brickSize, std::set<int> &brickIds)
+  {
+    int numberOfBricks[3];
+    int total = ComputeNumberOfBricks(state.Extent, brickSize, numberOfBricks);
+    if (state.AllModified)
+      {
+      for (int id = 0; id < total; ++id)
+        {
+        brickIds.insert(id);
+        }
+      return;
+      }
+
+    const std::vector<int> &modified = state.ModifiedExtents;
+    for (size_t m = 0; m + 5 < modified.size(); m += 6)
+      {
+      int first[3];
+      int last[3];
+      bool inside = total > 0;
+      for (int d = 0; d < 3 && inside; ++d)
+        {
+        int cells = state.Extent[2*d+1] - state.Extent[2*d];
+        int lower = std::max(modified[m+2*d] - state.Extent[2*d], 0);
+        int upper = std::min(modified[m+2*d+1] - state.Extent[2*d], cells);
+        inside = lower <= upper;
+        first[d] = lower > 0 ? (lower - 1) / brickSize : 0;
+        last[d] = std::min(upper / brickSize, numberOfBricks[d] - 1);
+        }
+      if (!inside)
+        {
+        continue;
+        }
+      for (int k = first[2]; k <= last[2]; ++k)
+        {
+        for (int j = first[1]; j <= last[1]; ++j)
+          {
+          for (int i = first[0]; i <= last[0]; ++i)
+            {
+            brickIds.insert(i + numberOfBricks[0] * (j + numberOfBricks[1] * k));
+            }
+          }
+        }
+      }
+  }
+
+  /**
+   * Keep only the polygons of one label of a multi-label marching cubes
+   * output. The unused points are removed when the bricks are joined.
+   */
+  static vtkSmartPointer<vtkPolyData> SelectLabel(vtkPolyData *surface, int label)
+  {
+    vtkSmartPointer<vtkPolyData> selected = vtkSmartPointer<vtkPolyData>::New();
+    vtkDataArray *cellLabels = surface->GetCellData()->GetScalars();
+    if (!cellLabels)
+      {
+      return selected;
+      }
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    vtkCellArray *allPolys = surface->GetPolys();
+    vtkIdType npts = 0;
+    vtkIdType *pts = NULL;
+    allPolys->InitTraversal();
+    for (vtkIdType cellId = 0; allPolys->GetNextCell(npts, pts); ++cellId)
+      {
+      if (static_cast<int>(cellLabels->GetComponent(cellId, 0)) == label)
+        {
+        polys->InsertNextCell(npts, pts);
+        }
+      }
+
+    selected->SetPoints(surface->GetPoints());
+    selected->GetPointData()->PassData(surface->GetPointData());
+    selected->SetPolys(polys);
+    return selected;
+  }
+
+  /**
+   * Extract the surfaces of the labels of a task: one copy of the samples of
+   * the brick and one marching cubes for all of its labels, then smoothing and
+   * transform of each label.
+   */
+  void ExtractBrick(const BrickTask &task, std::vector<BrickResult> &results)
+  {
+    const InputSamples &input = this->Inputs[task.Input];
+    const int brickSize = this->Self->GetBrickSize();
+
+    int numberOfBricks[3];
+    ComputeNumberOfBricks(input.Extent, brickSize, numberOfBricks);
+    int index[3] = { task.Brick % numberOfBricks[0],
+                     (task.Brick / numberOfBricks[0]) % numberOfBricks[1],
+                     task.Brick / (numberOfBricks[0] * numberOfBricks[1]) };
+
+    // neighbouring bricks share their boundary plane of samples
+    int voi[6];
+    for (int d = 0; d < 3; ++d)
+      {
+      voi[2*d] = input.Extent[2*d] + index[d] * brickSize;
+      voi[2*d+1] = std::min(voi[2*d] + brickSize, input.Extent[2*d+1]);
+      }
+
+    vtkSmartPointer<vtkImageData> brick = vtkSmartPointer<vtkImageData>::New();
+    brick->SetExtent(voi);
+    brick->SetOrigin(input.Origin[0], input.Origin[1], input.Origin[2]);
+    brick->SetSpacing(input.Spacing[0], input.Spacing[1], input.Spacing[2]);
+    brick->AllocateScalars(input.ScalarType, input.NumberOfComponents);
+
+    char *target = static_cast<char*>(brick->GetScalarPointer());
+    size_t rowSize = static_cast<size_t>(voi[1] - voi[0] + 1) * input.VoxelSize;
+    for (int k = voi[4]; k <= voi[5]; ++k)
+      {
+      for (int j = voi[2]; j <= voi[3]; ++j)
+        {
+        const char *source = input.Scalars + (voi[0] - input.Extent[0]) * input.Increments[0]
+            + (j - input.Extent[2]) * input.Increments[1]
+            + (k - input.Extent[4]) * input.Increments[2];
+        memcpy(target, source, rowSize);
+        target += rowSize;
+        }
+      }
+
+    vtkSmartPointer<vtkDiscreteMarchingCubes> mCubes = vtkSmartPointer<vtkDiscreteMarchingCubes>::New();
+    mCubes->SetInputData(brick);
+    for (size_t l = 0; l < task.Labels.size(); ++l)
+      {
+      mCubes->SetValue(static_cast<int>(l), this->Labels[task.Labels[l]].Label);
+      }
+    // the label of each polygon is needed to tell the labels apart
+    mCubes->SetComputeScalars(task.Labels.size() > 1);
+    mCubes->Update();
+
+    for (size_t l = 0; l < task.Labels.size(); ++l)
+      {
+      BrickResult result;
+      result.Label = task.Labels[l];
+      result.Brick = task.Brick;
+
+      vtkSmartPointer<vtkPolyData> surface = mCubes->GetOutput();
+      if (task.Labels.size() > 1)
+        {
+        surface = SelectLabel(surface, this->Labels[task.Labels[l]].Label);
+        }
+
+      if (surface->GetNumberOfPolys() > 0)
+        {
+        // boundary smoothing off keeps the vertices on the seams in place
+        vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother =
+            vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+        smoother->SetInputData(surface);
+        smoother->SetNumberOfIterations(this->Self->GetNumberOfSmoothingIterations());
+        smoother->BoundarySmoothingOff();
+        smoother->FeatureEdgeSmoothingOff();
+        smoother->SetFeatureAngle(120.0);
+        smoother->SetPassBand(.001);
+        smoother->NonManifoldSmoothingOn();
+        smoother->NormalizeCoordinatesOn();
+        smoother->Update();
+        result.Surface = smoother->GetOutput();
+
+        if (this->TransformMatrix)
+          {
+          vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+          transform->SetMatrix(this->TransformElements);
+          vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter =
+              vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+          transformFilter->SetInputData(result.Surface);
+          transformFilter->SetTransform(transform);
+          transformFilter->Update();
+          result.Surface = transformFilter->GetOutput();
+          }
+        }
+
+      results.push_back(result);
+      }
+  }
+
+  /**
+   * Join the cached bricks of a label, merging the duplicated vertices of the
+   * seams.
+   */
+  void AppendBricks(LabelState &state)
+  {
+    if (state.Bricks.empty())
+      {
+      state.Surface = NULL;
+      return;
+      }
+
+    vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+    for (std::map<int, vtkSmartPointer<vtkPolyData> >::iterator it = state.Bricks.begin();
+         it != state.Bricks.end(); ++it)
+      {
+      append->AddInputData(it->second);
+      }
+
+    vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
+    clean->SetInputConnection(append->GetOutputPort());
+    clean->PointMergingOn();
+    clean->ToleranceIsAbsoluteOn();
+    clean->SetAbsoluteTolerance(1e-4);
+    clean->ConvertLinesToPointsOff();
+    clean->ConvertPolysToLinesOff();
+    clean->ConvertStripsToPolysOff();
+    clean->Update();
+
+    state.Surface = clean->GetOutput();
+  }
+
+  // threads take the next task until all are done or the update is aborted
+  static VTK_THREAD_RETURN_TYPE ExtractBricksThread(void *arg)
+  {
+    vtkMultiThreader::ThreadInfo *info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+    vtkInternal *self = static_cast<vtkInternal*>(info->UserData);
+    std::vector<BrickResult> &results = self->ThreadResults[info->ThreadID];
+
+    for (;;)
+      {
+      self->Lock->Lock();
+      bool done = self->NextTask >= self->Tasks.size() || self->Self->GetAbortExecute();
+      size_t task = self->NextTask++;
+      self->Lock->Unlock();
+      if (done)
+        {
+        break;
+        }
+
+      self->ExtractBrick(self->Tasks[task], results);
+
+      self->Lock->Lock();
+      size_t finished = ++self->FinishedTasks;
+      self->Lock->Unlock();
+
+      // thread 0 runs on the calling thread, which is the only one allowed
+      // to report progress
+      if (info->ThreadID == 0)
+        {
+        self->Self->UpdateProgress(0.9 * finished / self->Tasks.size());
+        }
+      }
+
+    return VTK_THREAD_RETURN_VALUE;
+  }
+
+  // threads take the next label whose bricks changed
+  static VTK_THREAD_RETURN_TYPE AppendBricksThread(void *arg)
+  {
+    vtkMultiThreader::ThreadInfo *info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+    vtkInternal *self = static_cast<vtkInternal*>(info->UserData);
+
+    for (;;)
+      {
+      self->Lock->Lock();
+      size_t label = self->NextTask++;
+      self->Lock->Unlock();
+      if (label >= self->Labels.size())
+        {
+        break;
+        }
+      if (self->Labels[label].SurfaceModified)
+        {
+        self->AppendBricks(self->Labels[label]);
+        }
+      }
+
+    return VTK_THREAD_RETURN_VALUE;
+  }
+
+  std::vector<LabelState> Labels;
+  vtkSmartPointer<vtkMatrix4x4> TransformMatrix;
+  double TransformElements[16];
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  vtkSmartPointer<vtkMutexLock> Lock;
+
+  // state of the running update
+  vtkVesselSegmentationBrickMesher *Self;
+  std::vector<InputSamples> Inputs;
+  std::vector<BrickTask> Tasks;
+  size_t NextTask;
+  size_t FinishedTasks;
+  std::vector<std::vector<BrickResult> > ThreadResults;
+};
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationBrickMesher::vtkVesselSegmentationBrickMesher()
+{
+  this->BrickSize = 32;
+  this->NumberOfSmoothingIterations = 10;
+  this->NumberOfUpdatedBricks = 0;
+  this->Internal = new vtkInternal;
+  this->Internal->Self = this;
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationBrickMesher::~vtkVesselSegmentationBrickMesher()
+{
+  delete this->Internal;
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "BrickSize: " << this->BrickSize << "\n";
+  os << indent << "NumberOfSmoothingIterations: " << this->NumberOfSmoothingIterations << "\n";
+  os << indent << "NumberOfUpdatedBricks: " << this->NumberOfUpdatedBricks << "\n";
+  for (size_t l = 0; l < this->Internal->Labels.size(); ++l)
+    {
+    os << indent << "Label " << l << ": " << this->Internal->Labels[l].Label
+       << ", NumberOfCachedBricks: " << this->Internal->Labels[l].Bricks.size() << "\n";
+    }
+  os << indent << "TransformMatrix: ";
+  if (this->Internal->TransformMatrix)
+    {
+    os << "\n";
+    this->Internal->TransformMatrix->PrintSelf(os, indent.GetNextIndent());
+    }
+  else
+    {
+    os << "(none)\n";
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetNumberOfLabels(int number)
+{
+  number = std::max(number, 1);
+  if (number == this->GetNumberOfLabels())
+    {
+    return;
+    }
+  this->Internal->Labels.resize(number);
+  this->SetNumberOfOutputPorts(number);
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationBrickMesher::GetNumberOfLabels()
+{
+  return static_cast<int>(this->Internal->Labels.size());
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetLabel(int index, int label)
+{
+  if (index < 0 || index >= this->GetNumberOfLabels())
+    {
+    vtkErrorMacro("SetLabel: label index " << index << " out of range.");
+    return;
+    }
+  if (this->Internal->Labels[index].Label == label)
+    {
+    return;
+    }
+  this->Internal->Labels[index].Label = label;
+  this->Reset(index);
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationBrickMesher::GetLabel(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfLabels())
+    {
+    vtkErrorMacro("GetLabel: label index " << index << " out of range.");
+    return 0;
+    }
+  return this->Internal->Labels[index].Label;
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetLabel(int label)
+{
+  this->SetNumberOfLabels(1);
+  this->SetLabel(0, label);
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetBrickSize(int size)
+{
+  size = std::max(size, 1);
+  if (this->BrickSize == size)
+    {
+    return;
+    }
+  this->BrickSize = size;
+  this->Reset();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetNumberOfSmoothingIterations(int iterations)
+{
+  if (this->NumberOfSmoothingIterations == iterations)
+    {
+    return;
+    }
+  this->NumberOfSmoothingIterations = iterations;
+  this->Reset();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::SetTransformMatrix(vtkMatrix4x4 *matrix)
+{
+  vtkMatrix4x4 *current = this->Internal->TransformMatrix;
+  if (!matrix && !current)
+    {
+    return;
+    }
+  if (matrix && current &&
+      std::equal(&matrix->Element[0][0], &matrix->Element[0][0] + 16, &current->Element[0][0]))
+    {
+    return;
+    }
+
+  if (matrix)
+    {
+    this->Internal->TransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    this->Internal->TransformMatrix->DeepCopy(matrix);
+    vtkMatrix4x4::DeepCopy(this->Internal->TransformElements, matrix);
+    }
+  else
+    {
+    this->Internal->TransformMatrix = NULL;
+    }
+  this->Reset();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::AddModifiedExtent(int index, const int extent[6])
+{
+  if (index < 0 || index >= this->GetNumberOfLabels())
+    {
+    vtkErrorMacro("AddModifiedExtent: label index " << index << " out of range.");
+    return;
+    }
+  std::vector<int> &modified = this->Internal->Labels[index].ModifiedExtents;
+  modified.insert(modified.end(), extent, extent + 6);
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::AddModifiedExtent(const int extent[6])
+{
+  for (int l = 0; l < this->GetNumberOfLabels(); ++l)
+    {
+    this->AddModifiedExtent(l, extent);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::Reset(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfLabels())
+    {
+    vtkErrorMacro("Reset: label index " << index << " out of range.");
+    return;
+    }
+  this->Internal->Labels[index].AllModified = true;
+  this->Internal->Labels[index].ModifiedExtents.clear();
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationBrickMesher::Reset()
+{
+  for (int l = 0; l < this->GetNumberOfLabels(); ++l)
+    {
+    this->Reset(l);
+    }
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationBrickMesher::FillInputPortInformation(int vtkNotUsed(port), vtkInformation *info)
+{
+  info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+  info->Set(vtkAlgorithm::INPUT_IS_REPEATABLE(), 1);
+  return 1;
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationBrickMesher::RequestData(vtkInformation *vtkNotUsed(request),
+                                                  vtkInformationVector **inputVector,
+                                                  vtkInformationVector *outputVector)
+{
+  vtkInternal *internal = this->Internal;
+  int numberOfInputs = inputVector[0]->GetNumberOfInformationObjects();
+  if (numberOfInputs == 0)
+    {
+    vtkErrorMacro("RequestData: no input label map.");
+    return 0;
+    }
+
+  this->NumberOfUpdatedBricks = 0;
+
+  // the threads only read the samples, everything that touches the image
+  // objects is done here
+  internal->Inputs.resize(numberOfInputs);
+  for (int c = 0; c < numberOfInputs; ++c)
+    {
+    vtkInternal::InputSamples &samples = internal->Inputs[c];
+    vtkImageData *input = vtkImageData::GetData(inputVector[0], c);
+    samples.Scalars = NULL;
+    if (input && input->GetPointData()->GetScalars())
+      {
+      input->GetExtent(samples.Extent);
+      input->GetIncrements(samples.Increments);
+      input->GetOrigin(samples.Origin);
+      input->GetSpacing(samples.Spacing);
+      samples.ScalarType = input->GetScalarType();
+      samples.NumberOfComponents = input->GetNumberOfScalarComponents();
+      samples.VoxelSize = input->GetScalarSize() * samples.NumberOfComponents;
+      for (int d = 0; d < 3; ++d)
+        {
+        samples.Increments[d] *= input->GetScalarSize();
+        }
+      samples.Scalars = static_cast<const char*>(input->GetScalarPointer());
+      }
+    if (!samples.Scalars || vtkInternal::IsEmpty(samples.Extent))
+      {
+      // nothing to extract, no brick is kept
+      samples.Scalars = NULL;
+      samples.Extent[0] = samples.Extent[2] = samples.Extent[4] = 0;
+      samples.Extent[1] = samples.Extent[3] = samples.Extent[5] = -1;
+      }
+    }
+
+  // collect the bricks to extract, the labels of one input share its bricks
+  std::map<std::pair<int, int>, std::vector<int> > brickLabels;
+  for (size_t l = 0; l < internal->Labels.size(); ++l)
+    {
+    vtkInternal::LabelState &state = internal->Labels[l];
+    const int c = std::min(static_cast<int>(l), numberOfInputs - 1);
+    const int *extent = internal->Inputs[c].Extent;
+    if (!std::equal(extent, extent + 6, state.Extent))
+      {
+      // a different image, none of the bricks can be kept
+      std::copy(extent, extent + 6, state.Extent);
+      state.AllModified = true;
+      }
+    if (state.AllModified)
+      {
+      state.Bricks.clear();
+      state.SurfaceModified = true;
+      }
+
+    std::set<int> brickIds;
+    vtkInternal::FindModifiedBricks(state, this->BrickSize, brickIds);
+    for (std::set<int>::iterator it = brickIds.begin(); it != brickIds.end(); ++it)
+      {
+      brickLabels[std::make_pair(c, *it)].push_back(static_cast<int>(l));
+      }
+    }
+
+  internal->Tasks.clear();
+  for (std::map<std::pair<int, int>, std::vector<int> >::iterator it = brickLabels.begin();
+       it != brickLabels.end(); ++it)
+    {
+    vtkInternal::BrickTask task;
+    task.Input = it->first.first;
+    task.Brick = it->first.second;
+    task.Labels = it->second;
+    internal->Tasks.push_back(task);
+    }
+
+  // extract the bricks concurrently, each thread keeping its own results
+  if (!internal->Tasks.empty())
+    {
+    int numberOfThreads = std::min(vtkMultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                   static_cast<int>(internal->Tasks.size()));
+    internal->NextTask = 0;
+    internal->FinishedTasks = 0;
+    internal->ThreadResults.assign(numberOfThreads, std::vector<vtkInternal::BrickResult>());
+    internal->Threader->SetNumberOfThreads(numberOfThreads);
+    internal->Threader->SetSingleMethod(vtkInternal::ExtractBricksThread, internal);
+    internal->Threader->SingleMethodExecute();
+    }
+
+  // merge the results of the threads into the caches of the labels
+  for (size_t t = 0; t < internal->ThreadResults.size(); ++t)
+    {
+    std::vector<vtkInternal::BrickResult> &results = internal->ThreadResults[t];
+    for (size_t r = 0; r < results.size(); ++r)
+      {
+      vtkInternal::LabelState &state = internal->Labels[results[r].Label];
+      if (results[r].Surface)
+        {
+        state.Bricks[results[r].Brick] = results[r].Surface;
+        }
+      else
+        {
+        state.Bricks.erase(results[r].Brick);
+        }
+      state.SurfaceModified = true;
+      ++this->NumberOfUpdatedBricks;
+      }
+    }
+  internal->ThreadResults.clear();
+  internal->Tasks.clear();
+
+  if (this->GetAbortExecute())
+    {
+    // keep the modified state so the remaining bricks are done next time
+    return 1;
+    }
+
+  for (size_t l = 0; l < internal->Labels.size(); ++l)
+    {
+    internal->Labels[l].AllModified = false;
+    internal->Labels[l].ModifiedExtents.clear();
+    }
+
+  // join the bricks of the changed labels concurrently
+  int numberOfModifiedLabels = 0;
+  for (size_t l = 0; l < internal->Labels.size(); ++l)
+    {
+    numberOfModifiedLabels += internal->Labels[l].SurfaceModified ? 1 : 0;
+    }
+  if (numberOfModifiedLabels > 0)
+    {
+    internal->NextTask = 0;
+    internal->Threader->SetNumberOfThreads(
+        std::min(vtkMultiThreader::GetGlobalDefaultNumberOfThreads(), numberOfModifiedLabels));
+    internal->Threader->SetSingleMethod(vtkInternal::AppendBricksThread, internal);
+    internal->Threader->SingleMethodExecute();
+    }
+
+  for (size_t l = 0; l < internal->Labels.size(); ++l)
+    {
+    vtkInternal::LabelState &state = internal->Labels[l];
+    vtkPolyData *output = vtkPolyData::GetData(outputVector, static_cast<int>(l));
+    if (state.Surface)
+      {
+      output->ShallowCopy(state.Surface);
+      }
+    else
+      {
+      output->Initialize();
+      }
+    state.SurfaceModified = false;
+    }
+  this->UpdateProgress(1.0);
+
+  return 1;
+}
@@ -0,0 +1,186 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationBrickMesher.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#ifndef __vtkVesselSegmentationBrickMesher_h
+#define __vtkVesselSegmentationBrickMesher_h
+
+#include "vtkSlicerVesselSegmentationModuleLogicExport.h"
+
+// VTK includes
+#include <vtkPolyDataAlgorithm.h>
+
+class vtkMatrix4x4;
+
+/**
+ * \ingroup VesselSegmentation
+ *
+ * \brief Extracts and smooths the surfaces of labels of label maps brick by brick.
+ *
+ * Each label gets its own output. Label i is extracted from input connection
+ * i, or from the last connection when there are fewer connections than labels,
+ * so several labels of one label map are extracted in a single pass over it.
+ *
+ * The label maps are split in bricks of BrickSize cells. The bricks are
+ * extracted, smoothed and transformed concurrently and the surface of each
+ * brick is cached, so that after a change of a label map only the bricks
+ * reaching into the extents given to AddModifiedExtent are extracted again.
+ * Neighbouring bricks share their boundary plane of samples and the vertices on
+ * it are not moved by the smoothing, so the seams of the surfaces stay closed.
+ *
+ * The outputs are in the coordinates of the input images, transformed by the
+ * TransformMatrix if one is set.
+ */
+class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT vtkVesselSegmentationBrickMesher :
+  public vtkPolyDataAlgorithm
+{
+public:
+  /**
+   * Standard vtk object instantiation method.
+   *
+   * @return a pointer to a newly created vtkVesselSegmentationBrickMesher.
+   */
+  static vtkVesselSegmentationBrickMesher *New();
+
+  vtkTypeMacro(vtkVesselSegmentationBrickMesher, vtkPolyDataAlgorithm);
+
+  /**
+   * Standard print object information method.
+   *
+   * @param os output stream to print the information to.
+   * @param indent indent value.
+   */
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /**
+   * Set the number of labels to extract, which is also the number of outputs.
+   * Labels added are extracted completely on the next update.
+   *
+   * @param number number of labels.
+   */
+  void SetNumberOfLabels(int number);
+  int GetNumberOfLabels();
+
+  /**
+   * Set the value of a label to extract.
+   *
+   * @param index index of the label and of its output.
+   * @param label label value.
+   */
+  void SetLabel(int index, int label);
+  int GetLabel(int index);
+
+  /**
+   * Extract a single label, as the only output.
+   *
+   * @param label label value.
+   */
+  void SetLabel(int label);
+
+  /// Number of cells along each side of a brick.
+  void SetBrickSize(int size);
+  vtkGetMacro(BrickSize, int);
+
+  /// Number of iterations of the windowed sinc smoothing of each brick.
+  void SetNumberOfSmoothingIterations(int iterations);
+  vtkGetMacro(NumberOfSmoothingIterations, int);
+
+  /**
+   * Set a matrix applied to the surfaces, for example the IJK to RAS matrix
+   * of the label maps. The matrix is copied and a different one drops all
+   * cached bricks. NULL leaves the surfaces in the input coordinates.
+   *
+   * @param matrix transform matrix.
+   */
+  void SetTransformMatrix(vtkMatrix4x4 *matrix);
+
+  /**
+   * Mark a part of a label map as changed. The bricks of the label reaching
+   * into the extent are extracted again on the next update.
+   *
+   * @param index index of the label.
+   * @param extent changed voxels, in the index space of the input image.
+   */
+  void AddModifiedExtent(int index, const int extent[6]);
+
+  /**
+   * Mark a part of the label maps of all labels as changed.
+   *
+   * @param extent changed voxels, in the index space of the input images.
+   */
+  void AddModifiedExtent(const int extent[6]);
+
+  /**
+   * Mark the label map of a label as changed everywhere, which drops all
+   * cached bricks of the label.
+   *
+   * @param index index of the label.
+   */
+  void Reset(int index);
+
+  /**
+   * Mark the label maps of all labels as changed everywhere.
+   */
+  void Reset();
+
+  /**
+   * Get the number of bricks extracted during the last update, a brick
+   * counts once for every label extracted from it.
+   *
+   * @return number of bricks.
+   */
+  vtkGetMacro(NumberOfUpdatedBricks, int);
+
+protected:
+  vtkVesselSegmentationBrickMesher();
+  ~vtkVesselSegmentationBrickMesher();
+
+  virtual int FillInputPortInformation(int port, vtkInformation *info) VTK_OVERRIDE;
+  virtual int RequestData(vtkInformation *request,
+                          vtkInformationVector **inputVector,
+                          vtkInformationVector *outputVector) VTK_OVERRIDE;
+
+  int BrickSize;
+  int NumberOfSmoothingIterations;
+  int NumberOfUpdatedBricks;
+
+private:
+  class vtkInternal;
+  vtkInternal *Internal;
+
+  vtkVesselSegmentationBrickMesher(const vtkVesselSegmentationBrickMesher&); // Not implemented
+  void operator=(const vtkVesselSegmentationBrickMesher&); // Not implemented
+};
+
+#endif
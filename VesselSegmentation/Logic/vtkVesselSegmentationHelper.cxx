@@ -58,57 +58,166 @@
 #include <vtkTransform.h>
 #include <vtkImageCast.h>
 #include <vtkMatrix4x4.h>
-#include <vtkImageImport.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkCallbackCommand.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkType.h>
 
 // ITK includes
 #include <itkImageRegionIteratorWithIndex.h>
-#include <itkImportImageFilter.h>
-#include <itkCastImageFilter.h>
+#include <itkImportImageContainer.h>
+#include <itkCommand.h>
 #include <vtkVesselSegmentationHelper.h>
 
+// STD includes
+#include <algorithm>
 
-//---------------------------------------------------------------------------
-/**
- * Constructor
- */
-vtkVesselSegmentationHelper::vtkVesselSegmentationHelper()
+namespace
 {
 
+// pixels cast by a thread at a time, large enough that scheduling is cheap
+const itk::SizeValueType CastChunkSize = 1 << 20;
+
+//------------------------------------------------------------------------------
+// a VTK array sharing an ITK pixel container gives up its reference when deleted
+void ReleaseItkBuffer(vtkObject *vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                      void *clientData, void *vtkNotUsed(callData))
+{
+  static_cast<itk::LightObject*>(clientData)->UnRegister();
 }
 
-//---------------------------------------------------------------------------
-vtkVesselSegmentationHelper::~vtkVesselSegmentationHelper()
+//------------------------------------------------------------------------------
+// an ITK pixel container sharing a VTK array gives up its reference when deleted
+void ReleaseVtkBuffer(itk::Object *, const itk::EventObject &, void *clientData)
 {
+  static_cast<vtkObjectBase*>(clientData)->UnRegister(NULL);
 }
 
-//---------------------------------------------------------------------------
-void vtkVesselSegmentationHelper::PrintSelf(ostream &os, vtkIndent vtkNotUsed(indent))
+//------------------------------------------------------------------------------
+/**
+ * Wraps the buffer of an ITK image in VTK image data without copying it. The
+ * VTK array holds a reference to the ITK pixel container, so the buffer stays
+ * valid as long as either side uses it.
+ */
+template <class TImage>
+vtkSmartPointer<vtkImageData> ShareItkBuffer(TImage *itkImage, int scalarType)
 {
-    (void)os;
+  typename TImage::IndexType imageIndex = itkImage->GetBufferedRegion().GetIndex();
+  typename TImage::SizeType imageSize = itkImage->GetBufferedRegion().GetSize();
+  typename TImage::PixelContainer *container = itkImage->GetPixelContainer();
+
+  // VTK extents are int and array sizes vtkIdType, which is 32 bit on some builds
+  if (imageSize[0] > static_cast<itk::SizeValueType>(VTK_INT_MAX) ||
+      imageSize[1] > static_cast<itk::SizeValueType>(VTK_INT_MAX) ||
+      imageSize[2] > static_cast<itk::SizeValueType>(VTK_INT_MAX) ||
+      container->Size() > static_cast<vtkTypeUInt64>(VTK_ID_MAX))
+    {
+    std::cerr
+      << "ItkImageToVtkImageData: image too large for vtkImageData"
+      << std::endl;
+    return NULL;
+    }
+
+  // a cropped image keeps its indices, which are also the voxel indices of
+  // the volume it was cropped from
+  int extent[6]={(int) imageIndex[0], (int) (imageIndex[0] + imageSize[0]) - 1,
+                 (int) imageIndex[1], (int) (imageIndex[1] + imageSize[1]) - 1,
+                 (int) imageIndex[2], (int) (imageIndex[2] + imageSize[2]) - 1};
+
+  vtkSmartPointer<vtkDataArray> scalars =
+      vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(scalarType));
+  scalars->SetNumberOfComponents(1);
+  // save = 1, VTK never frees the buffer itself
+  scalars->SetVoidArray(container->GetBufferPointer(),
+                        static_cast<vtkIdType>(container->Size()), 1);
+
+  container->Register();
+  vtkSmartPointer<vtkCallbackCommand> release = vtkSmartPointer<vtkCallbackCommand>::New();
+  release->SetCallback(ReleaseItkBuffer);
+  release->SetClientData(static_cast<itk::LightObject*>(container));
+  scalars->AddObserver(vtkCommand::DeleteEvent, release);
+
+  vtkSmartPointer<vtkImageData> vtkImage = vtkSmartPointer<vtkImageData>::New();
+  vtkImage->SetExtent(extent);
+  vtkImage->SetSpacing(1,1,1);
+  vtkImage->SetOrigin(0,0,0);
+  vtkImage->GetPointData()->SetScalars(scalars);
+
+  return vtkImage;
 }
 
 //------------------------------------------------------------------------------
-vtkVesselSegmentationHelper::SeedImageType::Pointer
-vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(vtkMRMLScalarVolumeNode *inVolumeNode,
-                                        bool applyRasToWorld,
-                                        bool applyRasToLps)
+/**
+ * Wraps the scalars of VTK image data in an ITK image without copying them.
+ * The ITK pixel container holds a reference to the VTK array, so the buffer
+ * stays valid as long as either side uses it.
+ */
+template <class TPixel>
+typename itk::Image<TPixel, 3>::Pointer ShareVtkBuffer(vtkImageData *inImageData,
+    const vtkVesselSegmentationHelper::SeedImageType::RegionType &region,
+    const double spacing[3], const double origin[3],
+    const itk::Matrix<double,3,3> &directionMatrix)
 {
-  // Check for null pointer
-  if (inVolumeNode == NULL)
+  typedef itk::Image<TPixel, 3> ImageType;
+  typedef typename ImageType::PixelContainer PixelContainerType;
+
+  vtkDataArray *scalars = inImageData->GetPointData()->GetScalars();
+
+  // compared in 64 bit, catches a region size truncated by a 32 bit SizeValueType
+  if (static_cast<vtkTypeUInt64>(scalars->GetNumberOfTuples()) !=
+      static_cast<vtkTypeUInt64>(inImageData->GetDimensions()[0]) *
+      static_cast<vtkTypeUInt64>(inImageData->GetDimensions()[1]) *
+      static_cast<vtkTypeUInt64>(inImageData->GetDimensions()[2]) ||
+      static_cast<vtkTypeUInt64>(region.GetNumberOfPixels()) !=
+      static_cast<vtkTypeUInt64>(scalars->GetNumberOfTuples()))
     {
     std::cerr
-      << "VolumeNodetoItkImage: Pointer to vtkMRMLScalarVolumeNode is NULL"
+      << "vtkImageDataToItkImage: number of scalars does not match the image size"
       << std::endl;
     return NULL;
     }
 
+  // container_manage_memory = false, ITK never frees the buffer itself
+  typename PixelContainerType::Pointer container = PixelContainerType::New();
+  container->SetImportPointer(static_cast<TPixel*>(scalars->GetVoidPointer(0)),
+                              region.GetNumberOfPixels(), false);
+
+  scalars->Register(NULL);
+  itk::CStyleCommand::Pointer release = itk::CStyleCommand::New();
+  release->SetCallback(ReleaseVtkBuffer);
+  release->SetClientData(static_cast<vtkObjectBase*>(scalars));
+  container->AddObserver(itk::DeleteEvent(), release);
+
+  typename ImageType::Pointer image = ImageType::New();
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->SetDirection(directionMatrix);
+  image->SetPixelContainer(container);
+
+  return image;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * Gets the matrices placing the image data of a volume node in the world,
+ * returns false if the node is under a non linear transform.
+ */
+bool GetVolumeNodeMatrices(vtkMRMLScalarVolumeNode *inVolumeNode,
+                           bool applyRasToWorld,
+                           bool applyRasToLps,
+                           vtkSmartPointer<vtkMatrix4x4> &inVolumeToRasTransformMatrix,
+                           vtkSmartPointer<vtkMatrix4x4> &rasToWorldTransformMatrix,
+                           vtkSmartPointer<vtkMatrix4x4> &rasToLpsTransformMatrix)
+{
   // Obtain IJK to RAS matrix
-  vtkSmartPointer<vtkMatrix4x4> inVolumeToRasTransformMatrix =
-    vtkSmartPointer<vtkMatrix4x4>::New();
+  inVolumeToRasTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
   inVolumeNode->GetIJKToRASMatrix(inVolumeToRasTransformMatrix);
 
   // Obtain RAS to World transform matrix
-  vtkSmartPointer<vtkMatrix4x4> rasToWorldTransformMatrix = 0;
+  rasToWorldTransformMatrix = 0;
 
   if (applyRasToWorld)
     {
@@ -121,14 +230,14 @@ vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(vtkMRMLScalarVolumeNode
         std::cerr
           <<  "VolumeNodeToItkImage: world transform is not linear"
           << std::endl;
-        return NULL;
+        return false;
         }
       inTransformNode->GetMatrixTransformToWorld(rasToWorldTransformMatrix);
       }
     }
 
   // Obtain RSAS to LPS matrix
-  vtkSmartPointer<vtkMatrix4x4> rasToLpsTransformMatrix = 0;
+  rasToLpsTransformMatrix = 0;
   if (applyRasToLps)
     {
     rasToLpsTransformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -138,31 +247,23 @@ vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(vtkMRMLScalarVolumeNode
     rasToLpsTransformMatrix->SetElement(3,3, 1.0);
     }
 
-  SeedImageType::Pointer outItkImage =
-      vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(inVolumeNode->GetImageData(),
-                                              inVolumeToRasTransformMatrix,
-                                              rasToWorldTransformMatrix,
-                                              rasToLpsTransformMatrix);
-
-  return outItkImage;
+  return true;
 }
 
 //------------------------------------------------------------------------------
-vtkVesselSegmentationHelper::SeedImageType::Pointer
-vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImageData,
-                                          vtkMatrix4x4 *inToRasMatrix,
-                                          vtkMatrix4x4 *rasToWorldMatrix,
-                                          vtkMatrix4x4 *rasToLpsMatrix)
+/**
+ * Computes the ITK region, spacing, origin and direction of VTK image data
+ * placed in the world by the given matrices.
+ */
+void ComputeItkGeometry(vtkImageData *inImageData,
+                        vtkMatrix4x4 *inToRasMatrix,
+                        vtkMatrix4x4 *rasToWorldMatrix,
+                        vtkMatrix4x4 *rasToLpsMatrix,
+                        vtkVesselSegmentationHelper::SeedImageType::RegionType &region,
+                        double spacing[3],
+                        double origin[3],
+                        itk::Matrix<double,3,3> &directionMatrix)
 {
-  // Check for null pointer
-  if (inImageData == NULL)
-    {
-    std::cerr
-      << "vtkImageDataToItkImage: Pointer to vtkImageData is NULL"
-      << std::endl;
-    return NULL;
-    }
-
   // Set orientation (if transformations are given)
   vtkSmartPointer<vtkTransform> coordinatesTransform =
     vtkSmartPointer<vtkTransform>::New();
@@ -184,7 +285,6 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
     }
 
   // Set image spacing
-  double spacing[3]={0.0};
   coordinatesTransform->GetScale(spacing);
   if (rasToLpsMatrix != NULL)
     {
@@ -194,7 +294,6 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
     }
 
   // Set image origin
-  double origin[3]={0.0};
   coordinatesTransform->GetPosition(origin);
 
   // Set direction
@@ -202,7 +301,6 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
     vtkSmartPointer<vtkMatrix4x4>::New();
   coordinatesTransform->GetMatrix(inVolumeToWorldTransformMatrix);
 
-  itk::Matrix<double,3,3> directionMatrix;
   unsigned int col = 0;
   for (col=0; col<3; col++)
     {
@@ -233,9 +331,266 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
   inSize[1] = extent[3] - extent[2] + 1;
   inSize[2] = extent[5] - extent[4] + 1;
   vtkVesselSegmentationHelper::SeedImageType::IndexType start = {0};
-  vtkVesselSegmentationHelper::SeedImageType::RegionType region;
   region.SetSize(inSize);
   region.SetIndex(start);
+}
+
+//------------------------------------------------------------------------------
+// pixels of a cast, split in chunks that the threads take in turn
+template <class TInPixel, class TOutPixel>
+struct CastBufferTask
+{
+  const TInPixel *Input;
+  TOutPixel *Output;
+  itk::SizeValueType NumberOfPixels;
+  itk::SizeValueType NumberOfChunks;
+};
+
+//------------------------------------------------------------------------------
+template <class TInPixel, class TOutPixel>
+void CastChunk(const CastBufferTask<TInPixel, TOutPixel> *task, itk::SizeValueType chunk)
+{
+  itk::SizeValueType begin = chunk * CastChunkSize;
+  itk::SizeValueType end = std::min(begin + CastChunkSize, task->NumberOfPixels);
+  const TInPixel *input = task->Input;
+  TOutPixel *output = task->Output;
+  for (itk::SizeValueType i = begin; i < end; ++i)
+    {
+    output[i] = static_cast<TOutPixel>(input[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+template <class TInPixel, class TOutPixel>
+VTK_THREAD_RETURN_TYPE CastBufferThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  const CastBufferTask<TInPixel, TOutPixel> *task =
+      static_cast<const CastBufferTask<TInPixel, TOutPixel>*>(info->UserData);
+
+  for (itk::SizeValueType chunk = info->ThreadID; chunk < task->NumberOfChunks;
+       chunk += info->NumberOfThreads)
+    {
+    CastChunk(task, chunk);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * Casts the pixels of an image into a new image of another pixel type, with
+ * the buffer split in chunks cast in parallel. Sizes and offsets are 64 bit,
+ * so volumes of more than 2^32 voxels are cast whole.
+ */
+template <class TOutImage, class TInImage>
+typename TOutImage::Pointer CastImage(TInImage *image)
+{
+  if (image == NULL)
+    {
+    return NULL;
+    }
+
+  typename TOutImage::Pointer outImage = TOutImage::New();
+  outImage->CopyInformation(image);
+  outImage->SetRegions(image->GetBufferedRegion());
+  outImage->Allocate();
+
+  CastBufferTask<typename TInImage::PixelType, typename TOutImage::PixelType> task;
+  task.Input = image->GetBufferPointer();
+  task.Output = outImage->GetBufferPointer();
+  task.NumberOfPixels = image->GetBufferedRegion().GetNumberOfPixels();
+  task.NumberOfChunks = (task.NumberOfPixels + CastChunkSize - 1) / CastChunkSize;
+
+  if (task.NumberOfChunks <= 1)
+    {
+    if (task.NumberOfChunks == 1)
+      {
+      CastChunk(&task, 0);
+      }
+    return outImage;
+    }
+
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(static_cast<int>(std::min<itk::SizeValueType>(
+      threader->GetNumberOfThreads(), task.NumberOfChunks)));
+  threader->SetSingleMethod(CastBufferThread<typename TInImage::PixelType,
+                                             typename TOutImage::PixelType>, &task);
+  threader->SingleMethodExecute();
+
+  return outImage;
+}
+
+
+}
+
+
+//---------------------------------------------------------------------------
+/**
+ * Constructor
+ */
+vtkVesselSegmentationHelper::vtkVesselSegmentationHelper()
+{
+
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationHelper::~vtkVesselSegmentationHelper()
+{
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationHelper::PrintSelf(ostream &os, vtkIndent vtkNotUsed(indent))
+{
+    (void)os;
+}
+
+//------------------------------------------------------------------------------
+vtkVesselSegmentationHelper::SeedImageType::Pointer
+vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(vtkMRMLScalarVolumeNode *inVolumeNode,
+                                        bool applyRasToWorld,
+                                        bool applyRasToLps)
+{
+  // Check for null pointer
+  if (inVolumeNode == NULL)
+    {
+    std::cerr
+      << "VolumeNodetoItkImage: Pointer to vtkMRMLScalarVolumeNode is NULL"
+      << std::endl;
+    return NULL;
+    }
+
+  vtkSmartPointer<vtkMatrix4x4> inVolumeToRasTransformMatrix;
+  vtkSmartPointer<vtkMatrix4x4> rasToWorldTransformMatrix;
+  vtkSmartPointer<vtkMatrix4x4> rasToLpsTransformMatrix;
+  if (!GetVolumeNodeMatrices(inVolumeNode, applyRasToWorld, applyRasToLps,
+                             inVolumeToRasTransformMatrix,
+                             rasToWorldTransformMatrix,
+                             rasToLpsTransformMatrix))
+    {
+    return NULL;
+    }
+
+  SeedImageType::Pointer outItkImage =
+      vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(inVolumeNode->GetImageData(),
+                                              inVolumeToRasTransformMatrix,
+                                              rasToWorldTransformMatrix,
+                                              rasToLpsTransformMatrix);
+
+  return outItkImage;
+}
+
+//------------------------------------------------------------------------------
+vtkVesselSegmentationHelper::LabelImageType::Pointer
+vtkVesselSegmentationHelper::ConvertVolumeNodeToItkLabelImage(vtkMRMLScalarVolumeNode *inVolumeNode,
+                                             bool applyRasToWorld,
+                                             bool applyRasToLps)
+{
+  SeedImageType::Pointer itkImage =
+      vtkVesselSegmentationHelper::ConvertVolumeNodeToItkImage(inVolumeNode,
+                                                               applyRasToWorld,
+                                                               applyRasToLps);
+  if (itkImage.IsNull())
+    {
+    return NULL;
+    }
+
+  // label values fit in the compact label type, the cast owns its own buffer
+  return CastImage<LabelImageType>(itkImage.GetPointer());
+}
+
+//------------------------------------------------------------------------------
+vtkVesselSegmentationHelper::NativeImageType::Pointer
+vtkVesselSegmentationHelper::ConvertVolumeNodeToNativeItkImage(vtkMRMLScalarVolumeNode *inVolumeNode,
+                                              bool applyRasToWorld,
+                                              bool applyRasToLps)
+{
+  // Check for null pointer
+  if (inVolumeNode == NULL)
+    {
+    std::cerr
+      << "VolumeNodeToNativeItkImage: Pointer to vtkMRMLScalarVolumeNode is NULL"
+      << std::endl;
+    return NULL;
+    }
+
+  vtkSmartPointer<vtkMatrix4x4> inVolumeToRasTransformMatrix;
+  vtkSmartPointer<vtkMatrix4x4> rasToWorldTransformMatrix;
+  vtkSmartPointer<vtkMatrix4x4> rasToLpsTransformMatrix;
+  if (!GetVolumeNodeMatrices(inVolumeNode, applyRasToWorld, applyRasToLps,
+                             inVolumeToRasTransformMatrix,
+                             rasToWorldTransformMatrix,
+                             rasToLpsTransformMatrix))
+    {
+    return NULL;
+    }
+
+  return vtkVesselSegmentationHelper::ConvertVtkImageDataToNativeItkImage(inVolumeNode->GetImageData(),
+                                                   inVolumeToRasTransformMatrix,
+                                                   rasToWorldTransformMatrix,
+                                                   rasToLpsTransformMatrix);
+}
+
+//------------------------------------------------------------------------------
+vtkVesselSegmentationHelper::NativeImageType::Pointer
+vtkVesselSegmentationHelper::ConvertVtkImageDataToNativeItkImage(vtkImageData *inImageData,
+                                                vtkMatrix4x4 *inToRasMatrix,
+                                                vtkMatrix4x4 *rasToWorldMatrix,
+                                                vtkMatrix4x4 *rasToLpsMatrix)
+{
+  // Check for null pointer
+  if (inImageData == NULL || inImageData->GetPointData()->GetScalars() == NULL)
+    {
+    std::cerr
+      << "vtkImageDataToNativeItkImage: Pointer to vtkImageData is NULL or has no scalars"
+      << std::endl;
+    return NULL;
+    }
+
+  vtkVesselSegmentationHelper::SeedImageType::RegionType region;
+  double spacing[3]={0.0};
+  double origin[3]={0.0};
+  itk::Matrix<double,3,3> directionMatrix;
+  ComputeItkGeometry(inImageData, inToRasMatrix, rasToWorldMatrix, rasToLpsMatrix,
+                     region, spacing, origin, directionMatrix);
+
+  // no cast, the ITK image shares the buffer of the VTK image
+  NativeImageType::Pointer imgReturn;
+  switch (inImageData->GetScalarType())
+    {
+    vtkVesselSegmentationTemplateMacro(
+        imgReturn = ShareVtkBuffer<VTK_TT>(inImageData, region, spacing, origin, directionMatrix).GetPointer());
+    default:
+      std::cerr
+      << "vtkImageDataToNativeItkImage: was not one of the scalar types"
+      << std::endl;
+      return NULL;
+    }
+
+  return imgReturn;
+}
+
+//------------------------------------------------------------------------------
+vtkVesselSegmentationHelper::SeedImageType::Pointer
+vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImageData,
+                                          vtkMatrix4x4 *inToRasMatrix,
+                                          vtkMatrix4x4 *rasToWorldMatrix,
+                                          vtkMatrix4x4 *rasToLpsMatrix)
+{
+  // Check for null pointer
+  if (inImageData == NULL)
+    {
+    std::cerr
+      << "vtkImageDataToItkImage: Pointer to vtkImageData is NULL"
+      << std::endl;
+    return NULL;
+    }
+
+  vtkVesselSegmentationHelper::SeedImageType::RegionType region;
+  double spacing[3]={0.0};
+  double origin[3]={0.0};
+  itk::Matrix<double,3,3> directionMatrix;
+  ComputeItkGeometry(inImageData, inToRasMatrix, rasToWorldMatrix, rasToLpsMatrix,
+                     region, spacing, origin, directionMatrix);
 
   std::cout
   << "vtkImageDataToItkImage: start import filter"
@@ -245,29 +600,24 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
   int scalarType = inImageData->GetScalarType();
 
 
+  if (inImageData->GetPointData()->GetScalars() == NULL)
+    {
+    std::cerr
+    << "vtkImageDataToItkImage: vtkImageData has no scalars"
+    << std::endl;
+    return NULL;
+    }
+
+  // the ITK image shares the buffer of the VTK image, only the casts to
+  // float allocate a new one
   if(scalarType == VTK_FLOAT)
     {
        std::cout
        << "vtkImageDataToItkImage: FLOAT"
        << std::endl;
 
-       typedef float pixelType;
-       typedef itk::ImportImageFilter<pixelType, 3> ImportFilterType;
-       ImportFilterType::Pointer importFilter = ImportFilterType::New();
-       importFilter->SetSpacing(spacing);
-       importFilter->SetOrigin(origin);
-       importFilter->SetDirection(directionMatrix);
-       importFilter->SetRegion(region);
-
-       // Import (itk filter will not have ownership of memory!)
-       float *pointerToData = static_cast<float*>(inImageData->GetScalarPointer());
-       unsigned int dataSize = inSize[0] * inSize[1] * inSize[2];
-       importFilter->SetImportPointer(pointerToData, dataSize, false);
-       importFilter->Update();
-
        // already float, no need to cast
-       imgReturn = importFilter->GetOutput();
-
+       imgReturn = ShareVtkBuffer<float>(inImageData, region, spacing, origin, directionMatrix);
     }
   else if(scalarType == VTK_SHORT)
     {
@@ -275,28 +625,8 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
       << "vtkImageDataToItkImage: SHORT"
       << std::endl;
 
-      typedef short pixelType;
-      typedef itk::Image<pixelType, 3>  InputImageType;
-
-      typedef itk::ImportImageFilter<pixelType, 3> ImportFilterType;
-      ImportFilterType::Pointer importFilter = ImportFilterType::New();
-      importFilter->SetSpacing(spacing);
-      importFilter->SetOrigin(origin);
-      importFilter->SetDirection(directionMatrix);
-      importFilter->SetRegion(region);
-
-      // Import (itk filter will not have ownership of memory!)
-      short *pointerToData = static_cast<short*>(inImageData->GetScalarPointer());
-      unsigned int dataSize = inSize[0] * inSize[1] * inSize[2];
-      importFilter->SetImportPointer(pointerToData, dataSize, false);
-      importFilter->Update();
-
-      typedef itk::CastImageFilter<InputImageType, vtkVesselSegmentationHelper::SeedImageType> CastFilterType;
-      CastFilterType::Pointer castFilter = CastFilterType::New();
-      castFilter->SetInput(importFilter->GetOutput());
-      castFilter->Update();
-      imgReturn = castFilter->GetOutput();
-
+      imgReturn = CastImage<SeedImageType>(
+          ShareVtkBuffer<short>(inImageData, region, spacing, origin, directionMatrix).GetPointer());
     }
   else if(scalarType == VTK_UNSIGNED_CHAR)
     {
@@ -304,28 +634,8 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
        << "vtkImageDataToItkImage: UNSIGNED CHAR"
        << std::endl;
 
-       typedef unsigned char pixelType;
-       typedef itk::Image<pixelType, 3>  InputImageType;
-
-       typedef itk::ImportImageFilter<pixelType, 3> ImportFilterType;
-       ImportFilterType::Pointer importFilter = ImportFilterType::New();
-       importFilter->SetSpacing(spacing);
-       importFilter->SetOrigin(origin);
-       importFilter->SetDirection(directionMatrix);
-       importFilter->SetRegion(region);
-
-       // Import (itk filter will not have ownership of memory!)
-       unsigned char *pointerToData = static_cast<unsigned char*>(inImageData->GetScalarPointer());
-       unsigned int dataSize = inSize[0] * inSize[1] * inSize[2];
-       importFilter->SetImportPointer(pointerToData, dataSize, false);
-       importFilter->Update();
-
-       typedef itk::CastImageFilter<InputImageType, vtkVesselSegmentationHelper::SeedImageType> CastFilterType;
-       CastFilterType::Pointer castFilter = CastFilterType::New();
-       castFilter->SetInput(importFilter->GetOutput());
-       castFilter->Update();
-       imgReturn = castFilter->GetOutput();
-
+       imgReturn = CastImage<SeedImageType>(
+           ShareVtkBuffer<unsigned char>(inImageData, region, spacing, origin, directionMatrix).GetPointer());
     }
   else if(scalarType == VTK_UNSIGNED_INT)
     {
@@ -333,28 +643,8 @@ vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkImageData *inImage
        << "vtkImageDataToItkImage: UNSIGNED INT"
        << std::endl;
 
-       typedef unsigned int pixelType;
-       typedef itk::Image<pixelType, 3>  InputImageType;
-
-       typedef itk::ImportImageFilter<pixelType, 3> ImportFilterType;
-       ImportFilterType::Pointer importFilter = ImportFilterType::New();
-       importFilter->SetSpacing(spacing);
-       importFilter->SetOrigin(origin);
-       importFilter->SetDirection(directionMatrix);
-       importFilter->SetRegion(region);
-
-       // Import (itk filter will not have ownership of memory!)
-       unsigned int *pointerToData = static_cast<unsigned int*>(inImageData->GetScalarPointer());
-       unsigned int dataSize = inSize[0] * inSize[1] * inSize[2];
-       importFilter->SetImportPointer(pointerToData, dataSize, false);
-       importFilter->Update();
-
-       typedef itk::CastImageFilter<InputImageType, vtkVesselSegmentationHelper::SeedImageType> CastFilterType;
-       CastFilterType::Pointer castFilter = CastFilterType::New();
-       castFilter->SetInput(importFilter->GetOutput());
-       castFilter->Update();
-       imgReturn = castFilter->GetOutput();
-
+       imgReturn = CastImage<SeedImageType>(
+           ShareVtkBuffer<unsigned int>(inImageData, region, spacing, origin, directionMatrix).GetPointer());
     }
   else
     {
@@ -384,32 +674,42 @@ vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(itk::Image<unsigned i
     return NULL;
     }
 
-  itk::Image<unsigned int, 3>::RegionType region = itkImage->GetBufferedRegion();
-  itk::Image<unsigned int, 3>::SizeType imageSize = region.GetSize();
-  //itk::Image<unsigned int, 3>::SpacingType imageSpacing = itkImage->GetSpacing();
-  //itk::Image<unsigned int, 3>::PointType origin = itkImage->GetOrigin();
+  // the VTK image keeps the buffer of the ITK image alive
+  vtkSmartPointer<vtkImageData> vtkImage = ShareItkBuffer(itkImage.GetPointer(), VTK_UNSIGNED_INT);
 
-  int extent[6]={0, (int) imageSize[0]-1,
-                 0, (int) imageSize[1]-1,
-                 0, (int) imageSize[2]-1};
+  if (!vtkImage)
+    {
+    std::cerr
+    << "ItkImageToVtkImageData: image could not be wrapped in vtkImageData"
+    << std::endl;
+    return NULL;
+    }
 
-  vtkSmartPointer<vtkImageImport> imageImport = vtkSmartPointer<vtkImageImport>::New();
+  return vtkImage;
+}
 
-  imageImport->SetDataScalarType(VTK_UNSIGNED_INT);
-  imageImport->SetNumberOfScalarComponents(1);
-  imageImport->SetDataSpacing(1,1,1);
-  imageImport->SetDataOrigin(0,0,0);
-  imageImport->SetWholeExtent(extent);
-  imageImport->SetDataExtentToWholeExtent();
-  void *dataPointer = static_cast<void*>(itkImage->GetBufferPointer());
-  imageImport->SetImportVoidPointer(dataPointer);
-  imageImport->Update();
+//------------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData>
+vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(LabelImageType::Pointer itkImage)
+{
+  if ( itkImage.IsNull() )
+    {
+    std::cerr
+    << "ItkImageToVtkImageData: itkImage (input image) is null"
+    << std::endl;
+    return NULL;
+    }
 
-  vtkSmartPointer<vtkImageData> vtkImage = imageImport->GetOutput();
+  // the VTK image keeps the buffer of the ITK image alive
+  vtkSmartPointer<vtkImageData> vtkImage = ShareItkBuffer(itkImage.GetPointer(), VTK_UNSIGNED_CHAR);
 
-  std::cout
-  << "ItkImageToVtkImageData: vtkImage reference count " << vtkImage->GetReferenceCount()
-  << std::endl;
+  if (!vtkImage)
+    {
+    std::cerr
+    << "ItkImageToVtkImageData: image could not be wrapped in vtkImageData"
+    << std::endl;
+    return NULL;
+    }
 
   return vtkImage;
 }
@@ -426,32 +726,16 @@ vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(SeedImageType::Pointe
     return NULL;
     }
 
-  SeedImageType::RegionType region = itkImage->GetBufferedRegion();
-  SeedImageType::SizeType imageSize = region.GetSize();
-  //SeedImageType::SpacingType imageSpacing = itkImage->GetSpacing();
-  //SeedImageType::PointType origin = itkImage->GetOrigin();
-
-  int extent[6]={0, (int) imageSize[0]-1,
-                 0, (int) imageSize[1]-1,
-                 0, (int) imageSize[2]-1};
-
-  vtkSmartPointer<vtkImageImport> imageImport = vtkSmartPointer<vtkImageImport>::New();
+  // the VTK image keeps the buffer of the ITK image alive
+  vtkSmartPointer<vtkImageData> vtkImage = ShareItkBuffer(itkImage.GetPointer(), VTK_FLOAT);
 
-  imageImport->SetDataScalarType(VTK_FLOAT);
-  imageImport->SetNumberOfScalarComponents(1);
-  imageImport->SetDataSpacing(1,1,1);
-  imageImport->SetDataOrigin(0,0,0);
-  imageImport->SetWholeExtent(extent);
-  imageImport->SetDataExtentToWholeExtent();
-  void *dataPointer = static_cast<void*>(itkImage->GetBufferPointer());
-  imageImport->SetImportVoidPointer(dataPointer);
-  imageImport->Update();
-
-  vtkSmartPointer<vtkImageData> vtkImage = imageImport->GetOutput();
-
-  std::cout
-  << "ItkImageToVtkImageData: vtkImage reference count " << vtkImage->GetReferenceCount()
-  << std::endl;
+  if (!vtkImage)
+    {
+    std::cerr
+    << "ItkImageToVtkImageData: image could not be wrapped in vtkImageData"
+    << std::endl;
+    return NULL;
+    }
 
   return vtkImage;
 }
@@ -536,10 +820,6 @@ ConvertItkImageToVolumeNode(SeedImageType::Pointer itkImage,
     outVolumeNode->SetIJKToRASMatrix(imageToWorldTransform->GetMatrix());
     }
 
-  std::cout
-  << "ConvertItkImageToVolumeNode: vtkImage reference count " << outImageData->GetReferenceCount()
-  << std::endl;
-
   return outVolumeNode;
 }
 
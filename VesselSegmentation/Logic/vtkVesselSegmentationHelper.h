@@ -37,6 +37,7 @@
 
 
 #include <vtkSmartPointer.h>
+#include <vtkSetGet.h>
 
 #include <itkImage.h>
 #include <itkPoint.h>
@@ -48,6 +49,17 @@ class vtkMRMLScalarVolumeNode;
 class vtkImageData;
 class vtkMatrix4x4;
 
+/**
+ * Dispatches call on the scalar types the segmentation pipeline is
+ * instantiated for, with VTK_TT as the pixel type. Used like vtkTemplateMacro
+ * inside a switch on the VTK scalar type.
+ */
+#define vtkVesselSegmentationTemplateMacro(call)                      \
+  vtkTemplateMacroCase(VTK_FLOAT, float, call);                       \
+  vtkTemplateMacroCase(VTK_SHORT, short, call);                       \
+  vtkTemplateMacroCase(VTK_UNSIGNED_CHAR, unsigned char, call);       \
+  vtkTemplateMacroCase(VTK_UNSIGNED_INT, unsigned int, call)
+
 /**
  * \ingroup VesselSegmentation
  *
@@ -66,6 +78,13 @@ public:
     typedef itk::Image<short, 3> LabelMapType;
     typedef itk::Image<pixelType, 3> SeedImageType;
 
+    // hepatic, portal and merged label maps only hold the values 0, 4, 5 and 9
+    typedef unsigned char labelPixelType;
+    typedef itk::Image<labelPixelType, 3> LabelImageType;
+
+    // image of any of the pixel types of vtkVesselSegmentationTemplateMacro
+    typedef itk::ImageBase<3> NativeImageType;
+
     /**
      * Standard vtk object function to print the properties of the object.
      *
@@ -83,6 +102,37 @@ public:
     static SeedImageType::Pointer ConvertVolumeNodeToItkImage(vtkMRMLScalarVolumeNode *inVolumeNode,
                            bool applyRasToWorld=true,
                            bool applyRasToLps=true);
+    /**
+     * Convert from a label map volume node to an ITK label image.
+     *
+     * @param pointer to a vtkMRMLScalarVolumeNode.
+     * @return LabelImageType::Pointer.
+     */
+    static LabelImageType::Pointer ConvertVolumeNodeToItkLabelImage(vtkMRMLScalarVolumeNode *inVolumeNode,
+                           bool applyRasToWorld=true,
+                           bool applyRasToLps=true);
+    /**
+     * Convert from a volume node to an ITK image of the scalar type of the
+     * node, sharing the buffer of the node.
+     *
+     * @param pointer to a vtkMRMLScalarVolumeNode.
+     * @return NativeImageType::Pointer, to an itk::Image of the pixel type.
+     */
+    static NativeImageType::Pointer ConvertVolumeNodeToNativeItkImage(vtkMRMLScalarVolumeNode *inVolumeNode,
+                           bool applyRasToWorld=true,
+                           bool applyRasToLps=true);
+    /**
+     * Convert from VTK image data to an ITK image of the same scalar type,
+     * sharing the buffer of the VTK image.
+     *
+     * @param pointer to vtkImageData.
+     * @return NativeImageType::Pointer, to an itk::Image of the pixel type.
+     */
+    static NativeImageType::Pointer ConvertVtkImageDataToNativeItkImage(vtkImageData *inImageData,
+                             vtkMatrix4x4 *inToRasMatrix=NULL,
+                             vtkMatrix4x4 *inToWorldMatrix=NULL,
+                             vtkMatrix4x4 *inRasToLpsMatrix=NULL);
+
     /**
      * Convert from VTK image data to an ITK image.
      *
@@ -110,6 +160,14 @@ public:
      */
     static vtkSmartPointer<vtkImageData> ConvertItkImageToVtkImageData(itk::Image<unsigned int, 3>::Pointer itkImage);
 
+    /**
+     * Convert from an ITK label image to an VTK image data.
+     *
+     * @param LabelImageType::Pointer.
+     * @return smart pointer to vtkImageData.
+     */
+    static vtkSmartPointer<vtkImageData> ConvertItkImageToVtkImageData(LabelImageType::Pointer itkImage);
+
     /**
      * Convert from an ITK image to a volume node.
      *
@@ -0,0 +1,412 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationLabelHistory.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#include "vtkVesselSegmentationLabelHistory.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+vtkStandardNewMacro(vtkVesselSegmentationLabelHistory);
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+// 7 bits per byte, the high bit set on all but the last byte
+void WriteVarint(std::vector<unsigned char> &runs, itk::SizeValueType value)
+{
+  while (value >= 0x80)
+    {
+    runs.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+    }
+  runs.push_back(static_cast<unsigned char>(value));
+}
+
+//---------------------------------------------------------------------------
+itk::SizeValueType ReadVarint(const unsigned char *&run)
+{
+  itk::SizeValueType value = 0;
+  int shift = 0;
+  while (*run & 0x80)
+    {
+    value |= static_cast<itk::SizeValueType>(*run & 0x7f) << shift;
+    shift += 7;
+    ++run;
+    }
+  value |= static_cast<itk::SizeValueType>(*run) << shift;
+  ++run;
+  return value;
+}
+
+//---------------------------------------------------------------------------
+// a run is stored as the gap since the end of the previous run, its length,
+// and its previous and new label
+void WriteRun(std::vector<unsigned char> &runs, itk::SizeValueType &end,
+              itk::SizeValueType start, itk::SizeValueType length,
+              unsigned char before, unsigned char after)
+{
+  WriteVarint(runs, start - end);
+  WriteVarint(runs, length);
+  runs.push_back(before);
+  runs.push_back(after);
+  end = start + length;
+}
+
+//---------------------------------------------------------------------------
+void UnionRegion(vtkVesselSegmentationLabelHistory::RegionType &region,
+                 const vtkVesselSegmentationLabelHistory::RegionType &other)
+{
+  if (other.GetNumberOfPixels() == 0)
+    {
+    return;
+    }
+  if (region.GetNumberOfPixels() == 0)
+    {
+    region = other;
+    return;
+    }
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    itk::IndexValueType lower = std::min(region.GetIndex(d), other.GetIndex(d));
+    itk::IndexValueType upper = std::max(
+        region.GetIndex(d) + static_cast<itk::IndexValueType>(region.GetSize(d)),
+        other.GetIndex(d) + static_cast<itk::IndexValueType>(other.GetSize(d)));
+    region.SetIndex(d, lower);
+    region.SetSize(d, static_cast<itk::SizeValueType>(upper - lower));
+    }
+}
+
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationLabelHistory::Delta::Delta()
+  : LabelMap(-1)
+  , NumberOfChangedVoxels(0)
+{
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationLabelHistory::Delta::Encode(int labelMap,
+                                                      const LabelImageType *before,
+                                                      const LabelImageType *after,
+                                                      const RegionType &region)
+{
+  this->LabelMap = labelMap;
+  this->Region = RegionType();
+  this->NumberOfChangedVoxels = 0;
+  this->Runs.clear();
+
+  if (after == NULL)
+    {
+    return;
+    }
+  this->BufferedRegion = after->GetBufferedRegion();
+
+  RegionType encoded = region;
+  if (!encoded.Crop(this->BufferedRegion) ||
+      (before != NULL && !encoded.Crop(before->GetBufferedRegion())))
+    {
+    return;
+    }
+
+  const LabelImageType::PixelType *afterBuffer = after->GetBufferPointer();
+  const LabelImageType::PixelType *beforeBuffer = before ? before->GetBufferPointer() : NULL;
+  const itk::SizeValueType lineLength = encoded.GetSize(0);
+
+  // offsets are those of the after image, consecutive runs are merged
+  itk::SizeValueType end = 0;
+  itk::SizeValueType runStart = 0;
+  itk::SizeValueType runLength = 0;
+  unsigned char runBefore = 0;
+  unsigned char runAfter = 0;
+
+  // bounds of the changed voxels
+  LabelImageType::IndexType lower = encoded.GetUpperIndex();
+  LabelImageType::IndexType upper = encoded.GetIndex();
+
+  LabelImageType::IndexType lineIndex = encoded.GetIndex();
+  for (itk::SizeValueType k = 0; k < encoded.GetSize(2); ++k)
+    {
+    lineIndex[2] = encoded.GetIndex(2) + static_cast<itk::IndexValueType>(k);
+    for (itk::SizeValueType j = 0; j < encoded.GetSize(1); ++j)
+      {
+      lineIndex[1] = encoded.GetIndex(1) + static_cast<itk::IndexValueType>(j);
+      itk::SizeValueType afterOffset = static_cast<itk::SizeValueType>(after->ComputeOffset(lineIndex));
+      const LabelImageType::PixelType *afterLine = afterBuffer + afterOffset;
+      const LabelImageType::PixelType *beforeLine = beforeBuffer ?
+          beforeBuffer + before->ComputeOffset(lineIndex) : NULL;
+
+      for (itk::SizeValueType i = 0; i < lineLength; ++i)
+        {
+        unsigned char valueAfter = afterLine[i];
+        unsigned char valueBefore = beforeLine ? beforeLine[i] : 0;
+        if (valueAfter == valueBefore)
+          {
+          continue;
+          }
+        itk::SizeValueType offset = afterOffset + i;
+        if (runLength > 0 && offset == runStart + runLength &&
+            valueBefore == runBefore && valueAfter == runAfter)
+          {
+          ++runLength;
+          }
+        else
+          {
+          if (runLength > 0)
+            {
+            WriteRun(this->Runs, end, runStart, runLength, runBefore, runAfter);
+            }
+          runStart = offset;
+          runLength = 1;
+          runBefore = valueBefore;
+          runAfter = valueAfter;
+          }
+
+        ++this->NumberOfChangedVoxels;
+        itk::IndexValueType x = lineIndex[0] + static_cast<itk::IndexValueType>(i);
+        lower[0] = std::min(lower[0], x);
+        upper[0] = std::max(upper[0], x);
+        for (unsigned int d = 1; d < 3; ++d)
+          {
+          lower[d] = std::min(lower[d], lineIndex[d]);
+          upper[d] = std::max(upper[d], lineIndex[d]);
+          }
+        }
+      }
+    }
+  if (runLength > 0)
+    {
+    WriteRun(this->Runs, end, runStart, runLength, runBefore, runAfter);
+    }
+  if (this->NumberOfChangedVoxels > 0)
+    {
+    this->Region.SetIndex(lower);
+    this->Region.SetUpperIndex(upper);
+    }
+
+  // the encoding is kept for the lifetime of the step
+  std::vector<unsigned char>(this->Runs).swap(this->Runs);
+}
+
+//---------------------------------------------------------------------------
+bool vtkVesselSegmentationLabelHistory::Delta::Apply(LabelImageType *labelMap, bool undo) const
+{
+  if (labelMap == NULL || labelMap->GetBufferedRegion() != this->BufferedRegion)
+    {
+    return false;
+    }
+
+  LabelImageType::PixelType *buffer = labelMap->GetBufferPointer();
+  const unsigned char *run = this->Runs.empty() ? NULL : &this->Runs[0];
+  const unsigned char *runsEnd = run + this->Runs.size();
+
+  itk::SizeValueType end = 0;
+  while (run < runsEnd)
+    {
+    itk::SizeValueType start = end + ReadVarint(run);
+    itk::SizeValueType length = ReadVarint(run);
+    unsigned char before = *run++;
+    unsigned char after = *run++;
+    std::fill(buffer + start, buffer + start + length, undo ? before : after);
+    end = start + length;
+    }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationLabelHistory::vtkVesselSegmentationLabelHistory()
+  : MaximumNumberOfSteps(50)
+{
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationLabelHistory::~vtkVesselSegmentationLabelHistory()
+{
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationLabelHistory::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "MaximumNumberOfSteps: " << this->MaximumNumberOfSteps << "\n";
+  os << indent << "NumberOfUndoSteps: " << this->GetNumberOfUndoSteps() << "\n";
+  os << indent << "NumberOfRedoSteps: " << this->GetNumberOfRedoSteps() << "\n";
+  os << indent << "MemorySize: " << this->GetMemorySize() << "\n";
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationLabelHistory::AddDelta(const Delta &delta)
+{
+  if (!delta.IsEmpty())
+    {
+    this->RecordedStep.push_back(delta);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationLabelHistory::EndStep()
+{
+  if (this->RecordedStep.empty())
+    {
+    return;
+    }
+
+  this->UndoSteps.push_back(StepType());
+  this->UndoSteps.back().swap(this->RecordedStep);
+  this->RedoSteps.clear();
+
+  while (static_cast<int>(this->UndoSteps.size()) > this->MaximumNumberOfSteps)
+    {
+    this->UndoSteps.pop_front();
+    }
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationLabelHistory::Clear()
+{
+  this->RecordedStep.clear();
+  this->UndoSteps.clear();
+  this->RedoSteps.clear();
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+bool vtkVesselSegmentationLabelHistory::ApplyStep(const StepType &step, bool undo,
+                                                  LabelImageType *const *labelMaps,
+                                                  int numberOfLabelMaps,
+                                                  RegionType *modifiedRegions)
+{
+  // nothing is written unless the whole step can be applied
+  for (size_t d = 0; d < step.size(); ++d)
+    {
+    int labelMap = step[d].GetLabelMap();
+    if (labelMap < 0 || labelMap >= numberOfLabelMaps || labelMaps[labelMap] == NULL ||
+        labelMaps[labelMap]->GetBufferedRegion() != step[d].GetBufferedRegion())
+      {
+      return false;
+      }
+    }
+
+  // deltas of the same label map are undone in the reverse order they were made
+  for (size_t d = 0; d < step.size(); ++d)
+    {
+    const Delta &delta = undo ? step[step.size() - 1 - d] : step[d];
+    if (!delta.Apply(labelMaps[delta.GetLabelMap()], undo))
+      {
+      return false;
+      }
+    if (modifiedRegions)
+      {
+      UnionRegion(modifiedRegions[delta.GetLabelMap()], delta.GetRegion());
+      }
+    }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool vtkVesselSegmentationLabelHistory::Undo(LabelImageType *const *labelMaps,
+                                             int numberOfLabelMaps,
+                                             RegionType *modifiedRegions)
+{
+  if (this->UndoSteps.empty() ||
+      !ApplyStep(this->UndoSteps.back(), true, labelMaps, numberOfLabelMaps, modifiedRegions))
+    {
+    return false;
+    }
+
+  this->RedoSteps.push_back(StepType());
+  this->RedoSteps.back().swap(this->UndoSteps.back());
+  this->UndoSteps.pop_back();
+  this->Modified();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool vtkVesselSegmentationLabelHistory::Redo(LabelImageType *const *labelMaps,
+                                             int numberOfLabelMaps,
+                                             RegionType *modifiedRegions)
+{
+  if (this->RedoSteps.empty() ||
+      !ApplyStep(this->RedoSteps.back(), false, labelMaps, numberOfLabelMaps, modifiedRegions))
+    {
+    return false;
+    }
+
+  this->UndoSteps.push_back(StepType());
+  this->UndoSteps.back().swap(this->RedoSteps.back());
+  this->RedoSteps.pop_back();
+  this->Modified();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationLabelHistory::GetNumberOfUndoSteps()
+{
+  return static_cast<int>(this->UndoSteps.size());
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationLabelHistory::GetNumberOfRedoSteps()
+{
+  return static_cast<int>(this->RedoSteps.size());
+}
+
+//---------------------------------------------------------------------------
+size_t vtkVesselSegmentationLabelHistory::GetMemorySize()
+{
+  size_t size = 0;
+  for (size_t s = 0; s < this->UndoSteps.size(); ++s)
+    {
+    for (size_t d = 0; d < this->UndoSteps[s].size(); ++d)
+      {
+      size += this->UndoSteps[s][d].GetMemorySize();
+      }
+    }
+  for (size_t s = 0; s < this->RedoSteps.size(); ++s)
+    {
+    for (size_t d = 0; d < this->RedoSteps[s].size(); ++d)
+      {
+      size += this->RedoSteps[s][d].GetMemorySize();
+      }
+    }
+  return size;
+}
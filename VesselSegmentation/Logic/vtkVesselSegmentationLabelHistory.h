@@ -0,0 +1,221 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationLabelHistory.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#ifndef __vtkVesselSegmentationLabelHistory_h
+#define __vtkVesselSegmentationLabelHistory_h
+
+#include "vtkSlicerVesselSegmentationModuleLogicExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <deque>
+#include <vector>
+
+#include "vtkVesselSegmentationHelper.h"
+
+/**
+ * \ingroup VesselSegmentation
+ *
+ * \brief Undo and redo history of the changes made to the vessel label maps.
+ *
+ * Each step keeps only the voxels it changed, as runs of voxels with the same
+ * previous and new label. The runs are stored as variable length gaps and
+ * lengths, so a step costs a few bytes per run instead of a copy of the label
+ * map, and undoing or redoing it writes the runs back into the label maps in
+ * place.
+ *
+ * The label maps are identified by the index given when a change is
+ * recorded, and must keep their size between the steps.
+ */
+class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT vtkVesselSegmentationLabelHistory :
+  public vtkObject
+{
+public:
+  /**
+   * Standard vtk object instantiation method.
+   *
+   * @return a pointer to a newly created vtkVesselSegmentationLabelHistory.
+   */
+  static vtkVesselSegmentationLabelHistory *New();
+
+  vtkTypeMacro(vtkVesselSegmentationLabelHistory, vtkObject);
+
+  /**
+   * Standard print object information method.
+   *
+   * @param os output stream to print the information to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent) VTK_OVERRIDE;
+
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+  typedef LabelImageType::RegionType RegionType;
+
+  /**
+   * Run length encoded changes of one label map. Encoding reads the label
+   * maps only, so it can be done in a worker thread.
+   */
+  class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT Delta
+  {
+  public:
+    Delta();
+
+    /**
+     * Encodes the voxels of the region that differ between before and after.
+     *
+     * @param index of the label map changed.
+     * @param label map before the change, NULL if it was empty.
+     * @param label map after the change, both must hold the region.
+     * @param region in which the voxels may have changed.
+     */
+    void Encode(int labelMap, const LabelImageType *before, const LabelImageType *after,
+                const RegionType &region);
+
+    /**
+     * Writes the previous (undo) or new values of the changed voxels.
+     *
+     * @param label map to write to, of the size of the encoded one.
+     * @param true to write the previous values, false for the new ones.
+     * @return false if the label map does not match the encoded one.
+     */
+    bool Apply(LabelImageType *labelMap, bool undo) const;
+
+    int GetLabelMap() const { return this->LabelMap; }
+    const RegionType &GetRegion() const { return this->Region; }
+    const RegionType &GetBufferedRegion() const { return this->BufferedRegion; }
+    itk::SizeValueType GetNumberOfChangedVoxels() const { return this->NumberOfChangedVoxels; }
+    bool IsEmpty() const { return this->NumberOfChangedVoxels == 0; }
+    size_t GetMemorySize() const { return this->Runs.size(); }
+
+  private:
+    int LabelMap;
+    RegionType BufferedRegion;
+    RegionType Region;
+    itk::SizeValueType NumberOfChangedVoxels;
+    std::vector<unsigned char> Runs;
+  };
+
+  /**
+   * Adds the changes of a label map to the step being recorded. Empty deltas
+   * are dropped.
+   *
+   * @param delta to add.
+   */
+  void AddDelta(const Delta &delta);
+
+  /**
+   * Closes the step being recorded, which becomes the one undone next. The
+   * steps that had been undone cannot be redone anymore.
+   */
+  void EndStep();
+
+  /**
+   * Removes all the steps.
+   */
+  void Clear();
+
+  /**
+   * Undoes the last step.
+   *
+   * @param label maps, indexed as when the step was recorded.
+   * @param number of label maps.
+   * @param regions changed in each label map, grown by the step.
+   * @return false if there is nothing to undo or a label map is missing.
+   */
+  bool Undo(LabelImageType *const *labelMaps, int numberOfLabelMaps, RegionType *modifiedRegions);
+
+  /**
+   * Redoes the last undone step.
+   *
+   * @param label maps, indexed as when the step was recorded.
+   * @param number of label maps.
+   * @param regions changed in each label map, grown by the step.
+   * @return false if there is nothing to redo or a label map is missing.
+   */
+  bool Redo(LabelImageType *const *labelMaps, int numberOfLabelMaps, RegionType *modifiedRegions);
+
+  /**
+   * Method to get the number of steps that can be undone.
+   *
+   * @return number of steps.
+   */
+  int GetNumberOfUndoSteps();
+
+  /**
+   * Method to get the number of steps that can be redone.
+   *
+   * @return number of steps.
+   */
+  int GetNumberOfRedoSteps();
+
+  /**
+   * Method to get the memory used by the steps.
+   *
+   * @return size in bytes of the encoded changes.
+   */
+  size_t GetMemorySize();
+
+  /**
+   * Maximum number of steps kept, the oldest ones are dropped. 50 by default.
+   */
+  vtkSetClampMacro(MaximumNumberOfSteps, int, 1, VTK_INT_MAX);
+  vtkGetMacro(MaximumNumberOfSteps, int);
+
+protected:
+  vtkVesselSegmentationLabelHistory();
+  ~vtkVesselSegmentationLabelHistory();
+
+  typedef std::vector<Delta> StepType;
+
+  /**
+   * Applies the deltas of a step, after checking all of its label maps exist.
+   */
+  static bool ApplyStep(const StepType &step, bool undo, LabelImageType *const *labelMaps,
+                        int numberOfLabelMaps, RegionType *modifiedRegions);
+
+  int MaximumNumberOfSteps;
+
+  StepType RecordedStep;
+  std::deque<StepType> UndoSteps;
+  std::deque<StepType> RedoSteps;
+
+private:
+  vtkVesselSegmentationLabelHistory(const vtkVesselSegmentationLabelHistory&); // Not implemented
+  void operator=(const vtkVesselSegmentationLabelHistory&); // Not implemented
+};
+
+#endif
@@ -0,0 +1,447 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMemoryManager.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#include "vtkVesselSegmentationMemoryManager.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkMutexLock.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkVesselSegmentationMemoryManager);
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager::MappedBuffer::MappedBuffer()
+  : Pointer(NULL)
+  , Size(0)
+  , LastUse(0)
+  , Spilled(false)
+#ifdef _WIN32
+  , File(INVALID_HANDLE_VALUE)
+  , Mapping(NULL)
+#else
+  , File(-1)
+#endif
+{
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager::MappedBuffer::~MappedBuffer()
+{
+  if (this->Manager)
+    {
+    this->Manager->RemoveBuffer(this);
+    }
+
+#ifdef _WIN32
+  if (this->Pointer)
+    {
+    UnmapViewOfFile(this->Pointer);
+    }
+  if (this->Mapping)
+    {
+    CloseHandle(this->Mapping);
+    }
+  // the file is deleted on close
+  if (this->File != INVALID_HANDLE_VALUE)
+    {
+    CloseHandle(this->File);
+    }
+#else
+  if (this->Pointer)
+    {
+    munmap(this->Pointer, this->Size);
+    }
+  if (this->File >= 0)
+    {
+    close(this->File);
+    }
+#endif
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager::vtkVesselSegmentationMemoryManager()
+{
+  this->MemoryBudget = 0;
+  this->TemporaryDirectory = NULL;
+  this->Lock = vtkSmartPointer<vtkMutexLock>::New();
+  this->UseCount = 0;
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager::~vtkVesselSegmentationMemoryManager()
+{
+  // the buffers keep the manager alive, none is left here
+  this->SetTemporaryDirectory(NULL);
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "MemoryBudget: " << this->MemoryBudget << "\n";
+  os << indent << "TemporaryDirectory: "
+     << (this->TemporaryDirectory ? this->TemporaryDirectory : "(none)") << "\n";
+  os << indent << "MappedSize: " << this->GetMappedSize() << "\n";
+  os << indent << "ResidentSize: " << this->GetResidentSize() << "\n";
+  for (int i = 0; i < this->GetNumberOfMappedImages(); ++i)
+    {
+    os << indent.GetNextIndent() << this->GetMappedImageName(i) << ": "
+       << this->GetMappedImageResidentSize(i) << " of "
+       << this->GetMappedImageSize(i) << " bytes resident\n";
+    }
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMemoryManager::MappedBuffer *
+vtkVesselSegmentationMemoryManager::CreateBuffer(const char *name, size_t size)
+{
+  MappedBuffer *buffer = new MappedBuffer;
+  buffer->Name = name ? name : "";
+  buffer->Size = size;
+
+#ifdef _WIN32
+  char directory[MAX_PATH + 1];
+  if (this->TemporaryDirectory)
+    {
+    strncpy(directory, this->TemporaryDirectory, MAX_PATH);
+    directory[MAX_PATH] = '\0';
+    }
+  else if (!GetTempPathA(MAX_PATH + 1, directory))
+    {
+    strcpy(directory, ".");
+    }
+  char fileName[MAX_PATH + 1];
+  if (GetTempFileNameA(directory, "ves", 0, fileName))
+    {
+    buffer->File = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    }
+  if (buffer->File != INVALID_HANDLE_VALUE)
+    {
+    ULARGE_INTEGER mappingSize;
+    mappingSize.QuadPart = size;
+    buffer->Mapping = CreateFileMappingA(buffer->File, NULL, PAGE_READWRITE,
+                                         mappingSize.HighPart, mappingSize.LowPart, NULL);
+    }
+  if (buffer->Mapping)
+    {
+    buffer->Pointer = MapViewOfFile(buffer->Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    }
+#else
+  std::string pattern = this->TemporaryDirectory ? this->TemporaryDirectory : "";
+  if (pattern.empty())
+    {
+    const char *tmp = getenv("TMPDIR");
+    pattern = tmp && *tmp ? tmp : "/tmp";
+    }
+  pattern += "/VesselSegmentationXXXXXX";
+  std::vector<char> fileName(pattern.begin(), pattern.end());
+  fileName.push_back('\0');
+
+  buffer->File = mkstemp(&fileName[0]);
+  if (buffer->File >= 0)
+    {
+    // only the mapping refers to the file from now on
+    unlink(&fileName[0]);
+    if (ftruncate(buffer->File, static_cast<off_t>(size)) == 0)
+      {
+      void *pointer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer->File, 0);
+      buffer->Pointer = pointer == MAP_FAILED ? NULL : pointer;
+      }
+    }
+#endif
+
+  if (buffer->Pointer == NULL)
+    {
+    vtkErrorMacro("MapImage: could not map a temporary file of " << size << " bytes for "
+                  << buffer->Name << ", the image stays in memory.");
+    delete buffer;
+    return NULL;
+    }
+
+  buffer->Manager = this;
+  this->Lock->Lock();
+  buffer->LastUse = ++this->UseCount;
+  this->Buffers.push_back(buffer);
+  this->Lock->Unlock();
+
+  return buffer;
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::RemoveBuffer(MappedBuffer *buffer)
+{
+  this->Lock->Lock();
+  this->Buffers.erase(std::remove(this->Buffers.begin(), this->Buffers.end(), buffer),
+                      this->Buffers.end());
+  this->Lock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMemoryManager::GetBufferResidentSize(const MappedBuffer *buffer)
+{
+#ifdef _WIN32
+  // the working set is not queried, a spilled buffer counts as not resident
+  // until it is used again
+  return buffer->Spilled ? 0 : static_cast<vtkTypeInt64>(buffer->Size);
+#else
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t pages = (buffer->Size + pageSize - 1) / pageSize;
+  std::vector<unsigned char> resident(pages);
+# ifdef __APPLE__
+  if (mincore(buffer->Pointer, buffer->Size, reinterpret_cast<char*>(&resident[0])) != 0)
+# else
+  if (mincore(buffer->Pointer, buffer->Size, &resident[0]) != 0)
+# endif
+    {
+    return buffer->Spilled ? 0 : static_cast<vtkTypeInt64>(buffer->Size);
+    }
+  vtkTypeInt64 residentPages = 0;
+  for (size_t p = 0; p < pages; ++p)
+    {
+    residentPages += resident[p] & 1;
+    }
+  return std::min(residentPages * static_cast<vtkTypeInt64>(pageSize),
+                  static_cast<vtkTypeInt64>(buffer->Size));
+#endif
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::SpillBuffer(MappedBuffer *buffer)
+{
+#ifdef _WIN32
+  FlushViewOfFile(buffer->Pointer, buffer->Size);
+  FlushFileBuffers(buffer->File);
+  // unlocking pages that are not locked removes them from the working set
+  VirtualUnlock(buffer->Pointer, buffer->Size);
+#else
+  // the pages are written to the file before they are dropped, and read back
+  // from it on the next access
+  msync(buffer->Pointer, buffer->Size, MS_SYNC);
+  madvise(buffer->Pointer, buffer->Size, MADV_DONTNEED);
+# ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(buffer->File, 0, static_cast<off_t>(buffer->Size), POSIX_FADV_DONTNEED);
+# endif
+#endif
+  buffer->Spilled = true;
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::Touch(const char *name)
+{
+  if (name == NULL)
+    {
+    return;
+    }
+
+  this->Lock->Lock();
+  ++this->UseCount;
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    MappedBuffer *buffer = this->Buffers[i];
+    if (buffer->Name != name)
+      {
+      continue;
+      }
+    buffer->LastUse = this->UseCount;
+    if (buffer->Spilled)
+      {
+#ifndef _WIN32
+      madvise(buffer->Pointer, buffer->Size, MADV_WILLNEED);
+#endif
+      buffer->Spilled = false;
+      }
+    }
+  this->Lock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::Spill(const char *name)
+{
+  if (name == NULL)
+    {
+    return;
+    }
+
+  this->Lock->Lock();
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    if (this->Buffers[i]->Name == name)
+      {
+      SpillBuffer(this->Buffers[i]);
+      }
+    }
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMemoryManager::EnforceBudget()
+{
+  if (this->MemoryBudget == 0)
+    {
+    return;
+    }
+
+  bool spilled = false;
+  this->Lock->Lock();
+
+  std::vector<vtkTypeInt64> resident(this->Buffers.size());
+  vtkTypeInt64 total = 0;
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    resident[i] = GetBufferResidentSize(this->Buffers[i]);
+    total += resident[i];
+    }
+
+  // least recently used first
+  std::vector<size_t> order;
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    order.push_back(i);
+    }
+  for (size_t i = 1; i < order.size(); ++i)
+    {
+    for (size_t j = i; j > 0 && this->Buffers[order[j]]->LastUse < this->Buffers[order[j-1]]->LastUse; --j)
+      {
+      std::swap(order[j], order[j-1]);
+      }
+    }
+
+  for (size_t k = 0; k < order.size() && total > this->MemoryBudget; ++k)
+    {
+    size_t i = order[k];
+    if (resident[i] > 0)
+      {
+      SpillBuffer(this->Buffers[i]);
+      total -= resident[i];
+      spilled = true;
+      }
+    }
+
+  this->Lock->Unlock();
+
+  if (spilled)
+    {
+    this->Modified();
+    }
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMemoryManager::GetMappedSize()
+{
+  vtkTypeInt64 size = 0;
+  this->Lock->Lock();
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    size += static_cast<vtkTypeInt64>(this->Buffers[i]->Size);
+    }
+  this->Lock->Unlock();
+  return size;
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMemoryManager::GetResidentSize()
+{
+  vtkTypeInt64 size = 0;
+  this->Lock->Lock();
+  for (size_t i = 0; i < this->Buffers.size(); ++i)
+    {
+    size += GetBufferResidentSize(this->Buffers[i]);
+    }
+  this->Lock->Unlock();
+  return size;
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationMemoryManager::GetNumberOfMappedImages()
+{
+  this->Lock->Lock();
+  int number = static_cast<int>(this->Buffers.size());
+  this->Lock->Unlock();
+  return number;
+}
+
+//---------------------------------------------------------------------------
+std::string vtkVesselSegmentationMemoryManager::GetMappedImageName(int index)
+{
+  std::string name;
+  this->Lock->Lock();
+  if (index >= 0 && index < static_cast<int>(this->Buffers.size()))
+    {
+    name = this->Buffers[index]->Name;
+    }
+  this->Lock->Unlock();
+  return name;
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMemoryManager::GetMappedImageSize(int index)
+{
+  vtkTypeInt64 size = 0;
+  this->Lock->Lock();
+  if (index >= 0 && index < static_cast<int>(this->Buffers.size()))
+    {
+    size = static_cast<vtkTypeInt64>(this->Buffers[index]->Size);
+    }
+  this->Lock->Unlock();
+  return size;
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMemoryManager::GetMappedImageResidentSize(int index)
+{
+  vtkTypeInt64 size = 0;
+  this->Lock->Lock();
+  if (index >= 0 && index < static_cast<int>(this->Buffers.size()))
+    {
+    size = GetBufferResidentSize(this->Buffers[index]);
+    }
+  this->Lock->Unlock();
+  return size;
+}
@@ -0,0 +1,285 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMemoryManager.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#ifndef __vtkVesselSegmentationMemoryManager_h
+#define __vtkVesselSegmentationMemoryManager_h
+
+#include "vtkSlicerVesselSegmentationModuleLogicExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// ITK includes
+#include <itkImportImageContainer.h>
+
+// STD includes
+#include <cstring>
+#include <string>
+#include <vector>
+
+class vtkMutexLock;
+
+/**
+ * \ingroup VesselSegmentation
+ *
+ * \brief Keeps the images of the vessel pipeline within a memory budget.
+ *
+ * Once a budget is set, MapImage moves an image into a temporary file mapped
+ * in memory. The image, and the VTK images sharing its buffer, keep working on
+ * the same pointer, while the pages that are not resident are read back from
+ * the file on access. EnforceBudget writes the least recently used images to
+ * their files and drops their pages until the resident size fits in the
+ * budget, so the system does not need to swap them.
+ *
+ * The temporary files are removed as soon as they are mapped, and the space
+ * is given back when the last image sharing the buffer is deleted.
+ */
+class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT vtkVesselSegmentationMemoryManager :
+  public vtkObject
+{
+public:
+  /**
+   * Standard vtk object instantiation method.
+   *
+   * @return a pointer to a newly created vtkVesselSegmentationMemoryManager.
+   */
+  static vtkVesselSegmentationMemoryManager *New();
+
+  vtkTypeMacro(vtkVesselSegmentationMemoryManager, vtkObject);
+
+  /**
+   * Standard print object information method.
+   *
+   * @param os output stream to print the information to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent) VTK_OVERRIDE;
+
+  /**
+   * Memory shared with a removed temporary file, unmapped when deleted.
+   */
+  class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT MappedBuffer
+  {
+  public:
+    ~MappedBuffer();
+
+    void *GetPointer() const { return this->Pointer; }
+    size_t GetSize() const { return this->Size; }
+    const std::string &GetName() const { return this->Name; }
+
+  private:
+    friend class vtkVesselSegmentationMemoryManager;
+    MappedBuffer();
+
+    vtkSmartPointer<vtkVesselSegmentationMemoryManager> Manager;
+    std::string Name;
+    void *Pointer;
+    size_t Size;
+    // set by the manager, guarded by its lock
+    unsigned long LastUse;
+    bool Spilled;
+#ifdef _WIN32
+    void *File;
+    void *Mapping;
+#else
+    int File;
+#endif
+
+    MappedBuffer(const MappedBuffer&); // Not implemented
+    void operator=(const MappedBuffer&); // Not implemented
+  };
+
+  /**
+   * Pixel container of an image mapped by the manager, which owns the
+   * mapped buffer.
+   */
+  template<class TElement>
+  class MappedImageContainer : public itk::ImportImageContainer<itk::SizeValueType, TElement>
+  {
+  public:
+    typedef MappedImageContainer Self;
+    typedef itk::ImportImageContainer<itk::SizeValueType, TElement> Superclass;
+    typedef itk::SmartPointer<Self> Pointer;
+    itkNewMacro(Self);
+    itkTypeMacro(MappedImageContainer, ImportImageContainer);
+
+    void SetBuffer(MappedBuffer *buffer)
+    {
+      this->SetImportPointer(static_cast<TElement*>(buffer->GetPointer()),
+                             buffer->GetSize() / sizeof(TElement), false);
+      this->Buffer = buffer;
+    }
+
+  protected:
+    MappedImageContainer() : Buffer(NULL) {}
+    ~MappedImageContainer()
+    {
+      // the base class does not free an imported pointer
+      delete this->Buffer;
+    }
+
+  private:
+    MappedBuffer *Buffer;
+
+    MappedImageContainer(const Self&); // Not implemented
+    void operator=(const Self&); // Not implemented
+  };
+
+  /**
+   * Budget of the resident size of the mapped images, in bytes. 0 (the
+   * default) leaves the images in memory.
+   */
+  vtkSetClampMacro(MemoryBudget, vtkTypeInt64, 0, VTK_TYPE_INT64_MAX);
+  vtkGetMacro(MemoryBudget, vtkTypeInt64);
+
+  /**
+   * Directory of the temporary files, the one of the system if not set.
+   */
+  vtkSetStringMacro(TemporaryDirectory);
+  vtkGetStringMacro(TemporaryDirectory);
+
+  /**
+   * Method to move an image into a temporary file mapped in memory, can be
+   * called from any thread.
+   *
+   * @param image to map, which is not changed.
+   * @param name under which the image is used, spilled and reported.
+   * @return a copy of the image in a mapped buffer, or the image itself if
+   * there is no budget or the file could not be created.
+   */
+  template<class TImage>
+  typename TImage::Pointer MapImage(TImage *image, const char *name)
+  {
+    if (image == NULL || this->MemoryBudget == 0 ||
+        image->GetPixelContainer() == NULL || image->GetPixelContainer()->Size() == 0)
+      {
+      return image;
+      }
+
+    typedef typename TImage::PixelType PixelType;
+    size_t size = image->GetPixelContainer()->Size() * sizeof(PixelType);
+    MappedBuffer *buffer = this->CreateBuffer(name, size);
+    if (buffer == NULL)
+      {
+      return image;
+      }
+    std::memcpy(buffer->GetPointer(), image->GetBufferPointer(), size);
+
+    typedef MappedImageContainer<PixelType> ContainerType;
+    typename ContainerType::Pointer container = ContainerType::New();
+    container->SetBuffer(buffer);
+
+    typename TImage::Pointer mapped = TImage::New();
+    mapped->CopyInformation(image);
+    mapped->SetBufferedRegion(image->GetBufferedRegion());
+    mapped->SetRequestedRegion(image->GetRequestedRegion());
+    mapped->SetPixelContainer(container);
+    return mapped;
+  }
+
+  /**
+   * Marks the images of a name as used by the current step, and asks the
+   * system to read back their pages that were spilled.
+   *
+   * @param name of the images.
+   */
+  void Touch(const char *name);
+
+  /**
+   * Writes the images of a name to their files and drops their pages.
+   *
+   * @param name of the images.
+   */
+  void Spill(const char *name);
+
+  /**
+   * Spills the least recently used images until the resident size fits in
+   * the budget.
+   */
+  void EnforceBudget();
+
+  /**
+   * Methods to get the usage of the mapped images.
+   *
+   * @return size in bytes.
+   */
+  vtkTypeInt64 GetMappedSize();
+  vtkTypeInt64 GetResidentSize();
+
+  /**
+   * Methods to get the mapped images one by one.
+   *
+   * @param index of the image.
+   * @return its name, size or resident size in bytes, empty or 0 if there
+   * is no such image.
+   */
+  int GetNumberOfMappedImages();
+  std::string GetMappedImageName(int index);
+  vtkTypeInt64 GetMappedImageSize(int index);
+  vtkTypeInt64 GetMappedImageResidentSize(int index);
+
+protected:
+  vtkVesselSegmentationMemoryManager();
+  ~vtkVesselSegmentationMemoryManager();
+
+  /**
+   * Creates and maps a removed temporary file.
+   *
+   * @return the buffer, NULL (after reporting the error) on failure.
+   */
+  MappedBuffer *CreateBuffer(const char *name, size_t size);
+
+  // called by the buffers when they are deleted
+  void RemoveBuffer(MappedBuffer *buffer);
+
+  // the lock must be held
+  static vtkTypeInt64 GetBufferResidentSize(const MappedBuffer *buffer);
+  static void SpillBuffer(MappedBuffer *buffer);
+
+  vtkTypeInt64 MemoryBudget;
+  char *TemporaryDirectory;
+
+  // guarded by the lock
+  vtkSmartPointer<vtkMutexLock> Lock;
+  std::vector<MappedBuffer*> Buffers;
+  unsigned long UseCount;
+
+private:
+  vtkVesselSegmentationMemoryManager(const vtkVesselSegmentationMemoryManager&); // Not implemented
+  void operator=(const vtkVesselSegmentationMemoryManager&); // Not implemented
+};
+
+#endif
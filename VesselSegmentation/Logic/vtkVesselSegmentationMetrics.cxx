@@ -0,0 +1,405 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMetrics.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#include "vtkVesselSegmentationMetrics.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkMutexLock.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+# include <sys/time.h>
+#endif
+
+vtkStandardNewMacro(vtkVesselSegmentationMetrics);
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+void WriteJSONString(std::ostream &os, const std::string &text)
+{
+  os << '"';
+  for (size_t i = 0; i < text.size(); ++i)
+    {
+    char c = text[i];
+    if (c == '"' || c == '\\')
+      {
+      os << '\\' << c;
+      }
+    else if (static_cast<unsigned char>(c) < 0x20)
+      {
+      static const char hex[] = "0123456789abcdef";
+      os << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+      }
+    else
+      {
+      os << c;
+      }
+    }
+  os << '"';
+}
+
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMetrics::Probe::Probe()
+  : Metrics(NULL)
+  , WallStart(0.0)
+  , CPUStart(0.0)
+  , PeakMemoryStart(0)
+{
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMetrics::Probe::Start(vtkVesselSegmentationMetrics *metrics,
+                                                const char *stage)
+{
+  if (metrics == NULL || !metrics->GetEnabled())
+    {
+    this->Metrics = NULL;
+    return;
+    }
+
+  this->Metrics = metrics;
+  this->Stage = stage ? stage : "";
+  this->PeakMemoryStart = vtkVesselSegmentationMetrics::GetProcessPeakMemory();
+  this->CPUStart = vtkVesselSegmentationMetrics::GetProcessCPUTime();
+  this->WallStart = vtkTimerLog::GetUniversalTime();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMetrics::Probe::Stop(vtkTypeInt64 numberOfVoxels)
+{
+  if (this->Metrics == NULL)
+    {
+    return;
+    }
+
+  double wallTime = vtkTimerLog::GetUniversalTime() - this->WallStart;
+  double cpuTime = vtkVesselSegmentationMetrics::GetProcessCPUTime() - this->CPUStart;
+  vtkTypeInt64 peakMemoryDelta =
+      vtkVesselSegmentationMetrics::GetProcessPeakMemory() - this->PeakMemoryStart;
+
+  this->Metrics->AddRecord(this->Stage.c_str(), wallTime, cpuTime, peakMemoryDelta, numberOfVoxels);
+  this->Metrics = NULL;
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMetrics::vtkVesselSegmentationMetrics()
+{
+  this->Enabled = false;
+  this->Lock = vtkSmartPointer<vtkMutexLock>::New();
+  this->Origin = vtkTimerLog::GetUniversalTime();
+}
+
+//---------------------------------------------------------------------------
+vtkVesselSegmentationMetrics::~vtkVesselSegmentationMetrics()
+{
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMetrics::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Enabled: " << (this->Enabled ? "true" : "false") << "\n";
+  os << indent << "NumberOfRecords: " << this->GetNumberOfRecords() << "\n";
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMetrics::AddRecord(const char *stage, double wallTime, double cpuTime,
+                                             vtkTypeInt64 peakMemoryDelta,
+                                             vtkTypeInt64 numberOfVoxels)
+{
+  Record record;
+  record.Stage = stage ? stage : "";
+  record.WallTime = wallTime;
+  record.CPUTime = cpuTime;
+  record.PeakMemoryDelta = peakMemoryDelta;
+  record.NumberOfVoxels = numberOfVoxels;
+
+  double now = vtkTimerLog::GetUniversalTime();
+
+  this->Lock->Lock();
+  record.StartTime = now - wallTime - this->Origin;
+  this->Records.push_back(record);
+  this->Lock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+void vtkVesselSegmentationMetrics::Clear()
+{
+  this->Lock->Lock();
+  this->Records.clear();
+  this->Origin = vtkTimerLog::GetUniversalTime();
+  this->Lock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationMetrics::GetNumberOfRecords()
+{
+  this->Lock->Lock();
+  int number = static_cast<int>(this->Records.size());
+  this->Lock->Unlock();
+  return number;
+}
+
+//---------------------------------------------------------------------------
+std::string vtkVesselSegmentationMetrics::GetStageName(int index)
+{
+  std::string stage;
+  this->Lock->Lock();
+  if (index >= 0 && index < static_cast<int>(this->Records.size()))
+    {
+    stage = this->Records[index].Stage;
+    }
+  this->Lock->Unlock();
+  return stage;
+}
+
+//---------------------------------------------------------------------------
+// the record getters only differ by the member they return
+#define vtkVesselSegmentationMetricsRecordGetter(type, member) \
+type vtkVesselSegmentationMetrics::Get##member(int index) \
+{ \
+  type value = 0; \
+  this->Lock->Lock(); \
+  if (index >= 0 && index < static_cast<int>(this->Records.size())) \
+    { \
+    value = this->Records[index].member; \
+    } \
+  this->Lock->Unlock(); \
+  return value; \
+}
+
+vtkVesselSegmentationMetricsRecordGetter(double, StartTime)
+vtkVesselSegmentationMetricsRecordGetter(double, WallTime)
+vtkVesselSegmentationMetricsRecordGetter(double, CPUTime)
+vtkVesselSegmentationMetricsRecordGetter(vtkTypeInt64, PeakMemoryDelta)
+vtkVesselSegmentationMetricsRecordGetter(vtkTypeInt64, NumberOfVoxels)
+
+#undef vtkVesselSegmentationMetricsRecordGetter
+
+//---------------------------------------------------------------------------
+int vtkVesselSegmentationMetrics::GetStageCount(const char *stage)
+{
+  int count = 0;
+  this->Lock->Lock();
+  for (size_t i = 0; stage && i < this->Records.size(); ++i)
+    {
+    if (this->Records[i].Stage == stage)
+      {
+      ++count;
+      }
+    }
+  this->Lock->Unlock();
+  return count;
+}
+
+//---------------------------------------------------------------------------
+double vtkVesselSegmentationMetrics::GetStageWallTime(const char *stage)
+{
+  double time = 0.0;
+  this->Lock->Lock();
+  for (size_t i = 0; stage && i < this->Records.size(); ++i)
+    {
+    if (this->Records[i].Stage == stage)
+      {
+      time += this->Records[i].WallTime;
+      }
+    }
+  this->Lock->Unlock();
+  return time;
+}
+
+//---------------------------------------------------------------------------
+double vtkVesselSegmentationMetrics::GetStageCPUTime(const char *stage)
+{
+  double time = 0.0;
+  this->Lock->Lock();
+  for (size_t i = 0; stage && i < this->Records.size(); ++i)
+    {
+    if (this->Records[i].Stage == stage)
+      {
+      time += this->Records[i].CPUTime;
+      }
+    }
+  this->Lock->Unlock();
+  return time;
+}
+
+//---------------------------------------------------------------------------
+std::string vtkVesselSegmentationMetrics::ExportJSON()
+{
+  this->Lock->Lock();
+  std::vector<Record> records = this->Records;
+  this->Lock->Unlock();
+
+  // the totals are kept in the order the stages first ran
+  std::vector<Record> totals;
+  std::vector<int> counts;
+  for (size_t i = 0; i < records.size(); ++i)
+    {
+    size_t t = 0;
+    while (t < totals.size() && totals[t].Stage != records[i].Stage)
+      {
+      ++t;
+      }
+    if (t == totals.size())
+      {
+      Record total = records[i];
+      total.WallTime = total.CPUTime = 0.0;
+      total.PeakMemoryDelta = total.NumberOfVoxels = 0;
+      totals.push_back(total);
+      counts.push_back(0);
+      }
+    totals[t].WallTime += records[i].WallTime;
+    totals[t].CPUTime += records[i].CPUTime;
+    totals[t].PeakMemoryDelta += records[i].PeakMemoryDelta;
+    totals[t].NumberOfVoxels += records[i].NumberOfVoxels;
+    ++counts[t];
+    }
+
+  std::ostringstream json;
+  json.precision(9);
+  json << "{\n  \"stages\": [";
+  for (size_t i = 0; i < records.size(); ++i)
+    {
+    json << (i ? ",\n" : "\n") << "    {\"name\": ";
+    WriteJSONString(json, records[i].Stage);
+    json << ", \"start\": " << records[i].StartTime
+         << ", \"wallTime\": " << records[i].WallTime
+         << ", \"cpuTime\": " << records[i].CPUTime
+         << ", \"peakMemoryDelta\": " << records[i].PeakMemoryDelta
+         << ", \"voxels\": " << records[i].NumberOfVoxels << "}";
+    }
+  json << (records.empty() ? "],\n" : "\n  ],\n");
+
+  json << "  \"totals\": [";
+  for (size_t t = 0; t < totals.size(); ++t)
+    {
+    json << (t ? ",\n" : "\n") << "    {\"name\": ";
+    WriteJSONString(json, totals[t].Stage);
+    json << ", \"count\": " << counts[t]
+         << ", \"wallTime\": " << totals[t].WallTime
+         << ", \"cpuTime\": " << totals[t].CPUTime
+         << ", \"peakMemoryDelta\": " << totals[t].PeakMemoryDelta
+         << ", \"voxels\": " << totals[t].NumberOfVoxels << "}";
+    }
+  json << (totals.empty() ? "]\n" : "\n  ]\n") << "}\n";
+
+  return json.str();
+}
+
+//---------------------------------------------------------------------------
+bool vtkVesselSegmentationMetrics::WriteJSON(const char *fileName)
+{
+  if (fileName == NULL)
+    {
+    vtkErrorMacro("WriteJSON: no file name.");
+    return false;
+    }
+
+  std::ofstream file(fileName);
+  file << this->ExportJSON();
+  if (!file.good())
+    {
+    vtkErrorMacro("WriteJSON: could not write " << fileName);
+    return false;
+    }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+double vtkVesselSegmentationMetrics::GetProcessCPUTime()
+{
+#ifdef _WIN32
+  FILETIME creation, exitTime, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user))
+    {
+    return 0.0;
+    }
+  ULARGE_INTEGER kernelTime, userTime;
+  kernelTime.LowPart = kernel.dwLowDateTime;
+  kernelTime.HighPart = kernel.dwHighDateTime;
+  userTime.LowPart = user.dwLowDateTime;
+  userTime.HighPart = user.dwHighDateTime;
+  // in units of 100 ns
+  return static_cast<double>(kernelTime.QuadPart + userTime.QuadPart) * 1e-7;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+    return 0.0;
+    }
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+//---------------------------------------------------------------------------
+vtkTypeInt64 vtkVesselSegmentationMetrics::GetProcessPeakMemory()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+    return 0;
+    }
+  return static_cast<vtkTypeInt64>(counters.PeakWorkingSetSize);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+    return 0;
+    }
+# ifdef __APPLE__
+  return static_cast<vtkTypeInt64>(usage.ru_maxrss);
+# else
+  // in kilobytes on Linux
+  return static_cast<vtkTypeInt64>(usage.ru_maxrss) * 1024;
+# endif
+#endif
+}
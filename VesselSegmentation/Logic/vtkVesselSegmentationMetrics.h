@@ -0,0 +1,225 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMetrics.h
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+#ifndef __vtkVesselSegmentationMetrics_h
+#define __vtkVesselSegmentationMetrics_h
+
+#include "vtkSlicerVesselSegmentationModuleLogicExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+class vtkMutexLock;
+
+/**
+ * \ingroup VesselSegmentation
+ *
+ * \brief Registry of the time and memory taken by the stages of the vessel
+ * pipeline.
+ *
+ * Each record holds the wall time, the CPU time of the whole process (so the
+ * ratio of the two shows how well a stage uses the threads), the growth of the
+ * peak resident memory of the process and the number of voxels processed by a
+ * stage. Records can be added from any thread, queried one by one or per stage
+ * name, and exported as JSON.
+ *
+ * Recording is disabled by default, a Probe then only checks the flag.
+ */
+class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT vtkVesselSegmentationMetrics :
+  public vtkObject
+{
+public:
+  /**
+   * Standard vtk object instantiation method.
+   *
+   * @return a pointer to a newly created vtkVesselSegmentationMetrics.
+   */
+  static vtkVesselSegmentationMetrics *New();
+
+  vtkTypeMacro(vtkVesselSegmentationMetrics, vtkObject);
+
+  /**
+   * Standard print object information method.
+   *
+   * @param os output stream to print the information to.
+   * @param indent indentation value.
+   */
+  void PrintSelf(ostream &os, vtkIndent indent) VTK_OVERRIDE;
+
+  /**
+   * Measures a stage between Start and Stop, and records it if the metrics
+   * were enabled when it started.
+   */
+  class VTK_SLICER_VESSELSEGMENTATION_MODULE_LOGIC_EXPORT Probe
+  {
+  public:
+    Probe();
+
+    /**
+     * Starts measuring a stage, does nothing if the metrics are NULL or
+     * disabled.
+     *
+     * @param metrics to record the stage in.
+     * @param name of the stage.
+     */
+    void Start(vtkVesselSegmentationMetrics *metrics, const char *stage);
+
+    /**
+     * Records the stage started last, if any.
+     *
+     * @param number of voxels processed by the stage.
+     */
+    void Stop(vtkTypeInt64 numberOfVoxels);
+
+    bool IsRunning() const { return this->Metrics != NULL; }
+
+  private:
+    vtkVesselSegmentationMetrics *Metrics;
+    std::string Stage;
+    double WallStart;
+    double CPUStart;
+    vtkTypeInt64 PeakMemoryStart;
+  };
+
+  /**
+   * Enables the recording. Disabled by default.
+   */
+  vtkSetMacro(Enabled, bool);
+  vtkGetMacro(Enabled, bool);
+  vtkBooleanMacro(Enabled, bool);
+
+  /**
+   * Adds a record, can be called from any thread.
+   *
+   * @param name of the stage.
+   * @param wall time in seconds.
+   * @param CPU time of the process in seconds.
+   * @param growth of the peak resident memory in bytes.
+   * @param number of voxels processed.
+   */
+  void AddRecord(const char *stage, double wallTime, double cpuTime,
+                 vtkTypeInt64 peakMemoryDelta, vtkTypeInt64 numberOfVoxels);
+
+  /**
+   * Removes all the records.
+   */
+  void Clear();
+
+  /**
+   * Method to get the number of records.
+   *
+   * @return number of records.
+   */
+  int GetNumberOfRecords();
+
+  /**
+   * Methods to get a record, in the order they were added.
+   *
+   * @param index of the record.
+   * @return the value, or an empty name and 0 if there is no such record.
+   */
+  std::string GetStageName(int index);
+  double GetStartTime(int index);
+  double GetWallTime(int index);
+  double GetCPUTime(int index);
+  vtkTypeInt64 GetPeakMemoryDelta(int index);
+  vtkTypeInt64 GetNumberOfVoxels(int index);
+
+  /**
+   * Methods to get the totals of the records of a stage.
+   *
+   * @param name of the stage.
+   * @return the number of records or the sum of their values.
+   */
+  int GetStageCount(const char *stage);
+  double GetStageWallTime(const char *stage);
+  double GetStageCPUTime(const char *stage);
+
+  /**
+   * Method to export the records and the totals per stage.
+   *
+   * @return JSON document.
+   */
+  std::string ExportJSON();
+
+  /**
+   * Method to write the JSON export to a file.
+   *
+   * @param name of the file.
+   * @return false if the file could not be written.
+   */
+  bool WriteJSON(const char *fileName);
+
+  /**
+   * Methods to get the current usage of the process.
+   *
+   * @return CPU time of all the threads in seconds, or the peak resident
+   * memory in bytes. 0 where not available.
+   */
+  static double GetProcessCPUTime();
+  static vtkTypeInt64 GetProcessPeakMemory();
+
+protected:
+  vtkVesselSegmentationMetrics();
+  ~vtkVesselSegmentationMetrics();
+
+  struct Record
+  {
+    std::string Stage;
+    double StartTime;
+    double WallTime;
+    double CPUTime;
+    vtkTypeInt64 PeakMemoryDelta;
+    vtkTypeInt64 NumberOfVoxels;
+  };
+
+  bool Enabled;
+
+  // guarded by the lock, the start times are relative to the origin
+  vtkSmartPointer<vtkMutexLock> Lock;
+  std::vector<Record> Records;
+  double Origin;
+
+private:
+  vtkVesselSegmentationMetrics(const vtkVesselSegmentationMetrics&); // Not implemented
+  void operator=(const vtkVesselSegmentationMetrics&); // Not implemented
+};
+
+#endif
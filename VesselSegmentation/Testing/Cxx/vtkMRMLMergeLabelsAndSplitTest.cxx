@@ -182,6 +182,7 @@ bool testLoadFileAndLabels( const char* volumeName1, const char* volumeName2, co
 
   // Declare the types of the images
   typedef itk::Image<PixelType,Dim> ImageType;
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
 
   vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode> storageNode2 =
       vtkSmartPointer<vtkMRMLVolumeArchetypeStorageNode>::New();
@@ -239,7 +240,7 @@ bool testLoadFileAndLabels( const char* volumeName1, const char* volumeName2, co
   TESTING_OUTPUT_ASSERT_ERRORS_END();
 
   std::cout << "Getting merged ITK data to write out" << std::endl;
-  ImageType::Pointer output = logic->GetMergedITKData();
+  LabelImageType::Pointer output = logic->GetMergedITKData();
 
   // check we have the merged label map
   if(output.IsNull())
@@ -248,7 +249,7 @@ bool testLoadFileAndLabels( const char* volumeName1, const char* volumeName2, co
     return false;
     }
 
-  typedef itk::ImageFileWriter<ImageType> FileWriterType;
+  typedef itk::ImageFileWriter<LabelImageType> FileWriterType;
 
   FileWriterType::Pointer writer = FileWriterType::New();
   writer->SetFileName(volumeName5);
@@ -310,7 +311,7 @@ bool testLoadFileAndLabels( const char* volumeName1, const char* volumeName2, co
   double minPx= imageCalculatorFilter->GetMinimum();
   double diff = 0;
   unsigned int nPix = 0;
-  itk::ImageRegionIterator<ImageType> itFilterOutput(output, output->GetLargestPossibleRegion());
+  itk::ImageRegionIterator<LabelImageType> itFilterOutput(output, output->GetLargestPossibleRegion());
   itk::ImageRegionIterator<ImageType> itSimilarityInput(similarityImg, similarityImg->GetLargestPossibleRegion());
 
   for(itFilterOutput.GoToBegin(), itSimilarityInput.GoToBegin(); !itSimilarityInput.IsAtEnd(); ++itFilterOutput, ++itSimilarityInput)
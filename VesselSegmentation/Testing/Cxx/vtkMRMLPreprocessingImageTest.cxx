@@ -274,5 +274,30 @@ bool testPreprocessAndCompare(const char* volumeName1, const char* volumeName2,
       return false;
   }
 
+  //--------------------------
+  // Preview: low resolution pass followed by the full resolution pass
+  // (runs in the foreground as there is no slicer application logic)
+  //--------------------------
+  selectionNode->SetActiveVolumeID(id);
+
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->PreprocessImagePreview(100,250,20,160,25,30,4);
+  TESTING_OUTPUT_ASSERT_ERRORS(0); // check have no errors
+  TESTING_OUTPUT_RESET(); // reset to clear errors + warnings
+
+  if (logic->IsPreprocessingRunning())
+    {
+    std::cout << "testPreprocessAndCompare: preprocessing still running." << std::endl;
+    return false;
+    }
+
+  ImageType::Pointer previewOutput = logic->GetPreprocessedITKData();
+  if (previewOutput.IsNull() || previewOutput == output ||
+      previewOutput->GetLargestPossibleRegion() != output->GetLargestPossibleRegion())
+    {
+    std::cout << "testPreprocessAndCompare: preview did not produce the full resolution image." << std::endl;
+    return false;
+    }
+
   return true;
 }
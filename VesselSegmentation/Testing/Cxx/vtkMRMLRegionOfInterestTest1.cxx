@@ -0,0 +1,407 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkMRMLRegionOfInterestTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+#include <vtkMRMLScene.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLLabelMapVolumeNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLSelectionNode.h>
+#include <vtkMRMLApplicationLogic.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkPolyData.h>
+
+// ITK includes
+#include <itkConfigure.h>
+#include <itkFactoryRegistration.h>
+
+// module includes
+#include "vtkSlicerVesselSegmentationLogic.h"
+#include "vtkMRMLVesselSegmentationSeedNode.h"
+#include "vtkVesselSegmentationHelper.h"
+
+// STD includes
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+
+const int VolumeSize = 48;
+
+//------------------------------------------------------------------------------
+// a bright tube along the slices, in a volume of 1 mm voxels
+vtkSmartPointer<vtkImageData> createVolume()
+{
+  vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+  imageData->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  imageData->AllocateScalars(VTK_SHORT, 1);
+
+  short *voxel = static_cast<short*>(imageData->GetScalarPointer());
+  for (int k = 0; k < VolumeSize; ++k)
+    {
+    for (int j = 0; j < VolumeSize; ++j)
+      {
+      for (int i = 0; i < VolumeSize; ++i, ++voxel)
+        {
+        *voxel = (std::abs(i - 24) <= 2 && std::abs(j - 24) <= 2) ? 200 : 0;
+        }
+      }
+    }
+  return imageData;
+}
+
+//------------------------------------------------------------------------------
+// the labelled voxels of a label map node of the scene, inside and outside of
+// a region of the volume
+bool countLabels(vtkMRMLScene *scene, const char *name,
+                 const vtkVesselSegmentationHelper::LabelImageType::RegionType &region,
+                 int &inside, int &outside)
+{
+  vtkMRMLLabelMapVolumeNode *labelMap =
+      vtkMRMLLabelMapVolumeNode::SafeDownCast(scene->GetFirstNodeByName(name));
+  if (labelMap == NULL || labelMap->GetImageData() == NULL)
+    {
+    std::cerr << "No label map " << name << std::endl;
+    return false;
+    }
+  vtkImageData *labels = labelMap->GetImageData();
+  int *dimensions = labels->GetDimensions();
+  if (dimensions[0] != VolumeSize || dimensions[1] != VolumeSize || dimensions[2] != VolumeSize)
+    {
+    std::cerr << "Label map " << name << " does not cover the whole volume" << std::endl;
+    return false;
+    }
+
+  inside = 0;
+  outside = 0;
+  for (int k = 0; k < VolumeSize; ++k)
+    {
+    for (int j = 0; j < VolumeSize; ++j)
+      {
+      for (int i = 0; i < VolumeSize; ++i)
+        {
+        if (labels->GetScalarComponentAsDouble(i, j, k, 0) == 0.0)
+          {
+          continue;
+          }
+        vtkVesselSegmentationHelper::LabelImageType::IndexType index;
+        index[0] = i;
+        index[1] = j;
+        index[2] = k;
+        ++(region.IsInside(index) ? inside : outside);
+        }
+      }
+    }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// traces the tube from a pair of seeds at slices k1 and k2, and checks the
+// label map only holds voxels of the preprocessed region
+bool segmentTube(vtkSlicerVesselSegmentationLogic *logic, vtkMRMLVesselSegmentationSeedNode *seedNode,
+                 bool isHepatic, double k1, double k2)
+{
+  seedNode->SetSeed1(24.0, 24.0, k1);
+  seedNode->SetSeed2(24.0, 24.0, k2);
+  logic->SegmentVessels(seedNode, isHepatic);
+
+  vtkVesselSegmentationHelper::LabelImageType::Pointer output =
+      isHepatic ? logic->GetHepaticITKData() : logic->GetPortalITKData();
+  vtkVesselSegmentationHelper::SeedImageType::RegionType region =
+      logic->GetPreprocessedITKData()->GetLargestPossibleRegion();
+  if (output.IsNull() || output->GetLargestPossibleRegion() != region)
+    {
+    std::cerr << (isHepatic ? "Hepatic" : "Portal")
+              << " label map not on the preprocessed region " << region << std::endl;
+    return false;
+    }
+
+  int inside = 0;
+  int outside = 0;
+  if (!countLabels(logic->GetMRMLScene(), isHepatic ? "hepaticLabel" : "portalLabel",
+                   region, inside, outside))
+    {
+    return false;
+    }
+  if (inside == 0 || outside != 0)
+    {
+    std::cerr << (isHepatic ? "Hepatic" : "Portal") << " label map with " << inside
+              << " voxels inside and " << outside << " outside of the region " << region << std::endl;
+    return false;
+    }
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLRegionOfInterestTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[]  )
+{
+  itk::itkFactoryRegistration();
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkSlicerVesselSegmentationLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  vtkNew<vtkMRMLApplicationLogic> appLogic;
+  logic->SetMRMLApplicationLogic(appLogic.GetPointer());
+
+  vtkNew<vtkMRMLSelectionNode> selectionNode;
+  scene->AddNode(selectionNode.GetPointer());
+
+  vtkNew<vtkMRMLScalarVolumeNode> volume;
+  volume->SetAndObserveImageData(createVolume());
+  scene->AddNode(volume.GetPointer());
+  selectionNode->SetActiveVolumeID(volume->GetID());
+
+  double bounds[6];
+  if (logic->GetRegionOfInterest(bounds))
+    {
+    std::cerr << "Region of interest set by default" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the voxels of the volume are at their RAS coordinates
+  const double box[6] = {16.0, 31.0, 16.0, 31.0, 8.0, 39.0};
+  logic->SetRegionOfInterest(box);
+  logic->SetRegionOfInterestMargin(2.0);
+
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->PreprocessImage(100,250,20,160,25,5);
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+
+  // the preprocessed image only holds the box and its margin, with the
+  // indices of the whole volume
+  vtkVesselSegmentationHelper::SeedImageType::Pointer preprocessed = logic->GetPreprocessedITKData();
+  if (preprocessed.IsNull())
+    {
+    std::cerr << "No preprocessed image" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkVesselSegmentationHelper::SeedImageType::RegionType region = preprocessed->GetLargestPossibleRegion();
+  for (unsigned int d = 0; d < 3; d++)
+    {
+    itk::IndexValueType first = static_cast<itk::IndexValueType>(box[2*d]) - 2;
+    itk::IndexValueType last = static_cast<itk::IndexValueType>(box[2*d+1]) + 2;
+    if (region.GetIndex(d) < first || region.GetIndex(d) + static_cast<itk::IndexValueType>(region.GetSize(d)) - 1 > last ||
+        region.GetIndex(d) > first + 1 || region.GetIndex(d) + static_cast<itk::IndexValueType>(region.GetSize(d)) - 1 < last - 1)
+      {
+      std::cerr << "Preprocessed region " << region << " does not match the region of interest" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // the node of the scene covers the whole volume, zero outside of the box
+  vtkMRMLScalarVolumeNode *preprocessedNode =
+      vtkMRMLScalarVolumeNode::SafeDownCast(scene->GetFirstNodeByName("preprocessedImage"));
+  if (preprocessedNode == NULL || preprocessedNode->GetImageData() == NULL)
+    {
+    std::cerr << "No preprocessed node" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int *dimensions = preprocessedNode->GetImageData()->GetDimensions();
+  if (dimensions[0] != VolumeSize || dimensions[1] != VolumeSize || dimensions[2] != VolumeSize)
+    {
+    std::cerr << "Preprocessed node of " << dimensions[0] << "x" << dimensions[1] << "x"
+              << dimensions[2] << " voxels instead of the whole volume" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkVesselSegmentationHelper::SeedImageType::IndexType inside;
+  inside[0] = 24;
+  inside[1] = 24;
+  inside[2] = 24;
+  float *pasted = static_cast<float*>(preprocessedNode->GetImageData()->GetScalarPointer(24, 24, 24));
+  float *outside = static_cast<float*>(preprocessedNode->GetImageData()->GetScalarPointer(2, 2, 2));
+  if (*pasted != preprocessed->GetPixel(inside) || *outside != 0.0f)
+    {
+    std::cerr << "Preprocessed image not pasted into the node" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // segment, merge, split and mesh on the cropped volume
+  vtkNew<vtkMRMLVesselSegmentationSeedNode> seedNode;
+  scene->AddNode(seedNode.GetPointer());
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  if (!segmentTube(logic.GetPointer(), seedNode.GetPointer(), true, 30.0, 36.0) ||
+      !segmentTube(logic.GetPointer(), seedNode.GetPointer(), false, 14.0, 10.0))
+    {
+    return EXIT_FAILURE;
+    }
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->MergeLabelMaps();
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+
+  vtkVesselSegmentationHelper::LabelImageType::Pointer merged = logic->GetMergedITKData();
+  if (merged.IsNull() || merged->GetLargestPossibleRegion() != region)
+    {
+    std::cerr << "Merged label map not on the preprocessed region" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int inside = 0;
+  int outside = 0;
+  if (!countLabels(scene.GetPointer(), "mergedLabel", region, inside, outside) ||
+      inside == 0 || outside != 0)
+    {
+    std::cerr << "Wrong merged label map node" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  seedNode->SetSeed1(24.0, 24.0, 20.0);
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->SplitVessels(seedNode.GetPointer(), true);
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+  if (logic->GetMergedITKData().IsNull() ||
+      logic->GetMergedITKData()->GetLargestPossibleRegion() != region)
+    {
+    std::cerr << "Split label map not on the preprocessed region" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->UpdateModels();
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+  const char *modelNames[2] = {"hepaticVesselModel", "portalVesselModel"};
+  for (int m = 0; m < 2; ++m)
+    {
+    vtkMRMLModelNode *model = vtkMRMLModelNode::SafeDownCast(scene->GetFirstNodeByName(modelNames[m]));
+    if (model == NULL || model->GetPolyData() == NULL || model->GetPolyData()->GetNumberOfPoints() == 0)
+      {
+      std::cerr << "No " << modelNames[m] << " of the cropped label map" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // segment again once the region of interest moved: the labels of the
+  // previous region are dropped, not shifted onto the new one
+  const double movedBox[6] = {16.0, 31.0, 16.0, 31.0, 20.0, 45.0};
+  logic->SetRegionOfInterest(movedBox);
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->PreprocessImage(100,250,20,160,25,5);
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+  if (logic->GetPreprocessedITKData()->GetLargestPossibleRegion() == region)
+    {
+    std::cerr << "Preprocessed region not moved with the region of interest" << std::endl;
+    return EXIT_FAILURE;
+    }
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  if (!segmentTube(logic.GetPointer(), seedNode.GetPointer(), true, 40.0, 44.0))
+    {
+    return EXIT_FAILURE;
+    }
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->MergeLabelMaps();
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+  if (logic->GetMergedITKData().IsNull() || logic->GetMergedITKData()->GetLargestPossibleRegion() !=
+      logic->GetPreprocessedITKData()->GetLargestPossibleRegion())
+    {
+    std::cerr << "Merged label map not moved with the region of interest" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the box of the labelled voxels of a label map
+  vtkSmartPointer<vtkImageData> labels = vtkSmartPointer<vtkImageData>::New();
+  labels->SetDimensions(VolumeSize, VolumeSize, VolumeSize);
+  labels->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  labels->GetPointData()->GetScalars()->FillComponent(0, 0);
+  for (int k = 10; k <= 12; ++k)
+    {
+    for (int j = 20; j <= 30; ++j)
+      {
+      for (int i = 5; i <= 40; ++i)
+        {
+        *static_cast<unsigned char*>(labels->GetScalarPointer(i, j, k)) = 1;
+        }
+      }
+    }
+  vtkNew<vtkMRMLLabelMapVolumeNode> labelMap;
+  labelMap->SetAndObserveImageData(labels);
+  scene->AddNode(labelMap.GetPointer());
+
+  if (!logic->SetRegionOfInterestFromNode(labelMap.GetPointer()) || !logic->GetRegionOfInterest(bounds) ||
+      bounds[0] != 5.0 || bounds[1] != 40.0 || bounds[2] != 20.0 || bounds[3] != 30.0 ||
+      bounds[4] != 10.0 || bounds[5] != 12.0)
+    {
+    std::cerr << "Wrong region of interest from the label map" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  logic->RemoveRegionOfInterest();
+  if (logic->GetRegionOfInterest(bounds))
+    {
+    std::cerr << "Region of interest not removed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // segment again on the whole volume
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  logic->PreprocessImage(100,250,20,160,25,5);
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+  vtkVesselSegmentationHelper::SeedImageType::RegionType wholeRegion =
+      logic->GetPreprocessedITKData()->GetLargestPossibleRegion();
+  if (wholeRegion.GetNumberOfPixels() != static_cast<itk::SizeValueType>(VolumeSize * VolumeSize * VolumeSize))
+    {
+    std::cerr << "Preprocessed region " << wholeRegion << " instead of the whole volume" << std::endl;
+    return EXIT_FAILURE;
+    }
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  if (!segmentTube(logic.GetPointer(), seedNode.GetPointer(), false, 4.0, 2.0))
+    {
+    return EXIT_FAILURE;
+    }
+  TESTING_OUTPUT_ASSERT_ERRORS(0);
+  TESTING_OUTPUT_RESET();
+
+  return EXIT_SUCCESS;
+}
@@ -162,6 +162,7 @@ bool testLoadFileAndSegment( const char* volumeName1, const char* volumeName2, c
 
   // Declare the types of the images
   typedef itk::Image<PixelType,Dim> ImageType;
+  typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
 
   //typedef itk::SeedVesselSegmentationImageFilter<ImageType, ImageType> SeedVesselFilterType;
 
@@ -218,9 +219,9 @@ bool testLoadFileAndSegment( const char* volumeName1, const char* volumeName2, c
   logic->SegmentVessels(seedNode.GetPointer(), false);
   TESTING_OUTPUT_ASSERT_ERRORS_END();
 
-  ImageType::Pointer output = logic->GetPortalITKData();
+  LabelImageType::Pointer output = logic->GetPortalITKData();
 
-  typedef itk::ImageFileWriter<ImageType> FileWriterType;
+  typedef itk::ImageFileWriter<LabelImageType> FileWriterType;
 
   FileWriterType::Pointer writer = FileWriterType::New();
   writer->SetFileName(volumeName3);
@@ -281,7 +282,7 @@ bool testLoadFileAndSegment( const char* volumeName1, const char* volumeName2, c
   double minPx= imageCalculatorFilter->GetMinimum();
   double diff = 0;
   unsigned int nPix = 0;
-  itk::ImageRegionIterator<ImageType> itFilterOutput(output, output->GetLargestPossibleRegion());
+  itk::ImageRegionIterator<LabelImageType> itFilterOutput(output, output->GetLargestPossibleRegion());
   itk::ImageRegionIterator<ImageType> itSimilarityInput(similarityImg, similarityImg->GetLargestPossibleRegion());
 
   for(itFilterOutput.GoToBegin(), itSimilarityInput.GoToBegin(); !itSimilarityInput.IsAtEnd(); ++itFilterOutput, ++itSimilarityInput)
@@ -464,6 +464,63 @@ public:
                   << "------------------------------");
     }
 
+  //------------------------------------------------------------------------------
+  bool JobStateTest1(bool isHepatic)
+    {
+    vtkDebugMacro("BEGIN: JobStateTest1"
+                  << "------------------------------");
+    // trigger error: could not get active volume, job reported as failed.
+
+    vtkSmartPointer<vtkMRMLScene> scene =
+      vtkSmartPointer<vtkMRMLScene>::New();
+    vtkSmartPointer<vtkMRMLSelectionNode> selectionNode =
+      vtkSmartPointer<vtkMRMLSelectionNode>::New();
+    vtkSmartPointer<vtkMRMLScalarVolumeNode> activeVol =
+      vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+
+    this->Superclass::SetMRMLScene(scene);
+    scene->AddNode(selectionNode);
+    scene->AddNode(activeVol);
+    char* id = activeVol->GetID();
+    selectionNode->SetActiveVolumeID(id);
+
+    vtkSmartPointer<vtkMRMLVesselSegmentationSeedNode> seedNode =
+        vtkSmartPointer<vtkMRMLVesselSegmentationSeedNode>::New();
+
+    if (this->GetJobState() != JobIdle)
+      {
+      std::cout << "JobStateTest1: new logic is not idle." << std::endl;
+      return false;
+      }
+
+    // without the Slicer application logic the jobs still run in the foreground
+    this->AsynchronousOn();
+
+    TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+    SegmentVessels(seedNode, isHepatic);
+    TESTING_OUTPUT_ASSERT_ERRORS(2);
+    TESTING_OUTPUT_RESET();
+
+    if (this->GetJobState() != JobFailed || this->GetNumberOfPendingJobs() != 0 ||
+        std::string(this->GetJobName()) != "Hepatic segmentation")
+      {
+      std::cout << "JobStateTest1: unexpected job state "
+                << GetJobStateAsString(this->GetJobState()) << std::endl;
+      return false;
+      }
+
+    // nothing to cancel or wait for
+    TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+    CancelJob();
+    WaitForJobs();
+    TESTING_OUTPUT_ASSERT_ERRORS(0);
+    TESTING_OUTPUT_RESET();
+
+    vtkDebugMacro("END: JobStateTest1"
+                  << "------------------------------");
+    return this->GetJobState() == JobFailed;
+    }
+
   //------------------------------------------------------------------------------
   void Reset3DViewTest1()
     {
@@ -609,6 +666,13 @@ int vtkMRMLVesselSegmentationLogicTest1(int , char * [] )
   logicTest->DebugOn();
   logicTest->UpdateModelsTest1();
 
+  logicTest = vtkSmartPointer<vtkSlicerVesselSegmentationLogicTest>::New();
+  logicTest->DebugOn();
+  if (!logicTest->JobStateTest1(isHepatic))
+    {
+    return EXIT_FAILURE;
+    }
+
   logicTest = vtkSmartPointer<vtkSlicerVesselSegmentationLogicTest>::New();
   logicTest->DebugOn();
   logicTest->Reset3DViewTest1();
@@ -0,0 +1,201 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationBrickMesherTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkPolyData.h>
+#include <vtkFeatureEdges.h>
+
+// module includes
+#include "vtkVesselSegmentationBrickMesher.h"
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// fill a ball of label inside the image, covering several bricks
+void fillBall(vtkImageData *image, const int center[3], int radius, unsigned char label)
+{
+  int *extent = image->GetExtent();
+  for (int k = extent[4]; k <= extent[5]; k++)
+    {
+    for (int j = extent[2]; j <= extent[3]; j++)
+      {
+      for (int i = extent[0]; i <= extent[1]; i++)
+        {
+        int di = i - center[0];
+        int dj = j - center[1];
+        int dk = k - center[2];
+        if (di*di + dj*dj + dk*dk <= radius*radius)
+          {
+          *static_cast<unsigned char*>(image->GetScalarPointer(i, j, k)) = label;
+          }
+        }
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+// count the edges used by only one polygon, a closed surface has none
+vtkIdType countOpenEdges(vtkPolyData *surface)
+{
+  vtkNew<vtkFeatureEdges> featureEdges;
+  featureEdges->SetInputData(surface);
+  featureEdges->BoundaryEdgesOn();
+  featureEdges->FeatureEdgesOff();
+  featureEdges->ManifoldEdgesOff();
+  featureEdges->NonManifoldEdgesOff();
+  featureEdges->Update();
+  return featureEdges->GetOutput()->GetNumberOfCells();
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkVesselSegmentationBrickMesherTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[]  )
+{
+  vtkNew<vtkImageData> image;
+  image->SetExtent(0, 39, 0, 39, 0, 39);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  image->GetPointData()->GetScalars()->FillComponent(0, 0);
+
+  int center[3] = { 20, 20, 20 };
+  fillBall(image.GetPointer(), center, 12, 4);
+
+  vtkNew<vtkVesselSegmentationBrickMesher> mesher;
+  mesher->SetLabel(4);
+  mesher->SetBrickSize(8);
+  mesher->SetInputData(image.GetPointer());
+  mesher->Update();
+
+  // 39 cells along each axis make 5 bricks
+  if (mesher->GetNumberOfUpdatedBricks() != 125)
+    {
+    std::cerr << "Expected all 125 bricks to be extracted, got "
+              << mesher->GetNumberOfUpdatedBricks() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (mesher->GetOutput()->GetNumberOfPolys() == 0)
+    {
+    std::cerr << "No surface extracted" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (countOpenEdges(mesher->GetOutput()) != 0)
+    {
+    std::cerr << "Surface is not closed at the brick seams" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // grow a small bump on the surface, only the bricks around it are extracted
+  int bumpCenter[3] = { 32, 20, 20 };
+  fillBall(image.GetPointer(), bumpCenter, 2, 4);
+  image->Modified();
+  int bumpExtent[6] = { 30, 34, 18, 22, 18, 22 };
+  mesher->AddModifiedExtent(bumpExtent);
+  mesher->Update();
+
+  if (mesher->GetNumberOfUpdatedBricks() == 0 || mesher->GetNumberOfUpdatedBricks() > 8)
+    {
+    std::cerr << "Expected at most 8 bricks to be extracted again, got "
+              << mesher->GetNumberOfUpdatedBricks() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (countOpenEdges(mesher->GetOutput()) != 0)
+    {
+    std::cerr << "Surface is not closed after the incremental update" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // compare with a complete extraction of the changed image
+  vtkNew<vtkVesselSegmentationBrickMesher> fullMesher;
+  fullMesher->SetLabel(4);
+  fullMesher->SetBrickSize(8);
+  fullMesher->SetInputData(image.GetPointer());
+  fullMesher->Update();
+
+  if (fullMesher->GetOutput()->GetNumberOfPolys() != mesher->GetOutput()->GetNumberOfPolys())
+    {
+    std::cerr << "Incremental surface has " << mesher->GetOutput()->GetNumberOfPolys()
+              << " polygons, complete extraction has "
+              << fullMesher->GetOutput()->GetNumberOfPolys() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a reset extracts everything again
+  mesher->Reset();
+  mesher->Update();
+  if (mesher->GetNumberOfUpdatedBricks() != 125)
+    {
+    std::cerr << "Expected all bricks to be extracted after a reset" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a second label in the same label map, both extracted in one pass
+  int secondCenter[3] = { 8, 8, 30 };
+  fillBall(image.GetPointer(), secondCenter, 5, 5);
+  image->Modified();
+
+  vtkNew<vtkVesselSegmentationBrickMesher> multiMesher;
+  multiMesher->SetNumberOfLabels(2);
+  multiMesher->SetLabel(0, 4);
+  multiMesher->SetLabel(1, 5);
+  multiMesher->SetBrickSize(8);
+  multiMesher->SetInputData(image.GetPointer());
+  multiMesher->Update();
+
+  // label 4 did not change, the complete extraction above still holds
+  if (multiMesher->GetOutput(0)->GetNumberOfPolys() != fullMesher->GetOutput()->GetNumberOfPolys())
+    {
+    std::cerr << "Multi-label surface of label 4 has " << multiMesher->GetOutput(0)->GetNumberOfPolys()
+              << " polygons, single label extraction has "
+              << fullMesher->GetOutput()->GetNumberOfPolys() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (multiMesher->GetOutput(1)->GetNumberOfPolys() == 0 ||
+      countOpenEdges(multiMesher->GetOutput(1)) != 0)
+    {
+    std::cerr << "Surface of label 5 is missing or not closed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
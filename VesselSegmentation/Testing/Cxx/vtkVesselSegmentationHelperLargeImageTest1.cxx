@@ -0,0 +1,203 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationHelperLargeImageTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkUnsignedCharArray.h>
+
+// module includes
+#include "vtkVesselSegmentationHelper.h"
+
+// STD includes
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+// reported to CTest as a skipped test (SKIP_RETURN_CODE)
+const int SkipReturnCode = 77;
+
+//------------------------------------------------------------------------------
+// a cast split over several chunks gives the same pixels as a plain cast
+int testChunkedCast()
+{
+  // not a multiple of the chunk size, the last chunk is partial
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(130, 130, 70);
+  image->AllocateScalars(VTK_SHORT, 1);
+
+  short *pixels = static_cast<short*>(image->GetScalarPointer());
+  vtkIdType numberOfPixels = image->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < numberOfPixels; ++i)
+    {
+    pixels[i] = static_cast<short>(i % 4001 - 2000);
+    }
+
+  vtkVesselSegmentationHelper::SeedImageType::Pointer itkImage =
+      vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(image.GetPointer());
+  if (itkImage.IsNull() ||
+      itkImage->GetLargestPossibleRegion().GetNumberOfPixels() !=
+      static_cast<itk::SizeValueType>(numberOfPixels))
+    {
+    std::cerr << "Cast image has the wrong size" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const float *castPixels = itkImage->GetBufferPointer();
+  for (vtkIdType i = 0; i < numberOfPixels; ++i)
+    {
+    if (castPixels[i] != static_cast<float>(pixels[i]))
+      {
+      std::cerr << "Pixel " << i << " cast to " << castPixels[i]
+                << " instead of " << pixels[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// import and export of a label volume of more than 2^32 voxels, on a lazily
+// mapped buffer of which only the pages written to are ever allocated;
+// SkipReturnCode when the buffer cannot be mapped
+int testLargeImage()
+{
+#ifdef _WIN32
+  std::cout << "No lazily mapped buffer on this platform, skipping" << std::endl;
+  return SkipReturnCode;
+#else
+  if (sizeof(vtkIdType) < 8 || sizeof(itk::SizeValueType) < 8 || sizeof(void*) < 8)
+    {
+    std::cout << "No 64 bit sizes in this build, skipping" << std::endl;
+    return SkipReturnCode;
+    }
+
+  const int dimensions[3] = { 2048, 2048, 1025 };
+  const vtkTypeUInt64 numberOfVoxels = static_cast<vtkTypeUInt64>(dimensions[0]) *
+      dimensions[1] * dimensions[2];
+  const vtkTypeUInt64 beyond32Bit = static_cast<vtkTypeUInt64>(1) << 32;
+
+  void *buffer = mmap(NULL, numberOfVoxels, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (buffer == MAP_FAILED)
+    {
+    std::cout << "Could not map " << numberOfVoxels << " bytes, skipping" << std::endl;
+    return SkipReturnCode;
+    }
+  unsigned char *voxels = static_cast<unsigned char*>(buffer);
+  voxels[beyond32Bit] = 3;
+  voxels[numberOfVoxels - 1] = 7;
+
+  int result = EXIT_SUCCESS;
+  {
+  vtkNew<vtkUnsignedCharArray> scalars;
+  // save = 1, the mapping is released below
+  scalars->SetArray(voxels, static_cast<vtkIdType>(numberOfVoxels), 1);
+
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+  image->GetPointData()->SetScalars(scalars.GetPointer());
+
+  // import: the ITK image shares the buffer, offsets past 2^32 reach the same voxels
+  vtkVesselSegmentationHelper::NativeImageType::Pointer nativeImage =
+      vtkVesselSegmentationHelper::ConvertVtkImageDataToNativeItkImage(image.GetPointer());
+  vtkVesselSegmentationHelper::LabelImageType::Pointer labelImage =
+      dynamic_cast<vtkVesselSegmentationHelper::LabelImageType*>(nativeImage.GetPointer());
+  if (labelImage.IsNull() || labelImage->GetBufferPointer() != voxels ||
+      labelImage->GetLargestPossibleRegion().GetNumberOfPixels() != numberOfVoxels)
+    {
+    std::cerr << "Large image was not imported whole" << std::endl;
+    result = EXIT_FAILURE;
+    }
+  else if (labelImage->GetPixel(labelImage->ComputeIndex(beyond32Bit)) != 3 ||
+           labelImage->GetPixel(labelImage->ComputeIndex(numberOfVoxels - 1)) != 7)
+    {
+    std::cerr << "Voxels past 2^32 read wrong values after import" << std::endl;
+    result = EXIT_FAILURE;
+    }
+  else
+    {
+    // export: the VTK image shares the ITK buffer again
+    vtkSmartPointer<vtkImageData> exported =
+        vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(labelImage);
+    if (exported == NULL ||
+        static_cast<vtkTypeUInt64>(exported->GetNumberOfPoints()) != numberOfVoxels ||
+        exported->GetScalarPointer() != voxels)
+      {
+      std::cerr << "Large image was not exported whole" << std::endl;
+      result = EXIT_FAILURE;
+      }
+    else if (exported->GetPointData()->GetScalars()->GetComponent(
+               static_cast<vtkIdType>(beyond32Bit), 0) != 3)
+      {
+      std::cerr << "Voxel past 2^32 reads a wrong value after export" << std::endl;
+      result = EXIT_FAILURE;
+      }
+    }
+  }
+
+  // every reference to the buffer is gone
+  munmap(buffer, numberOfVoxels);
+  return result;
+#endif
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkVesselSegmentationHelperLargeImageTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[])
+{
+  if (testChunkedCast() != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+  int result = testLargeImage();
+  if (result == SkipReturnCode)
+    {
+    return SkipReturnCode;
+    }
+  if (result != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -104,6 +104,38 @@ public:
                   << "------------------------------");
   }
 
+  void ConvertVtkImageDataToNativeItkImageTest1()
+  {
+    vtkDebugMacro("BEGIN: ConvertVtkImageDataToNativeItkImageTest1"
+                  << "------------------------------");
+    // a short image stays short and shares its buffer
+
+    vtkNew<vtkImageData> shortData;
+    shortData->SetDimensions(4, 4, 4);
+    shortData->AllocateScalars(VTK_SHORT, 1);
+
+    vtkVesselSegmentationHelper::NativeImageType::Pointer nativeImage =
+        vtkVesselSegmentationHelper::ConvertVtkImageDataToNativeItkImage(shortData.GetPointer());
+    itk::Image<short, 3> *shortImage = dynamic_cast<itk::Image<short, 3>*>(nativeImage.GetPointer());
+    if (shortImage == NULL ||
+        shortImage->GetBufferPointer() != shortData->GetScalarPointer())
+      {
+      vtkErrorMacro("ConvertVtkImageDataToNativeItkImageTest1: short buffer not shared");
+      }
+
+    // trigger error: double is not one of the supported types
+    vtkNew<vtkImageData> doubleData;
+    doubleData->SetDimensions(4, 4, 4);
+    doubleData->AllocateScalars(VTK_DOUBLE, 1);
+
+    if (vtkVesselSegmentationHelper::ConvertVtkImageDataToNativeItkImage(doubleData.GetPointer()).IsNotNull())
+      {
+      vtkErrorMacro("ConvertVtkImageDataToNativeItkImageTest1: double image converted");
+      }
+    vtkDebugMacro("END: ConvertVtkImageDataToNativeItkImageTest1"
+                  << "------------------------------");
+  }
+
   void ConvertItkImageToVtkImageDataTest1()
   {
     vtkDebugMacro("BEGIN: ConvertItkImageToVtkImageDataTest1"
@@ -201,6 +233,10 @@ int vtkVesselSegmentationHelperTest1(int argc, char * argv[]  )
   logicTest->DebugOn();
   logicTest->ConvertVtkImageDataToItkImageTest1();
 
+  logicTest = vtkSmartPointer<vtkVesselSegmentationHelperTest>::New();
+  logicTest->DebugOn();
+  logicTest->ConvertVtkImageDataToNativeItkImageTest1();
+
   logicTest = vtkSmartPointer<vtkVesselSegmentationHelperTest>::New();
   logicTest->DebugOn();
   logicTest->ConvertItkImageToVtkImageDataTest1();
@@ -307,6 +343,37 @@ bool loadImageAndTestConversions( const char* volumeName1, vtkSlicerVesselSegmen
     return false;
   }
 
+  // the VTK data shares the buffer of the ITK image and keeps it alive
+  if (vtkConvertedData->GetScalarPointer() != static_cast<void*>(itkConvertedImage->GetBufferPointer()))
+  {
+    std::cout << "ITK image and VTK data do not share their buffer" << std::endl;
+    return false;
+  }
+  float firstValue = itkConvertedImage->GetBufferPointer()[0];
+  itkConvertedImage = NULL;
+  volumeNodeConverted = NULL;
+  if (*static_cast<float*>(vtkConvertedData->GetScalarPointer()) != firstValue)
+  {
+    std::cout << "VTK data lost its buffer with the ITK image" << std::endl;
+    return false;
+  }
+
+  // and the other way around
+  vtkVesselSegmentationHelper::SeedImageType::Pointer itkSharedImage =
+      vtkVesselSegmentationHelper::ConvertVtkImageDataToItkImage(vtkConvertedData);
+  if (itkSharedImage.IsNull() ||
+      static_cast<void*>(itkSharedImage->GetBufferPointer()) != vtkConvertedData->GetScalarPointer())
+  {
+    std::cout << "VTK data and ITK image do not share their buffer" << std::endl;
+    return false;
+  }
+  vtkConvertedData = NULL;
+  if (itkSharedImage->GetBufferPointer()[0] != firstValue)
+  {
+    std::cout << "ITK image lost its buffer with the VTK data" << std::endl;
+    return false;
+  }
+
   return true;
 }
 
@@ -0,0 +1,217 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationLabelHistoryTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+// VTK includes
+#include <vtkNew.h>
+
+// ITK includes
+#include <itkImageAlgorithm.h>
+
+// module includes
+#include "vtkVesselSegmentationLabelHistory.h"
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+typedef vtkVesselSegmentationLabelHistory::LabelImageType LabelImageType;
+
+//------------------------------------------------------------------------------
+LabelImageType::Pointer createLabelMap()
+{
+  LabelImageType::SizeType size;
+  size.Fill(64);
+  LabelImageType::Pointer image = LabelImageType::New();
+  image->SetRegions(size);
+  image->Allocate();
+  image->FillBuffer(0);
+  return image;
+}
+
+//------------------------------------------------------------------------------
+LabelImageType::Pointer copyLabelMap(const LabelImageType *image)
+{
+  LabelImageType::Pointer copy = createLabelMap();
+  itk::ImageAlgorithm::Copy(image, copy.GetPointer(),
+                            image->GetBufferedRegion(), copy->GetBufferedRegion());
+  return copy;
+}
+
+//------------------------------------------------------------------------------
+// trace a straight vessel along x, as a segmentation step would
+void addVessel(LabelImageType *image, int y, int z, int radius, unsigned char label)
+{
+  LabelImageType::IndexType index;
+  for (index[2] = z - radius; index[2] <= z + radius; ++index[2])
+    {
+    for (index[1] = y - radius; index[1] <= y + radius; ++index[1])
+      {
+      for (index[0] = 4; index[0] < 60; ++index[0])
+        {
+        image->SetPixel(index, label);
+        }
+      }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool sameLabelMaps(const LabelImageType *a, const LabelImageType *b)
+{
+  const LabelImageType::PixelType *bufferA = a->GetBufferPointer();
+  const LabelImageType::PixelType *bufferB = b->GetBufferPointer();
+  for (itk::SizeValueType i = 0; i < a->GetBufferedRegion().GetNumberOfPixels(); ++i)
+    {
+    if (bufferA[i] != bufferB[i])
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkVesselSegmentationLabelHistoryTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[]  )
+{
+  vtkNew<vtkVesselSegmentationLabelHistory> history;
+
+  // first step, from an empty label map over the whole image
+  LabelImageType::Pointer step1 = createLabelMap();
+  addVessel(step1, 20, 20, 3, 4);
+  vtkVesselSegmentationLabelHistory::Delta delta1;
+  delta1.Encode(0, NULL, step1, step1->GetLargestPossibleRegion());
+  history->AddDelta(delta1);
+  history->EndStep();
+
+  // second step, changes a region only
+  LabelImageType::Pointer step2 = copyLabelMap(step1);
+  addVessel(step2, 40, 30, 2, 4);
+  LabelImageType::RegionType region2;
+  region2.SetIndex(0, 0);
+  region2.SetIndex(1, 36);
+  region2.SetIndex(2, 26);
+  region2.SetSize(0, 64);
+  region2.SetSize(1, 9);
+  region2.SetSize(2, 9);
+  vtkVesselSegmentationLabelHistory::Delta delta2;
+  delta2.Encode(0, step1, step2, region2);
+  history->AddDelta(delta2);
+  history->EndStep();
+
+  if (delta2.GetNumberOfChangedVoxels() != 56 * 5 * 5)
+    {
+    std::cerr << "Expected " << 56 * 5 * 5 << " changed voxels, got "
+              << delta2.GetNumberOfChangedVoxels() << std::endl;
+    return EXIT_FAILURE;
+    }
+  // a few bytes per run, far less than the 262144 voxels of the label map
+  if (history->GetMemorySize() > 1024)
+    {
+    std::cerr << "History uses " << history->GetMemorySize() << " bytes" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // undo on the current label map, in place
+  LabelImageType::Pointer current = copyLabelMap(step2);
+  LabelImageType *labelMaps[1] = { current.GetPointer() };
+  LabelImageType::RegionType modified[1];
+  if (!history->Undo(labelMaps, 1, modified) || !sameLabelMaps(current, step1))
+    {
+    std::cerr << "Undo did not restore the first step" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!region2.IsInside(modified[0]))
+    {
+    std::cerr << "Undo modified region is outside of the edited region" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!history->Undo(labelMaps, 1, NULL) || !sameLabelMaps(current, createLabelMap()))
+    {
+    std::cerr << "Undo did not restore the empty label map" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (history->Undo(labelMaps, 1, NULL))
+    {
+    std::cerr << "Undo past the first step" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // redo both steps
+  if (!history->Redo(labelMaps, 1, NULL) || !history->Redo(labelMaps, 1, NULL) ||
+      !sameLabelMaps(current, step2))
+    {
+    std::cerr << "Redo did not restore the second step" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a new step after an undo drops the redo steps
+  history->Undo(labelMaps, 1, NULL);
+  LabelImageType::Pointer step3 = copyLabelMap(current);
+  addVessel(step3, 10, 50, 1, 4);
+  vtkVesselSegmentationLabelHistory::Delta delta3;
+  delta3.Encode(0, current, step3, step3->GetLargestPossibleRegion());
+  history->AddDelta(delta3);
+  history->EndStep();
+  if (history->GetNumberOfRedoSteps() != 0 || history->GetNumberOfUndoSteps() != 2)
+    {
+    std::cerr << "Expected 2 undo and no redo steps after a new step" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a label map of another size is not written to
+  LabelImageType::Pointer other = LabelImageType::New();
+  LabelImageType::SizeType otherSize;
+  otherSize.Fill(32);
+  other->SetRegions(otherSize);
+  other->Allocate();
+  LabelImageType *otherMaps[1] = { other.GetPointer() };
+  if (history->Undo(otherMaps, 1, NULL))
+    {
+    std::cerr << "Undo applied to a label map of another size" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  history->Clear();
+  if (history->GetNumberOfUndoSteps() != 0 || history->GetMemorySize() != 0)
+    {
+    std::cerr << "History not cleared" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMemoryManagerTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkImageData.h>
+
+// ITK includes
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+
+// module includes
+#include "vtkVesselSegmentationHelper.h"
+#include "vtkVesselSegmentationMemoryManager.h"
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+
+//------------------------------------------------------------------------------
+LabelImageType::Pointer createLabelMap()
+{
+  LabelImageType::SizeType size;
+  size.Fill(96);
+  LabelImageType::Pointer image = LabelImageType::New();
+  image->SetRegions(size);
+  image->Allocate();
+
+  itk::ImageRegionIterator<LabelImageType> it(image, image->GetBufferedRegion());
+  unsigned int n = 0;
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it, ++n)
+    {
+    it.Set(static_cast<LabelImageType::PixelType>((n * 7) % 251));
+    }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+bool sameLabelMaps(const LabelImageType *a, const LabelImageType *b)
+{
+  if (a->GetBufferedRegion() != b->GetBufferedRegion())
+    {
+    return false;
+    }
+  itk::ImageRegionConstIterator<LabelImageType> itA(a, a->GetBufferedRegion());
+  itk::ImageRegionConstIterator<LabelImageType> itB(b, b->GetBufferedRegion());
+  for (itA.GoToBegin(), itB.GoToBegin(); !itA.IsAtEnd(); ++itA, ++itB)
+    {
+    if (itA.Get() != itB.Get())
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkVesselSegmentationMemoryManagerTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[]  )
+{
+  vtkNew<vtkVesselSegmentationMemoryManager> manager;
+  LabelImageType::Pointer original = createLabelMap();
+  const vtkTypeInt64 imageSize = 96 * 96 * 96;
+
+  // without a budget the images stay as they are
+  LabelImageType::Pointer unmapped = manager->MapImage(original.GetPointer(), "hepatic");
+  if (unmapped != original || manager->GetNumberOfMappedImages() != 0)
+    {
+    std::cerr << "Image mapped without a budget" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  manager->SetMemoryBudget(imageSize + imageSize / 2);
+
+  LabelImageType::Pointer hepatic = manager->MapImage(original.GetPointer(), "hepatic");
+  LabelImageType::Pointer portal = manager->MapImage(original.GetPointer(), "portal");
+  if (hepatic == original || hepatic->GetBufferPointer() == original->GetBufferPointer() ||
+      !sameLabelMaps(hepatic, original) || !sameLabelMaps(portal, original))
+    {
+    std::cerr << "Mapped images differ from the original" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (manager->GetNumberOfMappedImages() != 2 || manager->GetMappedSize() != 2 * imageSize ||
+      manager->GetMappedImageName(0) != "hepatic" || manager->GetMappedImageSize(1) != imageSize ||
+      manager->GetResidentSize() > 2 * imageSize)
+    {
+    std::cerr << "Wrong usage of the mapped images: " << manager->GetNumberOfMappedImages()
+              << " images, " << manager->GetMappedSize() << " bytes" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a change made in place survives a spill
+  LabelImageType::IndexType index;
+  index.Fill(42);
+  hepatic->SetPixel(index, 9);
+  manager->Spill("hepatic");
+  if (hepatic->GetPixel(index) != 9)
+    {
+    std::cerr << "Change lost by the spill" << std::endl;
+    return EXIT_FAILURE;
+    }
+  hepatic->SetPixel(index, original->GetPixel(index));
+  if (!sameLabelMaps(hepatic, original))
+    {
+    std::cerr << "Spilled image read back wrong" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the hepatic image is used last, the portal one is spilled
+  manager->Touch("hepatic");
+  manager->EnforceBudget();
+  if (!sameLabelMaps(portal, original) || !sameLabelMaps(hepatic, original))
+    {
+    std::cerr << "Images read back wrong after enforcing the budget" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // a VTK image sharing the buffer keeps the mapping alive
+  vtkSmartPointer<vtkImageData> portalData =
+      vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(portal);
+  const LabelImageType::PixelType *portalBuffer = portal->GetBufferPointer();
+  portal = NULL;
+  hepatic = NULL;
+  if (manager->GetNumberOfMappedImages() != 1 || manager->GetMappedImageName(0) != "portal")
+    {
+    std::cerr << "Expected the portal image only, got "
+              << manager->GetNumberOfMappedImages() << " images" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (portalData->GetScalarPointer() != portalBuffer ||
+      *static_cast<unsigned char*>(portalData->GetScalarPointer(42, 42, 42)) != original->GetPixel(index))
+    {
+    std::cerr << "VTK image does not share the mapped buffer" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  portalData = NULL;
+  if (manager->GetNumberOfMappedImages() != 0 || manager->GetMappedSize() != 0)
+    {
+    std::cerr << "Mapped images not released" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
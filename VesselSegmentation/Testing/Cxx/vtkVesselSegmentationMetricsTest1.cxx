@@ -0,0 +1,222 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: vtkVesselSegmentationMetricsTest1.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+
+// VTK includes
+#include <vtkNew.h>
+
+// ITK includes
+#include <itkCommand.h>
+
+// module includes
+#include "vtkVesselSegmentationHelper.h"
+#include "vtkVesselSegmentationMetrics.h"
+#include "itkVesselSegmentationPreProcessingFilter.h"
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkVesselSegmentationHelper::SeedImageType ImageType;
+typedef itk::VesselSegmentationPreProcessingFilter<ImageType, ImageType> PreprocessingFilterType;
+
+//------------------------------------------------------------------------------
+// keeps the names of the stages the preprocessing filter starts
+class StageObserver : public itk::Command
+{
+public:
+  typedef StageObserver Self;
+  typedef itk::SmartPointer<Self> Pointer;
+  itkNewMacro(Self);
+
+  virtual void Execute(itk::Object *caller, const itk::EventObject &event)
+  {
+    this->Execute(const_cast<const itk::Object*>(caller), event);
+  }
+
+  virtual void Execute(const itk::Object *caller, const itk::EventObject &event)
+  {
+    const PreprocessingFilterType *filter = dynamic_cast<const PreprocessingFilterType*>(caller);
+    if (filter && itk::IterationEvent().CheckEvent(&event))
+      {
+      this->Stages.push_back(filter->GetStageName());
+      this->NumberOfPixels.push_back(filter->GetStageNumberOfPixels());
+      }
+  }
+
+  std::vector<std::string> Stages;
+  std::vector<itk::SizeValueType> NumberOfPixels;
+};
+
+//------------------------------------------------------------------------------
+bool testProbes()
+{
+  vtkNew<vtkVesselSegmentationMetrics> metrics;
+
+  // nothing is recorded while disabled
+  vtkVesselSegmentationMetrics::Probe probe;
+  probe.Start(metrics.GetPointer(), "disabled");
+  if (probe.IsRunning())
+    {
+    std::cerr << "Probe started with the metrics disabled" << std::endl;
+    return false;
+    }
+  probe.Stop(10);
+  probe.Start(NULL, "none");
+  probe.Stop(10);
+  if (metrics->GetNumberOfRecords() != 0)
+    {
+    std::cerr << "Recorded " << metrics->GetNumberOfRecords() << " stages while disabled" << std::endl;
+    return false;
+    }
+
+  metrics->EnabledOn();
+  probe.Start(metrics.GetPointer(), "tracking");
+  // some CPU work and memory for the stage
+  std::vector<double> values(1 << 20);
+  for (size_t i = 0; i < values.size(); ++i)
+    {
+    values[i] = std::sqrt(static_cast<double>(i));
+    }
+  probe.Stop(static_cast<vtkTypeInt64>(values.size()));
+  probe.Stop(1); // stopped already, not recorded again
+
+  metrics->AddRecord("tracking", 2.0, 3.0, 1024, 100);
+  metrics->AddRecord("merge", 0.5, 0.5, 0, 50);
+
+  if (metrics->GetNumberOfRecords() != 3)
+    {
+    std::cerr << "Expected 3 records, got " << metrics->GetNumberOfRecords() << std::endl;
+    return false;
+    }
+  if (metrics->GetStageName(0) != "tracking" || metrics->GetNumberOfVoxels(0) != (1 << 20) ||
+      metrics->GetWallTime(0) < 0.0 || metrics->GetCPUTime(0) < 0.0 || metrics->GetPeakMemoryDelta(0) < 0)
+    {
+    std::cerr << "Wrong probe record " << metrics->GetStageName(0) << " "
+              << metrics->GetNumberOfVoxels(0) << " " << metrics->GetWallTime(0) << std::endl;
+    return false;
+    }
+  if (metrics->GetStageName(3) != "" || metrics->GetWallTime(-1) != 0.0)
+    {
+    std::cerr << "Records out of range are not empty" << std::endl;
+    return false;
+    }
+  if (metrics->GetStageCount("tracking") != 2 || metrics->GetStageCount("split") != 0 ||
+      metrics->GetStageWallTime("tracking") < 2.0 || metrics->GetStageCPUTime("merge") != 0.5)
+    {
+    std::cerr << "Wrong stage totals" << std::endl;
+    return false;
+    }
+
+  metrics->AddRecord("quote \" and \\", 0.0, 0.0, 0, 0);
+  std::string json = metrics->ExportJSON();
+  if (json.find("\"stages\"") == std::string::npos || json.find("\"totals\"") == std::string::npos ||
+      json.find("{\"name\": \"merge\", \"count\": 1, \"wallTime\": 0.5") == std::string::npos ||
+      json.find("quote \\\" and \\\\") == std::string::npos)
+    {
+    std::cerr << "Unexpected JSON export:" << std::endl << json << std::endl;
+    return false;
+    }
+
+  metrics->Clear();
+  if (metrics->GetNumberOfRecords() != 0 ||
+      metrics->ExportJSON() != "{\n  \"stages\": [],\n  \"totals\": []\n}\n")
+    {
+    std::cerr << "Metrics not cleared:" << std::endl << metrics->ExportJSON() << std::endl;
+    return false;
+    }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool testPreprocessingStages()
+{
+  ImageType::SizeType size;
+  size.Fill(16);
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(size);
+  image->Allocate();
+  image->FillBuffer(150.0f);
+
+  StageObserver::Pointer observer = StageObserver::New();
+  PreprocessingFilterType::Pointer filter = PreprocessingFilterType::New();
+  filter->SetInput(image);
+  filter->SetNumberOfIterations(1);
+  filter->AddObserver(itk::IterationEvent(), observer);
+  filter->Update();
+
+  const char *expected[] = { "sigmoid", "diffusion", "resample", "" };
+  if (observer->Stages.size() != 4)
+    {
+    std::cerr << "Expected 4 stage events, got " << observer->Stages.size() << std::endl;
+    return false;
+    }
+  for (size_t i = 0; i < 4; ++i)
+    {
+    if (observer->Stages[i] != expected[i])
+      {
+      std::cerr << "Expected stage " << expected[i] << ", got " << observer->Stages[i] << std::endl;
+      return false;
+      }
+    }
+  if (observer->NumberOfPixels[0] != 16 * 16 * 16 || observer->NumberOfPixels[3] != 0)
+    {
+    std::cerr << "Wrong number of pixels of the stages" << std::endl;
+    return false;
+    }
+
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int vtkVesselSegmentationMetricsTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[]  )
+{
+  if (!testProbes())
+    {
+    return EXIT_FAILURE;
+    }
+  if (!testPreprocessingStages())
+    {
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -42,6 +42,7 @@
 
 // QT includes
 #include <QString>
+#include <QTimer>
 #include <QWidget>
 
 // STD includes
@@ -61,6 +62,8 @@ public:
   qSlicerVesselSegmentationPreprocessingWidgetPrivate(
     qSlicerVesselSegmentationPreprocessingWidget& object);
   virtual void setupUi(qSlicerVesselSegmentationPreprocessingWidget*);
+
+  QTimer *PreviewTimer;
 };
 
 // --------------------------------------------------------------------------
@@ -69,6 +72,7 @@ qSlicerVesselSegmentationPreprocessingWidgetPrivate
   qSlicerVesselSegmentationPreprocessingWidget& object)
   : q_ptr(&object)
 {
+  this->PreviewTimer = 0;
 }
 
 // --------------------------------------------------------------------------
@@ -76,6 +80,12 @@ void qSlicerVesselSegmentationPreprocessingWidgetPrivate
 ::setupUi(qSlicerVesselSegmentationPreprocessingWidget* widget)
 {
   this->Ui_qSlicerVesselSegmentationPreprocessingWidget::setupUi(widget);
+
+  this->PreviewTimer = new QTimer(widget);
+  this->PreviewTimer->setSingleShot(true);
+  this->PreviewTimer->setInterval(300);
+  QObject::connect(this->PreviewTimer, SIGNAL(timeout()),
+                   widget, SLOT(RequestPreview()));
 }
 
 // --------------------------------------------------------------------------
@@ -93,6 +103,9 @@ qSlicerVesselSegmentationPreprocessingWidget
   beta = 160;
   conductance = 20;
   iterations = 30;
+
+  previewEnabled = false;
+  previewShrinkFactor = 2;
 }
 
 //-----------------------------------------------------------------------------
@@ -117,6 +130,7 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnLTSpin(int value)
   //std::cout << "preWidget - On LT spin " << value << std::endl;
 
   this->lowerThreshold = value;
+  this->SchedulePreview();
 }
 
 void qSlicerVesselSegmentationPreprocessingWidget::OnUTSpin(int value)
@@ -124,6 +138,7 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnUTSpin(int value)
   //std::cout << "preWidget - On UT spin " << value << std::endl;
 
   this->upperThreshold = value;
+  this->SchedulePreview();
 }
 
 void qSlicerVesselSegmentationPreprocessingWidget::OnAlphaSpin(int value)
@@ -131,6 +146,7 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnAlphaSpin(int value)
   //std::cout << "preWidget - On Alpha spin " << value << std::endl;
 
   this->alpha = (unsigned int) value;
+  this->SchedulePreview();
 }
 
 void qSlicerVesselSegmentationPreprocessingWidget::OnBetaSpin(int value)
@@ -138,6 +154,7 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnBetaSpin(int value)
   //std::cout << "preWidget - On Beta spin " << value << std::endl;
 
   this->beta = value;
+  this->SchedulePreview();
 }
 
 void qSlicerVesselSegmentationPreprocessingWidget::OnConductanceSpin(int value)
@@ -145,6 +162,7 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnConductanceSpin(int value)
   //std::cout << "preWidget - On Conductance spin " << value << std::endl;
 
   this->conductance = (unsigned int) value;
+  this->SchedulePreview();
 }
 
 void qSlicerVesselSegmentationPreprocessingWidget::OnIterationsSpin(int value)
@@ -152,6 +170,42 @@ void qSlicerVesselSegmentationPreprocessingWidget::OnIterationsSpin(int value)
   //std::cout << "preWidget - On Iterations spin " << value << std::endl;
 
   this->iterations = (unsigned int) value;
+  this->SchedulePreview();
+}
+
+void qSlicerVesselSegmentationPreprocessingWidget::OnPreviewToggled(bool checked)
+{
+  this->previewEnabled = checked;
+  this->SchedulePreview();
+}
+
+void qSlicerVesselSegmentationPreprocessingWidget::OnPreviewScale(int index)
+{
+  this->previewShrinkFactor = (index == 1) ? 4 : 2;
+  this->SchedulePreview();
+}
+
+void qSlicerVesselSegmentationPreprocessingWidget::SchedulePreview()
+{
+  Q_D(qSlicerVesselSegmentationPreprocessingWidget);
+
+  if (!this->previewEnabled)
+    {
+    return;
+    }
+
+  d->PreviewTimer->start();
+}
+
+void qSlicerVesselSegmentationPreprocessingWidget::RequestPreview()
+{
+  if (!this->previewEnabled)
+    {
+    return;
+    }
+
+  emit PreviewRequested(this->lowerThreshold, this->upperThreshold, this->alpha, this->beta,
+                        this->conductance, this->iterations, this->previewShrinkFactor);
 }
 
 
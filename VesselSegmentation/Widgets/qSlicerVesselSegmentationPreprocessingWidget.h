@@ -82,6 +82,19 @@ class Q_SLICER_MODULE_VESSELSEGMENTATION_WIDGETS_EXPORT qSlicerVesselSegmentatio
   */
  void PreprocessingClicked(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations);
 
+ /**
+  * Signal emited when the parameters change while the live preview is on
+  *
+  * @param lower threshold from spin box
+  * @param upper threshold from spin box
+  * @param alpha from spin box
+  * @param beta from spin box
+  * @param conductance from spin box
+  * @param interations from spin box
+  * @param downsampling factor of the preview
+  */
+ void PreviewRequested(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations, unsigned int shrinkFactor);
+
 
  protected slots:
 
@@ -132,7 +145,33 @@ class Q_SLICER_MODULE_VESSELSEGMENTATION_WIDGETS_EXPORT qSlicerVesselSegmentatio
    */
   void OnIterationsSpin(int value);
 
+  /**
+   * Triggered when the live preview check box is toggled
+   *
+   * @param if the live preview is on.
+   */
+  void OnPreviewToggled(bool checked);
+
+  /**
+   * Triggered when the preview scale combo box is changed
+   *
+   * @param index of the combo box (0: 1/2, 1: 1/4).
+   */
+  void OnPreviewScale(int index);
+
+  /**
+   * Triggered when the parameters have settled, emits the preview request
+   */
+  void RequestPreview();
+
  protected:
+
+  /**
+   * Restarts the timer that requests a preview, so a burst of spin box
+   * changes only results in one preview
+   */
+  void SchedulePreview();
+
   QScopedPointer<qSlicerVesselSegmentationPreprocessingWidgetPrivate> d_ptr;
 
   // values for the preprocessing
@@ -143,6 +182,10 @@ class Q_SLICER_MODULE_VESSELSEGMENTATION_WIDGETS_EXPORT qSlicerVesselSegmentatio
   unsigned int conductance;
   unsigned int iterations;
 
+  // values for the live preview
+  bool previewEnabled;
+  unsigned int previewShrinkFactor;
+
  private:
   Q_DECLARE_PRIVATE(qSlicerVesselSegmentationPreprocessingWidget);
   Q_DISABLE_COPY(qSlicerVesselSegmentationPreprocessingWidget);
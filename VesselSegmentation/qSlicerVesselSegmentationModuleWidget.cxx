@@ -124,6 +124,10 @@ void qSlicerVesselSegmentationModuleWidget::setup()
                    SIGNAL(PreprocessingClicked(int,int,unsigned int,int,unsigned int,unsigned int)),
                    this,
                    SLOT(onPreprocessing(int,int,unsigned int,int,unsigned int,unsigned int)));
+  QObject::connect(d->PreprocessingWidget,
+                   SIGNAL(PreviewRequested(int,int,unsigned int,int,unsigned int,unsigned int,unsigned int)),
+                   this,
+                   SLOT(onPreprocessingPreview(int,int,unsigned int,int,unsigned int,unsigned int,unsigned int)));
 
   // connections to segmentation widget
   QObject::connect(d->SegmentationWidget,
@@ -149,6 +153,17 @@ void qSlicerVesselSegmentationModuleWidget::setup()
                    this,
                    SLOT(onRunSeedAssignment(bool)));
 
+  QObject::connect(d->CancelJobButton,
+                   SIGNAL(clicked()),
+                   this,
+                   SLOT(onCancelJob()));
+
+  // keep the views responsive while computing
+  if (this->vesselSegmentationLogic())
+    {
+    this->vesselSegmentationLogic()->AsynchronousOn();
+    }
+
   this->Superclass::setup();
 }
 
@@ -163,6 +178,18 @@ void qSlicerVesselSegmentationModuleWidget::enter()
 
   this->qvtkConnect(this->mrmlScene(), vtkMRMLScene::NodeRemovedEvent,
                      this, SLOT(onNodeRemovedEvent(vtkObject*, vtkObject*)));
+
+  vtkSlicerVesselSegmentationLogic *logic = this->vesselSegmentationLogic();
+  if (logic)
+    {
+    this->qvtkConnect(logic, vtkSlicerVesselSegmentationLogic::JobStartedEvent,
+                      this, SLOT(onJobStateChanged()));
+    this->qvtkConnect(logic, vtkSlicerVesselSegmentationLogic::JobFinishedEvent,
+                      this, SLOT(onJobStateChanged()));
+    this->qvtkConnect(logic, vtkCommand::ProgressEvent,
+                      this, SLOT(onJobProgress(vtkObject*, void*)));
+    }
+  this->onJobStateChanged();
 }
 
 void qSlicerVesselSegmentationModuleWidget::exit()
@@ -224,6 +251,12 @@ void qSlicerVesselSegmentationModuleWidget::onPreprocessing(int lowerThreshold,
   this->vesselSegmentationLogic()->PreprocessImage( lowerThreshold, upperThreshold, alpha, beta, conductance, iterations);
 }
 
+//------------------------------------------------------------------------------
+void qSlicerVesselSegmentationModuleWidget::onPreprocessingPreview(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations, unsigned int shrinkFactor)
+{
+  this->vesselSegmentationLogic()->PreprocessImagePreview( lowerThreshold, upperThreshold, alpha, beta, conductance, iterations, shrinkFactor);
+}
+
 //------------------------------------------------------------------------------
 /*
  * Functions associated with segmentation widget
@@ -439,3 +472,65 @@ void qSlicerVesselSegmentationModuleWidget::onPreprocessing(int lowerThreshold,
        }
      }
  }
+
+ //------------------------------------------------------------------------------
+ /*
+  * Functions associated with the jobs run by the logic
+  */
+ void qSlicerVesselSegmentationModuleWidget::onCancelJob()
+ {
+   if (!this->vesselSegmentationLogic())
+     {
+     std::cerr << "Error: No module logic." << std::endl;
+     return;
+     }
+
+   this->vesselSegmentationLogic()->CancelJob();
+ }
+
+ //------------------------------------------------------------------------------
+ void qSlicerVesselSegmentationModuleWidget::onJobStateChanged()
+ {
+   Q_D(qSlicerVesselSegmentationModuleWidget);
+
+   vtkSlicerVesselSegmentationLogic *logic = this->vesselSegmentationLogic();
+   if (!logic)
+     {
+     return;
+     }
+
+   int state = logic->GetJobState();
+   bool busy = (state == vtkSlicerVesselSegmentationLogic::JobRunning ||
+                state == vtkSlicerVesselSegmentationLogic::JobQueued);
+
+   QString status = QString(logic->GetJobName());
+   if (status.isEmpty())
+     {
+     status = vtkSlicerVesselSegmentationLogic::GetJobStateAsString(state);
+     }
+   else
+     {
+     status += QString(": ") + vtkSlicerVesselSegmentationLogic::GetJobStateAsString(state);
+     }
+   if (logic->GetNumberOfPendingJobs() > 0)
+     {
+     status += QString(" (%1 queued)").arg(logic->GetNumberOfPendingJobs());
+     }
+
+   d->JobStatusLabel->setText(status);
+   d->JobProgressBar->setEnabled(busy);
+   d->JobProgressBar->setValue(busy ? static_cast<int>(100 * logic->GetJobProgress()) : 0);
+   d->CancelJobButton->setEnabled(busy);
+ }
+
+ //------------------------------------------------------------------------------
+ void qSlicerVesselSegmentationModuleWidget::onJobProgress(vtkObject*, void *callData)
+ {
+   Q_D(qSlicerVesselSegmentationModuleWidget);
+
+   double *progress = reinterpret_cast<double*>(callData);
+   if (progress)
+     {
+     d->JobProgressBar->setValue(static_cast<int>(100 * (*progress)));
+     }
+ }
@@ -87,6 +87,13 @@ public slots:
    */
    void onPreprocessing(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations);
 
+  /**
+   * Called when the preprocessing parameters change with the live preview on
+   * connected to signal from preprocessing widget: PreviewRequested()
+   * This function sends the parameter information up to the Logic
+   */
+   void onPreprocessingPreview(int lowerThreshold, int upperThreshold, unsigned int alpha, int beta, unsigned int conductance, unsigned int iterations, unsigned int shrinkFactor);
+
  /**
   * Called when the place seeds button is clicked
   * connected to signal from segmentation widget: PlaceSeedsSegClicked()
@@ -137,6 +144,22 @@ public slots:
    */
   void onSeedNodeModifiedEvent();
 
+  /**
+   * Called when the cancel button is clicked
+   * This function cancels the running and queued jobs of the Logic
+   */
+  void onCancelJob();
+
+  /**
+   * Actions to perform when the Logic starts or finishes a job
+   */
+  void onJobStateChanged();
+
+  /**
+   * Actions to perform when the Logic reports the progress of the running job
+   */
+  void onJobProgress(vtkObject*, void *callData);
+
 
 protected:
   vtkSlicerVesselSegmentationLogic *vesselSegmentationLogic();
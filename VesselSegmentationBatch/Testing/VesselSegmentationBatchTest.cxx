@@ -0,0 +1,154 @@
+#if defined(_MSC_VER)
+#pragma warning ( disable : 4786 )
+#endif
+
+#ifdef __BORLANDC__
+#define ITK_LEAN_AND_MEAN
+#endif
+
+#include "itkTestMain.h"
+
+// ITK includes
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkFactoryRegistration.h>
+
+// STD includes
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef WIN32
+# define MODULE_IMPORT __declspec(dllimport)
+#else
+# define MODULE_IMPORT
+#endif
+
+extern "C" MODULE_IMPORT int ModuleEntryPoint(int, char* []);
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// every case of the timing report has a total and none failed
+bool CheckTimingReport(const std::string &fileName, size_t numberOfCases)
+{
+  std::ifstream report(fileName.c_str());
+  std::string line;
+  if (!std::getline(report, line) || line != "case,stage,seconds")
+    {
+    std::cerr << "Timing report " << fileName << " missing or without header" << std::endl;
+    return false;
+    }
+
+  size_t finishedCases = 0;
+  bool batchTotal = false;
+  while (std::getline(report, line))
+    {
+    size_t comma = line.find(',');
+    if (comma == std::string::npos)
+      {
+      std::cerr << "Invalid row '" << line << "' in " << fileName << std::endl;
+      return false;
+      }
+    std::string caseName = line.substr(0, comma);
+    std::string stage = line.substr(comma + 1, line.find(',', comma + 1) - comma - 1);
+    if (stage.find("failed") != std::string::npos)
+      {
+      std::cerr << "Failed case in " << fileName << ": " << line << std::endl;
+      return false;
+      }
+    if (caseName == "batch")
+      {
+      batchTotal = true;
+      }
+    else if (stage == "total")
+      {
+      // the same volume may be processed more than once, rows are counted
+      ++finishedCases;
+      }
+    }
+
+  if (!batchTotal || finishedCases != numberOfCases)
+    {
+    std::cerr << "Timing report " << fileName << " has " << finishedCases
+              << " finished cases, expected " << numberOfCases << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// the label map has voxels of the label
+bool CheckLabelMap(const std::string &fileName, int label)
+{
+  typedef itk::Image<unsigned char, 3> LabelImageType;
+  typedef itk::ImageFileReader<LabelImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fileName);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &e)
+    {
+    std::cerr << "Cannot read " << fileName << ": " << e.GetDescription() << std::endl;
+    return false;
+    }
+
+  itk::SizeValueType numberOfVoxels = 0;
+  itk::ImageRegionConstIterator<LabelImageType> it(reader->GetOutput(),
+                                                   reader->GetOutput()->GetLargestPossibleRegion());
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+    if (it.Get() == label)
+      {
+      ++numberOfVoxels;
+      }
+    }
+
+  if (numberOfVoxels == 0)
+    {
+    std::cerr << "No voxel of label " << label << " in " << fileName << std::endl;
+    return false;
+    }
+  std::cout << fileName << ": " << numberOfVoxels << " voxels of label " << label << std::endl;
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+// CheckOutput <timing report> <number of cases> [<label map> <label>]...
+int CheckOutput(int argc, char *argv[])
+{
+  if (argc < 3 || argc % 2 == 0)
+    {
+    std::cerr << "Usage: " << argv[0]
+              << " <timing report> <number of cases> [<label map> <label>]..." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::itkFactoryRegistration();
+
+  if (!CheckTimingReport(argv[1], static_cast<size_t>(atoi(argv[2]))))
+    {
+    return EXIT_FAILURE;
+    }
+  for (int i = 3; i < argc; i += 2)
+    {
+    if (!CheckLabelMap(argv[i], atoi(argv[i + 1])))
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+void RegisterTests()
+{
+  StringToTestFunctionMap["ModuleEntryPoint"] = ModuleEntryPoint;
+  StringToTestFunctionMap["CheckOutput"] = CheckOutput;
+}
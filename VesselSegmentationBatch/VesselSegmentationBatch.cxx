@@ -0,0 +1,746 @@
+/*=========================================================================
+  Program: NorMIT-Plan
+  Module: VesselSegmentationBatch.cxx
+
+  Copyright (c) 2017, The Intervention Centre, Oslo University Hospital
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice,
+  this list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its contributors
+  may be used to endorse or promote products derived from this software
+  without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  =========================================================================*/
+
+// ITK includes
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkCastImageFilter.h>
+#include <itkAddImageFilter.h>
+#include <itkObjectFactoryBase.h>
+#include <itkMultiThreader.h>
+#include <itkTimeProbe.h>
+#include <itkPluginUtilities.h>
+#include <itkFactoryRegistration.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkXMLPolyDataWriter.h>
+#include <vtkSTLWriter.h>
+
+// module includes
+#include "itkVesselSegmentationPreProcessingFilter.h"
+#include "itkSeedVesselSegmentationImageFilter.h"
+#include "vtkVesselSegmentationHelper.h"
+#include "vtkVesselSegmentationBrickMesher.h"
+
+#include "VesselSegmentationBatchCLP.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef vtkVesselSegmentationHelper::SeedImageType SeedImageType;
+typedef vtkVesselSegmentationHelper::LabelImageType LabelImageType;
+typedef itk::SeedVesselSegmentationImageFilter<SeedImageType, LabelImageType> SeedFilterType;
+
+// labels of the vessel systems, as in the module
+const LabelImageType::PixelType HepaticLabel = 4;
+const LabelImageType::PixelType PortalLabel = 5;
+
+//----------------------------------------------------------------------------
+// a seed and its direction seed, in RAS or IJK
+struct SeedPair
+{
+  bool IsHepatic;
+  double Seed[3];
+  double DirectionSeed[3];
+};
+
+//----------------------------------------------------------------------------
+struct StageTime
+{
+  std::string Stage;
+  double Seconds;
+};
+
+//----------------------------------------------------------------------------
+// inputs, outputs and report of one case
+struct Case
+{
+  Case() : Succeeded(false) {}
+
+  std::string Volume;
+  std::string Seeds;
+  std::string HepaticLabel;
+  std::string PortalLabel;
+  std::string MergedLabel;
+  std::string HepaticModel;
+  std::string PortalModel;
+
+  bool Succeeded;
+  std::string Error;
+  std::vector<StageTime> Times;
+};
+
+//----------------------------------------------------------------------------
+// parameters shared by all the cases
+struct Parameters
+{
+  bool SkipPreprocessing;
+  int LowerThreshold;
+  int UpperThreshold;
+  int Alpha;
+  int Beta;
+  int Conductance;
+  int Iterations;
+  bool SeedsInIJK;
+};
+
+//----------------------------------------------------------------------------
+// cases taken in turn by the threads
+struct BatchState
+{
+  std::vector<Case> *Cases;
+  const Parameters *Settings;
+  size_t NextCase;
+  vtkMutexLock *Lock;
+};
+
+//----------------------------------------------------------------------------
+// times a stage of a case
+class StageClock
+{
+public:
+  StageClock(Case &c, const char *stage) : CurrentCase(c), Stage(stage)
+  {
+    this->Clock.Start();
+  }
+
+  ~StageClock()
+  {
+    this->Clock.Stop();
+    StageTime time;
+    time.Stage = this->Stage;
+    time.Seconds = this->Clock.GetTotal();
+    this->CurrentCase.Times.push_back(time);
+  }
+
+private:
+  Case &CurrentCase;
+  std::string Stage;
+  itk::TimeProbe Clock;
+};
+
+//----------------------------------------------------------------------------
+bool ReadSeeds(const std::string &fileName, std::vector<SeedPair> &seeds, std::string &error)
+{
+  std::ifstream file(fileName.c_str());
+  if (!file)
+    {
+    error = "cannot read seed file " + fileName;
+    return false;
+    }
+
+  std::string line;
+  while (std::getline(file, line))
+    {
+    std::istringstream fields(line);
+    std::string system;
+    if (!(fields >> system) || system[0] == '#')
+      {
+      continue;
+      }
+
+    SeedPair pair;
+    pair.IsHepatic = (system == "hepatic");
+    if ((!pair.IsHepatic && system != "portal") ||
+        !(fields >> pair.Seed[0] >> pair.Seed[1] >> pair.Seed[2]
+                 >> pair.DirectionSeed[0] >> pair.DirectionSeed[1] >> pair.DirectionSeed[2]))
+      {
+      error = "invalid seed line '" + line + "' in " + fileName;
+      return false;
+      }
+    seeds.push_back(pair);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool ReadCaseList(const std::string &fileName, std::vector<Case> &cases)
+{
+  std::ifstream file(fileName.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read case list " << fileName << std::endl;
+    return false;
+    }
+
+  std::string line;
+  while (std::getline(file, line))
+    {
+    std::istringstream fields(line);
+    std::string volume;
+    if (!(fields >> volume) || volume[0] == '#')
+      {
+      continue;
+      }
+
+    Case c;
+    std::string outputDirectory;
+    c.Volume = volume;
+    if (!(fields >> c.Seeds >> outputDirectory))
+      {
+      std::cerr << "Invalid case line '" << line << "' in " << fileName << std::endl;
+      return false;
+      }
+    c.HepaticLabel = outputDirectory + "/hepaticLabel.nrrd";
+    c.PortalLabel = outputDirectory + "/portalLabel.nrrd";
+    c.MergedLabel = outputDirectory + "/mergedLabel.nrrd";
+    c.HepaticModel = outputDirectory + "/hepaticModel.vtk";
+    c.PortalModel = outputDirectory + "/portalModel.vtk";
+    cases.push_back(c);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// seeds are RAS unless given as voxel indices, ITK images are in LPS
+vtkVesselSegmentationHelper::Index3D SeedToIndex(const double seed[3], const SeedImageType *image,
+                                                 bool seedInIJK)
+{
+  vtkVesselSegmentationHelper::Index3D index;
+  if (seedInIJK)
+    {
+    for (int d = 0; d < 3; ++d)
+      {
+      index[d] = static_cast<itk::IndexValueType>(std::floor(seed[d] + 0.5));
+      }
+    return index;
+    }
+
+  SeedImageType::PointType point;
+  point[0] = -seed[0];
+  point[1] = -seed[1];
+  point[2] = seed[2];
+  image->TransformPhysicalPointToIndex(point, index);
+  return index;
+}
+
+//----------------------------------------------------------------------------
+// traces the pairs of seeds of one system, each one adding to the previous output
+LabelImageType::Pointer TraceVessels(const SeedImageType *vesselness, const std::vector<SeedPair> &seeds,
+                                     bool isHepatic, bool seedsInIJK)
+{
+  LabelImageType::Pointer labelMap;
+  for (size_t s = 0; s < seeds.size(); ++s)
+    {
+    if (seeds[s].IsHepatic != isHepatic)
+      {
+      continue;
+      }
+
+    SeedFilterType::Pointer filter = SeedFilterType::New();
+    filter->SetInput(vesselness);
+    filter->SetSeed(SeedToIndex(seeds[s].Seed, vesselness, seedsInIJK));
+    filter->SetDirectionSeed(SeedToIndex(seeds[s].DirectionSeed, vesselness, seedsInIJK));
+    filter->SetOutputLabel(isHepatic ? HepaticLabel : PortalLabel);
+    if (labelMap.IsNotNull())
+      {
+      filter->SetPreviousOutput(labelMap);
+      }
+    filter->Update();
+
+    labelMap = filter->GetOutput();
+    labelMap->DisconnectPipeline();
+    }
+
+  // a system without seeds has an empty label map
+  if (labelMap.IsNull())
+    {
+    labelMap = LabelImageType::New();
+    labelMap->CopyInformation(vesselness);
+    labelMap->SetRegions(vesselness->GetLargestPossibleRegion());
+    labelMap->Allocate();
+    labelMap->FillBuffer(0);
+    }
+  return labelMap;
+}
+
+//----------------------------------------------------------------------------
+void WriteLabelMap(const LabelImageType *labelMap, const std::string &fileName)
+{
+  typedef itk::ImageFileWriter<LabelImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(labelMap);
+  writer->SetFileName(fileName);
+  writer->SetUseCompression(true);
+  writer->Update();
+}
+
+//----------------------------------------------------------------------------
+bool EndsWith(const std::string &text, const std::string &end)
+{
+  return text.size() >= end.size() &&
+      text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+//----------------------------------------------------------------------------
+bool WriteModel(vtkPolyData *model, const std::string &fileName)
+{
+  if (EndsWith(fileName, ".vtp"))
+    {
+    vtkNew<vtkXMLPolyDataWriter> writer;
+    writer->SetInputData(model);
+    writer->SetFileName(fileName.c_str());
+    return writer->Write() != 0;
+    }
+  if (EndsWith(fileName, ".stl"))
+    {
+    vtkNew<vtkSTLWriter> writer;
+    writer->SetInputData(model);
+    writer->SetFileName(fileName.c_str());
+    return writer->Write() != 0;
+    }
+  vtkNew<vtkPolyDataWriter> writer;
+  writer->SetInputData(model);
+  writer->SetFileName(fileName.c_str());
+  return writer->Write() != 0;
+}
+
+//----------------------------------------------------------------------------
+// voxel indices to RAS, the models are placed like the ones of the module
+void ComputeIJKToRASMatrix(const LabelImageType *image, vtkMatrix4x4 *matrix)
+{
+  matrix->Identity();
+  for (int row = 0; row < 3; ++row)
+    {
+    // LPS to RAS flips the first two axes
+    double flip = row < 2 ? -1.0 : 1.0;
+    for (int col = 0; col < 3; ++col)
+      {
+      matrix->SetElement(row, col,
+                         flip * image->GetDirection()[row][col] * image->GetSpacing()[col]);
+      }
+    matrix->SetElement(row, 3, flip * image->GetOrigin()[row]);
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class TPixel>
+void ProcessCase(Case &c, const Parameters &settings, const std::vector<SeedPair> &seeds)
+{
+  typedef itk::Image<TPixel, 3> InputImageType;
+
+  typename InputImageType::Pointer volume;
+  {
+  StageClock clock(c, "read");
+  typedef itk::ImageFileReader<InputImageType> ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(c.Volume);
+  reader->Update();
+  volume = reader->GetOutput();
+  volume->DisconnectPipeline();
+  }
+
+  SeedImageType::Pointer vesselness;
+  {
+  StageClock clock(c, "preprocessing");
+  if (settings.SkipPreprocessing)
+    {
+    typedef itk::CastImageFilter<InputImageType, SeedImageType> CastFilterType;
+    typename CastFilterType::Pointer cast = CastFilterType::New();
+    cast->SetInput(volume);
+    cast->Update();
+    vesselness = cast->GetOutput();
+    }
+  else
+    {
+    typedef itk::VesselSegmentationPreProcessingFilter<InputImageType, SeedImageType> PreprocessingFilterType;
+    typename PreprocessingFilterType::Pointer preprocessing = PreprocessingFilterType::New();
+    preprocessing->SetInput(volume);
+    preprocessing->SetLowerThreshold(settings.LowerThreshold);
+    preprocessing->SetUpperThreshold(settings.UpperThreshold);
+    preprocessing->SetAlpha(settings.Alpha);
+    preprocessing->SetBeta(settings.Beta);
+    preprocessing->SetConductance(settings.Conductance);
+    preprocessing->SetNumberOfIterations(settings.Iterations);
+    preprocessing->Update();
+    vesselness = preprocessing->GetOutput();
+    }
+  vesselness->DisconnectPipeline();
+  }
+  volume = NULL;
+
+  LabelImageType::Pointer hepatic;
+  {
+  StageClock clock(c, "hepatic segmentation");
+  hepatic = TraceVessels(vesselness, seeds, true, settings.SeedsInIJK);
+  }
+
+  LabelImageType::Pointer portal;
+  {
+  StageClock clock(c, "portal segmentation");
+  portal = TraceVessels(vesselness, seeds, false, settings.SeedsInIJK);
+  }
+  vesselness = NULL;
+
+  LabelImageType::Pointer merged;
+  {
+  StageClock clock(c, "merge");
+  typedef itk::AddImageFilter<LabelImageType, LabelImageType> AddFilterType;
+  AddFilterType::Pointer add = AddFilterType::New();
+  add->SetInput1(hepatic);
+  add->SetInput2(portal);
+  add->Update();
+  merged = add->GetOutput();
+  }
+
+  {
+  StageClock clock(c, "write label maps");
+  if (!c.HepaticLabel.empty())
+    {
+    WriteLabelMap(hepatic, c.HepaticLabel);
+    }
+  if (!c.PortalLabel.empty())
+    {
+    WriteLabelMap(portal, c.PortalLabel);
+    }
+  if (!c.MergedLabel.empty())
+    {
+    WriteLabelMap(merged, c.MergedLabel);
+    }
+  }
+
+  if (c.HepaticModel.empty() && c.PortalModel.empty())
+    {
+    c.Succeeded = true;
+    return;
+    }
+
+  vtkNew<vtkVesselSegmentationBrickMesher> mesher;
+  {
+  StageClock clock(c, "models");
+  // the VTK images share the buffers of the label maps
+  vtkSmartPointer<vtkImageData> hepaticData =
+      vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(hepatic);
+  vtkSmartPointer<vtkImageData> portalData =
+      vtkVesselSegmentationHelper::ConvertItkImageToVtkImageData(portal);
+  if (!hepaticData || !portalData)
+    {
+    c.Error = "label maps too large to be meshed";
+    return;
+    }
+
+  vtkNew<vtkMatrix4x4> ijkToRas;
+  ComputeIJKToRASMatrix(hepatic, ijkToRas.GetPointer());
+
+  mesher->SetNumberOfLabels(2);
+  mesher->SetLabel(0, HepaticLabel);
+  mesher->SetLabel(1, PortalLabel);
+  mesher->SetTransformMatrix(ijkToRas.GetPointer());
+  mesher->SetInputData(hepaticData);
+  mesher->AddInputData(portalData);
+  mesher->Update();
+  }
+
+  {
+  StageClock clock(c, "write models");
+  if (!c.HepaticModel.empty() && !WriteModel(mesher->GetOutput(0), c.HepaticModel))
+    {
+    c.Error = "cannot write " + c.HepaticModel;
+    return;
+    }
+  if (!c.PortalModel.empty() && !WriteModel(mesher->GetOutput(1), c.PortalModel))
+    {
+    c.Error = "cannot write " + c.PortalModel;
+    return;
+    }
+  }
+
+  c.Succeeded = true;
+}
+
+//----------------------------------------------------------------------------
+void RunCase(Case &c, const Parameters &settings)
+{
+  itk::TimeProbe clock;
+  clock.Start();
+
+  std::vector<SeedPair> seeds;
+  if (!ReadSeeds(c.Seeds, seeds, c.Error))
+    {
+    return;
+    }
+
+  try
+    {
+    itk::ImageIOBase::IOPixelType pixelType;
+    itk::ImageIOBase::IOComponentType componentType;
+    itk::GetImageType(c.Volume, pixelType, componentType);
+
+    // the pixel types the preprocessing is instantiated for in the module
+    switch (componentType)
+      {
+      case itk::ImageIOBase::FLOAT:
+        ProcessCase<float>(c, settings, seeds);
+        break;
+      case itk::ImageIOBase::SHORT:
+        ProcessCase<short>(c, settings, seeds);
+        break;
+      case itk::ImageIOBase::UCHAR:
+        ProcessCase<unsigned char>(c, settings, seeds);
+        break;
+      case itk::ImageIOBase::UINT:
+        ProcessCase<unsigned int>(c, settings, seeds);
+        break;
+      default:
+        c.Error = "unsupported pixel type of " + c.Volume;
+        break;
+      }
+    }
+  catch (itk::ExceptionObject &e)
+    {
+    c.Error = e.GetDescription();
+    c.Succeeded = false;
+    }
+  catch (const std::exception &e)
+    {
+    // e.g. out of memory on a large case, which must not end the other cases
+    c.Error = e.what();
+    c.Succeeded = false;
+    }
+
+  clock.Stop();
+  StageTime total;
+  total.Stage = "total";
+  total.Seconds = clock.GetTotal();
+  c.Times.push_back(total);
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE RunCasesThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  BatchState *state = static_cast<BatchState*>(info->UserData);
+
+  for (;;)
+    {
+    state->Lock->Lock();
+    size_t caseId = state->NextCase++;
+    state->Lock->Unlock();
+    if (caseId >= state->Cases->size())
+      {
+      break;
+      }
+
+    Case &c = (*state->Cases)[caseId];
+    RunCase(c, *state->Settings);
+
+    state->Lock->Lock();
+    if (c.Succeeded)
+      {
+      std::cout << "Finished " << c.Volume << " in " << c.Times.back().Seconds << "s" << std::endl;
+      }
+    else
+      {
+      std::cerr << "Failed " << c.Volume << ": " << c.Error << std::endl;
+      }
+    state->Lock->Unlock();
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+// quotes a CSV field, the error messages may contain commas and quotes
+std::string CsvField(const std::string &text)
+{
+  std::string field = "\"";
+  for (size_t i = 0; i < text.size(); ++i)
+    {
+    field += text[i];
+    if (text[i] == '"')
+      {
+      field += '"';
+      }
+    }
+  return field + "\"";
+}
+
+//----------------------------------------------------------------------------
+bool WriteTimingReport(const std::vector<Case> &cases, double wallTime, const std::string &fileName)
+{
+  std::ofstream report(fileName.c_str());
+  if (!report)
+    {
+    return false;
+    }
+  report << "case,stage,seconds\n";
+  for (size_t c = 0; c < cases.size(); ++c)
+    {
+    for (size_t t = 0; t < cases[c].Times.size(); ++t)
+      {
+      report << cases[c].Volume << "," << cases[c].Times[t].Stage << ","
+             << cases[c].Times[t].Seconds << "\n";
+      }
+    if (!cases[c].Succeeded)
+      {
+      report << cases[c].Volume << "," << CsvField("failed: " + cases[c].Error) << ",0\n";
+      }
+    }
+  report << "batch,total," << wallTime << "\n";
+  return report.good();
+}
+
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  PARSE_ARGS;
+
+  itk::itkFactoryRegistration();
+
+  std::vector<Case> cases;
+  if (!caseList.empty())
+    {
+    if (!ReadCaseList(caseList, cases))
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  if (!inputVolume.empty())
+    {
+    Case c;
+    c.Volume = inputVolume;
+    c.Seeds = seeds;
+    c.HepaticLabel = hepaticLabel;
+    c.PortalLabel = portalLabel;
+    c.MergedLabel = mergedLabel;
+    c.HepaticModel = hepaticModel;
+    c.PortalModel = portalModel;
+    cases.push_back(c);
+    }
+  if (cases.empty())
+    {
+    std::cerr << "No case to process, give an input volume or a case list." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // the constraints of the description are not checked on the command line
+  if (numberOfConcurrentCases < 1)
+    {
+    std::cerr << "The number of concurrent cases must be at least 1." << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (threadsPerCase < 0)
+    {
+    std::cerr << "The number of threads per case cannot be negative." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  Parameters settings;
+  settings.SkipPreprocessing = skipPreprocessing;
+  settings.LowerThreshold = lowerThreshold;
+  settings.UpperThreshold = upperThreshold;
+  settings.Alpha = alpha;
+  settings.Beta = beta;
+  settings.Conductance = conductance;
+  settings.Iterations = iterations;
+  settings.SeedsInIJK = seedsInIJK;
+
+  // split the processors between the concurrent cases
+  int concurrentCases = std::min(numberOfConcurrentCases, static_cast<int>(cases.size()));
+  int caseThreads = threadsPerCase;
+  if (caseThreads <= 0)
+    {
+    caseThreads = std::max(1, static_cast<int>(itk::MultiThreader::GetGlobalDefaultNumberOfThreads()) /
+                           concurrentCases);
+    }
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads(caseThreads);
+  vtkMultiThreader::SetGlobalDefaultNumberOfThreads(caseThreads);
+  std::cout << "Processing " << cases.size() << " cases, " << concurrentCases
+            << " at a time with " << caseThreads << " threads each" << std::endl;
+
+  // the image IO factories are registered before the threads use them
+  itk::ObjectFactoryBase::CreateAllInstance("itkImageIOBase");
+
+  itk::TimeProbe clock;
+  clock.Start();
+
+  vtkNew<vtkMutexLock> lock;
+  BatchState state;
+  state.Cases = &cases;
+  state.Settings = &settings;
+  state.NextCase = 0;
+  state.Lock = lock.GetPointer();
+
+  if (concurrentCases == 1)
+    {
+    vtkMultiThreader::ThreadInfo info;
+    info.ThreadID = 0;
+    info.NumberOfThreads = 1;
+    info.UserData = &state;
+    RunCasesThread(&info);
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(concurrentCases);
+    threader->SetSingleMethod(RunCasesThread, &state);
+    threader->SingleMethodExecute();
+    }
+
+  clock.Stop();
+
+  if (!timingReport.empty() && !WriteTimingReport(cases, clock.GetTotal(), timingReport))
+    {
+    std::cerr << "Cannot write the timing report " << timingReport << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  for (size_t c = 0; c < cases.size(); ++c)
+    {
+    if (!cases[c].Succeeded)
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}